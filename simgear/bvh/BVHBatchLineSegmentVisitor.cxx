@@ -0,0 +1,317 @@
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHBatchLineSegmentVisitor.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <thread>
+
+#include "BVHGroup.hxx"
+#include "BVHPageNode.hxx"
+#include "BVHTransform.hxx"
+#include "BVHMotionTransform.hxx"
+#include "BVHLineGeometry.hxx"
+#include "BVHStaticGeometry.hxx"
+#include "BVHFlatTree.hxx"
+
+namespace simgear {
+
+namespace {
+
+// queries hitting one geometry below this count stay on the calling thread
+const size_t PARALLEL_MIN_QUERIES = 256;
+// smallest share of queries worth a thread of its own
+const size_t PARALLEL_CHUNK_QUERIES = 64;
+
+// spreads the low 10 bits of v to every third bit
+inline uint32_t spreadBits(uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+}
+
+BVHBatchLineSegmentVisitor::BVHBatchLineSegmentVisitor(const double& t) :
+    _active(1),
+    _level(0),
+    _sorted(true),
+    _parallel(false),
+    _time(t)
+{
+}
+
+BVHBatchLineSegmentVisitor::~BVHBatchLineSegmentVisitor()
+{
+}
+
+size_t
+BVHBatchLineSegmentVisitor::addLineSegment(const SGLineSegmentd& lineSegment)
+{
+    Query query;
+    query._lineSegment = lineSegment;
+    query._material = 0;
+    query._id = 0;
+    query._haveHit = false;
+    _queries.push_back(query);
+    _sorted = false;
+    return _queries.size() - 1;
+}
+
+size_t
+BVHBatchLineSegmentVisitor::addElevationQuery(const SGGeod& position,
+                                              double belowM)
+{
+    SGGeod bottom = SGGeod::fromGeodM(position, position.getElevationM() - belowM);
+    return addLineSegment(SGLineSegmentd(SGVec3d::fromGeod(position),
+                                         SGVec3d::fromGeod(bottom)));
+}
+
+void
+BVHBatchLineSegmentVisitor::clear()
+{
+    _queries.clear();
+    _active.resize(1);
+    _active[0].clear();
+    _level = 0;
+    _sorted = true;
+}
+
+void
+BVHBatchLineSegmentVisitor::sortQueries()
+{
+    // Order the queries along a Morton curve through their centers, so
+    // queries next to each other in a packet take the same paths.
+    SGBoxd box;
+    for (const Query& query : _queries)
+        box.expandBy(query._lineSegment.getCenter());
+
+    SGVec3d scale;
+    for (unsigned i = 0; i < 3; ++i) {
+        double extent = box.getMax()[i] - box.getMin()[i];
+        scale[i] = 0 < extent ? 1023/extent : 0;
+    }
+
+    std::vector<std::pair<uint32_t, unsigned> > keys(_queries.size());
+    for (unsigned i = 0; i < _queries.size(); ++i) {
+        SGVec3d p = _queries[i]._lineSegment.getCenter() - box.getMin();
+        uint32_t code = spreadBits(uint32_t(p[0]*scale[0]))
+            | spreadBits(uint32_t(p[1]*scale[1])) << 1
+            | spreadBits(uint32_t(p[2]*scale[2])) << 2;
+        keys[i] = std::make_pair(code, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    _active[0].resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        _active[0][i] = keys[i].second;
+    _sorted = true;
+}
+
+bool
+BVHBatchLineSegmentVisitor::pushActive(const SGSphered& sphere)
+{
+    if (_level == 0 && !_sorted)
+        sortQueries();
+    if (_active.size() <= _level + 1)
+        _active.resize(_level + 2);
+
+    const std::vector<unsigned>& current = _active[_level];
+    std::vector<unsigned>& next = _active[_level + 1];
+    next.clear();
+    for (unsigned i : current) {
+        if (intersects(_queries[i]._lineSegment, sphere))
+            next.push_back(i);
+    }
+    if (next.empty())
+        return false;
+    ++_level;
+    return true;
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHGroup& group)
+{
+    if (!pushActive(group.getBoundingSphere()))
+        return;
+    group.traverse(*this);
+    popActive();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHPageNode& pageNode)
+{
+    if (!pushActive(pageNode.getBoundingSphere()))
+        return;
+    pageNode.traverse(*this);
+    popActive();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHTransform& transform)
+{
+    if (!pushActive(transform.getBoundingSphere()))
+        return;
+
+    // Deeper levels may grow _active, so refer to this one by index
+    const unsigned level = _level;
+    const size_t count = _active[level].size();
+    std::vector<SGLineSegmentd> lineSegments(count);
+    std::vector<bool> haveHit(count);
+    for (size_t k = 0; k < count; ++k) {
+        Query& query = _queries[_active[level][k]];
+        lineSegments[k] = query._lineSegment;
+        haveHit[k] = query._haveHit;
+        query._haveHit = false;
+        query._lineSegment = transform.lineSegmentToLocal(lineSegments[k]);
+    }
+
+    transform.traverse(*this);
+
+    for (size_t k = 0; k < count; ++k) {
+        Query& query = _queries[_active[level][k]];
+        if (query._haveHit) {
+            query._linearVelocity = transform.vecToWorld(query._linearVelocity);
+            query._angularVelocity = transform.vecToWorld(query._angularVelocity);
+            SGVec3d point(transform.ptToWorld(query._lineSegment.getEnd()));
+            query._lineSegment.set(lineSegments[k].getStart(), point);
+            query._normal = transform.vecToWorld(query._normal);
+        } else {
+            query._lineSegment = lineSegments[k];
+            query._haveHit = haveHit[k];
+        }
+    }
+    popActive();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHMotionTransform& transform)
+{
+    if (!pushActive(transform.getBoundingSphere()))
+        return;
+
+    // The matrices at _time are the same for all queries
+    const SGMatrixd toLocal = transform.getToLocalTransform(_time);
+    const unsigned level = _level;
+    const size_t count = _active[level].size();
+    std::vector<SGLineSegmentd> lineSegments(count);
+    std::vector<bool> haveHit(count);
+    for (size_t k = 0; k < count; ++k) {
+        Query& query = _queries[_active[level][k]];
+        lineSegments[k] = query._lineSegment;
+        haveHit[k] = query._haveHit;
+        query._haveHit = false;
+        query._lineSegment = lineSegments[k].transform(toLocal);
+    }
+
+    transform.traverse(*this);
+
+    const SGMatrixd toWorld = transform.getToWorldTransform(_time);
+    for (size_t k = 0; k < count; ++k) {
+        Query& query = _queries[_active[level][k]];
+        if (query._haveHit) {
+            SGVec3d localStart = query._lineSegment.getStart();
+            query._linearVelocity += transform.getLinearVelocityAt(localStart);
+            query._angularVelocity += transform.getAngularVelocity();
+            query._linearVelocity = toWorld.xformVec(query._linearVelocity);
+            query._angularVelocity = toWorld.xformVec(query._angularVelocity);
+            SGVec3d localEnd = query._lineSegment.getEnd();
+            query._lineSegment.set(lineSegments[k].getStart(),
+                                   toWorld.xformPt(localEnd));
+            query._normal = toWorld.xformVec(query._normal);
+            if (!query._id)
+                query._id = transform.getId();
+        } else {
+            query._lineSegment = lineSegments[k];
+            query._haveHit = haveHit[k];
+        }
+    }
+    popActive();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHLineGeometry&)
+{
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHStaticGeometry& node)
+{
+    if (!pushActive(node.getBoundingSphere()))
+        return;
+
+    const std::vector<unsigned>& active = getActive();
+    const size_t count = active.size();
+    std::vector<SGLineSegmentd> lineSegments(count);
+    for (size_t k = 0; k < count; ++k)
+        lineSegments[k] = _queries[active[k]]._lineSegment;
+
+    const BVHFlatTree* flatTree = node.getFlatTree();
+    std::vector<BVHFlatTree::Hit> hits(count);
+    if (_parallel && PARALLEL_MIN_QUERIES <= count) {
+        // whole packets of four per thread, the flat tree is read only
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, count/PARALLEL_CHUNK_QUERIES);
+        size_t chunk = ((count + threads - 1)/threads + 3) & ~size_t(3);
+        std::vector<std::future<void> > futures;
+        for (size_t begin = chunk; begin < count; begin += chunk) {
+            size_t n = std::min(chunk, count - begin);
+            futures.push_back(std::async(std::launch::async, [&, begin, n]() {
+                flatTree->intersect(&lineSegments[begin], &hits[begin], n);
+            }));
+        }
+        flatTree->intersect(lineSegments.data(), hits.data(),
+                            std::min(chunk, count));
+        for (auto& future : futures)
+            future.get();
+    } else {
+        flatTree->intersect(lineSegments.data(), hits.data(), count);
+    }
+
+    for (size_t k = 0; k < count; ++k) {
+        if (!hits[k].valid)
+            continue;
+        Query& query = _queries[active[k]];
+        query._lineSegment.set(query._lineSegment.getStart(), hits[k].point);
+        query._normal = hits[k].normal;
+        query._linearVelocity = SGVec3d::zeros();
+        query._angularVelocity = SGVec3d::zeros();
+        query._material = hits[k].material;
+        query._id = 0;
+        query._haveHit = true;
+    }
+    popActive();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(const BVHStaticBinary&, const BVHStaticData&)
+{
+    // static geometry is answered through its flat tree
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(const BVHStaticTriangle&, const BVHStaticData&)
+{
+}
+
+}
@@ -0,0 +1,116 @@
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHBatchLineSegmentVisitor_hxx
+#define BVHBatchLineSegmentVisitor_hxx
+
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+
+#include "BVHVisitor.hxx"
+#include "BVHNode.hxx"
+
+namespace simgear {
+
+class BVHMaterial;
+
+/// Intersects many line segments with a tree in one traversal. Each
+/// query gets the answer a BVHLineSegmentVisitor would give for it, but
+/// groups, page nodes and transforms are visited once for all queries
+/// that reach them, and static geometry is hit with packets of spatially
+/// sorted queries.
+class BVHBatchLineSegmentVisitor : public BVHVisitor {
+public:
+    BVHBatchLineSegmentVisitor(const double& t = 0);
+    virtual ~BVHBatchLineSegmentVisitor();
+
+    /// Returns the index of the query.
+    size_t addLineSegment(const SGLineSegmentd& lineSegment);
+    /// Query for the ground below position, down to belowM meters under
+    /// it. getElevationM() then gives the terrain elevation.
+    size_t addElevationQuery(const SGGeod& position, double belowM = 10000);
+    void clear();
+
+    /// Split large packets of queries hitting the same geometry across
+    /// threads.
+    void setParallel(bool parallel)
+    { _parallel = parallel; }
+    bool getParallel() const
+    { return _parallel; }
+
+    size_t getNumQueries() const
+    { return _queries.size(); }
+
+    bool empty(size_t i) const
+    { return !_queries[i]._haveHit; }
+    const SGLineSegmentd& getLineSegment(size_t i) const
+    { return _queries[i]._lineSegment; }
+    SGVec3d getPoint(size_t i) const
+    { return _queries[i]._lineSegment.getEnd(); }
+    double getElevationM(size_t i) const
+    { return SGGeod::fromCart(getPoint(i)).getElevationM(); }
+    const SGVec3d& getNormal(size_t i) const
+    { return _queries[i]._normal; }
+    const SGVec3d& getLinearVelocity(size_t i) const
+    { return _queries[i]._linearVelocity; }
+    const SGVec3d& getAngularVelocity(size_t i) const
+    { return _queries[i]._angularVelocity; }
+    const BVHMaterial* getMaterial(size_t i) const
+    { return _queries[i]._material; }
+    BVHNode::Id getId(size_t i) const
+    { return _queries[i]._id; }
+
+    virtual void apply(BVHGroup& group);
+    virtual void apply(BVHPageNode& node);
+    virtual void apply(BVHTransform& transform);
+    virtual void apply(BVHMotionTransform& transform);
+    virtual void apply(BVHLineGeometry&);
+    virtual void apply(BVHStaticGeometry& node);
+
+    virtual void apply(const BVHStaticBinary&, const BVHStaticData&);
+    virtual void apply(const BVHStaticTriangle&, const BVHStaticData&);
+
+private:
+    struct Query {
+        SGLineSegmentd _lineSegment;
+        SGVec3d _normal;
+        SGVec3d _linearVelocity;
+        SGVec3d _angularVelocity;
+        const BVHMaterial* _material;
+        BVHNode::Id _id;
+        bool _haveHit;
+    };
+
+    void sortQueries();
+    bool pushActive(const SGSphered& sphere);
+    void popActive()
+    { --_level; }
+    const std::vector<unsigned>& getActive() const
+    { return _active[_level]; }
+
+    std::vector<Query> _queries;
+    /// indices of the queries still in play at each traversal level,
+    /// level 0 holds all of them in spatial order
+    std::vector<std::vector<unsigned> > _active;
+    unsigned _level;
+    bool _sorted;
+    bool _parallel;
+    double _time;
+};
+
+}
+
+#endif
@@ -0,0 +1,550 @@
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHFlatTree.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include <simgear/math/simd.hxx>
+
+#include "BVHVisitor.hxx"
+#include "BVHStaticBinary.hxx"
+#include "BVHStaticTriangle.hxx"
+
+namespace simgear {
+
+namespace {
+
+typedef simd4_t<float,4> Lanes;
+
+const unsigned QUANT_MAX = 0xffff;
+// same relative tolerance BVHLineSegmentVisitor passes to intersects()
+const float TRIANGLE_EPS = 1e-4f;
+// traversal stacks of deeper trees go to the heap
+const unsigned STACK_SIZE = 64;
+
+struct StackEntry {
+    uint32_t _ref;
+    float _near;
+    float _min[3];
+    float _max[3];
+};
+
+inline float inverse(float d)
+{
+    // keep the slab computations finite for axis parallel segments
+    if (std::fabs(d) < 1e-30f)
+        return 1e30f;
+    return 1/d;
+}
+
+// Moeller/Trumbore acceptance test in the division free form of
+// intersects(SGVec3f&, const SGTrianglef&, const SGLineSegmentf&, float),
+// with the segment end replaced by the current nearest fraction.
+inline bool
+acceptTriangleHit(float denom, float tDenom, float u, float v, float& fraction)
+{
+    if (tDenom < 0)
+        return false;
+    float absDenom = std::fabs(denom);
+    if (absDenom*fraction < tDenom)
+        return false;
+    float absDenomEps = absDenom*TRIANGLE_EPS;
+    if (u < -absDenomEps || v < -absDenomEps)
+        return false;
+    if (u + v > absDenom + absDenomEps)
+        return false;
+    if (absDenom <= SGLimitsf::min())
+        return false;
+    fraction = tDenom/absDenom;
+    return true;
+}
+
+}
+
+class BVHFlatTree::Collector : public BVHVisitor {
+public:
+    Collector(BVHFlatTree& tree) :
+        _tree(tree),
+        _ref(0),
+        _depth(0),
+        _maxDepth(0)
+    { }
+
+    virtual void apply(BVHGroup&) { }
+    virtual void apply(BVHPageNode&) { }
+    virtual void apply(BVHTransform&) { }
+    virtual void apply(BVHMotionTransform&) { }
+    virtual void apply(BVHLineGeometry&) { }
+    virtual void apply(BVHStaticGeometry&) { }
+
+    virtual void apply(const BVHStaticBinary& node, const BVHStaticData& data)
+    {
+        uint32_t index = static_cast<uint32_t>(_tree._nodes.size());
+        _tree._nodes.push_back(Node());
+        _childBoxes.resize(2*_tree._nodes.size());
+        _maxDepth = std::max(_maxDepth, ++_depth);
+
+        node.getLeftChild()->accept(*this, data);
+        uint32_t left = _ref;
+        _childBoxes[2*index] = _box;
+        node.getRightChild()->accept(*this, data);
+        _childBoxes[2*index + 1] = _box;
+        --_depth;
+
+        _tree._nodes[index]._child[0] = left;
+        _tree._nodes[index]._child[1] = _ref;
+        _box.expandBy(_childBoxes[2*index]);
+        _ref = index;
+    }
+    virtual void apply(const BVHStaticTriangle& triangle,
+                       const BVHStaticData& data)
+    {
+        SGTrianglef tri = triangle.getTriangle(data);
+        Triangle flat;
+        flat._v0 = tri.getBaseVertex();
+        flat._edge[0] = tri.getEdge(0);
+        flat._edge[1] = tri.getEdge(1);
+        flat._normal = tri.getNormal();
+        flat._material = triangle.getMaterialIndex();
+
+        _ref = LEAF_FLAG | static_cast<uint32_t>(_tree._triangles.size());
+        _tree._triangles.push_back(flat);
+        _box.clear();
+        for (unsigned i = 0; i < 3; ++i)
+            _box.expandBy(tri.getVertex(i));
+    }
+
+    BVHFlatTree& _tree;
+    /// exact boxes of both children of each node, only needed to quantize
+    std::vector<SGBoxf> _childBoxes;
+    /// reference to and box of the subtree visited last
+    uint32_t _ref;
+    SGBoxf _box;
+    unsigned _depth;
+    unsigned _maxDepth;
+};
+
+/// Four segments traversed together, lane i holds segment i.
+struct BVHFlatTree::Packet {
+    Lanes _start[3];
+    Lanes _direction[3];
+    Lanes _inverse[3];
+    /// nearest hit so far, negative for unused lanes
+    Lanes _fraction;
+    uint32_t _triangle[4];
+};
+
+namespace {
+
+inline float
+dequantize(const float* min, const float* max, unsigned axis, unsigned q)
+{
+    if (q == QUANT_MAX)
+        return max[axis];
+    float scale = (max[axis] - min[axis])*(1.0f/QUANT_MAX);
+    return min[axis] + q*scale;
+}
+
+// Both rounding directions are checked against dequantize() itself, so
+// decoded child boxes always contain the exact ones.
+inline uint16_t
+quantizeMin(const float* min, const float* max, unsigned axis, float value)
+{
+    float extent = max[axis] - min[axis];
+    if (!(0 < extent))
+        return 0;
+    float f = std::floor((value - min[axis])/extent*QUANT_MAX);
+    unsigned q = unsigned(SGMiscf::clip(f, 0, QUANT_MAX));
+    while (0 < q && value < dequantize(min, max, axis, q))
+        --q;
+    return q;
+}
+
+inline uint16_t
+quantizeMax(const float* min, const float* max, unsigned axis, float value)
+{
+    float extent = max[axis] - min[axis];
+    if (!(0 < extent))
+        return QUANT_MAX;
+    float f = std::ceil((value - min[axis])/extent*QUANT_MAX);
+    unsigned q = unsigned(SGMiscf::clip(f, 0, QUANT_MAX));
+    while (q < QUANT_MAX && dequantize(min, max, axis, q) < value)
+        ++q;
+    return q;
+}
+
+// Slab test of one segment against a box, the three axes in the lanes
+// of one simd4_t. Returns the entry fraction through near.
+inline bool
+intersectBox(const StackEntry& box, const Lanes& start, const Lanes& inv,
+             float fraction, float& near)
+{
+    Lanes t1 = (Lanes(box._min[0], box._min[1], box._min[2], 0) - start)*inv;
+    Lanes t2 = (Lanes(box._max[0], box._max[1], box._max[2], 0) - start)*inv;
+    Lanes tNear = simd4::min(t1, t2);
+    Lanes tFar = simd4::max(t1, t2);
+    near = std::max(std::max(tNear[0], tNear[1]), std::max(tNear[2], 0.0f));
+    float far = std::min(std::min(tFar[0], tFar[1]), std::min(tFar[2], fraction));
+    return near <= far;
+}
+
+}
+
+BVHFlatTree::BVHFlatTree(const BVHStaticNode* staticNode,
+                         const BVHStaticData* staticData) :
+    _root(0),
+    _depth(0),
+    _staticData(staticData)
+{
+    Collector collector(*this);
+    staticNode->accept(collector, *staticData);
+    _root = collector._ref;
+    _depth = collector._maxDepth;
+    _box = collector._box;
+
+    if (!(_root & LEAF_FLAG)) {
+        Box box;
+        for (unsigned i = 0; i < 3; ++i) {
+            box._min[i] = _box.getMin()[i];
+            box._max[i] = _box.getMax()[i];
+        }
+        quantize(_root, box, collector._childBoxes);
+    }
+}
+
+BVHFlatTree::~BVHFlatTree()
+{
+}
+
+void
+BVHFlatTree::quantize(uint32_t nodeIndex, const Box& box,
+                      const std::vector<SGBoxf>& childBoxes)
+{
+    Node& node = _nodes[nodeIndex];
+    for (unsigned c = 0; c < 2; ++c) {
+        const SGBoxf& child = childBoxes[2*nodeIndex + c];
+        for (unsigned i = 0; i < 3; ++i) {
+            node._bounds[c][i] = quantizeMin(box._min, box._max, i,
+                                             child.getMin()[i]);
+            node._bounds[c][3 + i] = quantizeMax(box._min, box._max, i,
+                                                 child.getMax()[i]);
+        }
+        // children are quantized relative to the decoded box, which is
+        // what the traversal has at hand
+        if (!(node._child[c] & LEAF_FLAG)) {
+            Box decoded;
+            decode(node, c, box, decoded);
+            quantize(node._child[c], decoded, childBoxes);
+        }
+    }
+}
+
+void
+BVHFlatTree::decode(const Node& node, unsigned child, const Box& parent,
+                    Box& box)
+{
+    for (unsigned i = 0; i < 3; ++i) {
+        box._min[i] = dequantize(parent._min, parent._max, i,
+                                 node._bounds[child][i]);
+        box._max[i] = dequantize(parent._min, parent._max, i,
+                                 node._bounds[child][3 + i]);
+    }
+}
+
+bool
+BVHFlatTree::intersectTriangle(const Triangle& triangle, const SGVec3f& start,
+                               const SGVec3f& direction, float& fraction) const
+{
+    SGVec3f p = cross(direction, triangle._edge[1]);
+    float denom = dot(p, triangle._edge[0]);
+    float signDenom = std::copysign(1.0f, denom);
+    SGVec3f s = start - triangle._v0;
+    SGVec3f q = cross(s, triangle._edge[0]);
+    return acceptTriangleHit(denom, signDenom*dot(q, triangle._edge[1]),
+                             signDenom*dot(p, s),
+                             signDenom*dot(q, direction), fraction);
+}
+
+void
+BVHFlatTree::setHit(Hit& hit, const SGLineSegmentd& segment,
+                    uint32_t triangle, float fraction) const
+{
+    // the point is computed in single precision, like the object tree does
+    const Triangle& t = _triangles[triangle];
+    SGVec3f start(segment.getStart());
+    SGVec3f direction(segment.getDirection());
+    hit.valid = true;
+    hit.fraction = fraction;
+    hit.point = SGVec3d(start + fraction*direction);
+    hit.normal = SGVec3d(t._normal);
+    hit.material = _staticData->getMaterial(t._material);
+}
+
+bool
+BVHFlatTree::intersect(const SGLineSegmentd& segment, Hit& hit) const
+{
+    hit = Hit();
+    const SGVec3f start(segment.getStart());
+    const SGVec3f direction(segment.getDirection());
+    float fraction = 1;
+    uint32_t triangle = ~0u;
+
+    if (_root & LEAF_FLAG) {
+        if (intersectTriangle(_triangles[_root & ~LEAF_FLAG], start,
+                              direction, fraction))
+            setHit(hit, segment, _root & ~LEAF_FLAG, fraction);
+        return hit.valid;
+    }
+
+    const Lanes start4(start[0], start[1], start[2], 0);
+    const Lanes inv4(inverse(direction[0]), inverse(direction[1]),
+                     inverse(direction[2]), 0);
+
+    StackEntry localStack[STACK_SIZE];
+    std::vector<StackEntry> heapStack;
+    StackEntry* stack = localStack;
+    if (STACK_SIZE <= _depth) {
+        heapStack.resize(_depth + 1);
+        stack = heapStack.data();
+    }
+    size_t top = 0;
+    StackEntry& root = stack[top++];
+    root._ref = _root;
+    for (unsigned i = 0; i < 3; ++i) {
+        root._min[i] = _box.getMin()[i];
+        root._max[i] = _box.getMax()[i];
+    }
+    if (!intersectBox(root, start4, inv4, fraction, root._near))
+        return false;
+
+    while (top) {
+        const StackEntry entry = stack[--top];
+        // the segment may have been shortened since this was pushed
+        if (fraction < entry._near)
+            continue;
+
+        const Node& node = _nodes[entry._ref];
+        Box parent;
+        std::copy(entry._min, entry._min + 3, parent._min);
+        std::copy(entry._max, entry._max + 3, parent._max);
+
+        StackEntry child[2];
+        bool hits[2];
+        for (unsigned c = 0; c < 2; ++c) {
+            Box box;
+            decode(node, c, parent, box);
+            child[c]._ref = node._child[c];
+            std::copy(box._min, box._min + 3, child[c]._min);
+            std::copy(box._max, box._max + 3, child[c]._max);
+            hits[c] = intersectBox(child[c], start4, inv4, fraction,
+                                   child[c]._near);
+        }
+
+        // Enter the nearer child first, as the object tree does, so
+        // the farther one is likely culled by the shortened segment
+        unsigned first = hits[1] && (!hits[0] || child[1]._near < child[0]._near);
+        unsigned order[2] = { first, 1 - first };
+        for (unsigned c : order) {
+            if (!hits[c] || !(child[c]._ref & LEAF_FLAG))
+                continue;
+            uint32_t index = child[c]._ref & ~LEAF_FLAG;
+            if (intersectTriangle(_triangles[index], start, direction, fraction))
+                triangle = index;
+        }
+        for (unsigned k = 2; k-- > 0;) {
+            unsigned c = order[k];
+            if (hits[c] && !(child[c]._ref & LEAF_FLAG))
+                stack[top++] = child[c];
+        }
+    }
+
+    if (triangle == ~0u)
+        return false;
+    setHit(hit, segment, triangle, fraction);
+    return true;
+}
+
+void
+BVHFlatTree::intersect(const SGLineSegmentd* segments, Hit* hits,
+                       size_t count) const
+{
+    for (size_t base = 0; base < count; base += 4) {
+        Packet packet;
+        for (unsigned lane = 0; lane < 4; ++lane) {
+            packet._triangle[lane] = ~0u;
+            if (count <= base + lane) {
+                for (unsigned i = 0; i < 3; ++i) {
+                    packet._start[i][lane] = 0;
+                    packet._direction[i][lane] = 0;
+                    packet._inverse[i][lane] = 0;
+                }
+                packet._fraction[lane] = -1;
+                continue;
+            }
+            SGVec3f start(segments[base + lane].getStart());
+            SGVec3f direction(segments[base + lane].getDirection());
+            for (unsigned i = 0; i < 3; ++i) {
+                packet._start[i][lane] = start[i];
+                packet._direction[i][lane] = direction[i];
+                packet._inverse[i][lane] = inverse(direction[i]);
+            }
+            packet._fraction[lane] = 1;
+        }
+
+        intersectPacket(packet);
+
+        for (unsigned lane = 0; lane < 4 && base + lane < count; ++lane) {
+            hits[base + lane] = Hit();
+            if (packet._triangle[lane] != ~0u)
+                setHit(hits[base + lane], segments[base + lane],
+                       packet._triangle[lane], packet._fraction[lane]);
+        }
+    }
+}
+
+namespace {
+
+// Slab test of four segments against one box. Returns the mask of the
+// lanes that hit and their mean entry fraction through near.
+inline unsigned
+intersectBox(const float* min, const float* max, const Lanes* start,
+             const Lanes* inv, const Lanes& fraction, float& near)
+{
+    Lanes tNear(0.0f);
+    Lanes tFar(fraction);
+    for (unsigned i = 0; i < 3; ++i) {
+        Lanes t1 = (Lanes(min[i]) - start[i])*inv[i];
+        Lanes t2 = (Lanes(max[i]) - start[i])*inv[i];
+        tNear = simd4::max(tNear, simd4::min(t1, t2));
+        tFar = simd4::min(tFar, simd4::max(t1, t2));
+    }
+    unsigned mask = 0;
+    unsigned count = 0;
+    near = 0;
+    for (unsigned lane = 0; lane < 4; ++lane) {
+        if (tNear[lane] <= tFar[lane]) {
+            mask |= 1u << lane;
+            near += tNear[lane];
+            ++count;
+        }
+    }
+    if (count)
+        near /= count;
+    return mask;
+}
+
+}
+
+void
+BVHFlatTree::intersectPacket(Packet& packet) const
+{
+    const Lanes* d = packet._direction;
+    auto testTriangle = [&](uint32_t index, unsigned mask) {
+        const Triangle& t = _triangles[index];
+        const SGVec3f& e0 = t._edge[0];
+        const SGVec3f& e1 = t._edge[1];
+        Lanes px = d[1]*e1[2] - d[2]*e1[1];
+        Lanes py = d[2]*e1[0] - d[0]*e1[2];
+        Lanes pz = d[0]*e1[1] - d[1]*e1[0];
+        Lanes denom = px*e0[0] + py*e0[1] + pz*e0[2];
+        Lanes sx = packet._start[0] - Lanes(t._v0[0]);
+        Lanes sy = packet._start[1] - Lanes(t._v0[1]);
+        Lanes sz = packet._start[2] - Lanes(t._v0[2]);
+        Lanes qx = sy*e0[2] - sz*e0[1];
+        Lanes qy = sz*e0[0] - sx*e0[2];
+        Lanes qz = sx*e0[1] - sy*e0[0];
+        Lanes tDenom = qx*e1[0] + qy*e1[1] + qz*e1[2];
+        Lanes u = px*sx + py*sy + pz*sz;
+        Lanes v = qx*d[0] + qy*d[1] + qz*d[2];
+        for (unsigned lane = 0; lane < 4; ++lane) {
+            if (!(mask & (1u << lane)))
+                continue;
+            float signDenom = std::copysign(1.0f, denom[lane]);
+            if (acceptTriangleHit(denom[lane], signDenom*tDenom[lane],
+                                  signDenom*u[lane], signDenom*v[lane],
+                                  packet._fraction[lane]))
+                packet._triangle[lane] = index;
+        }
+    };
+
+    if (_root & LEAF_FLAG) {
+        testTriangle(_root & ~LEAF_FLAG, 0xf);
+        return;
+    }
+
+    float near;
+    float rootMin[3], rootMax[3];
+    for (unsigned i = 0; i < 3; ++i) {
+        rootMin[i] = _box.getMin()[i];
+        rootMax[i] = _box.getMax()[i];
+    }
+    if (!intersectBox(rootMin, rootMax, packet._start, packet._inverse,
+                      packet._fraction, near))
+        return;
+
+    StackEntry localStack[STACK_SIZE];
+    std::vector<StackEntry> heapStack;
+    StackEntry* stack = localStack;
+    if (STACK_SIZE <= _depth) {
+        heapStack.resize(_depth + 1);
+        stack = heapStack.data();
+    }
+    size_t top = 0;
+    stack[top]._ref = _root;
+    std::copy(rootMin, rootMin + 3, stack[top]._min);
+    std::copy(rootMax, rootMax + 3, stack[top]._max);
+    ++top;
+
+    while (top) {
+        const StackEntry entry = stack[--top];
+        const Node& node = _nodes[entry._ref];
+        Box parent;
+        std::copy(entry._min, entry._min + 3, parent._min);
+        std::copy(entry._max, entry._max + 3, parent._max);
+
+        StackEntry child[2];
+        unsigned masks[2];
+        for (unsigned c = 0; c < 2; ++c) {
+            Box box;
+            decode(node, c, parent, box);
+            child[c]._ref = node._child[c];
+            std::copy(box._min, box._min + 3, child[c]._min);
+            std::copy(box._max, box._max + 3, child[c]._max);
+            masks[c] = intersectBox(box._min, box._max, packet._start,
+                                    packet._inverse, packet._fraction,
+                                    child[c]._near);
+        }
+
+        // the child nearer on average for the lanes entering it goes first
+        unsigned first = masks[1] && (!masks[0]
+                                      || child[1]._near < child[0]._near);
+        unsigned order[2] = { first, 1 - first };
+        for (unsigned c : order) {
+            if (masks[c] && (child[c]._ref & LEAF_FLAG))
+                testTriangle(child[c]._ref & ~LEAF_FLAG, masks[c]);
+        }
+        for (unsigned k = 2; k-- > 0;) {
+            unsigned c = order[k];
+            if (masks[c] && !(child[c]._ref & LEAF_FLAG))
+                stack[top++] = child[c];
+        }
+    }
+}
+
+}
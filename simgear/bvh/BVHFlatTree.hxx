@@ -0,0 +1,115 @@
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHFlatTree_hxx
+#define BVHFlatTree_hxx
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+
+#include "BVHStaticData.hxx"
+#include "BVHStaticNode.hxx"
+
+namespace simgear {
+
+class BVHMaterial;
+
+/// Linearized copy of a static triangle tree, used for line segment
+/// queries. Nodes live in one array and store the boxes of both children
+/// quantized to 16 bits relative to their own box; triangles live in a
+/// second array in the precomputed form the intersection test needs.
+/// Batched queries run four segments at a time through simd4_t kernels.
+class BVHFlatTree : public SGReferenced {
+public:
+    BVHFlatTree(const BVHStaticNode* staticNode,
+                const BVHStaticData* staticData);
+    virtual ~BVHFlatTree();
+
+    struct Hit {
+        Hit() : valid(false), fraction(1), material(0) {}
+        bool valid;
+        /// position of the hit along the segment, 0 at the start
+        double fraction;
+        SGVec3d point;
+        SGVec3d normal;
+        const BVHMaterial* material;
+    };
+
+    /// Nearest intersection of the segment with the triangles, the same
+    /// one BVHLineSegmentVisitor finds in the original tree.
+    bool intersect(const SGLineSegmentd& segment, Hit& hit) const;
+    /// Nearest intersections of count segments, hits[i] belongs to
+    /// segments[i].
+    void intersect(const SGLineSegmentd* segments, Hit* hits,
+                   size_t count) const;
+
+    const SGBoxf& getBoundingBox() const
+    { return _box; }
+    size_t getNumNodes() const
+    { return _nodes.size(); }
+    size_t getNumTriangles() const
+    { return _triangles.size(); }
+
+private:
+    /// a child reference with this bit set is a triangle index
+    static const uint32_t LEAF_FLAG = 0x80000000u;
+
+    struct Node {
+        /// min x, y, z then max x, y, z of each child
+        uint16_t _bounds[2][6];
+        uint32_t _child[2];
+    };
+
+    struct Triangle {
+        SGVec3f _v0;
+        SGVec3f _edge[2];
+        SGVec3f _normal;
+        unsigned _material;
+    };
+
+    struct Box {
+        float _min[3];
+        float _max[3];
+    };
+
+    class Collector;
+    struct Packet;
+
+    void quantize(uint32_t nodeIndex, const Box& box,
+                  const std::vector<SGBoxf>& childBoxes);
+    static void decode(const Node& node, unsigned child, const Box& parent,
+                       Box& box);
+    bool intersectTriangle(const Triangle& triangle, const SGVec3f& start,
+                           const SGVec3f& direction, float& fraction) const;
+    void intersectPacket(Packet& packet) const;
+    void setHit(Hit& hit, const SGLineSegmentd& segment,
+                uint32_t triangle, float fraction) const;
+
+    std::vector<Node> _nodes;
+    std::vector<Triangle> _triangles;
+    uint32_t _root;
+    unsigned _depth;
+    SGBoxf _box;
+    SGSharedPtr<const BVHStaticData> _staticData;
+};
+
+}
+
+#endif
@@ -32,6 +32,7 @@
 #include "BVHMotionTransform.hxx"
 #include "BVHLineGeometry.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHFlatTree.hxx"
 
 #include "BVHStaticData.hxx"
 
@@ -128,7 +129,19 @@ BVHLineSegmentVisitor::apply(BVHStaticGeometry& node)
 {
     if (!intersects(_lineSegment, node.getBoundingSphere()))
         return;
-    node.traverse(*this);
+
+    // The flat tree finds the same nearest triangle as traversing the
+    // static nodes would, with far less pointer chasing.
+    BVHFlatTree::Hit hit;
+    if (!node.getFlatTree()->intersect(_lineSegment, hit))
+        return;
+    setLineSegmentEnd(hit.point);
+    _normal = hit.normal;
+    _linearVelocity = SGVec3d::zeros();
+    _angularVelocity = SGVec3d::zeros();
+    _material = hit.material;
+    _id = 0;
+    _haveHit = true;
 }
 
 void
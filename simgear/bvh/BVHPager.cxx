@@ -19,90 +19,135 @@
 
 #include "BVHPager.hxx"
 
+#include <algorithm>
+#include <condition_variable>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <string>
+#include <vector>
 
+#include <simgear/structure/SGProfiler.hxx>
 #include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include "BVHPageNode.hxx"
 #include "BVHPageRequest.hxx"
 
 namespace simgear {
 
-struct BVHPager::_PrivateData : protected SGThread {
+struct BVHPager::_PrivateData {
     typedef SGSharedPtr<BVHPageRequest> _Request;
-    typedef std::list<_Request> _RequestList;
     typedef std::list<SGSharedPtr<BVHPageNode> > _PageNodeList;
-    
-    struct _LockedQueue {
-        void _push(const _Request& request)
-        {
-            std::lock_guard<std::mutex> scopeLock(_mutex);
-            _requestList.push_back(request);
-        }
-        _Request _pop()
+
+    enum _State {
+        _Queued,
+        _Loading,
+        _Loaded,
+        _Cancelled
+    };
+
+    struct _Pending : public SGReferenced {
+        _Request _request;
+        BVHPageNode* _pageNode;
+        // the priority, must not change while in the queue
+        unsigned _useStamp;
+        double _distance;
+        unsigned long _sequence;
+        SGTimeStamp _scheduled;
+        // guarded by the mutex
+        _State _state;
+    };
+    typedef SGSharedPtr<_Pending> _PendingPtr;
+
+    struct _Priority {
+        bool operator()(const _PendingPtr& a, const _PendingPtr& b) const
         {
-            std::lock_guard<std::mutex> scopeLock(_mutex);
-            if (_requestList.empty())
-                return _Request();
-            _Request request;
-            request.swap(_requestList.front());
-            _requestList.pop_front();
-            return request;
+            // Most recently used first. As in _update, test the sign bit
+            // of the difference to be wraparound save.
+            unsigned diff = b->_useStamp - a->_useStamp;
+            if (diff)
+                return diff & (~((~0u) >> 1));
+            if (a->_distance != b->_distance)
+                return a->_distance < b->_distance;
+            return a->_sequence < b->_sequence;
         }
-    private:
-        std::mutex _mutex;
-        _RequestList _requestList;
     };
-    
-    struct _WorkQueue {
-        void _stop()
+    typedef std::set<_PendingPtr, _Priority> _Queue;
+
+    struct _Worker : public SGThread {
+        _Worker(_PrivateData& pager, unsigned index) :
+            _pager(pager),
+            _index(index)
         {
-            _push(_Request());
         }
-        void _push(const _Request& request)
+        virtual ~_Worker()
         {
-            std::lock_guard<std::mutex> scopeLock(_mutex);
-            bool needSignal = _requestList.empty();
-            _requestList.push_back(request);
-            if (needSignal)
-                _waitCondition.signal();
         }
-        _Request _pop()
+        virtual void run()
         {
-            std::lock_guard<std::mutex> scopeLock(_mutex);
-            while (_requestList.empty())
-                _waitCondition.wait(_mutex);
-            _Request request;
-            request.swap(_requestList.front());
-            _requestList.pop_front();
-            return request;
+            _pager._work(_index);
         }
-    private:
-        std::mutex _mutex;
-        SGWaitCondition _waitCondition;
-        _RequestList _requestList;
+        _PrivateData& _pager;
+        unsigned _index;
     };
 
     _PrivateData() :
         _started(false),
-        _useStamp(0)
+        _useStamp(0),
+        _numWorkers(1),
+        _reference(SGVec3d::zeros()),
+        _sequence(0),
+        _stopping(false),
+        _loading(0),
+        _loaded(0),
+        _cancelled(0),
+        _latencySum(0),
+        _latencyCount(0),
+        _maxLatency(0)
     {
     }
-    virtual ~_PrivateData()
+    ~_PrivateData()
     {
         _stop();
     }
 
-    virtual void run()
+    void _work(unsigned index)
     {
+        SGProfiler::setThreadName("bvh-pager-" + std::to_string(index));
         for (;;) {
-            _Request request = _pendingRequests._pop();
-            // This means stop working
-            if (!request.valid())
-                return;
-            request->load();
-            _processedRequests._push(request);
+            _PendingPtr pending;
+            {
+                std::unique_lock<std::mutex> scopeLock(_mutex);
+                while (!_stopping && _queue.empty())
+                    _waitCondition.wait(scopeLock);
+                // This means stop working
+                if (_stopping)
+                    return;
+                pending = *_queue.begin();
+                _queue.erase(_queue.begin());
+                pending->_state = _Loading;
+                ++_loading;
+            }
+
+            {
+                SG_PROFILE_ZONE("bvh-page-load");
+                pending->_request->load();
+            }
+
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            --_loading;
+            double latency = (SGTimeStamp::now() - pending->_scheduled).toSecs();
+            _latencySum += latency;
+            ++_latencyCount;
+            _maxLatency = std::max(_maxLatency, latency);
+            // else it was cancelled meanwhile and is just dropped
+            if (pending->_state == _Loading) {
+                pending->_state = _Loaded;
+                _processed.push_back(pending);
+            }
         }
     }
 
@@ -110,8 +155,14 @@ struct BVHPager::_PrivateData : protected SGThread {
     {
         if (_started)
             return true;
-        if (!start())
-            return false;
+        for (unsigned i = 0; i < _numWorkers; ++i) {
+            _workers.emplace_back(new _Worker(*this, i));
+            if (!_workers.back()->start()) {
+                _workers.pop_back();
+                _joinWorkers();
+                return false;
+            }
+        }
         _started = true;
         return true;
     }
@@ -120,19 +171,91 @@ struct BVHPager::_PrivateData : protected SGThread {
     {
         if (!_started)
             return;
-        // send a stop request ...
-        _pendingRequests._stop();
-        // ... and wait for the thread to finish
-        join();
+        _joinWorkers();
         _started = false;
     }
 
+    void _joinWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            _stopping = true;
+            _waitCondition.notify_all();
+        }
+        for (auto& worker : _workers)
+            worker->join();
+        _workers.clear();
+        _stopping = false;
+    }
+
+    double _distance(BVHPageNode& pageNode) const
+    {
+        const SGSphered& sphere = pageNode.getBoundingSphere();
+        if (sphere.empty())
+            return 0;
+        double d = dist(sphere.getCenter(), _reference) - sphere.getRadius();
+        return std::max(d, 0.0);
+    }
+
+    void _schedule(BVHPageNode& pageNode, const _Request& request)
+    {
+        _PendingPtr pending = new _Pending;
+        pending->_request = request;
+        pending->_pageNode = &pageNode;
+        pending->_useStamp = _useStamp;
+        pending->_distance = _distance(pageNode);
+        pending->_sequence = _sequence++;
+        pending->_scheduled = SGTimeStamp::now();
+        _pending[&pageNode] = pending;
+
+        std::lock_guard<std::mutex> scopeLock(_mutex);
+        pending->_state = _Queued;
+        _queue.insert(pending);
+        _waitCondition.notify_one();
+    }
+
+    void _reprioritize(BVHPageNode& pageNode)
+    {
+        _PendingMap::iterator i = _pending.find(&pageNode);
+        if (i == _pending.end())
+            return;
+        _PendingPtr pending = i->second;
+        std::lock_guard<std::mutex> scopeLock(_mutex);
+        if (pending->_state != _Queued)
+            return;
+        _queue.erase(pending);
+        pending->_useStamp = _useStamp;
+        pending->_distance = _distance(pageNode);
+        _queue.insert(pending);
+    }
+
+    /// Returns false if the page node has no request in flight
+    bool _cancelPending(BVHPageNode& pageNode)
+    {
+        _PendingMap::iterator i = _pending.find(&pageNode);
+        if (i == _pending.end())
+            return false;
+        _PendingPtr pending = i->second;
+        _pending.erase(i);
+
+        std::lock_guard<std::mutex> scopeLock(_mutex);
+        if (pending->_state == _Queued)
+            _queue.erase(pending);
+        // loading or loaded requests are dropped once they show up
+        pending->_state = _Cancelled;
+        ++_cancelled;
+        return true;
+    }
+
     void _use(BVHPageNode& pageNode)
     {
+        pageNode._useStamp = _useStamp;
         if (pageNode._requested) {
             // move it forward in the lru list
             _pageNodeList.splice(_pageNodeList.end(), _pageNodeList,
                                  pageNode._iterator);
+            // and a request still waiting in the queue along with it
+            _reprioritize(pageNode);
         } else {
             _Request request = pageNode.newRequest();
             if (!request.valid())
@@ -143,24 +266,41 @@ struct BVHPager::_PrivateData : protected SGThread {
             pageNode._requested = true;
 
             if (_started) {
-                _pendingRequests._push(request);
+                _schedule(pageNode, request);
             } else {
                 request->load();
                 request->insert();
             }
         }
-        pageNode._useStamp = _useStamp;
+    }
+
+    void _cancel(BVHPageNode& pageNode)
+    {
+        if (!pageNode._requested)
+            return;
+        if (!_cancelPending(pageNode))
+            return;
+        pageNode._requested = false;
+        // may drop the last reference to the page node
+        _pageNodeList.erase(pageNode._iterator);
     }
 
     void _update(unsigned expiry)
     {
+        SG_PROFILE_ZONE("bvh-pager-update");
         // Insert all processed requests
-        for (;;) {
-            SGSharedPtr<BVHPageRequest> request;
-            request = _processedRequests._pop();
-            if (!request.valid())
-                break;
-            request->insert();
+        std::list<_PendingPtr> processed;
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            processed.swap(_processed);
+        }
+        for (const _PendingPtr& pending : processed) {
+            // only this thread cancels loaded requests
+            if (pending->_state != _Loaded)
+                continue;
+            _pending.erase(pending->_pageNode);
+            pending->_request->insert();
+            ++_loaded;
         }
 
         // ... and throw away stuff that is not used for a long time
@@ -174,18 +314,54 @@ struct BVHPager::_PrivateData : protected SGThread {
             // test the sign bit of the difference
             if (!(diff & (~((~0u) >> 1))))
                 break;
+            // a request not yet loaded is superseded
+            _cancelPending(**i);
             (*i)->clear();
             (*i)->_requested = false;
             i = _pageNodeList.erase(i);
         }
     }
 
+    Stats _getStats() const
+    {
+        std::lock_guard<std::mutex> scopeLock(_mutex);
+        Stats stats;
+        stats.queued = static_cast<unsigned>(_queue.size());
+        stats.loading = _loading;
+        stats.loaded = _loaded;
+        stats.cancelled = _cancelled;
+        stats.meanLatencySec = _latencyCount ? _latencySum/_latencyCount : 0;
+        stats.maxLatencySec = _maxLatency;
+        return stats;
+    }
+
+    typedef std::map<BVHPageNode*, _PendingPtr> _PendingMap;
+
     bool _started;
     unsigned _useStamp;
-    _WorkQueue _pendingRequests;
-    _LockedQueue _processedRequests;
+    unsigned _numWorkers;
+    SGVec3d _reference;
     // Store the rcu list of loaded nodes so that they can expire
     _PageNodeList _pageNodeList;
+    // requests not yet inserted, only touched by the bvh main thread
+    _PendingMap _pending;
+    unsigned long _sequence;
+    std::vector<std::unique_ptr<_Worker> > _workers;
+
+    // shared with the pager threads
+    mutable std::mutex _mutex;
+    // every pager thread has to wake up on stop, which SGWaitCondition
+    // does not guarantee
+    std::condition_variable _waitCondition;
+    bool _stopping;
+    _Queue _queue;
+    std::list<_PendingPtr> _processed;
+    unsigned _loading;
+    unsigned _loaded;
+    unsigned _cancelled;
+    double _latencySum;
+    unsigned _latencyCount;
+    double _maxLatency;
 };
 
 BVHPager::BVHPager() :
@@ -211,12 +387,48 @@ BVHPager::stop()
     _privateData->_stop();
 }
 
+void
+BVHPager::setNumWorkers(unsigned numWorkers)
+{
+    _privateData->_numWorkers = std::max(numWorkers, 1u);
+}
+
+unsigned
+BVHPager::getNumWorkers() const
+{
+    return _privateData->_numWorkers;
+}
+
+void
+BVHPager::setReferencePoint(const SGVec3d& point)
+{
+    _privateData->_reference = point;
+}
+
+const SGVec3d&
+BVHPager::getReferencePoint() const
+{
+    return _privateData->_reference;
+}
+
 void
 BVHPager::use(BVHPageNode& pageNode)
 {
     _privateData->_use(pageNode);
 }
 
+void
+BVHPager::cancel(BVHPageNode& pageNode)
+{
+    _privateData->_cancel(pageNode);
+}
+
+BVHPager::Stats
+BVHPager::getStats() const
+{
+    return _privateData->_getStats();
+}
+
 void
 BVHPager::update(unsigned expiry)
 {
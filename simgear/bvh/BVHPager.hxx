@@ -18,6 +18,7 @@
 #ifndef BVHPager_hxx
 #define BVHPager_hxx
 
+#include <simgear/math/SGMath.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
 
 namespace simgear {
@@ -30,15 +31,45 @@ public:
     BVHPager();
     ~BVHPager();
 
-    /// Starts the pager thread
+    /// Starts the pager threads
     bool start();
 
-    /// Stops the pager thread
+    /// Stops the pager threads, requests not yet loaded stay queued
     void stop();
 
+    /// Number of pager threads start() runs, one by default.
+    /// Takes effect on the next start().
+    void setNumWorkers(unsigned numWorkers);
+    unsigned getNumWorkers() const;
+
+    /// Pending requests are loaded most recently used first, and among
+    /// those nearest to this point first. Usually the aircraft position.
+    void setReferencePoint(const SGVec3d& point);
+    const SGVec3d& getReferencePoint() const;
+
     /// Use this page node, if loaded make it as used, if not loaded schedule
     void use(BVHPageNode& pageNode);
 
+    /// Drop a request that is still queued or loading, the page node
+    /// is then unused again. Loaded page nodes are left alone.
+    void cancel(BVHPageNode& pageNode);
+
+    struct Stats {
+        /// requests waiting for a pager thread
+        unsigned queued;
+        /// requests a pager thread is loading right now
+        unsigned loading;
+        /// requests inserted into the tree so far
+        unsigned loaded;
+        /// requests cancelled or expired before they were inserted
+        unsigned cancelled;
+        /// time from scheduling to the end of loading, over all
+        /// requests loaded so far
+        double meanLatencySec;
+        double maxLatencySec;
+    };
+    Stats getStats() const;
+
     /// Call this from the main thread to incorporate the processed page
     /// requests into the bounding volume tree
     void update(unsigned expiry);
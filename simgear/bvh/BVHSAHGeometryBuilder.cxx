@@ -0,0 +1,299 @@
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHSAHGeometryBuilder.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+
+#include "BVHStaticBinary.hxx"
+#include "BVHStaticTriangle.hxx"
+
+namespace simgear {
+
+namespace {
+
+// number of candidate split planes per axis is SAH_BINS - 1
+const int SAH_BINS = 16;
+// subtrees at least this large may be handed to another thread ...
+const unsigned PARALLEL_MIN_TRIANGLES = 8192;
+// ... down to this depth, which bounds the number of threads to 2^depth
+const unsigned PARALLEL_MAX_DEPTH = 3;
+
+inline size_t hashCombine(size_t seed, size_t value)
+{
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+inline uint32_t floatBits(float f)
+{
+    // -0 and +0 compare equal, so they must hash the same
+    if (f == 0.0f)
+        f = 0.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+inline float surfaceArea(const SGBoxf& box)
+{
+    if (box.empty())
+        return 0.0f;
+    SGVec3f s = box.getSize();
+    return 2.0f*(s[0]*s[1] + s[1]*s[2] + s[2]*s[0]);
+}
+
+}
+
+size_t
+BVHSAHGeometryBuilder::VertexHash::operator()(const SGVec3f& v) const
+{
+    size_t h = floatBits(v[0]);
+    h = hashCombine(h, floatBits(v[1]));
+    return hashCombine(h, floatBits(v[2]));
+}
+
+size_t
+BVHSAHGeometryBuilder::TriangleKeyHash::operator()(const SGVec3<unsigned>& key) const
+{
+    size_t h = key[0];
+    h = hashCombine(h, key[1]);
+    return hashCombine(h, key[2]);
+}
+
+struct BVHSAHGeometryBuilder::BuildContext {
+    std::vector<unsigned> _order;
+    std::vector<SGBoxf> _boxes;
+    std::vector<SGVec3f> _centers;
+    bool _parallel;
+};
+
+BVHSAHGeometryBuilder::BVHSAHGeometryBuilder() :
+    _staticData(new BVHStaticData),
+    _currentMaterial(0),
+    _currentMaterialIndex(~0u),
+    _parallelBuild(true)
+{
+}
+
+BVHSAHGeometryBuilder::~BVHSAHGeometryBuilder()
+{
+}
+
+void
+BVHSAHGeometryBuilder::setCurrentMaterial(const BVHMaterial* material)
+{
+    _currentMaterial = material;
+    _currentMaterialIndex = addMaterial(material);
+}
+
+unsigned
+BVHSAHGeometryBuilder::addMaterial(const BVHMaterial* material)
+{
+    auto i = _materialMap.find(material);
+    if (i != _materialMap.end())
+        return i->second;
+    unsigned index = _staticData->addMaterial(material);
+    _materialMap[material] = index;
+    return index;
+}
+
+unsigned
+BVHSAHGeometryBuilder::addVertex(const SGVec3f& v)
+{
+    auto i = _vertexMap.find(v);
+    if (i != _vertexMap.end())
+        return i->second;
+    unsigned index = _staticData->addVertex(v);
+    _vertexMap.emplace(v, index);
+    return index;
+}
+
+void
+BVHSAHGeometryBuilder::addTriangle(const SGVec3f& v1, const SGVec3f& v2,
+                                   const SGVec3f& v3)
+{
+    Triangle triangle;
+    triangle._indices[0] = addVertex(v1);
+    triangle._indices[1] = addVertex(v2);
+    triangle._indices[2] = addVertex(v3);
+    std::sort(triangle._indices, triangle._indices + 3);
+    if (!_triangleSet.insert(SGVec3<unsigned>(triangle._indices)).second)
+        return;
+    triangle._material = _currentMaterialIndex;
+    _triangles.push_back(triangle);
+}
+
+BVHStaticGeometry*
+BVHSAHGeometryBuilder::buildTree()
+{
+    if (_triangles.empty())
+        return 0;
+
+    BuildContext context;
+    const unsigned count = static_cast<unsigned>(_triangles.size());
+    context._order.resize(count);
+    context._boxes.resize(count);
+    context._centers.resize(count);
+    context._parallel = _parallelBuild;
+    for (unsigned i = 0; i < count; ++i) {
+        const Triangle& t = _triangles[i];
+        SGBoxf& box = context._boxes[i];
+        for (unsigned j = 0; j < 3; ++j)
+            box.expandBy(_staticData->getVertex(t._indices[j]));
+        context._order[i] = i;
+        context._centers[i] = box.getCenter();
+    }
+
+    const BVHStaticNode* tree = buildRecursive(context, 0, count, 0);
+    if (!tree)
+        return 0;
+
+    // the hash tables are only needed while collecting
+    decltype(_vertexMap)().swap(_vertexMap);
+    decltype(_triangleSet)().swap(_triangleSet);
+    std::vector<Triangle>().swap(_triangles);
+
+    _staticData->trim();
+    // flatten here in the loader, not in the first ground query
+    BVHStaticGeometry* geometry = new BVHStaticGeometry(tree, _staticData);
+    geometry->getFlatTree();
+    return geometry;
+}
+
+const BVHStaticNode*
+BVHSAHGeometryBuilder::buildRecursive(BuildContext& context,
+                                      unsigned begin, unsigned end,
+                                      unsigned depth) const
+{
+    if (begin == end)
+        return 0;
+
+    unsigned* order = context._order.data();
+    if (end - begin == 1) {
+        const Triangle& t = _triangles[order[begin]];
+        return new BVHStaticTriangle(t._material, t._indices);
+    }
+
+    SGBoxf box, centerBox;
+    for (unsigned i = begin; i < end; ++i) {
+        box.expandBy(context._boxes[order[i]]);
+        centerBox.expandBy(context._centers[order[i]]);
+    }
+
+    // Evaluate the binned SAH cost of the planes between bins of
+    // triangle centers, on all three axes
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    int bestBin = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float minCenter = centerBox.getMin()[axis];
+        const float extent = centerBox.getMax()[axis] - minCenter;
+        if (!(extent > 0.0f))
+            continue;
+        const float scale = SAH_BINS / extent;
+
+        SGBoxf binBox[SAH_BINS];
+        unsigned binCount[SAH_BINS] = { 0 };
+        for (unsigned i = begin; i < end; ++i) {
+            unsigned p = order[i];
+            int b = std::min(SAH_BINS - 1,
+                             int((context._centers[p][axis] - minCenter)*scale));
+            binCount[b]++;
+            binBox[b].expandBy(context._boxes[p]);
+        }
+
+        float leftArea[SAH_BINS];
+        unsigned leftCount[SAH_BINS];
+        SGBoxf accBox;
+        unsigned accCount = 0;
+        for (int b = 0; b < SAH_BINS - 1; ++b) {
+            accBox.expandBy(binBox[b]);
+            accCount += binCount[b];
+            leftArea[b] = surfaceArea(accBox);
+            leftCount[b] = accCount;
+        }
+
+        accBox = SGBoxf();
+        accCount = 0;
+        for (int b = SAH_BINS - 1; b > 0; --b) {
+            accBox.expandBy(binBox[b]);
+            accCount += binCount[b];
+            if (!accCount || !leftCount[b - 1])
+                continue;
+            float cost = leftArea[b - 1]*leftCount[b - 1]
+                + surfaceArea(accBox)*accCount;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b - 1;
+            }
+        }
+    }
+
+    unsigned splitAxis;
+    unsigned* mid = order + begin;
+    if (0 <= bestAxis) {
+        splitAxis = bestAxis;
+        const float minCenter = centerBox.getMin()[splitAxis];
+        const float scale = SAH_BINS
+            / (centerBox.getMax()[splitAxis] - minCenter);
+        mid = std::partition(order + begin, order + end, [&](unsigned p) {
+            int b = std::min(SAH_BINS - 1,
+                             int((context._centers[p][splitAxis] - minCenter)*scale));
+            return b <= bestBin;
+        });
+    }
+
+    if (mid == order + begin || mid == order + end) {
+        // all centers coincide: split the triangles into equal halves
+        splitAxis = box.getBroadestAxis();
+        mid = order + begin + (end - begin)/2;
+        std::nth_element(order + begin, mid, order + end,
+                         [&](unsigned a, unsigned b) {
+            return context._centers[a][splitAxis] < context._centers[b][splitAxis];
+        });
+    }
+
+    const unsigned split = static_cast<unsigned>(mid - order);
+    const BVHStaticNode* child0;
+    const BVHStaticNode* child1;
+    if (context._parallel && depth < PARALLEL_MAX_DEPTH
+        && PARALLEL_MIN_TRIANGLES <= end - begin) {
+        // the two halves touch disjoint ranges of the context arrays
+        auto left = std::async(std::launch::async, [&]() {
+            return buildRecursive(context, begin, split, depth + 1);
+        });
+        child1 = buildRecursive(context, split, end, depth + 1);
+        child0 = left.get();
+    } else {
+        child0 = buildRecursive(context, begin, split, depth + 1);
+        child1 = buildRecursive(context, split, end, depth + 1);
+    }
+
+    if (!child0)
+        return child1;
+    if (!child1)
+        return child0;
+
+    return new BVHStaticBinary(splitAxis, child0, child1, box);
+}
+
+}
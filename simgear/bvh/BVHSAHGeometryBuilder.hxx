@@ -0,0 +1,104 @@
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHSAHGeometryBuilder_hxx
+#define BVHSAHGeometryBuilder_hxx
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+
+#include "BVHStaticData.hxx"
+#include "BVHStaticGeometry.hxx"
+#include "BVHStaticNode.hxx"
+
+namespace simgear {
+
+/// Drop-in alternative to BVHStaticGeometryBuilder which keeps triangles
+/// in flat arrays, deduplicates through hash tables and splits nodes by a
+/// binned surface area heuristic. Large inputs build their subtrees in
+/// parallel. The result is made of the usual BVHStaticBinary and
+/// BVHStaticTriangle nodes.
+class BVHSAHGeometryBuilder : public SGReferenced {
+public:
+    BVHSAHGeometryBuilder();
+    virtual ~BVHSAHGeometryBuilder();
+
+    void setCurrentMaterial(const BVHMaterial* material);
+    const BVHMaterial* getCurrentMaterial() const
+    { return _currentMaterial; }
+    unsigned addMaterial(const BVHMaterial* material);
+
+    void addTriangle(const SGVec3f& v1, const SGVec3f& v2, const SGVec3f& v3);
+    unsigned addVertex(const SGVec3f& v);
+
+    /// number of distinct triangles added so far
+    size_t getNumTriangles() const
+    { return _triangles.size(); }
+
+    /// build subtrees of large inputs on worker threads, on by default
+    void setParallelBuild(bool parallel)
+    { _parallelBuild = parallel; }
+
+    BVHStaticGeometry* buildTree();
+
+private:
+    struct Triangle {
+        unsigned _indices[3];
+        unsigned _material;
+    };
+
+    struct VertexHash {
+        size_t operator()(const SGVec3f& v) const;
+    };
+
+    struct VertexEqual {
+        bool operator()(const SGVec3f& a, const SGVec3f& b) const
+        { return a[0] == b[0] && a[1] == b[1] && a[2] == b[2]; }
+    };
+
+    struct TriangleKeyHash {
+        size_t operator()(const SGVec3<unsigned>& key) const;
+    };
+
+    struct TriangleKeyEqual {
+        bool operator()(const SGVec3<unsigned>& a, const SGVec3<unsigned>& b) const
+        { return a[0] == b[0] && a[1] == b[1] && a[2] == b[2]; }
+    };
+
+    struct BuildContext;
+    const BVHStaticNode* buildRecursive(BuildContext& context,
+                                        unsigned begin, unsigned end,
+                                        unsigned depth) const;
+
+    SGSharedPtr<BVHStaticData> _staticData;
+    std::vector<Triangle> _triangles;
+
+    std::unordered_map<SGVec3f, unsigned, VertexHash, VertexEqual> _vertexMap;
+    /// sorted vertex index triples of the triangles added so far
+    std::unordered_set<SGVec3<unsigned>, TriangleKeyHash, TriangleKeyEqual> _triangleSet;
+
+    std::unordered_map<const BVHMaterial*, unsigned> _materialMap;
+    const BVHMaterial* _currentMaterial;
+    unsigned _currentMaterialIndex;
+    bool _parallelBuild;
+};
+
+}
+
+#endif
@@ -18,6 +18,7 @@
 #include "BVHStaticGeometry.hxx"
 
 #include "BVHBoundingBoxVisitor.hxx"
+#include "BVHFlatTree.hxx"
 
 namespace simgear {
 
@@ -38,6 +39,15 @@ BVHStaticGeometry::accept(BVHVisitor& visitor)
     visitor.apply(*this);
 }
 
+const BVHFlatTree*
+BVHStaticGeometry::getFlatTree() const
+{
+    std::call_once(_flatTreeOnce, [this]() {
+        _flatTree = new BVHFlatTree(_staticNode, _staticData);
+    });
+    return _flatTree;
+}
+
 SGSphered
 BVHStaticGeometry::computeBoundingSphere() const
 {
@@ -18,6 +18,8 @@
 #ifndef BVHStaticGeometry_hxx
 #define BVHStaticGeometry_hxx
 
+#include <mutex>
+
 #include <simgear/math/SGGeometry.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
 
@@ -28,6 +30,8 @@
 
 namespace simgear {
 
+class BVHFlatTree;
+
 class BVHStaticGeometry : public BVHNode {
 public:
     BVHStaticGeometry(const BVHStaticNode* staticNode,
@@ -44,11 +48,19 @@ public:
     const BVHStaticNode* getStaticNode() const
     { return _staticNode; }
     
+    /// Linearized copy of the tree for line segment queries. The geometry
+    /// builders create it along with the geometry; anything else builds
+    /// it on first use. Safe to call from several threads.
+    const BVHFlatTree* getFlatTree() const;
+
     virtual SGSphered computeBoundingSphere() const;
     
 private:
     SGSharedPtr<const BVHStaticNode> _staticNode;
     SGSharedPtr<const BVHStaticData> _staticData;
+
+    mutable std::once_flag _flatTreeOnce;
+    mutable SGSharedPtr<const BVHFlatTree> _flatTree;
 };
 
 }
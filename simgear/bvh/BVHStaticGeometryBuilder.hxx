@@ -19,6 +19,7 @@
 #define BVHStaticGeometryBuilder_hxx
 
 #include <algorithm>
+#include <list>
 #include <map>
 #include <set>
 
@@ -133,7 +134,10 @@ public:
         if (!tree)
             return 0;
         _staticData->trim();
-        return new BVHStaticGeometry(tree, _staticData);
+        // flatten here in the loader, not in the first ground query
+        BVHStaticGeometry* geometry = new BVHStaticGeometry(tree, _staticData);
+        geometry->getFlatTree();
+        return geometry;
     }
 
 private:
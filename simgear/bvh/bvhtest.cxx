@@ -16,12 +16,21 @@
 //
 
 #include <simgear_config.h>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <simgear/structure/SGSharedPtr.hxx>
 
 #include "BVHNode.hxx"
 #include "BVHGroup.hxx"
 #include "BVHTransform.hxx"
+#include "BVHMaterial.hxx"
+#include "BVHPageNode.hxx"
+#include "BVHPageRequest.hxx"
+#include "BVHPager.hxx"
 
 #include "BVHStaticData.hxx"
 
@@ -30,10 +39,14 @@
 #include "BVHStaticTriangle.hxx"
 #include "BVHStaticBinary.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHStaticGeometryBuilder.hxx"
+#include "BVHSAHGeometryBuilder.hxx"
+#include "BVHFlatTree.hxx"
 
 #include "BVHBoundingBoxVisitor.hxx"
 #include "BVHSubTreeCollector.hxx"
 #include "BVHLineSegmentVisitor.hxx"
+#include "BVHBatchLineSegmentVisitor.hxx"
 #include "BVHNearestPointVisitor.hxx"
 
 using namespace simgear;
@@ -132,6 +145,388 @@ testNearestPoint()
     return true;
 }
 
+// a wavy height field of size x size quads, with every triangle added twice
+template<typename Builder>
+void
+addHeightField(Builder& builder, int size)
+{
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) {
+                SGVec3f v[4];
+                for (int k = 0; k < 4; ++k) {
+                    float x = float(i + (k & 1));
+                    float y = float(j + (k >> 1));
+                    v[k] = SGVec3f(x, y, std::sin(0.1f*x)*std::cos(0.07f*y));
+                }
+                builder.addTriangle(v[0], v[1], v[3]);
+                builder.addTriangle(v[0], v[3], v[2]);
+            }
+        }
+    }
+}
+
+bool
+testSAHBuilder()
+{
+    const int size = 80;
+    SGSharedPtr<BVHStaticGeometryBuilder> reference = new BVHStaticGeometryBuilder;
+    SGSharedPtr<BVHSAHGeometryBuilder> builder = new BVHSAHGeometryBuilder;
+    addHeightField(*reference, size);
+    addHeightField(*builder, size);
+
+    // duplicates are dropped, also when only the sign of zero differs
+    if (builder->getNumTriangles() != 2u*size*size)
+        return false;
+    builder->addTriangle(SGVec3f(-0.0f, -0.0f, 0),
+                         SGVec3f(1, 1, std::sin(0.1f)*std::cos(0.07f)),
+                         SGVec3f(1, 0, std::sin(0.1f)));
+    if (builder->getNumTriangles() != 2u*size*size)
+        return false;
+
+    SGSharedPtr<BVHNode> referenceTree = reference->buildTree();
+    SGSharedPtr<BVHNode> tree = builder->buildTree();
+    if (!referenceTree || !tree)
+        return false;
+
+    // vertical probes must hit the same surface in both trees
+    for (int i = 0; i < 50; ++i) {
+        SGVec3d probe(0.37 + 1.53*i, 0.71 + 1.29*i, 0);
+        SGLineSegmentd segment(probe + SGVec3d(0, 0, 10), probe - SGVec3d(0, 0, 10));
+
+        BVHLineSegmentVisitor expected(segment);
+        referenceTree->accept(expected);
+        BVHLineSegmentVisitor visitor(segment);
+        tree->accept(visitor);
+        if (expected.empty() || visitor.empty())
+            return false;
+        if (!equivalent(expected.getPoint(), visitor.getPoint(), 1e-5))
+            return false;
+    }
+
+    // and the serial build gives the same answers as the parallel one
+    SGSharedPtr<BVHSAHGeometryBuilder> serial = new BVHSAHGeometryBuilder;
+    serial->setParallelBuild(false);
+    addHeightField(*serial, size);
+    SGSharedPtr<BVHNode> serialTree = serial->buildTree();
+    SGLineSegmentd segment(SGVec3d(40.5, 20.5, 10), SGVec3d(40.5, 20.5, -10));
+    BVHLineSegmentVisitor v1(segment), v2(segment);
+    tree->accept(v1);
+    serialTree->accept(v2);
+    if (v1.empty() || v2.empty() || !equivalent(v1.getPoint(), v2.getPoint()))
+        return false;
+
+    return true;
+}
+
+bool
+testFlatTree()
+{
+    const int size = 60;
+    SGSharedPtr<BVHStaticGeometryBuilder> builder = new BVHStaticGeometryBuilder;
+    addHeightField(*builder, size);
+    SGSharedPtr<BVHStaticGeometry> tree = builder->buildTree();
+    if (!tree)
+        return false;
+    const BVHFlatTree* flat = tree->getFlatTree();
+    if (flat != tree->getFlatTree())
+        return false;
+    if (flat->getNumTriangles() != 2u*size*size)
+        return false;
+
+    // vertical, oblique and axis parallel probes, some of them missing,
+    // and a count that leaves a partial packet
+    std::vector<SGLineSegmentd> segments;
+    for (int i = 0; i < 61; ++i) {
+        SGVec3d probe(0.37 + 0.97*i, 0.71 + 0.83*i, 0);
+        switch (i % 3) {
+        case 0:
+            segments.push_back(SGLineSegmentd(probe + SGVec3d(0, 0, 10),
+                                              probe - SGVec3d(0, 0, 10)));
+            break;
+        case 1:
+            segments.push_back(SGLineSegmentd(probe + SGVec3d(-3, 2, 5),
+                                              probe + SGVec3d(4, -1, -5)));
+            break;
+        default:
+            segments.push_back(SGLineSegmentd(SGVec3d(-5, probe[1], 0.5),
+                                              SGVec3d(size + 5, probe[1], 0.5)));
+            break;
+        }
+    }
+    segments.push_back(SGLineSegmentd(SGVec3d(-10, -10, 10), SGVec3d(-5, -5, 10)));
+
+    std::vector<BVHFlatTree::Hit> hits(segments.size());
+    flat->intersect(segments.data(), hits.data(), segments.size());
+
+    unsigned hitCount = 0;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        // the object tree traversal is the reference
+        BVHLineSegmentVisitor expected(segments[i]);
+        tree->traverse(expected);
+        BVHFlatTree::Hit hit;
+        bool haveHit = flat->intersect(segments[i], hit);
+        if (haveHit != !expected.empty() || hits[i].valid != haveHit)
+            return false;
+        if (!haveHit)
+            continue;
+        ++hitCount;
+        if (!equivalent(expected.getPoint(), hit.point, 1e-4))
+            return false;
+        if (!equivalent(hits[i].point, hit.point, 1e-4))
+            return false;
+        if (!equivalent(expected.getNormal(), hit.normal, 1e-5))
+            return false;
+
+        // and the visitor entering through the geometry uses the flat tree
+        BVHLineSegmentVisitor visitor(segments[i]);
+        tree->accept(visitor);
+        if (visitor.empty() || !equivalent(visitor.getPoint(), hit.point))
+            return false;
+    }
+    if (hitCount < segments.size()/2)
+        return false;
+
+    // a tree made of a single triangle
+    SGSharedPtr<BVHNode> single = buildSingleTriangle(SGVec3f(-1, -1, 0),
+                                                      SGVec3f(1, -1, 0),
+                                                      SGVec3f(0, 1, 0));
+    BVHLineSegmentVisitor visitor(SGLineSegmentd(SGVec3d(0, 0, -1),
+                                                 SGVec3d(0, 0, 1)));
+    single->accept(visitor);
+    if (visitor.empty() || !equivalent(visitor.getPoint(), SGVec3d(0, 0, 0)))
+        return false;
+
+    return true;
+}
+
+bool
+testBatchQueries()
+{
+    const int size = 40;
+    SGSharedPtr<BVHStaticGeometryBuilder> builder = new BVHStaticGeometryBuilder;
+    addHeightField(*builder, size);
+    SGSharedPtr<BVHNode> field = builder->buildTree();
+
+    // the same field twice, once shifted through a transform
+    SGSharedPtr<BVHGroup> scene = new BVHGroup;
+    scene->addChild(field);
+    SGSharedPtr<BVHTransform> transform = new BVHTransform;
+    transform->setToWorldTransform(SGMatrixd(-SGVec3d(size + 10, 5, 2)));
+    transform->addChild(field);
+    scene->addChild(transform);
+
+    std::vector<SGLineSegmentd> segments;
+    for (int i = 0; i < 700; ++i) {
+        SGVec3d probe(0.13 + 0.127*i, 0.29 + 0.053*i, 0);
+        if (i % 7 == 3)
+            probe += SGVec3d(0, 1000, 0); // misses everything
+        segments.push_back(SGLineSegmentd(probe + SGVec3d(0.2, 0, 10),
+                                          probe - SGVec3d(0, 0.3, 10)));
+    }
+
+    BVHBatchLineSegmentVisitor batch;
+    for (size_t i = 0; i < segments.size(); ++i)
+        batch.addLineSegment(segments[i]);
+    scene->accept(batch);
+
+    // queries enter in a different order, results keep their index
+    BVHBatchLineSegmentVisitor parallel;
+    parallel.setParallel(true);
+    for (size_t i = segments.size(); i-- > 0;)
+        parallel.addLineSegment(segments[i]);
+    scene->accept(parallel);
+
+    unsigned hitCount = 0;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        BVHLineSegmentVisitor expected(segments[i]);
+        scene->accept(expected);
+        size_t j = segments.size() - 1 - i;
+        if (expected.empty() != batch.empty(i)
+            || expected.empty() != parallel.empty(j))
+            return false;
+        if (expected.empty())
+            continue;
+        ++hitCount;
+        if (!equivalent(expected.getPoint(), batch.getPoint(i), 1e-6))
+            return false;
+        if (!equivalent(expected.getNormal(), batch.getNormal(i), 1e-6))
+            return false;
+        if (!equivalent(expected.getPoint(), parallel.getPoint(j), 1e-6))
+            return false;
+    }
+    if (hitCount < segments.size()/3)
+        return false;
+
+    // ground elevation of a patch of terrain at 100m
+    SGSharedPtr<BVHMaterial> material = new BVHMaterial;
+    SGSharedPtr<BVHStaticGeometryBuilder> terrain = new BVHStaticGeometryBuilder;
+    terrain->setCurrentMaterial(material);
+    SGVec3d center = SGVec3d::fromGeod(SGGeod::fromDegM(10, 50, 100));
+    SGVec3f v[4];
+    for (int k = 0; k < 4; ++k) {
+        SGGeod corner = SGGeod::fromDegM(10 + ((k & 1) ? 0.01 : -0.01),
+                                         50 + ((k >> 1) ? 0.01 : -0.01), 100);
+        v[k] = SGVec3f(SGVec3d::fromGeod(corner) - center);
+    }
+    terrain->addTriangle(v[0], v[1], v[3]);
+    terrain->addTriangle(v[0], v[3], v[2]);
+    SGSharedPtr<BVHTransform> placed = new BVHTransform;
+    placed->setToWorldTransform(SGMatrixd(-center));
+    placed->addChild(terrain->buildTree());
+
+    BVHBatchLineSegmentVisitor ground;
+    ground.addElevationQuery(SGGeod::fromDegM(10.002, 50.003, 3000));
+    ground.addElevationQuery(SGGeod::fromDegM(10.5, 50.5, 3000));
+    placed->accept(ground);
+    if (ground.empty(0) || !ground.empty(1))
+        return false;
+    if (std::fabs(ground.getElevationM(0) - 100) > 0.5)
+        return false;
+    if (ground.getMaterial(0) != material)
+        return false;
+
+    return true;
+}
+
+// page requests block in load() until the gate opens
+std::atomic<bool> pageGate(true);
+std::mutex pageLoadMutex;
+std::vector<int> pageLoadOrder;
+
+class TestPageNode : public BVHPageNode {
+public:
+    TestPageNode(int id, const SGVec3d& center) :
+        _id(id),
+        _center(center),
+        _inserted(false)
+    { }
+
+    virtual SGSphered computeBoundingSphere() const
+    { return SGSphered(_center, 1); }
+    virtual BVHPageRequest* newRequest();
+
+    int _id;
+    SGVec3d _center;
+    bool _inserted;
+
+protected:
+    virtual void invalidateBound()
+    { }
+};
+
+class TestPageRequest : public BVHPageRequest {
+public:
+    TestPageRequest(TestPageNode* pageNode) :
+        _pageNode(pageNode)
+    { }
+
+    virtual void load()
+    {
+        while (!pageGate)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lock(pageLoadMutex);
+        pageLoadOrder.push_back(_pageNode->_id);
+    }
+    virtual void insert()
+    { _pageNode->_inserted = true; }
+    virtual BVHPageNode* getPageNode()
+    { return _pageNode; }
+
+private:
+    SGSharedPtr<TestPageNode> _pageNode;
+};
+
+BVHPageRequest*
+TestPageNode::newRequest()
+{
+    return new TestPageRequest(this);
+}
+
+template<typename Predicate>
+bool
+waitFor(BVHPager& pager, Predicate predicate)
+{
+    for (int i = 0; i < 5000; ++i) {
+        pager.update(100);
+        if (predicate(pager.getStats()))
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+bool
+testPager()
+{
+    BVHPager pager;
+    pager.setNumWorkers(1);
+    pager.setReferencePoint(SGVec3d(0, 0, 0));
+    if (!pager.start())
+        return false;
+
+    // keep the only pager thread busy ...
+    pageGate = false;
+    SGSharedPtr<TestPageNode> blocker = new TestPageNode(0, SGVec3d(0, 0, 0));
+    pager.use(*blocker);
+    if (!waitFor(pager, [](const BVHPager::Stats& s) { return s.loading == 1; }))
+        return false;
+
+    // ... while requests queue up out of order
+    std::vector<SGSharedPtr<TestPageNode> > nodes;
+    const int distances[] = { 300, 100, 400, 200 };
+    for (int d : distances) {
+        nodes.push_back(new TestPageNode(d, SGVec3d(d, 0, 0)));
+        pager.use(*nodes.back());
+    }
+    pager.cancel(*nodes[2]);
+    BVHPager::Stats stats = pager.getStats();
+    if (stats.queued != 3 || stats.cancelled != 1)
+        return false;
+
+    pageGate = true;
+    if (!waitFor(pager, [](const BVHPager::Stats& s) { return s.loaded == 4; }))
+        return false;
+    const std::vector<int> expected = { 0, 100, 200, 300 };
+    if (pageLoadOrder != expected)
+        return false;
+    if (!nodes[0]->_inserted || !nodes[1]->_inserted || nodes[2]->_inserted
+        || !nodes[3]->_inserted)
+        return false;
+
+    // a request expiring while it loads is never inserted
+    pageGate = false;
+    SGSharedPtr<TestPageNode> expiring = new TestPageNode(7, SGVec3d(7, 0, 0));
+    pager.use(*expiring);
+    if (!waitFor(pager, [](const BVHPager::Stats& s) { return s.loading == 1; }))
+        return false;
+    pager.setUseStamp(pager.getUseStamp() + 1000);
+    pager.update(100);
+    pageGate = true;
+    if (!waitFor(pager, [](const BVHPager::Stats& s) { return s.loading == 0; }))
+        return false;
+    pager.update(100);
+    if (expiring->_inserted || pager.getStats().cancelled != 2)
+        return false;
+
+    // several pager threads drain a larger queue
+    pager.stop();
+    pager.setNumWorkers(4);
+    if (!pager.start())
+        return false;
+    for (int i = 0; i < 40; ++i) {
+        nodes.push_back(new TestPageNode(1000 + i, SGVec3d(i, i, 0)));
+        pager.use(*nodes.back());
+    }
+    if (!waitFor(pager, [](const BVHPager::Stats& s) { return s.loaded == 44; }))
+        return false;
+    stats = pager.getStats();
+    if (stats.queued || stats.loading || stats.maxLatencySec < stats.meanLatencySec)
+        return false;
+    pager.stop();
+    return true;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -139,5 +534,13 @@ main(int argc, char** argv)
         return EXIT_FAILURE;
     if (!testNearestPoint())
         return EXIT_FAILURE;
+    if (!testSAHBuilder())
+        return EXIT_FAILURE;
+    if (!testFlatTree())
+        return EXIT_FAILURE;
+    if (!testBatchQueries())
+        return EXIT_FAILURE;
+    if (!testPager())
+        return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
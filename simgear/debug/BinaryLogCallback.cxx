@@ -0,0 +1,218 @@
+/** \file BinaryLogCallback.cxx
+ * Write log entries to a compact binary file, and read them back
+ */
+
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "BinaryLogCallback.hxx"
+
+#include <cstring>
+
+#include <simgear/misc/sg_path.hxx>
+
+namespace simgear
+{
+
+namespace
+{
+
+const char MAGIC[8] = { 'S', 'G', 'L', 'O', 'G', 'B', 'I', 'N' };
+
+enum RecordType {
+    RECORD_NAME = 1,
+    RECORD_ENTRY = 2
+};
+
+// a corrupt length should not make the reader allocate gigabytes
+const uint64_t MAX_STRING_LENGTH = 16 * 1024 * 1024;
+
+} // of anonymous namespace
+
+BinaryLogCallback::BinaryLogCallback(const SGPath& path, sgDebugClass c,
+                                     sgDebugPriority p) :
+    LogCallback(c, p)
+{
+    m_file.open(path, std::ios_base::out | std::ios_base::trunc |
+                      std::ios_base::binary);
+    m_start.stamp();
+
+    putBytes(MAGIC, sizeof(MAGIC));
+    put(VERSION, 4);
+    m_file.write(m_record.data(), m_record.size());
+    m_file.flush();
+}
+
+bool BinaryLogCallback::doProcessEntry(const LogEntry& e)
+{
+    if (!shouldLog(e.debugClass, e.debugPriority))
+        return true;
+
+    m_record.clear();
+    // name records go first, nameId() appends them
+    uint32_t fileId = nameId(e.file, e.freeFilename);
+    uint32_t functionId = nameId(e.function, e.freeFilename);
+
+    put(RECORD_ENTRY, 1);
+    put(static_cast<uint64_t>((SGTimeStamp::now() - m_start).toUSecs()), 8);
+    put(static_cast<uint32_t>(e.debugClass), 4);
+    put(e.debugPriority, 1);
+    put(e.originalPriority, 1);
+    put(static_cast<uint32_t>(e.line), 4);
+    put(fileId, 4);
+    put(functionId, 4);
+    put(e.message.size(), 4);
+    putBytes(e.message.data(), e.message.size());
+
+    m_file.write(m_record.data(), m_record.size());
+    // the rest can wait for the stream buffer to fill, but warnings
+    // should be on disk in case we crash
+    if (e.debugPriority >= SG_WARN) {
+        m_file.flush();
+    }
+    return true;
+}
+
+uint32_t BinaryLogCallback::nameId(const char* name, bool owned)
+{
+    if (!name || !*name)
+        return 0;
+
+    if (!owned) {
+        auto it = m_staticNames.find(name);
+        if (it != m_staticNames.end())
+            return it->second;
+    }
+
+    // the same text might be known already, from another pointer
+    auto it = m_ownedNames.find(name);
+    uint32_t id;
+    if (it != m_ownedNames.end()) {
+        id = it->second;
+    } else {
+        id = m_nextId++;
+        m_ownedNames.emplace(name, id);
+
+        size_t length = strlen(name);
+        put(RECORD_NAME, 1);
+        put(id, 4);
+        put(length, 4);
+        putBytes(name, length);
+    }
+
+    if (!owned)
+        m_staticNames.emplace(name, id);
+    return id;
+}
+
+void BinaryLogCallback::put(uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) {
+        m_record.push_back(static_cast<char>(value & 0xff));
+        value >>= 8;
+    }
+}
+
+void BinaryLogCallback::putBytes(const char* data, size_t length)
+{
+    m_record.insert(m_record.end(), data, data + length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+BinaryLogReader::BinaryLogReader(const SGPath& path) :
+    m_file(path),
+    m_valid(false)
+{
+    char magic[sizeof(MAGIC)];
+    uint64_t version;
+    if (!m_file.read(magic, sizeof(magic)) ||
+        memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !get(version, 4) || version != BinaryLogCallback::VERSION) {
+        return;
+    }
+
+    m_names.push_back(std::string()); // id 0, no name
+    m_valid = true;
+}
+
+bool BinaryLogReader::next(Entry& entry)
+{
+    if (!m_valid)
+        return false;
+
+    uint64_t type;
+    for (;;) {
+        // running out of file between records is the normal end
+        if (!get(type, 1))
+            return false;
+
+        if (type == RECORD_NAME) {
+            uint64_t id;
+            std::string name;
+            // ids are handed out in order
+            if (!get(id, 4) || id != m_names.size() || !getString(name))
+                break; // corrupt
+            m_names.push_back(name);
+        } else if (type == RECORD_ENTRY) {
+            uint64_t usec, c, p, op, line, fileId, functionId;
+            if (!get(usec, 8) || !get(c, 4) || !get(p, 1) || !get(op, 1) ||
+                !get(line, 4) || !get(fileId, 4) || !get(functionId, 4) ||
+                fileId >= m_names.size() || functionId >= m_names.size() ||
+                !getString(entry.message)) {
+                break; // corrupt
+            }
+            entry.usec = usec;
+            entry.debugClass = static_cast<sgDebugClass>(c);
+            entry.debugPriority = static_cast<sgDebugPriority>(p);
+            entry.originalPriority = static_cast<sgDebugPriority>(op);
+            entry.line = static_cast<int32_t>(line);
+            entry.file = m_names[fileId];
+            entry.function = m_names[functionId];
+            return true;
+        } else {
+            break; // corrupt
+        }
+    }
+
+    // nothing after a bad record can be trusted
+    m_valid = false;
+    return false;
+}
+
+bool BinaryLogReader::get(uint64_t& value, int bytes)
+{
+    unsigned char buf[8];
+    if (!m_file.read(reinterpret_cast<char*>(buf), bytes))
+        return false;
+
+    value = 0;
+    for (int i = bytes - 1; i >= 0; --i)
+        value = (value << 8) | buf[i];
+    return true;
+}
+
+bool BinaryLogReader::getString(std::string& s)
+{
+    uint64_t length;
+    if (!get(length, 4) || length > MAX_STRING_LENGTH)
+        return false;
+
+    s.resize(length);
+    return length == 0 || m_file.read(&s[0], length);
+}
+
+} // namespace simgear
@@ -0,0 +1,121 @@
+/** \file BinaryLogCallback.hxx
+ * Write log entries to a compact binary file, and read them back
+ */
+
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef SG_DEBUG_BINARYLOGCALLBACK_HXX
+#define SG_DEBUG_BINARYLOGCALLBACK_HXX
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <simgear/debug/LogCallback.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+class SGPath;
+
+namespace simgear
+{
+
+/**
+ * Log callback writing a binary file, which is smaller and cheaper to
+ * write than text: file and function names are written once and then
+ * referred to by number, and nothing is formatted.
+ *
+ * The file starts with the 8 bytes "SGLOGBIN" and a 32 bit format
+ * version, followed by records starting with a type byte:
+ *
+ *  - 1, a name: 32 bit id (starting at 1), 32 bit length, characters
+ *  - 2, an entry: 64 bit microseconds since the file was opened, 32 bit
+ *    class, 8 bit priority, 8 bit original priority, 32 bit line,
+ *    32 bit file id, 32 bit function id (0 for none), 32 bit message
+ *    length, message
+ *
+ * All integers are little endian.
+ */
+class BinaryLogCallback : public LogCallback
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    BinaryLogCallback(const SGPath& path, sgDebugClass c, sgDebugPriority p);
+
+    bool doProcessEntry(const LogEntry& e) override;
+
+private:
+    uint32_t nameId(const char* name, bool owned);
+
+    void put(uint64_t value, int bytes);
+    void putBytes(const char* data, size_t length);
+
+    sg_ofstream m_file;
+    SGTimeStamp m_start;
+    std::vector<char> m_record;
+
+    // __FILE__ and __FUNCTION__ are constant, so their addresses can be
+    // used as keys. Names owned by the entry are looked up by content.
+    std::unordered_map<const char*, uint32_t> m_staticNames;
+    std::map<std::string, uint32_t> m_ownedNames;
+    uint32_t m_nextId = 1;
+};
+
+/**
+ * Reads the files written by BinaryLogCallback.
+ */
+class BinaryLogReader
+{
+public:
+    struct Entry
+    {
+        uint64_t usec;
+        sgDebugClass debugClass;
+        sgDebugPriority debugPriority;
+        sgDebugPriority originalPriority;
+        int line;
+        std::string file;
+        std::string function;
+        std::string message;
+    };
+
+    /// Opens the file and checks its header, see isValid()
+    explicit BinaryLogReader(const SGPath& path);
+
+    bool isValid() const { return m_valid; }
+
+    /**
+     * Read the next entry.
+     *
+     * @return false at the end of the file, or if the rest of it is
+     *         truncated or corrupt. isValid() is false after that.
+     */
+    bool next(Entry& entry);
+
+private:
+    bool get(uint64_t& value, int bytes);
+    bool getString(std::string& s);
+
+    sg_ifstream m_file;
+    bool m_valid;
+    std::vector<std::string> m_names;
+};
+
+} // namespace simgear
+
+#endif // SG_DEBUG_BINARYLOGCALLBACK_HXX
@@ -0,0 +1,121 @@
+/** \file LogRingBuffer.cxx
+ * Bounded lock-free queue passing log entries to the logging thread
+ */
+
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "LogRingBuffer.hxx"
+
+#include <cstdlib>
+
+namespace simgear
+{
+
+namespace
+{
+
+// initial capacity of the message strings, enough for most messages
+const size_t MESSAGE_RESERVE = 128;
+
+size_t roundUpPow2(size_t n)
+{
+    size_t size = 2;
+    while (size < n)
+        size <<= 1;
+    return size;
+}
+
+} // of anonymous namespace
+
+LogRingBuffer::LogRingBuffer(size_t size) :
+    _slots(new Slot[roundUpPow2(size)]),
+    _mask(roundUpPow2(size) - 1),
+    _enqueuePos(0),
+    _dequeuePos(0),
+    _dropped(0)
+{
+    for (size_t i = 0; i <= _mask; ++i) {
+        _slots[i].message.reserve(MESSAGE_RESERVE);
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+LogRingBuffer::~LogRingBuffer()
+{
+    // free the names of entries nobody consumed
+    for (const Slot* s = front(); s; s = front()) {
+        if (s->freeFilename) {
+            free(const_cast<char*>(s->file));
+            free(const_cast<char*>(s->function));
+        }
+        pop();
+    }
+}
+
+bool LogRingBuffer::push(sgDebugClass c, sgDebugPriority p, sgDebugPriority op,
+                         const char* file, int line, const char* function,
+                         const std::string& msg, bool freeFilename)
+{
+    Slot* slot;
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &_slots[pos & _mask];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        ptrdiff_t diff = static_cast<ptrdiff_t>(seq - pos);
+        if (diff == 0) {
+            // free for this position, claim it
+            if (_enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // still holds the entry from one lap ago
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->debugClass = c;
+    slot->debugPriority = p;
+    slot->originalPriority = op;
+    slot->file = file;
+    slot->line = line;
+    slot->function = function;
+    slot->freeFilename = freeFilename;
+    slot->message.assign(msg);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+const LogRingBuffer::Slot* LogRingBuffer::front() const
+{
+    const Slot& slot = _slots[_dequeuePos & _mask];
+    if (slot.sequence.load(std::memory_order_acquire) != _dequeuePos + 1)
+        return nullptr;
+    return &slot;
+}
+
+void LogRingBuffer::pop()
+{
+    Slot& slot = _slots[_dequeuePos & _mask];
+    // free for the position one lap ahead
+    slot.sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+    ++_dequeuePos;
+}
+
+} // namespace simgear
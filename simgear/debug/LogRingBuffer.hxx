@@ -0,0 +1,102 @@
+/** \file LogRingBuffer.hxx
+ * Bounded lock-free queue passing log entries to the logging thread
+ */
+
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef SG_DEBUG_LOGRINGBUFFER_HXX
+#define SG_DEBUG_LOGRINGBUFFER_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <simgear/debug/debug_types.h>
+
+namespace simgear
+{
+
+/**
+ * Ring of preallocated log entries, written by any number of threads and
+ * read by one.
+ *
+ * push() never blocks: when the ring is full the entry is dropped and
+ * counted instead. The message strings of the slots keep their storage,
+ * so once the ring has warmed up, pushing a message no longer allocates.
+ * (After D. Vyukov's bounded MPMC queue: every slot carries a sequence
+ * number telling whether it is free for a given position or filled.)
+ */
+class LogRingBuffer
+{
+public:
+    struct Slot
+    {
+        sgDebugClass debugClass;
+        sgDebugPriority debugPriority;
+        sgDebugPriority originalPriority;
+        const char* file;
+        int line;
+        const char* function;
+        bool freeFilename;
+        std::string message;
+
+        std::atomic<size_t> sequence;
+    };
+
+    /// @param size Number of entries, rounded up to a power of two
+    explicit LogRingBuffer(size_t size);
+    ~LogRingBuffer();
+
+    /**
+     * Add an entry, from any thread.
+     *
+     * @return false if the ring is full and the entry was dropped. The
+     *         caller still owns file and function then.
+     */
+    bool push(sgDebugClass c, sgDebugPriority p, sgDebugPriority op,
+              const char* file, int line, const char* function,
+              const std::string& msg, bool freeFilename);
+
+    /**
+     * Oldest entry, or nullptr if the ring is empty. Only the consuming
+     * thread may call this and pop(). Ownership of file and function
+     * passes to the consumer if freeFilename is set.
+     */
+    const Slot* front() const;
+
+    /// Release the entry returned by front()
+    void pop();
+
+    bool empty() const { return front() == nullptr; }
+
+    /// Number of entries dropped so far because the ring was full
+    size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    LogRingBuffer(const LogRingBuffer&) = delete;
+    LogRingBuffer& operator=(const LogRingBuffer&) = delete;
+
+    std::unique_ptr<Slot[]> _slots;
+    const size_t _mask;
+    // producers and the consumer on separate cache lines
+    alignas(64) std::atomic<size_t> _enqueuePos;
+    alignas(64) size_t _dequeuePos;
+    std::atomic<size_t> _dropped;
+};
+
+} // namespace simgear
+
+#endif // SG_DEBUG_LOGRINGBUFFER_HXX
@@ -0,0 +1,61 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <simgear/debug/BinaryLogCallback.hxx>
+#include <simgear/misc/sg_path.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Turns a log file written by logstream::logToBinaryFile() into text, in
+// the layout of the text log files.
+
+namespace {
+
+// for the class and priority names of the text log files
+class LogNames : public simgear::LogCallback
+{
+public:
+    using simgear::LogCallback::debugClassToString;
+    using simgear::LogCallback::debugPriorityToString;
+};
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " <binary log file>" << endl;
+        return EXIT_FAILURE;
+    }
+
+    simgear::BinaryLogReader reader(SGPath::fromLocal8Bit(argv[1]));
+    if (!reader.isValid()) {
+        cerr << argv[1] << ": not a binary log file" << endl;
+        return EXIT_FAILURE;
+    }
+
+    simgear::BinaryLogReader::Entry e;
+    while (reader.next(e)) {
+        cout << std::fixed << std::setprecision(2) << std::setw(8) << std::right
+             << (e.usec / 1e6)
+             << std::setw(8) << std::left
+             << " [" + std::string(LogNames::debugPriorityToString(e.debugPriority)) + "]:"
+             << std::setw(10) << std::left
+             << LogNames::debugClassToString(e.debugClass);
+        if (!e.file.empty()) {
+            cout << e.file << ":" << std::abs(e.line) << ": ";
+        }
+        cout << e.message << "\n";
+    }
+
+    if (reader.isValid()) {
+        return EXIT_SUCCESS;
+    }
+    cerr << argv[1] << ": truncated or corrupt" << endl;
+    return EXIT_FAILURE;
+}
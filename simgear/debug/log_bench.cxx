@@ -0,0 +1,82 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <iostream>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/debug/LogCallback.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Times SG_LOG statements that are filtered out, through the call site
+// cache of SG_LOGX and through logstream::would_log() as before, and
+// statements that are logged (to a callback discarding them).
+
+namespace {
+
+class DiscardLogCallback : public simgear::LogCallback
+{
+public:
+    DiscardLogCallback() : simgear::LogCallback(SG_ALL, SG_BULK) {}
+    bool doProcessEntry(const simgear::LogEntry&) override { return true; }
+};
+
+// Returns nanoseconds per statement
+double disabledCached(int n)
+{
+    SGTimeStamp start = SGTimeStamp::now();
+    for (int i = 0; i < n; ++i) {
+        SG_LOG(SG_GENERAL, SG_DEBUG, "disabled " << i);
+    }
+    return (SGTimeStamp::now() - start).toNSecs() / double(n);
+}
+
+double disabledUncached(int n)
+{
+    SGTimeStamp start = SGTimeStamp::now();
+    for (int i = 0; i < n; ++i) {
+        if (sglog().would_log(SG_GENERAL, SG_DEBUG, __FILE__, __LINE__, __FUNCTION__)) {
+            std::ostringstream os; os << "disabled " << i;
+            sglog().log(SG_GENERAL, SG_DEBUG, __FILE__, __LINE__, __FUNCTION__, os.str());
+        }
+    }
+    return (SGTimeStamp::now() - start).toNSecs() / double(n);
+}
+
+double enabled(int n)
+{
+    SGTimeStamp start = SGTimeStamp::now();
+    for (int i = 0; i < n; ++i) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "enabled " << i);
+    }
+    return (SGTimeStamp::now() - start).toNSecs() / double(n);
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2) {
+        cerr << "Usage: " << argv[0] << " [iterations]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    int n = (argc > 1) ? atoi(argv[1]) : 10000000;
+    if (n <= 0) {
+        cerr << "bad iteration count" << endl;
+        return EXIT_FAILURE;
+    }
+
+    sglog().removeCallbacks();
+    sglog().addCallback(new DiscardLogCallback);
+    sglog().setLogLevels(SG_ALL, SG_WARN);
+
+    cout << "disabled, cached:   " << disabledCached(n) << " ns" << endl;
+    cout << "disabled, uncached: " << disabledUncached(n) << " ns" << endl;
+    // enabled statements format a message and queue it for the log thread
+    cout << "enabled:            " << enabled(n / 10) << " ns" << endl;
+    return EXIT_SUCCESS;
+}
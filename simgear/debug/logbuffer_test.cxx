@@ -0,0 +1,174 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <simgear/debug/BinaryLogCallback.hxx>
+#include <simgear/debug/LogRingBuffer.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/misc/test_macros.hxx>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+using simgear::BinaryLogReader;
+using simgear::LogRingBuffer;
+
+void testFullRing()
+{
+    LogRingBuffer ring(4);
+    SG_VERIFY(ring.empty());
+
+    for (int i = 0; i < 4; ++i) {
+        SG_VERIFY(ring.push(SG_GENERAL, SG_INFO, SG_INFO, "file", i, "func",
+                            std::to_string(i), false));
+    }
+    SG_VERIFY(!ring.push(SG_GENERAL, SG_INFO, SG_INFO, "file", 4, "func",
+                         "4", false));
+    SG_CHECK_EQUAL(ring.dropped(), 1u);
+
+    for (int i = 0; i < 2; ++i) {
+        const LogRingBuffer::Slot* s = ring.front();
+        SG_VERIFY(s);
+        SG_CHECK_EQUAL(s->line, i);
+        SG_CHECK_EQUAL(s->message, std::to_string(i));
+        ring.pop();
+    }
+
+    // freed slots are used again
+    SG_VERIFY(ring.push(SG_GENERAL, SG_INFO, SG_INFO, "file", 5, "func",
+                        "5", false));
+    int expected[] = { 2, 3, 5 };
+    for (int line : expected) {
+        const LogRingBuffer::Slot* s = ring.front();
+        SG_VERIFY(s);
+        SG_CHECK_EQUAL(s->line, line);
+        ring.pop();
+    }
+    SG_VERIFY(ring.empty());
+    SG_CHECK_EQUAL(ring.dropped(), 1u);
+
+    // owned names left in the ring are freed by its destructor
+    ring.push(SG_GENERAL, SG_INFO, SG_INFO, strdup("owned"), 6, strdup("f"),
+              "6", true);
+}
+
+void testThreads()
+{
+    const int numThreads = 4;
+    const int perThread = 100000;
+    LogRingBuffer ring(64);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < numThreads; ++t) {
+        producers.emplace_back([&ring, t]() {
+            for (int i = 0; i < perThread; ++i) {
+                // spin instead of dropping, to check nothing gets lost
+                while (!ring.push(SG_GENERAL, SG_INFO, SG_INFO, "file", i,
+                                  nullptr, string(1, 'a' + t), false)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // entries of each thread arrive in order
+    std::vector<int> next(numThreads, 0);
+    int received = 0;
+    while (received < numThreads * perThread) {
+        const LogRingBuffer::Slot* s = ring.front();
+        if (!s) {
+            std::this_thread::yield();
+            continue;
+        }
+        int t = s->message[0] - 'a';
+        SG_VERIFY(t >= 0 && t < numThreads);
+        SG_CHECK_EQUAL(s->line, next[t]);
+        ++next[t];
+        ++received;
+        ring.pop();
+    }
+
+    for (std::thread& t : producers) {
+        t.join();
+    }
+    SG_VERIFY(ring.empty());
+}
+
+void testBinaryFile()
+{
+    SGPath path = SGPath::fromEnv("TMPDIR", SGPath::fromUtf8("/tmp")) /
+                  "test_logbuffer.sglog";
+    const char* thisFile = "test_logbuffer.cxx";
+    {
+        simgear::BinaryLogCallback cb(path, SG_ALL, SG_INFO);
+        cb.processEntry(simgear::LogEntry(SG_NASAL, SG_WARN, SG_DEV_WARN,
+                                          thisFile, 10, "main", "first", false));
+        // filtered out
+        cb.processEntry(simgear::LogEntry(SG_NASAL, SG_DEBUG, SG_DEBUG,
+                                          thisFile, 11, "main", "hidden", false));
+        cb.processEntry(simgear::LogEntry(SG_IO, SG_ALERT, SG_ALERT,
+                                          thisFile, -12, nullptr, "", false));
+        // same name, owned by the entry
+        cb.processEntry(simgear::LogEntry(SG_GENERAL, SG_INFO, SG_INFO,
+                                          strdup(thisFile), 13, strdup("other"),
+                                          "third", true));
+    }
+
+    BinaryLogReader reader(path);
+    SG_VERIFY(reader.isValid());
+
+    BinaryLogReader::Entry e;
+    SG_VERIFY(reader.next(e));
+    SG_CHECK_EQUAL(e.debugClass, SG_NASAL);
+    SG_CHECK_EQUAL(e.debugPriority, SG_WARN);
+    SG_CHECK_EQUAL(e.originalPriority, SG_DEV_WARN);
+    SG_CHECK_EQUAL(e.file, thisFile);
+    SG_CHECK_EQUAL(e.line, 10);
+    SG_CHECK_EQUAL(e.function, "main");
+    SG_CHECK_EQUAL(e.message, "first");
+
+    SG_VERIFY(reader.next(e));
+    SG_CHECK_EQUAL(e.debugClass, SG_IO);
+    SG_CHECK_EQUAL(e.line, -12);
+    SG_CHECK_EQUAL(e.function, "");
+    SG_CHECK_EQUAL(e.message, "");
+
+    SG_VERIFY(reader.next(e));
+    SG_CHECK_EQUAL(e.file, thisFile);
+    SG_CHECK_EQUAL(e.function, "other");
+    SG_CHECK_EQUAL(e.message, "third");
+
+    SG_VERIFY(!reader.next(e));
+    SG_VERIFY(reader.isValid());
+
+    // a truncated file ends early, and says so
+    string data = sg_ifstream(path).read_all();
+    {
+        sg_ofstream out(path, std::ios_base::out | std::ios_base::trunc |
+                              std::ios_base::binary);
+        out.write(data.data(), data.size() - 3);
+    }
+    BinaryLogReader truncated(path);
+    SG_VERIFY(truncated.next(e));
+    SG_VERIFY(truncated.next(e));
+    SG_VERIFY(!truncated.next(e));
+    SG_VERIFY(!truncated.isValid());
+
+    path.remove();
+}
+
+int main(int argc, char* argv[])
+{
+    testFullRing();
+    testThreads();
+    testBinaryFile();
+
+    cout << "all tests passed" << endl;
+    return EXIT_SUCCESS;
+}
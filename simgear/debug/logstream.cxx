@@ -30,13 +30,18 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
 #include <mutex>
 
 #include <simgear/sg_inlines.h>
 #include <simgear/threads/SGThread.hxx>
-#include <simgear/threads/SGQueue.hxx>
 
+#include "BinaryLogCallback.hxx"
 #include "LogCallback.hxx"
+#include "LogRingBuffer.hxx"
 #include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/misc/strutils.hxx>
@@ -193,6 +198,7 @@ private:
 
 public:
     LogStreamPrivate() :
+        m_entries(LOG_BUFFER_SIZE),
         m_logClass(SG_ALL),
         m_logPriority(SG_ALERT)
     {
@@ -314,7 +320,17 @@ public:
     }
 
     std::mutex m_lock;
-    SGBlockingQueue<simgear::LogEntry> m_entries;
+
+    // Entries from all threads for the logging thread. When it runs out
+    // of entries, the thread sets m_waiting and sleeps on m_wakeup until
+    // the next log() or stop().
+    static const size_t LOG_BUFFER_SIZE = 4096;
+    simgear::LogRingBuffer m_entries;
+    std::mutex m_wakeupLock;
+    std::condition_variable m_wakeup;
+    std::atomic<bool> m_waiting{false};
+    std::atomic<bool> m_stopping{false};
+    size_t m_reportedDropped = 0;
 
     // log entries posted during startup
     std::vector<simgear::LogEntry> m_startupEntries;
@@ -347,9 +363,54 @@ public:
         std::lock_guard<std::mutex> g(m_lock);
         if (m_isRunning) return;
         m_isRunning = true;
+        m_stopping = false;
         start();
     }
 
+    void wakeup()
+    {
+        if (m_waiting.exchange(false)) {
+            // taking the lock makes sure the thread is waiting already
+            std::lock_guard<std::mutex> g(m_wakeupLock);
+            m_wakeup.notify_one();
+        }
+    }
+
+    // Sleep until there are entries or stop() is called. Returns false
+    // if stop() was called and all entries are processed.
+    bool waitForEntries()
+    {
+        std::unique_lock<std::mutex> g(m_wakeupLock);
+        m_waiting = true;
+        while (m_entries.empty()) {
+            if (m_stopping) {
+                m_waiting = false;
+                return false;
+            }
+            // the timeout is only a safety net, log() and stop() notify
+            m_wakeup.wait_for(g, std::chrono::milliseconds(100));
+            m_waiting = true;
+        }
+        m_waiting = false;
+        return true;
+    }
+
+    void processEntry(const simgear::LogEntry& entry)
+    {
+        {
+            std::lock_guard<std::mutex> g(m_lock);
+            if (m_startupLogging) {
+                // save to the startup list for not-yet-added callbacks to
+                // pull down on startup
+                m_startupEntries.push_back(entry);
+            }
+        }
+        // submit to each installed callback in turn
+        for (simgear::LogCallback* cb : m_callbacks) {
+            cb->processEntry(entry);
+        }
+    }
+
     void setStartupLoggingEnabled(bool on)
     {
         if (m_startupLogging == on) {
@@ -370,24 +431,26 @@ public:
 
     void run() override
     {
-        while (1) {
-            simgear::LogEntry entry(m_entries.pop());
-            // special marker entry detected, terminate the thread since we are
-            // making a configuration change or quitting the app
-            if ((entry.debugClass == SG_NONE) && entry.file && !strcmp(entry.file, "done")) {
-                return;
+        // runs until stop() is called, a configuration change or quitting
+        // the app, after processing everything logged before
+        while (waitForEntries()) {
+            while (const simgear::LogRingBuffer::Slot* s = m_entries.front()) {
+                // the entry takes over file and function, if owned
+                simgear::LogEntry entry(s->debugClass, s->debugPriority,
+                                        s->originalPriority, s->file, s->line,
+                                        s->function, s->message, s->freeFilename);
+                m_entries.pop();
+                processEntry(entry);
             }
-            {
-                std::lock_guard<std::mutex> g(m_lock);
-                if (m_startupLogging) {
-                    // save to the startup list for not-yet-added callbacks to
-                    // pull down on startup
-                    m_startupEntries.push_back(entry);
-                }
-            }
-            // submit to each installed callback in turn
-            for (simgear::LogCallback* cb : m_callbacks) {
-                cb->processEntry(entry);
+
+            size_t dropped = m_entries.dropped();
+            if (dropped != m_reportedDropped) {
+                std::ostringstream os;
+                os << (dropped - m_reportedDropped)
+                   << " log messages dropped, the log buffer was full";
+                m_reportedDropped = dropped;
+                processEntry(simgear::LogEntry(SG_GENERAL, SG_ALERT, SG_ALERT,
+                                               nullptr, 0, nullptr, os.str(), false));
             }
         } // of main thread loop
     }
@@ -400,9 +463,10 @@ public:
                 return false;
             }
 
-            // log a special marker value, which will cause the thread to wakeup,
-            // and then exit
-            log(SG_NONE, SG_ALERT, "done", -1, "", "", false);
+            // makes the thread exit once it has processed all entries
+            std::lock_guard<std::mutex> w(m_wakeupLock);
+            m_stopping = true;
+            m_wakeup.notify_one();
         }
         join();
 
@@ -449,6 +513,7 @@ public:
         for (auto cb : m_consoleCallbacks) {
             cb->setLogLevels(c, p);
         }
+        simgear::LogCallSite::invalidateAll();
     }
 
     bool would_log( sgDebugClass c, sgDebugPriority p,
@@ -477,8 +542,15 @@ public:
             line = -line;
         }
 
-        simgear::LogEntry entry(c, tp, p, fileName, line, function, msg, freeFilename);
-        m_entries.push(entry);
+        if (!m_entries.push(c, tp, p, fileName, line, function, msg, freeFilename)) {
+            // dropped, see run()
+            if (freeFilename) {
+                free(const_cast<char*>(fileName));
+                free(const_cast<char*>(function));
+            }
+            return;
+        }
+        wakeup();
     }
 
     sgDebugPriority translatePriority(sgDebugPriority in,
@@ -524,6 +596,7 @@ logstream::setLogLevels( sgDebugClass c, sgDebugPriority p )
 void logstream::setDeveloperMode(bool devMode)
 {
     d->m_developerMode = devMode;
+    simgear::LogCallSite::invalidateAll();
 }
 
 void logstream::setFileLine(bool fileLine)
@@ -543,6 +616,12 @@ logstream::removeCallback(simgear::LogCallback* cb)
     d->removeCallback(cb);
 }
 
+void
+logstream::removeCallbacks()
+{
+    d->removeCallbacks();
+}
+
 void
 logstream::log( sgDebugClass c, sgDebugPriority p,
         const char* fileName, int line, const char* function,
@@ -707,6 +786,18 @@ logstream::logToFile( const SGPath& aPath, sgDebugClass c, sgDebugPriority p )
     d->addCallback(new FileLogCallback(aPath, c, p));
 }
 
+void
+logstream::logToBinaryFile( const SGPath& aPath, sgDebugClass c, sgDebugPriority p )
+{
+    d->addCallback(new simgear::BinaryLogCallback(aPath, c, p));
+}
+
+size_t
+logstream::droppedEntries() const
+{
+    return d->m_entries.dropped();
+}
+
 void logstream::setStartupLoggingEnabled(bool enabled)
 {
     d->setStartupLoggingEnabled(enabled);
@@ -761,6 +852,7 @@ logstream::setTestingMode( bool testMode )
 {
     d->m_testMode = testMode;
     if (testMode) d->removeCallbacks();
+    simgear::LogCallSite::invalidateAll();
 }
 
 
@@ -779,4 +871,22 @@ void shutdownLogging()
     global_logstream.reset();
 }
 
+std::atomic<unsigned> LogCallSite::s_epoch(1);
+
+void LogCallSite::invalidateAll()
+{
+    // a masked epoch of 0 could match a call site that never ran
+    if ((++s_epoch & 0xffffff) == 0)
+        ++s_epoch;
+}
+
+bool LogCallSite::update(uint64_t key, sgDebugClass c, sgDebugPriority p,
+                         const char* file, int line, const char* function)
+{
+    bool result = sglog().would_log(c, p, file, line, function);
+    if (key)
+        _state.store((key << 1) | result, std::memory_order_relaxed);
+    return result;
+}
+
 } // of namespace simgear
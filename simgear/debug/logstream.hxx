@@ -28,6 +28,8 @@
 #include <simgear/compiler.h>
 #include <simgear/debug/debug_types.h>
 
+#include <atomic>
+#include <cstdint>
 #include <sstream>
 #include <vector>
 #include <memory>
@@ -48,6 +50,57 @@ void requestConsole();
 
 void shutdownLogging();
 
+/**
+ * Cached result of logstream::would_log() for one SG_LOG statement.
+ *
+ * The result depends on the log class and priority, the global levels,
+ * developer mode and SG_LOG_DELTAS (per file, line and function). Each
+ * call site keeps its last result together with the class and priority
+ * it was asked for and a global epoch, which changes whenever the
+ * levels or modes do. A statement that was filtered out before thus
+ * costs two relaxed atomic loads and a compare, without calling sglog().
+ */
+class LogCallSite
+{
+public:
+    constexpr LogCallSite() : _state(0) {}
+
+    bool would_log(sgDebugClass c, sgDebugPriority p,
+                   const char* file, int line, const char* function)
+    {
+        if (static_cast<unsigned>(p) > 0xf) // SG_OSG, see logstream
+            return update(0, c, p, file, line, function);
+
+        uint64_t key = makeKey(c, p);
+        uint64_t state = _state.load(std::memory_order_relaxed);
+        if ((state >> 1) == key)
+            return state & 1;
+        return update(key, c, p, file, line, function);
+    }
+
+    /**
+     * Drop the results cached by all call sites. logstream calls this
+     * when anything changes that would_log() depends on.
+     */
+    static void invalidateAll();
+
+private:
+    // epoch in bits 36-59, priority in bits 32-35, class in bits 0-31
+    static uint64_t makeKey(sgDebugClass c, sgDebugPriority p)
+    {
+        uint64_t epoch = s_epoch.load(std::memory_order_acquire) & 0xffffff;
+        return (epoch << 36) | (uint64_t(p & 0xf) << 32) | uint32_t(c);
+    }
+
+    bool update(uint64_t key, sgDebugClass c, sgDebugPriority p,
+                const char* file, int line, const char* function);
+
+    // key << 1 | result, 0 before the first call (epoch 0 is skipped)
+    std::atomic<uint64_t> _state;
+
+    static std::atomic<unsigned> s_epoch;
+};
+
 } // of namespace simgear
 
 /**
@@ -80,6 +133,19 @@ public:
 
     void logToFile( const SGPath& aPath, sgDebugClass c, sgDebugPriority p );
 
+    /**
+     * Log to a file in the compact binary format of BinaryLogCallback,
+     * which the decode_binlog tool turns back into text.
+     */
+    void logToBinaryFile( const SGPath& aPath, sgDebugClass c, sgDebugPriority p );
+
+    /**
+     * Number of entries dropped so far because the logging thread fell
+     * behind and the buffer between it and the logging threads was full.
+     * Log calls never wait for the logging thread.
+     */
+    size_t droppedEntries() const;
+
     void set_log_priority( sgDebugPriority p);
     
     void set_log_classes( sgDebugClass c);
@@ -201,7 +267,8 @@ logstream& sglog();
  * @param M message
  */
 # define SG_LOGX(C,P,M) \
-    do { if(sglog().would_log(C,P, __FILE__, __LINE__, __FUNCTION__)) { \
+    do { static simgear::LogCallSite sg_log_site_;       \
+        if(sg_log_site_.would_log(C,P, __FILE__, __LINE__, __FUNCTION__)) { \
         std::ostringstream os; os << M;                  \
         sglog().log(C, P, __FILE__, __LINE__, __FUNCTION__, os.str()); \
         if ((P) == SG_POPUP) sglog().popup(os.str());    \
@@ -213,8 +280,9 @@ logstream& sglog();
 #else
 # define SG_LOG(C,P,M)	SG_LOGX(C,P,M)
 # define SG_LOG_NAN(C,P,M) do { SG_LOGX(C,P,M); throw std::overflow_error(M); } while(0)
-# define SG_LOG_HEXDUMP(C,P,MEM,LEN) if(sglog().would_log(C,P, __FILE__, __LINE__, __FUNCTION__)) \
-        sglog().hexdump(C, P, __FILE__, __LINE__, __FUNCTION__, MEM, LEN)
+# define SG_LOG_HEXDUMP(C,P,MEM,LEN) do { static simgear::LogCallSite sg_log_site_; \
+        if(sg_log_site_.would_log(C,P, __FILE__, __LINE__, __FUNCTION__)) \
+        sglog().hexdump(C, P, __FILE__, __LINE__, __FUNCTION__, MEM, LEN); } while(0)
 #endif
 
 #define SG_ORIGIN __FILE__ ":" SG_STRINGIZE(__LINE__)
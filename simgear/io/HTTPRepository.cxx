@@ -29,6 +29,11 @@
 #include <fstream>
 #include <limits>
 #include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <fcntl.h>
 
@@ -44,6 +49,7 @@
 #include <simgear/timing/timestamp.hxx>
 
 #include <simgear/misc/sg_hash.hxx>
+#include <simgear/misc/sg_mmap.hxx>
 
 #include "HTTPRepository_private.hxx"
 
@@ -120,8 +126,99 @@ std::string computeHashForPath(const SGPath& p)
     return strutils::encodeHex(hashBytes);
 }
 
+// Files of a directory hashed on the repository's workers; the results
+// are only read once remaining drops to zero.
+struct HashBatch {
+    std::vector<SGPath> paths;
+    std::vector<std::string> hashes;
+    std::atomic<size_t> remaining{0};
+};
+
+using HashBatchPtr = std::shared_ptr<HashBatch>;
+
+// The .hashes file: a header, count fixed size records, then the path
+// strings the records point into. It is written in host byte order, a
+// file with the wrong magic is ignored and rebuilt.
+const uint32_t HASH_CACHE_MAGIC = ('S' << 24) | ('G' << 16) | ('H' << 8) | 'C';
+const uint32_t HASH_CACHE_VERSION = 1;
+
+struct HashCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct HashCacheRecord {
+    int64_t modTime;
+    uint64_t lengthBytes;
+    uint32_t pathOffset; // from the start of the path strings
+    uint32_t pathLength;
+    uint8_t hash[HASH_LENGTH];
+    uint8_t padding[4];
+};
+
 } // namespace
 
+// Runs jobs on a few threads; used to hash local files, so verifying a
+// large tree overlaps with the requests in flight.
+class HashWorkerPool
+{
+public:
+    explicit HashWorkerPool(unsigned numThreads)
+    {
+        for (unsigned i = 0; i < numThreads; ++i) {
+            _threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~HashWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> g(_lock);
+            _stop = true;
+            _jobs.clear();
+        }
+        _wake.notify_all();
+        for (auto& t : _threads) {
+            t.join();
+        }
+    }
+
+    void add(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> g(_lock);
+            _jobs.push_back(std::move(job));
+        }
+        _wake.notify_one();
+    }
+
+private:
+    void run()
+    {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> g(_lock);
+                _wake.wait(g, [this] { return _stop || !_jobs.empty(); });
+                if (_stop) {
+                    return;
+                }
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _jobs;
+    std::mutex _lock;
+    std::condition_variable _wake;
+    bool _stop = false;
+};
+
 class HTTPDirectory
 {
     struct ChildInfo
@@ -270,6 +367,7 @@ public:
     {
       using SAct = HTTPRepository::SyncAction;
 
+      finishHashingChildren();
       copyInstalledChildren();
 
       ChildInfoList toBeUpdated;
@@ -555,25 +653,59 @@ public:
 
     std::string hashForPath(const SGPath& p) const
     {
-        const auto ps = p.utf8Str();
-        auto it = hashes.find(ps);
-        if (it != hashes.end()) {
-            const auto& entry = it->second;
-            // ensure data on disk hasn't changed.
-            // we could also use the file type here if we were paranoid
-            if ((p.sizeInBytes() == entry.lengthBytes) && (p.modTime() == entry.modTime)) {
-                return entry.hashHex;
-            }
-
-            // entry in the cache, but it's stale so remove and fall through
-            hashes.erase(it);
+        std::string hash = cachedHashForPath(p);
+        if (!hash.empty()) {
+            return hash;
         }
 
-        std::string hash = computeHashForPath(p);
+        hash = computeHashForPath(p);
         updatedFileContents(p, hash);
         return hash;
     }
 
+    /**
+     * Start hashing the children whose cached hash is missing or stale on
+     * the repository's workers. updateChildrenBasedOnHash() picks up the
+     * results instead of hashing them one by one.
+     */
+    void startHashingChildren()
+    {
+        if (_hashBatch) {
+            return;
+        }
+
+        auto batch = std::make_shared<HashBatch>();
+        for (const auto& c : children) {
+            SGPath p = hashPathForChild(c);
+            if (cachedHashForPath(p).empty()) {
+                batch->paths.push_back(p);
+            }
+        }
+
+        if (batch->paths.empty()) {
+            return;
+        }
+
+        batch->hashes.resize(batch->paths.size());
+        batch->remaining = batch->paths.size();
+        _hashBatch = batch;
+        for (size_t i = 0; i < batch->paths.size(); ++i) {
+            _repository->hashInBackground([batch, i]() {
+                try {
+                    batch->hashes[i] = computeHashForPath(batch->paths[i]);
+                } catch (sg_exception&) {
+                    // left empty, hashed again in the foreground
+                }
+                --batch->remaining;
+            });
+        }
+    }
+
+    bool isHashingChildren() const
+    {
+        return _hashBatch && (_hashBatch->remaining > 0);
+    }
+
     bool isHashCacheDirty() const
     {
         return hashCacheDirty;
@@ -586,14 +718,43 @@ public:
 
         hashCacheDirty = false;
 
-        SGPath cachePath = absolutePath() / ".dirhash";
-        sg_ofstream stream(cachePath, std::ios::out | std::ios::trunc | std::ios::binary);
+        std::vector<HashCacheRecord> records;
+        std::string paths;
+        records.reserve(hashes.size());
         for (const auto& e : hashes) {
             const auto& entry = e.second;
-            stream << entry.filePath << "*" << entry.modTime << "*"
-                   << entry.lengthBytes << "*" << entry.hashHex << "\n";
+            const auto hashBytes = strutils::decodeHex(entry.hashHex);
+            if (hashBytes.size() != HASH_LENGTH) {
+                continue;
+            }
+
+            HashCacheRecord record;
+            memset(&record, 0, sizeof(record));
+            record.modTime = entry.modTime;
+            record.lengthBytes = entry.lengthBytes;
+            record.pathOffset = paths.size();
+            record.pathLength = entry.filePath.size();
+            memcpy(record.hash, hashBytes.data(), HASH_LENGTH);
+            records.push_back(record);
+            paths += entry.filePath;
         }
+
+        HashCacheHeader header = {HASH_CACHE_MAGIC, HASH_CACHE_VERSION,
+                                  static_cast<uint32_t>(records.size()), 0};
+
+        SGPath cachePath = absolutePath() / ".hashes";
+        sg_ofstream stream(cachePath, std::ios::out | std::ios::trunc | std::ios::binary);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(records.data()),
+                     records.size() * sizeof(HashCacheRecord));
+        stream.write(paths.data(), paths.size());
         stream.close();
+
+        // superseded by the file above
+        SGPath legacyPath = absolutePath() / ".dirhash";
+        if (legacyPath.exists()) {
+            legacyPath.remove();
+        }
     }
 
 private:
@@ -729,7 +890,7 @@ private:
         }
     }
 
-    std::string hashForChild(const ChildInfo& child) const
+    SGPath hashPathForChild(const ChildInfo& child) const
     {
       SGPath p(child.path);
       if (child.type == HTTPRepository::DirectoryType)
@@ -737,16 +898,66 @@ private:
       if (child.type == HTTPRepository::TarballType)
         p.concat(
             ".tgz"); // For tarballs the hash is against the tarball file itself
-      return hashForPath(p);
+      return p;
+    }
+
+    std::string hashForChild(const ChildInfo& child) const
+    {
+      return hashForPath(hashPathForChild(child));
+    }
+
+    // the cached hash of p, empty if there is none or p changed since
+    std::string cachedHashForPath(const SGPath& p) const
+    {
+        const auto ps = p.utf8Str();
+        auto it = hashes.find(ps);
+        if (it == hashes.end()) {
+            return {};
+        }
+
+        const auto& entry = it->second;
+        // ensure data on disk hasn't changed.
+        // we could also use the file type here if we were paranoid
+        if ((p.sizeInBytes() == entry.lengthBytes) && (p.modTime() == entry.modTime)) {
+            return entry.hashHex;
+        }
+
+        // entry in the cache, but it's stale so remove it
+        hashes.erase(it);
+        hashCacheDirty = true;
+        return {};
+    }
+
+    void finishHashingChildren()
+    {
+        if (!_hashBatch) {
+            return;
+        }
+
+        // still running: give up on it, the workers own the batch too
+        if (_hashBatch->remaining == 0) {
+            for (size_t i = 0; i < _hashBatch->paths.size(); ++i) {
+                if (!_hashBatch->hashes[i].empty()) {
+                    updatedFileContents(_hashBatch->paths[i], _hashBatch->hashes[i]);
+                }
+            }
+        }
+        _hashBatch.reset();
     }
 
     void parseHashCache()
     {
         hashes.clear();
+        if (parseBinaryHashCache()) {
+            return;
+        }
+
+        // older versions wrote a text file, read it and convert it
         SGPath cachePath = absolutePath() / ".dirhash";
         if (!cachePath.exists()) {
             return;
         }
+        hashCacheDirty = true;
 
         sg_ifstream stream(cachePath, std::ios::in);
 
@@ -781,6 +992,48 @@ private:
         }
     }
 
+    bool parseBinaryHashCache()
+    {
+        SGPath cachePath = absolutePath() / ".hashes";
+        if (!cachePath.exists()) {
+            return false;
+        }
+
+        MappedFile file;
+        if (!file.open(cachePath) || (file.size() < sizeof(HashCacheHeader))) {
+            return false;
+        }
+
+        HashCacheHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        const size_t recordsEnd = sizeof(header) + size_t(header.count) * sizeof(HashCacheRecord);
+        if ((header.magic != HASH_CACHE_MAGIC) || (header.version != HASH_CACHE_VERSION) ||
+            (recordsEnd > file.size())) {
+            SG_LOG(SG_TERRASYNC, SG_WARN, "invalid hash cache '" << cachePath << "' (ignoring)");
+            return false;
+        }
+
+        const char* pathData = file.data() + recordsEnd;
+        const size_t pathSize = file.size() - recordsEnd;
+        hashes.reserve(header.count);
+        for (uint32_t i = 0; i < header.count; ++i) {
+            HashCacheRecord record;
+            memcpy(&record, file.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+            if ((record.pathOffset > pathSize) || (record.pathLength > pathSize - record.pathOffset)) {
+                SG_LOG(SG_TERRASYNC, SG_WARN, "invalid entry in '" << cachePath << "' (ignoring)");
+                continue;
+            }
+
+            HashCacheEntry entry;
+            entry.filePath.assign(pathData + record.pathOffset, record.pathLength);
+            entry.modTime = record.modTime;
+            entry.lengthBytes = record.lengthBytes;
+            entry.hashHex = strutils::encodeHex(record.hash, HASH_LENGTH);
+            hashes.emplace(entry.filePath, std::move(entry));
+        }
+        return true;
+    }
+
     void updatedFileContents(const SGPath& p, const std::string& newHash) const
     {
         // remove the existing entry
@@ -813,6 +1066,7 @@ private:
 
     HTTPRepoPrivate* _repository;
     std::string _relativePath; // in URL and file-system space
+    HashBatchPtr _hashBatch; // children being hashed in the background
 };
 
 HTTPRepository::HTTPRepository(const SGPath& base, HTTP::Client *cl) :
@@ -1143,19 +1397,9 @@ HTTPRepository::failure() const
 
             _directory->repository()->totalDownloaded += contentSize();
 
-            try {
-              // either way we've confirmed the index is valid so update
-              // children now
-              SGTimeStamp st;
-              st.stamp();
-              _directory->updateChildrenBasedOnHash();
-              SG_LOG(SG_TERRASYNC, SG_DEBUG,
-                     "after update of:" << _directory->absolutePath()
-                                        << " child update took:"
-                                        << st.elapsedMSec());
-            } catch (sg_exception &) {
-              _directory->failedToUpdate(HTTPRepository::REPO_ERROR_IO);
-            }
+            // either way we've confirmed the index is valid so update
+            // children, once their hashes are known
+            _directory->repository()->scheduleUpdateOfChildren(_directory);
           } else if (responseCode() == 404) {
             _directory->failedToUpdate(
                 HTTPRepository::REPO_ERROR_FILE_NOT_FOUND);
@@ -1213,6 +1457,8 @@ HTTPRepository::failure() const
             http->cancelRequest(*rq, "Repository object deleted");
         }
 
+        // stop hashing before the directories go away
+        hashPool.reset();
         flushHashCaches();
         directories.clear(); // wil delete them all
     }
@@ -1369,14 +1615,42 @@ HTTPRepository::failure() const
 
     void HTTPRepoPrivate::scheduleUpdateOfChildren(HTTPDirectory* dir)
     {
+      // hashing runs on the workers while the tasks queued before this
+      // one, and the requests in flight, make progress
+      dir->startHashingChildren();
+
       auto updateChildTask = [dir](const HTTPRepoPrivate *) {
-        dir->updateChildrenBasedOnHash();
+        if (dir->isHashingChildren()) {
+          return ProcessContinue;
+        }
+
+        try {
+          SGTimeStamp st;
+          st.stamp();
+          dir->updateChildrenBasedOnHash();
+          SG_LOG(SG_TERRASYNC, SG_DEBUG,
+                 "after update of:" << dir->absolutePath()
+                                    << " child update took:"
+                                    << st.elapsedMSec());
+        } catch (sg_exception &) {
+          dir->failedToUpdate(HTTPRepository::REPO_ERROR_IO);
+          return ProcessFailed;
+        }
         return ProcessDone;
       };
 
       addTask(updateChildTask);
     }
 
+    void HTTPRepoPrivate::hashInBackground(std::function<void()> job)
+    {
+      if (!hashPool) {
+        unsigned threads = std::thread::hardware_concurrency();
+        hashPool.reset(new HashWorkerPool(std::min(std::max(threads, 2u), 8u)));
+      }
+      hashPool->add(std::move(job));
+    }
+
     void HTTPRepoPrivate::addTask(RepoProcessTask task) {
       pendingTasks.push_back(task);
     }
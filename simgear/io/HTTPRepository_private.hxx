@@ -35,6 +35,8 @@ namespace simgear {
 class HTTPDirectory;
 using HTTPDirectory_ptr = std::unique_ptr<HTTPDirectory>;
 
+class HashWorkerPool;
+
 class HTTPRepoGetRequest : public HTTP::Request {
 public:
   HTTPRepoGetRequest(HTTPDirectory *d, const std::string &u)
@@ -121,6 +123,11 @@ public:
   void addTask(RepoProcessTask task);
 
   std::deque<RepoProcessTask> pendingTasks;
+
+  /// Run job on the threads hashing local files, started on first use.
+  void hashInBackground(std::function<void()> job);
+
+  std::unique_ptr<HashWorkerPool> hashPool;
 };
 
 } // namespace simgear
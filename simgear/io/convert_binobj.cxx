@@ -0,0 +1,57 @@
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "sg_binobj.hxx"
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/structure/exception.hxx>
+
+using std::cerr;
+using std::endl;
+
+
+// Rewrites a BTG file with another compression, for sites that would
+// rather spend disk space than inflate time on scenery loading.
+int main( int argc, char **argv ) {
+    // check usage
+    if ( argc != 4 ) {
+        cerr << "Usage: " << argv[0] << " --gzip|--none|--lz4 input_btg output_btg" << endl;
+        exit(-1);
+    }
+
+    SGBinObject::Compression compression;
+    if ( !strcmp(argv[1], "--gzip") ) {
+        compression = SGBinObject::COMPRESSION_GZIP;
+    } else if ( !strcmp(argv[1], "--none") ) {
+        compression = SGBinObject::COMPRESSION_NONE;
+    } else if ( !strcmp(argv[1], "--lz4") ) {
+        compression = SGBinObject::COMPRESSION_LZ4;
+    } else {
+        cerr << "unknown compression: " << argv[1] << endl;
+        exit(-1);
+    }
+
+    sglog().setLogLevels( SG_ALL, SG_ALERT );
+
+    try {
+        bool result = SGBinObject::convert_bin( SGPath::fromLocal8Bit(argv[2]),
+                                                SGPath::fromLocal8Bit(argv[3]),
+                                                compression );
+        if ( !result ) {
+            cerr << "error writing: " << argv[3] << endl;
+            exit(-1);
+        }
+    } catch ( sg_exception& e ) {
+        cerr << "error converting " << argv[2] << ": " << e.getFormattedMessage() << endl;
+        exit(-1);
+    }
+
+    return 0;
+}
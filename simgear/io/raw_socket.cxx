@@ -58,6 +58,7 @@
 #define socklen_t int
 #endif
 
+#include <algorithm>
 #include <map>
 
 #include <simgear/debug/logstream.hxx>
@@ -643,6 +644,81 @@ int Socket::recvfrom ( void * buffer, int size,
 }
 
 
+int Socket::sendBatch ( const void* const* buffers, const int* sizes,
+                        int count, int flags )
+{
+  assert ( handle != -1 ) ;
+  int sent = 0 ;
+#if defined(__linux__)
+  enum { MAX_BATCH = 64 } ;
+  struct mmsghdr msgs [ MAX_BATCH ] ;
+  struct iovec iovs [ MAX_BATCH ] ;
+
+  while ( sent < count )
+  {
+    int n = std::min ( count - sent, (int) MAX_BATCH ) ;
+    memset ( msgs, 0, n * sizeof(msgs[0]) ) ;
+    for ( int i = 0; i < n; i++ )
+    {
+      iovs[i].iov_base = const_cast<void*>(buffers[sent + i]) ;
+      iovs[i].iov_len = sizes[sent + i] ;
+      msgs[i].msg_hdr.msg_iov = &iovs[i] ;
+      msgs[i].msg_hdr.msg_iovlen = 1 ;
+    }
+
+    int result = ::sendmmsg ( handle, msgs, n, flags | MSG_NOSIGNAL ) ;
+    if ( result < 0 )
+      break ;
+    sent += result ;
+    if ( result < n )
+      break ; // the socket buffer is full
+  }
+#else
+  for ( ; sent < count; sent++ )
+  {
+    if ( send ( buffers[sent], sizes[sent], flags ) < 0 )
+      break ;
+  }
+#endif
+  return ( sent || count <= 0 ) ? sent : -1 ;
+}
+
+
+int Socket::recvBatch ( void* const* buffers, const int* sizes, int* lengths,
+                        int count, int flags )
+{
+  assert ( handle != -1 ) ;
+  if ( count <= 0 )
+    return 0 ;
+#if defined(__linux__)
+  enum { MAX_BATCH = 64 } ;
+  struct mmsghdr msgs [ MAX_BATCH ] ;
+  struct iovec iovs [ MAX_BATCH ] ;
+
+  int n = std::min ( count, (int) MAX_BATCH ) ;
+  memset ( msgs, 0, n * sizeof(msgs[0]) ) ;
+  for ( int i = 0; i < n; i++ )
+  {
+    iovs[i].iov_base = buffers[i] ;
+    iovs[i].iov_len = sizes[i] ;
+    msgs[i].msg_hdr.msg_iov = &iovs[i] ;
+    msgs[i].msg_hdr.msg_iovlen = 1 ;
+  }
+
+  int result = ::recvmmsg ( handle, msgs, n, flags | MSG_WAITFORONE, NULL ) ;
+  for ( int i = 0; i < result; i++ )
+    lengths[i] = (int) msgs[i].msg_len ;
+  return result ;
+#else
+  int result = recv ( buffers[0], sizes[0], flags ) ;
+  if ( result < 0 )
+    return result ;
+  lengths[0] = result ;
+  return 1 ;
+#endif
+}
+
+
 void Socket::close (void)
 {
   if ( handle != -1 )
@@ -97,6 +97,21 @@ public:
   int   recv	    ( void * buffer, int size, int flags = 0 ) ;
   int   recvfrom    ( void * buffer, int size, int flags, IPAddress* from ) ;
 
+  /**
+   * Send count datagrams on a connected socket, with one system call
+   * per batch where available (sendmmsg on Linux). Returns the number of
+   * datagrams sent, or -1 if not even the first one could be sent.
+   */
+  int   sendBatch   ( const void* const* buffers, const int* sizes, int count, int flags = 0 ) ;
+
+  /**
+   * Receive up to count datagrams into buffers, storing their lengths.
+   * Waits like recv() for the first datagram only, then takes whatever
+   * else is already queued (recvmmsg on Linux; one datagram elsewhere).
+   * Returns the number of datagrams received, or -1 as recv() does.
+   */
+  int   recvBatch   ( void* const* buffers, const int* sizes, int* lengths, int count, int flags = 0 ) ;
+
   void setBlocking ( bool blocking ) ;
   void setBroadcast ( bool broadcast ) ;
 
@@ -35,19 +35,24 @@
 #include <cstdlib> // for system()
 #include <cassert>
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <bitset>
 
 #include <simgear/bucket/newbucket.hxx>
+#include <simgear/misc/sg_mmap.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/misc/strutils.hxx>
 #include <simgear/math/SGGeometry.hxx>
 #include <simgear/structure/exception.hxx>
 
+#include <simgear/io/iostreams/sgstream.hxx>
+
 #include "lowlevel.hxx"
 #include "sg_binobj.hxx"
+#include "sg_lz4.hxx"
 
 
 using std::string;
@@ -95,6 +100,17 @@ enum sgVertexAttributeTypes {
     SG_VA_FLOAT_3 =   0x00000800,
 };
 
+// The container version sets the top bit of the version field, so older
+// readers reject a container as an unknown scenery-file version.
+const unsigned int SG_BTG_CONTAINER_VERSION = 0x8001;
+const unsigned int SG_BTG_CONTAINER_MAGIC = ('S'<<24) + ('G'<<16) + SG_BTG_CONTAINER_VERSION;
+const unsigned int SG_BTG_CONTAINER_HEADER_SIZE = 16;
+const unsigned int SG_LZ4_MAX_RATIO = 255;
+
+enum sgContainerCompression {
+    SG_CONTAINER_LZ4 = 1
+};
+
 static gzFile gzFileFromSGPath(const SGPath& path, const char* mode)
 {
   #if defined(SG_WINDOWS)
@@ -113,190 +129,371 @@ enum sgPropertyTypes {
 };
 
 
-class sgSimpleBuffer {
+namespace {
 
-private:
+template <class T>
+inline T decodeLE(const char* p)
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    if ( sgIsBigEndian() ) {
+        sgEndianSwap(&v);
+    }
+    return v;
+}
 
-    char *ptr;
-    unsigned int size;
-    size_t offset;
+inline float decodeFloat(const char* p)
+{
+    uint32_t i = decodeLE<uint32_t>(p);
+    float f;
+    memcpy(&f, &i, sizeof(f));
+    return f;
+}
+
+inline double decodeDouble(const char* p)
+{
+    uint64_t i = decodeLE<uint64_t>(p);
+    double d;
+    memcpy(&d, &i, sizeof(d));
+    return d;
+}
+
+// Bounds checked reads from a file held in memory. Reading past the end
+// sets the error flag and yields zeros.
+class BinReader {
 public:
+    BinReader(const char* data, size_t size) :
+        _pos(data),
+        _end(data + size),
+        _error(false)
+    {
+    }
 
-    sgSimpleBuffer( unsigned int s = 0) :
-        ptr(NULL),
-        size(0),
-        offset(0)
+    bool error() const { return _error; }
+
+    // the next n bytes, nullptr if the data ends first
+    const char* read(size_t n)
     {
-        resize(s);
+        if ( static_cast<size_t>(_end - _pos) < n ) {
+            _error = true;
+            _pos = _end;
+            return nullptr;
+        }
+        const char* p = _pos;
+        _pos += n;
+        return p;
     }
 
-    ~sgSimpleBuffer()
+    char readChar()
     {
-        delete [] ptr;
+        const char* p = read(1);
+        return p ? *p : 0;
     }
 
-    unsigned int get_size() const { return size; }
-    char *get_ptr() const { return ptr; }
+    uint16_t readUShort() { return readLE<uint16_t>(); }
+    uint32_t readUInt() { return readLE<uint32_t>(); }
 
-    void reset()
+private:
+    template <class T>
+    T readLE()
     {
-        offset = 0;
+        const char* p = read(sizeof(T));
+        return p ? decodeLE<T>(p) : 0;
     }
 
-    void resize( unsigned int s )
-    {
-        if ( s > size ) {
-            if ( ptr != NULL ) {
-                delete [] ptr;
-            }
+    const char* _pos;
+    const char* _end;
+    bool _error;
+};
 
-            if ( size == 0) {
-                size = 16;
-            }
+// Inflate a gzip file held in memory into out. Like gzread, members
+// following the first one are inflated as well.
+bool inflate_gzip(const char* data, size_t size, std::vector<char>& out)
+{
+    // the trailer holds the uncompressed size (mod 2^32) of the last
+    // member, which for a single member file is the exact size needed.
+    // It can't be trusted though: a corrupt one must not make us allocate
+    // gigabytes up front, the buffer grows as needed anyway.
+    size_t expected = 0;
+    if ( size >= 18 ) {
+        expected = decodeLE<uint32_t>(data + size - 4);
+    }
+    expected = std::min<size_t>(expected, 64 * size);
+    out.resize((expected >= size ? expected : 4 * size) + 1);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if ( inflateInit2(&zs, 15 + 16) != Z_OK ) {
+        return false;
+    }
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = static_cast<uInt>(size);
+
+    size_t produced = 0;
+    int ret;
+    for (;;) {
+        if ( produced == out.size() ) {
+            out.resize(2 * out.size());
+        }
+        zs.next_out = reinterpret_cast<Bytef*>(out.data() + produced);
+        zs.avail_out = static_cast<uInt>(out.size() - produced);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        produced = out.size() - zs.avail_out;
 
-            while ( size < s ) {
-              size = size << 1;
+        if ( ret == Z_STREAM_END ) {
+            if ( zs.avail_in < 2 || zs.next_in[0] != 0x1f || zs.next_in[1] != 0x8b ) {
+                break;
             }
-            ptr = new char[size];
+            inflateReset(&zs);
+        } else if ( ret != Z_OK && !(ret == Z_BUF_ERROR && zs.avail_out == 0) ) {
+            break;
         }
     }
+    inflateEnd(&zs);
 
-    int32_t readInt()
-    {
-        unsigned int* p = reinterpret_cast<unsigned int*>(ptr + offset);
-        if ( sgIsBigEndian() ) {
-            sgEndianSwap((uint32_t *) p);
-        }
+    out.resize(produced);
+    return ret == Z_STREAM_END;
+}
 
-        offset += sizeof(unsigned int);
-        return *p;
+// Bring the whole file into memory: uncompressed files are mapped,
+// compressed ones unpacked into one buffer. Returns false if the file
+// can't be opened.
+bool load_file(const SGPath& path, simgear::MappedFile& mapped,
+               std::vector<char>& inflated, const char*& data, size_t& size)
+{
+    if ( !path.exists() || !mapped.open(path) ) {
+        return false;
     }
+    data = mapped.data();
+    size = mapped.size();
 
-    SGVec3d readVec3d()
-    {
-        double* p = reinterpret_cast<double*>(ptr + offset);
-
-        if ( sgIsBigEndian() ) {
-            sgEndianSwap((uint64_t *) p + 0);
-            sgEndianSwap((uint64_t *) p + 1);
-            sgEndianSwap((uint64_t *) p + 2);
+    if ( size >= 2 && static_cast<unsigned char>(data[0]) == 0x1f &&
+         static_cast<unsigned char>(data[1]) == 0x8b ) {
+        if ( !inflate_gzip(data, size, inflated) ) {
+            throw sg_io_exception("Error decompressing BTG file", sg_location(path));
+        }
+        mapped.close();
+        data = inflated.data();
+        size = inflated.size();
+    } else if ( size >= SG_BTG_CONTAINER_HEADER_SIZE &&
+                decodeLE<uint32_t>(data) == SG_BTG_CONTAINER_MAGIC ) {
+        const uint32_t compression = decodeLE<uint32_t>(data + 4);
+        const uint32_t nbytes = decodeLE<uint32_t>(data + 8);
+        const uint32_t compressed = decodeLE<uint32_t>(data + 12);
+        if ( compression != SG_CONTAINER_LZ4 ) {
+            throw sg_io_exception("Unknown BTG container compression", sg_location(path));
+        }
+        // LZ4 can't pack more than 255 bytes into one, so a larger size
+        // is corrupt, and must not be allocated
+        if ( size - SG_BTG_CONTAINER_HEADER_SIZE < compressed ||
+             nbytes > SG_LZ4_MAX_RATIO * static_cast<uint64_t>(compressed) ) {
+            throw sg_io_exception("Bad BTG container size", sg_location(path));
         }
 
-        offset += 3 * sizeof(double);
-        return SGVec3d(p);
+        inflated.resize(nbytes);
+        if ( !simgear::lz4Decompress(data + SG_BTG_CONTAINER_HEADER_SIZE, compressed,
+                                     inflated.data(), nbytes) ) {
+            throw sg_io_exception("Error decompressing BTG file", sg_location(path));
+        }
+        mapped.close();
+        data = inflated.data();
+        size = inflated.size();
     }
+    return true;
+}
 
-    float readFloat()
-    {
-        float* p = reinterpret_cast<float*>(ptr + offset);
-        if ( sgIsBigEndian() ) {
-            sgEndianSwap((uint32_t *) p);
+// Store the plain scenery-file in data at dst, compressed as asked.
+bool write_stream(const SGPath& dst, const char* data, size_t size,
+                  SGBinObject::Compression compression)
+{
+    if ( compression == SGBinObject::COMPRESSION_GZIP ) {
+        gzFile fp = gzFileFromSGPath(dst, "wb9");
+        if ( fp == nullptr ) {
+            return false;
         }
+        bool ok = size == 0 || gzwrite(fp, data, static_cast<unsigned>(size)) > 0;
+        return (gzclose(fp) == Z_OK) && ok;
+    }
 
-        offset += sizeof(float);
-        return *p;
+    sg_ofstream out(dst);
+    if ( compression == SGBinObject::COMPRESSION_LZ4 ) {
+        std::vector<char> compressed;
+        simgear::lz4Compress(data, size, compressed);
+
+        const uint32_t header[4] = {
+            SG_BTG_CONTAINER_MAGIC,
+            SG_CONTAINER_LZ4,
+            static_cast<uint32_t>(size),
+            static_cast<uint32_t>(compressed.size())
+        };
+        char bytes[SG_BTG_CONTAINER_HEADER_SIZE];
+        for ( unsigned i = 0; i < 4; ++i ) {
+            for ( unsigned b = 0; b < 4; ++b ) {
+                bytes[4 * i + b] = static_cast<char>(header[i] >> (8 * b));
+            }
+        }
+        out.write(bytes, sizeof(bytes));
+        out.write(compressed.data(), compressed.size());
+    } else {
+        out.write(data, size);
     }
+    out.close();
+    return !out.fail();
+}
 
-    SGVec2f readVec2f()
-    {
-        float* p = reinterpret_cast<float*>(ptr + offset);
+void skip_properties(BinReader& reader, uint32_t nproperties)
+{
+    for ( uint32_t j = 0; j < nproperties && !reader.error(); ++j ) {
+        reader.readChar();
+        reader.read( reader.readUInt() );
+    }
+}
 
-        if ( sgIsBigEndian() ) {
-            sgEndianSwap((uint32_t *) p + 0);
-            sgEndianSwap((uint32_t *) p + 1);
+// Decode the elements of a points, triangles, strips or fans object
+// straight into the streams of groups.
+template <class T>
+void read_elements(BinReader& reader,
+                   uint32_t nelements,
+                   unsigned char idx_mask,
+                   uint32_t va_mask,
+                   unsigned material,
+                   SGBinObjectGroups& groups)
+{
+    // the index masks map onto consecutive streams
+    const unsigned mask = idx_mask
+        | ((va_mask & 0xf) << SGBinObjectGroups::VA_0)
+        | (((va_mask >> 8) & 0xf) << (SGBinObjectGroups::VA_0 + 4));
+
+    unsigned streams[SGBinObjectGroups::NUM_STREAMS];
+    unsigned nstreams = 0;
+    for ( unsigned s = 0; s < SGBinObjectGroups::NUM_STREAMS; ++s ) {
+        if ( mask & (1u << s) ) {
+            streams[nstreams++] = s;
         }
-
-        offset += 2 * sizeof(float);
-        return SGVec2f(p);
     }
 
-    SGVec3f readVec3f()
-    {
-        float* p = reinterpret_cast<float*>(ptr + offset);
+    // the element count follows from all mask bits, unknown ones included
+    const size_t stride = sizeof(T) * (std::bitset<32>(idx_mask).count() +
+                                       std::bitset<32>(va_mask).count());
+    const size_t tuple = sizeof(T) * nstreams;
+
+    // size the streams for the whole object up front
+    BinReader scan(reader);
+    size_t total = 0;
+    for ( uint32_t j = 0; j < nelements && !scan.error(); ++j ) {
+        uint32_t nbytes = scan.readUInt();
+        scan.read( nbytes );
+        total += nbytes / stride;
+    }
+    groups.reserve(mask, total);
 
-        if ( sgIsBigEndian() ) {
-            sgEndianSwap((uint32_t *) p + 0);
-            sgEndianSwap((uint32_t *) p + 1);
-            sgEndianSwap((uint32_t *) p + 2);
+    int* indices[SGBinObjectGroups::NUM_STREAMS];
+    for ( uint32_t j = 0; j < nelements; ++j ) {
+        uint32_t nbytes = reader.readUInt();
+        if ( reader.error() ) {
+            throw sg_exception("Error reading element size");
         }
 
-        offset += 3 * sizeof(float);
-        return SGVec3f(p);
-    }
+        const char* ptr = reader.read( nbytes );
+        if ( reader.error() ) {
+            throw sg_exception("Error reading element bytes");
+        }
 
-    SGVec4f readVec4f()
-    {
-        float* p = reinterpret_cast<float*>(ptr + offset);
+        const size_t count = nbytes / stride;
+        if ( count == 0 || !(idx_mask & SG_IDX_VERTICES) ) {
+            continue;
+        }
 
-        if ( sgIsBigEndian() ) {
-            sgEndianSwap((uint32_t *) p + 0);
-            sgEndianSwap((uint32_t *) p + 1);
-            sgEndianSwap((uint32_t *) p + 2);
-            sgEndianSwap((uint32_t *) p + 3);
+        // WS2.0 fix : toss zero area triangles
+        if ( count == 3 ) {
+            int v0 = decodeLE<T>(ptr);
+            int v1 = decodeLE<T>(ptr + tuple);
+            int v2 = decodeLE<T>(ptr + 2 * tuple);
+            if ( (v0 == v1) || (v1 == v2) || (v2 == v0) ) {
+                continue;
+            }
         }
 
-        offset += 4 * sizeof(float);
-        return SGVec4f(p);
+        groups.addGroup(material, mask, count, indices);
+        for ( size_t i = 0; i < count; ++i ) {
+            for ( unsigned k = 0; k < nstreams; ++k ) {
+                indices[streams[k]][i] = decodeLE<T>(ptr);
+                ptr += sizeof(T);
+            }
+        }
     }
-};
+}
 
-template <class T>
-static void read_indices(char* buffer,
-                         size_t bytes,
-                         int indexMask,
-                         int vaMask,
-                         int_list& vertices,
-                         int_list& normals,
-                         int_list& colors,
-                         tci_list& texCoords,
-                         vai_list& vas
-                        )
+// read the properties and elements of a points, triangles, strips or
+// fans object
+void read_object( BinReader& reader,
+                  unsigned short version,
+                  int obj_type,
+                  uint32_t nproperties,
+                  uint32_t nelements,
+                  SGBinObjectGroups& groups )
 {
-    const int indexSize = sizeof(T) * std::bitset<32>((int)indexMask).count();
-    const int vaSize = sizeof(T) * std::bitset<32>((int)vaMask).count();
-    const int count = bytes / (indexSize + vaSize);
-
-    // fix endian-ness of the whole lot, if required
-    if (sgIsBigEndian()) {
-        int indices = bytes / sizeof(T);
-        T* src = reinterpret_cast<T*>(buffer);
-        for (int i=0; i<indices; ++i) {
-            sgEndianSwap(src++);
-        }
+    unsigned char idx_mask;
+    uint32_t vertex_attrib_mask = 0;
+    std::string material;
+
+    // default values
+    if ( obj_type == SG_POINTS ) {
+        idx_mask = SG_IDX_VERTICES;
+    } else {
+        idx_mask = (char)(SG_IDX_VERTICES | SG_IDX_TEXCOORDS_0);
     }
 
-    T* src = reinterpret_cast<T*>(buffer);
-    for (int i=0; i<count; ++i) {
-        if (indexMask & SG_IDX_VERTICES) vertices.push_back(*src++);
-        if (indexMask & SG_IDX_NORMALS) normals.push_back(*src++);
-        if (indexMask & SG_IDX_COLORS) colors.push_back(*src++);
-        if (indexMask & SG_IDX_TEXCOORDS_0) texCoords[0].push_back(*src++);
-        if (indexMask & SG_IDX_TEXCOORDS_1) texCoords[1].push_back(*src++);
-        if (indexMask & SG_IDX_TEXCOORDS_2) texCoords[2].push_back(*src++);
-        if (indexMask & SG_IDX_TEXCOORDS_3) texCoords[3].push_back(*src++);
-
-        if ( vaMask ) {
-            if (vaMask & SG_VA_INTEGER_0) vas[0].push_back(*src++);
-            if (vaMask & SG_VA_INTEGER_1) vas[1].push_back(*src++);
-            if (vaMask & SG_VA_INTEGER_2) vas[2].push_back(*src++);
-            if (vaMask & SG_VA_INTEGER_3) vas[3].push_back(*src++);
-            if (vaMask & SG_VA_FLOAT_0) vas[4].push_back(*src++);
-            if (vaMask & SG_VA_FLOAT_1) vas[5].push_back(*src++);
-            if (vaMask & SG_VA_FLOAT_2) vas[6].push_back(*src++);
-            if (vaMask & SG_VA_FLOAT_3) vas[7].push_back(*src++);
+    for ( uint32_t j = 0; j < nproperties; ++j ) {
+        char prop_type = reader.readChar();
+        uint32_t nbytes = reader.readUInt();
+        const char* ptr = reader.read( nbytes );
+        if ( !ptr ) {
+            break;
         }
-    } // of elements in the index
-
-    // WS2.0 fix : toss zero area triangles
-    if ( ( count == 3 ) && (indexMask & SG_IDX_VERTICES) ) {
-        if ( (vertices[0] == vertices[1]) ||
-             (vertices[1] == vertices[2]) ||
-             (vertices[2] == vertices[0]) ) {
-            vertices.clear();
+
+        switch( prop_type )
+        {
+            case SG_MATERIAL:
+                material.assign( ptr, strnlen( ptr, std::min<uint32_t>( nbytes, 255 ) ) );
+                break;
+
+            case SG_INDEX_TYPES:
+                if (nbytes == 1) {
+                    idx_mask = ptr[0];
+                }
+                break;
+
+            case SG_VERT_ATTRIBS:
+                if (nbytes == 4) {
+                    vertex_attrib_mask = decodeLE<uint32_t>( ptr );
+                }
+                break;
+
+            default:
+                SG_LOG(SG_IO, SG_ALERT, "Found UNKNOWN property type with nbytes == " << nbytes << " mask is " << (int)idx_mask );
+                break;
         }
     }
+
+    if ( reader.error() ) {
+        throw sg_exception("Error reading object properties");
+    }
+
+    if ( idx_mask == 0 ) {
+        throw sg_exception("object index mask has no bits set");
+    }
+
+    unsigned materialIndex = groups.addMaterial( material );
+    if ( version >= 10 ) {
+        read_elements<uint32_t>( reader, nelements, idx_mask, vertex_attrib_mask, materialIndex, groups );
+    } else {
+        read_elements<uint16_t>( reader, nelements, idx_mask, vertex_attrib_mask, materialIndex, groups );
+    }
 }
 
+} // of anonymous namespace
+
 template <class T>
 void write_indice(gzFile fp, T value)
 {
@@ -385,130 +582,49 @@ void write_indices(gzFile fp,
 }
 
 
-// read object properties
-void SGBinObject::read_object( gzFile fp,
-                         int obj_type,
-                         int nproperties,
-                         int nelements,
-                         group_list& vertices,
-                         group_list& normals,
-                         group_list& colors,
-                         group_tci_list& texCoords,
-                         group_vai_list& vertexAttribs,
-                         string_list& materials)
+void SGBinObject::build_lists( Primitive p ) const
 {
-    unsigned int  nbytes;
-    unsigned char idx_mask;
-    unsigned int  vertex_attrib_mask;
-    int j;
-    sgSimpleBuffer buf( 32768 );  // 32 Kb
-    char material[256];
-
-    // default values
-    if ( obj_type == SG_POINTS ) {
-        idx_mask = SG_IDX_VERTICES;
-    } else {
-        idx_mask = (char)(SG_IDX_VERTICES | SG_IDX_TEXCOORDS_0);
-    }
-    vertex_attrib_mask = 0;
-
-    for ( j = 0; j < nproperties; ++j ) {
-        char prop_type;
-        sgReadChar( fp, &prop_type );
-        sgReadUInt( fp, &nbytes );
-
-        buf.resize(nbytes);
-        char *ptr = buf.get_ptr();
-
-        switch( prop_type )
-        {
-            case SG_MATERIAL:
-                sgReadBytes( fp, nbytes, ptr );
-                if (nbytes > 255) {
-                    nbytes = 255;
-                }
-                strncpy( material, ptr, nbytes );
-                material[nbytes] = '\0';
-                break;
-
-            case SG_INDEX_TYPES:
-                if (nbytes == 1) {
-                    sgReadChar( fp, (char *)&idx_mask );
-                } else {
-                    sgReadBytes( fp, nbytes, ptr );
-                }
-                break;
-
-            case SG_VERT_ATTRIBS:
-                if (nbytes == 4) {
-                    sgReadUInt( fp, &vertex_attrib_mask );
-                } else {
-                    sgReadBytes( fp, nbytes, ptr );
-                }
-                break;
-
-            default:
-                sgReadBytes( fp, nbytes, ptr );
-                SG_LOG(SG_IO, SG_ALERT, "Found UNKNOWN property type with nbytes == " << nbytes << " mask is " << (int)idx_mask );
-                break;
-        }
-    }
-
-    if ( sgReadError() ) {
-        throw sg_exception("Error reading object properties");
+    switch ( p ) {
+    case PRIM_POINTS:
+        pts_groups.toLists( pts_v, pts_n, pts_c, pts_tcs, pts_vas, pt_materials );
+        break;
+    case PRIM_TRIANGLES:
+        tris_groups.toLists( tris_v, tris_n, tris_c, tris_tcs, tris_vas, tri_materials );
+        break;
+    case PRIM_STRIPS:
+        strips_groups.toLists( strips_v, strips_n, strips_c, strips_tcs, strips_vas, strip_materials );
+        break;
+    case PRIM_FANS:
+        fans_groups.toLists( fans_v, fans_n, fans_c, fans_tcs, fans_vas, fan_materials );
+        break;
     }
+    lists_pending &= ~(1u << p);
+}
 
-    size_t indexCount = std::bitset<32>((int)idx_mask).count();
-    if (indexCount == 0) {
-        throw sg_exception("object index mask has no bits set");
+void SGBinObject::build_groups( Primitive p ) const
+{
+    switch ( p ) {
+    case PRIM_POINTS:
+        pts_groups.fromLists( pts_v, pts_n, pts_c, pts_tcs, pts_vas, pt_materials );
+        break;
+    case PRIM_TRIANGLES:
+        tris_groups.fromLists( tris_v, tris_n, tris_c, tris_tcs, tris_vas, tri_materials );
+        break;
+    case PRIM_STRIPS:
+        strips_groups.fromLists( strips_v, strips_n, strips_c, strips_tcs, strips_vas, strip_materials );
+        break;
+    case PRIM_FANS:
+        fans_groups.fromLists( fans_v, fans_n, fans_c, fans_tcs, fans_vas, fan_materials );
+        break;
     }
-
-    for ( j = 0; j < nelements; ++j ) {
-        sgReadUInt( fp, &nbytes );
-        if ( sgReadError() ) {
-            throw sg_exception("Error reading element size");
-        }
-
-        buf.resize( nbytes );
-        char *ptr = buf.get_ptr();
-        sgReadBytes( fp, nbytes, ptr );
-
-        if ( sgReadError() ) {
-            throw sg_exception("Error reading element bytes");
-        }
-
-        int_list vs;
-        int_list ns;
-        int_list cs;
-        tci_list tcs;
-        vai_list vas;
-
-        if (version >= 10) {
-            read_indices<uint32_t>(ptr, nbytes, idx_mask, vertex_attrib_mask, vs, ns, cs, tcs, vas );
-        } else {
-            read_indices<uint16_t>(ptr, nbytes, idx_mask, vertex_attrib_mask, vs, ns, cs, tcs, vas );
-        }
-
-        // Fix for WS2.0 - ignore zero area triangles
-        if ( !vs.empty() ) {
-            vertices.push_back( vs );
-            normals.push_back( ns );
-            colors.push_back( cs );
-            texCoords.push_back( tcs );
-            vertexAttribs.push_back( vas );
-            materials.push_back( material );
-        }
-    } // of element iteration
+    groups_pending &= ~(1u << p);
 }
 
 
 // read a binary file and populate the provided structures.
 bool SGBinObject::read_bin( const SGPath& file ) {
-    SGVec3d p;
     int i, k;
-    size_t j;
-    unsigned int nbytes;
-    sgSimpleBuffer buf( 32768 );  // 32 Kb
+    uint32_t j;
 
     // zero out structures
     gbs_center = SGVec3d(0, 0, 0);
@@ -546,12 +662,24 @@ bool SGBinObject::read_bin( const SGPath& file ) {
     fans_vas.clear();
     fan_materials.clear();
 
-    gzFile fp = gzFileFromSGPath(file, "rb");
-    if ( fp == NULL ) {
+    pts_groups.clear();
+    tris_groups.clear();
+    strips_groups.clear();
+    fans_groups.clear();
+
+    // the lists are built from the groups when first asked for
+    lists_pending = (1u << PRIM_POINTS) | (1u << PRIM_TRIANGLES) |
+                    (1u << PRIM_STRIPS) | (1u << PRIM_FANS);
+    groups_pending = 0;
+
+    simgear::MappedFile mapped;
+    std::vector<char> inflated;
+    const char* data = nullptr;
+    size_t size = 0;
+    if ( !load_file(file, mapped, inflated, data, size) ) {
         SGPath withGZ = file;
         withGZ.concat(".gz");
-        fp = gzFileFromSGPath(withGZ, "rb");
-        if (fp == nullptr) {
+        if ( !load_file(withGZ, mapped, inflated, data, size) ) {
             SG_LOG( SG_EVENT, SG_ALERT,
                "ERROR: opening " << file << " or " << withGZ << " for reading!");
 
@@ -559,15 +687,13 @@ bool SGBinObject::read_bin( const SGPath& file ) {
         }
     }
 
-    sgClearReadError();
+    BinReader reader(data, size);
 
     // read headers
-    unsigned int header;
-    sgReadUInt( fp, &header );
+    unsigned int header = reader.readUInt();
 
-    if (sgReadError()) {
-        gzclose(fp);
-        throw sg_io_exception("Unable to read BTG header: " + simgear::strutils::error_string(errno), sg_location(file));
+    if ( reader.error() ) {
+        throw sg_io_exception("Unable to read BTG header", sg_location(file));
     }
 
     if ( ((header & 0xFF000000) >> 24) == 'S' &&
@@ -576,240 +702,169 @@ bool SGBinObject::read_bin( const SGPath& file ) {
         // read file version
         version = (header & 0x0000FFFF);
     } else {
-        // close the file before we return
-        gzclose(fp);
         throw sg_io_exception("Bad BTG magic/version", sg_location(file));
     }
 
-    // read creation time
-    unsigned int foo_calendar_time;
-    sgReadUInt( fp, &foo_calendar_time );
-
-#if 0
-    time_t calendar_time = foo_calendar_time;
-    // The following code has a global effect on the host application
-    // and can screws up the time elsewhere.  It should be avoided
-    // unless you need this for debugging in which case you should
-    // disable it again once the debugging task is finished.
-    struct tm *local_tm;
-    local_tm = localtime( &calendar_time );
-    char time_str[256];
-    strftime( time_str, 256, "%a %b %d %H:%M:%S %Z %Y", local_tm);
-    SG_LOG( SG_EVENT, SG_DEBUG, "File created on " << time_str);
-#endif
+    // skip creation time
+    reader.readUInt();
 
     // read number of top level objects
     int nobjects;
     if ( version >= 10) { // version 10 extends everything to be 32-bit
-        sgReadInt( fp, &nobjects );
+        nobjects = static_cast<int32_t>( reader.readUInt() );
     } else if ( version >= 7 ) {
-        uint16_t v;
-        sgReadUShort( fp, &v );
-        nobjects = v;
+        nobjects = reader.readUShort();
     } else {
-        int16_t v;
-        sgReadShort( fp, &v );
-        nobjects = v;
+        nobjects = static_cast<int16_t>( reader.readUShort() );
     }
 
     SG_LOG(SG_IO, SG_DEBUG, "SGBinObject::read_bin Total objects to read = " << nobjects);
 
-    if ( sgReadError() ) {
+    if ( reader.error() ) {
         throw sg_io_exception("Error reading BTG file header", sg_location(file));
     }
 
     // read in objects
     for ( i = 0; i < nobjects; ++i ) {
         // read object header
-        char obj_type;
+        char obj_type = reader.readChar();
         uint32_t nproperties, nelements;
-        sgReadChar( fp, &obj_type );
         if ( version >= 10 ) {
-            sgReadUInt( fp, &nproperties );
-            sgReadUInt( fp, &nelements );
+            nproperties = reader.readUInt();
+            nelements = reader.readUInt();
         } else if ( version >= 7 ) {
-            uint16_t v;
-            sgReadUShort( fp, &v );
-            nproperties = v;
-            sgReadUShort( fp, &v );
-            nelements = v;
+            nproperties = reader.readUShort();
+            nelements = reader.readUShort();
         } else {
-            int16_t v;
-            sgReadShort( fp, &v );
-            nproperties = v;
-            sgReadShort( fp, &v );
-            nelements = v;
+            nproperties = static_cast<int16_t>( reader.readUShort() );
+            nelements = static_cast<int16_t>( reader.readUShort() );
         }
 
         SG_LOG(SG_IO, SG_DEBUG, "SGBinObject::read_bin object " << i <<
                 " = " << (int)obj_type << " props = " << nproperties <<
                 " elements = " << nelements);
 
-        if ( obj_type == SG_BOUNDING_SPHERE ) {
-            // read bounding sphere properties
-            read_properties( fp, nproperties );
-
-            // read bounding sphere elements
-            for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                buf.resize( nbytes );
-                buf.reset();
-                char *ptr = buf.get_ptr();
-                sgReadBytes( fp, nbytes, ptr );
-                gbs_center = buf.readVec3d();
-                gbs_radius = buf.readFloat();
-            }
-        } else if ( obj_type == SG_VERTEX_LIST ) {
-            // read vertex list properties
-            read_properties( fp, nproperties );
-
-            // read vertex list elements
-            for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                buf.resize( nbytes );
-                buf.reset();
-                char *ptr = buf.get_ptr();
-                sgReadBytes( fp, nbytes, ptr );
-                int count = nbytes / (sizeof(float) * 3);
-                wgs84_nodes.reserve( count );
-                for ( k = 0; k < count; ++k ) {
-                    SGVec3f v = buf.readVec3f();
-                    // extend from float to double, hmmm
-                    wgs84_nodes.push_back( SGVec3d(v[0], v[1], v[2]) );
-                }
-            }
-        } else if ( obj_type == SG_COLOR_LIST ) {
-            // read color list properties
-            read_properties( fp, nproperties );
-
-            // read color list elements
-            for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                buf.resize( nbytes );
-                buf.reset();
-                char *ptr = buf.get_ptr();
-                sgReadBytes( fp, nbytes, ptr );
-                int count = nbytes / (sizeof(float) * 4);
-                colors.reserve(count);
-                for ( k = 0; k < count; ++k ) {
-                    colors.push_back( buf.readVec4f() );
-                }
-            }
-        } else if ( obj_type == SG_NORMAL_LIST ) {
-            // read normal list properties
-            read_properties( fp, nproperties );
-
-            // read normal list elements
-            for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                buf.resize( nbytes );
-                buf.reset();
-                unsigned char *ptr = (unsigned char *)(buf.get_ptr());
-                sgReadBytes( fp, nbytes, ptr );
-                int count = nbytes / 3;
-                normals.reserve( count );
-
-                for ( k = 0; k < count; ++k ) {
-                    SGVec3f normal( (ptr[0]) / 127.5 - 1.0,
-                                    (ptr[1]) / 127.5 - 1.0,
-                                    (ptr[2]) / 127.5 - 1.0);
-                    normals.push_back(normalize(normal));
-                    ptr += 3;
-                }
-            }
-        } else if ( obj_type == SG_TEXCOORD_LIST ) {
-            // read texcoord list properties
-            read_properties( fp, nproperties );
-
-            // read texcoord list elements
-            for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                buf.resize( nbytes );
-                buf.reset();
-                char *ptr = buf.get_ptr();
-                sgReadBytes( fp, nbytes, ptr );
-                int count = nbytes / (sizeof(float) * 2);
-                texcoords.reserve(count);
-                for ( k = 0; k < count; ++k ) {
-                    texcoords.push_back( buf.readVec2f() );
-                }
-            }
-        } else if ( obj_type == SG_VA_FLOAT_LIST ) {
-            // read vertex attribute (float) properties
-            read_properties( fp, nproperties );
-
-            // read vertex attribute list elements
-            for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                buf.resize( nbytes );
-                buf.reset();
-                char *ptr = buf.get_ptr();
-                sgReadBytes( fp, nbytes, ptr );
-                int count = nbytes / (sizeof(float));
-                va_flt.reserve(count);
-                for ( k = 0; k < count; ++k ) {
-                    va_flt.push_back( buf.readFloat() );
-                }
-            }
-        } else if ( obj_type == SG_VA_INTEGER_LIST ) {
-            // read vertex attribute (integer) properties
-            read_properties( fp, nproperties );
-
-            // read vertex attribute list elements
-            for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                buf.resize( nbytes );
-                buf.reset();
-                char *ptr = buf.get_ptr();
-                sgReadBytes( fp, nbytes, ptr );
-                int count = nbytes / (sizeof(unsigned int));
-                va_int.reserve(count);
-                for ( k = 0; k < count; ++k ) {
-                    va_int.push_back( buf.readInt() );
-                }
-            }
-        } else if ( obj_type == SG_POINTS ) {
+        if ( obj_type == SG_POINTS ) {
             // read point elements
-            read_object( fp, SG_POINTS, nproperties, nelements,
-                         pts_v, pts_n, pts_c, pts_tcs,
-                         pts_vas, pt_materials );
+            read_object( reader, version, SG_POINTS, nproperties, nelements, pts_groups );
         } else if ( obj_type == SG_TRIANGLE_FACES ) {
             // read triangle face properties
-            read_object( fp, SG_TRIANGLE_FACES, nproperties, nelements,
-                         tris_v, tris_n, tris_c, tris_tcs,
-                         tris_vas, tri_materials );
+            read_object( reader, version, SG_TRIANGLE_FACES, nproperties, nelements, tris_groups );
         } else if ( obj_type == SG_TRIANGLE_STRIPS ) {
             // read triangle strip properties
-            read_object( fp, SG_TRIANGLE_STRIPS, nproperties, nelements,
-                         strips_v, strips_n, strips_c, strips_tcs,
-                         strips_vas, strip_materials );
+            read_object( reader, version, SG_TRIANGLE_STRIPS, nproperties, nelements, strips_groups );
         } else if ( obj_type == SG_TRIANGLE_FANS ) {
             // read triangle fan properties
-            read_object( fp, SG_TRIANGLE_FANS, nproperties, nelements,
-                         fans_v, fans_n, fans_c, fans_tcs,
-                         fans_vas, fan_materials );
+            read_object( reader, version, SG_TRIANGLE_FANS, nproperties, nelements, fans_groups );
         } else {
-            // unknown object type, just skip
-            read_properties( fp, nproperties );
+            // lists have no properties we use, unknown objects are skipped
+            skip_properties( reader, nproperties );
 
-            // read elements
             for ( j = 0; j < nelements; ++j ) {
-                sgReadUInt( fp, &nbytes );
-                // cout << "element size = " << nbytes << endl;
-                if ( nbytes > buf.get_size() ) { buf.resize( nbytes ); }
-                char *ptr = buf.get_ptr();
-                sgReadBytes( fp, nbytes, ptr );
+                uint32_t nbytes = reader.readUInt();
+                const char* ptr = reader.read( nbytes );
+                if ( !ptr ) {
+                    break;
+                }
+
+                if ( obj_type == SG_BOUNDING_SPHERE ) {
+                    if ( nbytes >= 3 * sizeof(double) + sizeof(float) ) {
+                        gbs_center = SGVec3d( decodeDouble(ptr),
+                                              decodeDouble(ptr + 8),
+                                              decodeDouble(ptr + 16) );
+                        gbs_radius = decodeFloat(ptr + 24);
+                    }
+                } else if ( obj_type == SG_VERTEX_LIST ) {
+                    int count = nbytes / (sizeof(float) * 3);
+                    wgs84_nodes.reserve( wgs84_nodes.size() + count );
+                    for ( k = 0; k < count; ++k, ptr += 12 ) {
+                        // extend from float to double, hmmm
+                        wgs84_nodes.push_back( SGVec3d( decodeFloat(ptr),
+                                                        decodeFloat(ptr + 4),
+                                                        decodeFloat(ptr + 8) ) );
+                    }
+                } else if ( obj_type == SG_COLOR_LIST ) {
+                    int count = nbytes / (sizeof(float) * 4);
+                    colors.reserve( colors.size() + count );
+                    for ( k = 0; k < count; ++k, ptr += 16 ) {
+                        colors.push_back( SGVec4f( decodeFloat(ptr),
+                                                   decodeFloat(ptr + 4),
+                                                   decodeFloat(ptr + 8),
+                                                   decodeFloat(ptr + 12) ) );
+                    }
+                } else if ( obj_type == SG_NORMAL_LIST ) {
+                    const unsigned char* uptr = reinterpret_cast<const unsigned char*>(ptr);
+                    int count = nbytes / 3;
+                    normals.reserve( normals.size() + count );
+                    for ( k = 0; k < count; ++k, uptr += 3 ) {
+                        SGVec3f normal( (uptr[0]) / 127.5 - 1.0,
+                                        (uptr[1]) / 127.5 - 1.0,
+                                        (uptr[2]) / 127.5 - 1.0);
+                        normals.push_back(normalize(normal));
+                    }
+                } else if ( obj_type == SG_TEXCOORD_LIST ) {
+                    int count = nbytes / (sizeof(float) * 2);
+                    texcoords.reserve( texcoords.size() + count );
+                    for ( k = 0; k < count; ++k, ptr += 8 ) {
+                        texcoords.push_back( SGVec2f( decodeFloat(ptr),
+                                                      decodeFloat(ptr + 4) ) );
+                    }
+                } else if ( obj_type == SG_VA_FLOAT_LIST ) {
+                    int count = nbytes / (sizeof(float));
+                    va_flt.reserve( va_flt.size() + count );
+                    for ( k = 0; k < count; ++k, ptr += 4 ) {
+                        va_flt.push_back( decodeFloat(ptr) );
+                    }
+                } else if ( obj_type == SG_VA_INTEGER_LIST ) {
+                    int count = nbytes / (sizeof(unsigned int));
+                    va_int.reserve( va_int.size() + count );
+                    for ( k = 0; k < count; ++k, ptr += 4 ) {
+                        va_int.push_back( static_cast<int32_t>( decodeLE<uint32_t>(ptr) ) );
+                    }
+                }
             }
         }
 
-        if ( sgReadError() ) {
+        if ( reader.error() ) {
             throw sg_io_exception("Error while reading object", sg_location(file, i));
         }
     }
 
-    // close the file
-    gzclose(fp);
+    return true;
+}
+
+bool SGBinObject::convert_bin( const SGPath& src, const SGPath& dst,
+                               Compression compression )
+{
+    simgear::MappedFile mapped;
+    std::vector<char> inflated;
+    const char* data = nullptr;
+    size_t size = 0;
+    if ( !load_file(src, mapped, inflated, data, size) ) {
+        throw sg_io_exception("Error opening for reading", sg_location(src));
+    }
 
+    BinReader reader(data, size);
+    unsigned int header = reader.readUInt();
+    if ( reader.error() || ((header & 0xFF000000) >> 24) != 'S' ||
+         ((header & 0x00FF0000) >> 16) != 'G' ) {
+        throw sg_io_exception("Bad BTG magic/version", sg_location(src));
+    }
+
+    SGPath dir(dst);
+    dir.create_dir( 0755 );
+
+    // data may still be mapped from src, which could be dst: write next
+    // to it and replace it when done, rather than truncate it under us
+    SGPath target(dst);
+    target.concat(".tmp");
+    bool ok = write_stream(target, data, size, compression);
+    mapped.close();
+    if ( !ok || !target.rename(dst) ) {
+        target.remove();
+        SG_LOG(SG_IO, SG_ALERT, "Error while writing file " << dst);
+        return false;
+    }
     return true;
 }
 
@@ -969,16 +1024,27 @@ static unsigned int max_object_size( const string_list& materials )
 
 const unsigned int VERSION_7_MATERIAL_LIMIT = 0x7fff;
 
-bool SGBinObject::write_bin_file(const SGPath& file)
+bool SGBinObject::write_bin_file(const SGPath& file, Compression compression)
 {
     int i;
 
+    for ( unsigned p = PRIM_POINTS; p <= PRIM_FANS; ++p ) {
+        sync_lists( Primitive(p) );
+    }
+
     SGPath file2(file);
     file2.create_dir( 0755 );
 
-    gzFile fp = gzFileFromSGPath(file, "wb9");
+    // the LZ4 container is packed from a plain file written first
+    SGPath target(file);
+    if ( compression == COMPRESSION_LZ4 ) {
+        target.concat(".tmp");
+    }
+
+    // "T" has zlib write the stream as is
+    gzFile fp = gzFileFromSGPath(target, compression == COMPRESSION_GZIP ? "wb9" : "wbT");
     if ( fp == nullptr ) {
-        cout << "ERROR: opening " << file << " for writing!" << endl;
+        cout << "ERROR: opening " << target << " for writing!" << endl;
         return false;
     }
 
@@ -1084,10 +1150,22 @@ bool SGBinObject::write_bin_file(const SGPath& file)
     gzclose(fp);
 
     if ( sgWriteError() ) {
-        cout << "Error while writing file " << file << endl;
+        cout << "Error while writing file " << target << endl;
         return false;
     }
 
+    if ( compression == COMPRESSION_LZ4 ) {
+        simgear::MappedFile mapped;
+        bool ok = mapped.open(target) &&
+                  write_stream(file, mapped.data(), mapped.size(), compression);
+        mapped.close();
+        target.remove();
+        if ( !ok ) {
+            cout << "Error while writing file " << file << endl;
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -1100,6 +1178,10 @@ bool SGBinObject::write_ascii( const string& base, const string& name,
 {
     int i, j;
 
+    for ( unsigned p = PRIM_POINTS; p <= PRIM_FANS; ++p ) {
+        sync_lists( Primitive(p) );
+    }
+
     SGPath file = base + "/" + b.gen_base_path() + "/" + name;
     file.create_dir( 0755 );
     cout << "Output file = " << file << endl;
@@ -1271,37 +1353,25 @@ bool SGBinObject::write_ascii( const string& base, const string& name,
     return (err == 0);
 }
 
-void SGBinObject::read_properties(gzFile fp, int nproperties)
-{
-    sgSimpleBuffer buf;
-    uint32_t nbytes;
-
-    // read properties
-    for ( int j = 0; j < nproperties; ++j ) {
-        char prop_type;
-        sgReadChar( fp, &prop_type );
-        sgReadUInt( fp, &nbytes );
-        // cout << "property size = " << nbytes << endl;
-        if ( nbytes > buf.get_size() ) { buf.resize( nbytes ); }
-        char *ptr = buf.get_ptr();
-        sgReadBytes( fp, nbytes, ptr );
-    }
-}
-
 bool SGBinObject::add_point( const SGBinObjectPoint& pt )
 {
+    sync_lists( PRIM_POINTS );
+
     // add the point info
     pt_materials.push_back( pt.material );
 
     pts_v.push_back( pt.v_list );
     pts_n.push_back( pt.n_list );
     pts_c.push_back( pt.c_list );
+    groups_pending |= 1u << PRIM_POINTS;
 
     return true;
 }
 
 bool SGBinObject::add_triangle( const SGBinObjectTriangle& tri )
 {
+    sync_lists( PRIM_TRIANGLES );
+
     // add the triangle info and keep lists aligned
     tri_materials.push_back( tri.material );
     tris_v.push_back( tri.v_list );
@@ -1309,6 +1379,121 @@ bool SGBinObject::add_triangle( const SGBinObjectTriangle& tri )
     tris_c.push_back( tri.c_list );
     tris_tcs.push_back( tri.tc_list );
     tris_vas.push_back( tri.va_list );
+    groups_pending |= 1u << PRIM_TRIANGLES;
 
     return true;
 }
+
+void SGBinObjectGroups::clear()
+{
+    _groups.clear();
+    _materials.clear();
+    for ( std::vector<int>& stream : _streams ) {
+        stream.clear();
+    }
+}
+
+unsigned SGBinObjectGroups::addMaterial( const std::string& material )
+{
+    for ( unsigned i = _materials.size(); i > 0; --i ) {
+        if ( _materials[i - 1] == material ) {
+            return i - 1;
+        }
+    }
+    _materials.push_back( material );
+    return _materials.size() - 1;
+}
+
+void SGBinObjectGroups::reserve( unsigned mask, size_t count )
+{
+    for ( unsigned s = 0; s < NUM_STREAMS; ++s ) {
+        if ( mask & (1u << s) ) {
+            _streams[s].reserve( _streams[s].size() + count );
+        }
+    }
+}
+
+void SGBinObjectGroups::addGroup( unsigned material, unsigned mask, size_t count,
+                                  int* indices[NUM_STREAMS] )
+{
+    Group group;
+    group._count = count;
+    group._mask = mask;
+    group._material = material;
+    for ( unsigned s = 0; s < NUM_STREAMS; ++s ) {
+        group._offset[s] = _streams[s].size();
+        if ( mask & (1u << s) ) {
+            _streams[s].resize( group._offset[s] + count );
+            indices[s] = _streams[s].data() + group._offset[s];
+        }
+    }
+    _groups.push_back( group );
+}
+
+void SGBinObjectGroups::toLists( group_list& vertices, group_list& normals,
+                                 group_list& colors, group_tci_list& texCoords,
+                                 group_vai_list& vertexAttribs,
+                                 string_list& materials ) const
+{
+    const size_t count = _groups.size();
+    vertices.assign( count, int_list() );
+    normals.assign( count, int_list() );
+    colors.assign( count, int_list() );
+    texCoords.assign( count, tci_list() );
+    vertexAttribs.assign( count, vai_list() );
+    materials.resize( count );
+
+    for ( size_t g = 0; g < count; ++g ) {
+        int_list* lists[NUM_STREAMS] = { &vertices[g], &normals[g], &colors[g] };
+        for ( unsigned t = 0; t < MAX_TC_SETS; ++t ) {
+            lists[TEXCOORDS_0 + t] = &texCoords[g][t];
+        }
+        for ( unsigned v = 0; v < MAX_VAS; ++v ) {
+            lists[VA_0 + v] = &vertexAttribs[g][v];
+        }
+
+        for ( unsigned s = 0; s < NUM_STREAMS; ++s ) {
+            if ( const int* indices = getIndices( g, s ) ) {
+                lists[s]->assign( indices, indices + _groups[g]._count );
+            }
+        }
+        materials[g] = getMaterial( g );
+    }
+}
+
+void SGBinObjectGroups::fromLists( const group_list& vertices, const group_list& normals,
+                                   const group_list& colors, const group_tci_list& texCoords,
+                                   const group_vai_list& vertexAttribs,
+                                   const string_list& materials )
+{
+    clear();
+
+    int* indices[NUM_STREAMS];
+    for ( size_t g = 0; g < vertices.size(); ++g ) {
+        const int_list* lists[NUM_STREAMS] = { &vertices[g] };
+        lists[NORMALS] = g < normals.size() ? &normals[g] : nullptr;
+        lists[COLORS] = g < colors.size() ? &colors[g] : nullptr;
+        for ( unsigned t = 0; t < MAX_TC_SETS; ++t ) {
+            lists[TEXCOORDS_0 + t] = g < texCoords.size() ? &texCoords[g][t] : nullptr;
+        }
+        for ( unsigned v = 0; v < MAX_VAS; ++v ) {
+            lists[VA_0 + v] = g < vertexAttribs.size() ? &vertexAttribs[g][v] : nullptr;
+        }
+
+        const size_t count = vertices[g].size();
+        unsigned mask = 0;
+        for ( unsigned s = 0; s < NUM_STREAMS; ++s ) {
+            if ( count && lists[s] && lists[s]->size() == count ) {
+                mask |= 1u << s;
+            }
+        }
+
+        addGroup( addMaterial( g < materials.size() ? materials[g] : std::string() ),
+                  mask, count, indices );
+        for ( unsigned s = 0; s < NUM_STREAMS; ++s ) {
+            if ( mask & (1u << s) ) {
+                std::copy( lists[s]->begin(), lists[s]->end(), indices[s] );
+            }
+        }
+    }
+}
@@ -35,6 +35,7 @@
 #include <simgear/math/SGMath.hxx>
 
 #include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -64,6 +65,84 @@ typedef group_vai_list::const_iterator const_group_vai_list_iterator;
 class SGBucket;
 class SGPath;
 
+/**
+ * The index groups of one primitive type (points, triangles, strips or
+ * fans) in contiguous storage. Each index stream - vertices, normals,
+ * colors, the texture coordinate sets and the vertex attributes - is one
+ * array for all groups, and a group records where its indices start in
+ * every stream it has. All streams of a group have the same length.
+ */
+class SGBinObjectGroups {
+public:
+    enum Stream {
+        VERTICES = 0,
+        NORMALS,
+        COLORS,
+        TEXCOORDS_0,
+        VA_0 = TEXCOORDS_0 + MAX_TC_SETS,
+        NUM_STREAMS = VA_0 + MAX_VAS
+    };
+
+    size_t size() const { return _groups.size(); }
+    bool empty() const { return _groups.empty(); }
+
+    const std::string& getMaterial( size_t group ) const
+    { return _materials[_groups[group]._material]; }
+    /// Number of indices in each stream of the group.
+    size_t getCount( size_t group ) const { return _groups[group]._count; }
+    bool has( size_t group, unsigned stream ) const
+    { return (_groups[group]._mask >> stream) & 1; }
+    /// The indices of the group in stream, nullptr if it has none.
+    const int* getIndices( size_t group, unsigned stream ) const
+    {
+        if (!has(group, stream))
+            return nullptr;
+        return _streams[stream].data() + _groups[group]._offset[stream];
+    }
+    const std::vector<int>& getStream( unsigned stream ) const
+    { return _streams[stream]; }
+
+    void clear();
+
+    /// Index of material in the material table, added if new.
+    unsigned addMaterial( const std::string& material );
+    /// Make room for count more indices in each stream of mask.
+    void reserve( unsigned mask, size_t count );
+    /**
+     * Append a group with count indices in each stream of mask. The
+     * indices are left for the caller to fill through indices[stream],
+     * which stay valid until the next group is added.
+     */
+    void addGroup( unsigned material, unsigned mask, size_t count,
+                   int* indices[NUM_STREAMS] );
+
+    /// Expand into one list per group, the layout of the SGBinObject getters.
+    void toLists( group_list& vertices, group_list& normals,
+                  group_list& colors, group_tci_list& texCoords,
+                  group_vai_list& vertexAttribs,
+                  string_list& materials ) const;
+    /**
+     * Rebuild from per group lists. A list not as long as the vertex list
+     * of its group can't be represented and is left out.
+     */
+    void fromLists( const group_list& vertices, const group_list& normals,
+                    const group_list& colors, const group_tci_list& texCoords,
+                    const group_vai_list& vertexAttribs,
+                    const string_list& materials );
+
+private:
+    struct Group {
+        uint32_t _offset[NUM_STREAMS];
+        uint32_t _count;
+        uint32_t _mask;
+        uint32_t _material;
+    };
+
+    std::vector<Group> _groups;
+    string_list _materials;
+    std::array<std::vector<int>, NUM_STREAMS> _streams;
+};
+
 class SGBinObjectPoint {
 public:
     std::string material;
@@ -138,6 +217,15 @@ public:
  *	              growth)
  *
  * - vertex: FLOAT, FLOAT, FLOAT
+ *
+ * The scenery-file is normally gzip compressed. It may also be stored
+ * as is, or LZ4 compressed in a container:
+ *
+ * - container: magic, compression, nbytes, nbytes_compressed, BYTE+
+ *
+ * - magic: "SG" + SG_BTG_CONTAINER_VERSION (never a scenery-file version)
+ *
+ * - compression: UINT (1 = one LZ4 block)
 */
 class SGBinObject {
 private:
@@ -154,46 +242,61 @@ private:
     std::vector<float>   va_flt;        // vertex attribute list (floats)
     std::vector<int>     va_int;        // vertex attribute list (ints) 
     
-    group_list pts_v;               	// points vertex index
-    group_list pts_n;               	// points normal index
-    group_list pts_c;               	// points color index
-    group_tci_list pts_tcs;             // points texture coordinates ( up to 4 sets )
-    group_vai_list pts_vas;             // points vertex attributes ( up to 8 sets )
-    string_list pt_materials;           // points materials
-
-    group_list tris_v;              	// triangles vertex index
-    group_list tris_n;              	// triangles normal index
-    group_list tris_c;              	// triangles color index
-    group_tci_list tris_tcs;            // triangles texture coordinates ( up to 4 sets )
-    group_vai_list tris_vas;            // triangles vertex attributes ( up to 8 sets )
-    string_list tri_materials;          // triangles materials
-
-    group_list strips_v;            	// tristrips vertex index
-    group_list strips_n;            	// tristrips normal index
-    group_list strips_c;            	// tristrips color index
-    group_tci_list strips_tcs;          // tristrips texture coordinates ( up to 4 sets )
-    group_vai_list strips_vas;          // tristrips vertex attributes ( up to 8 sets )
-    string_list strip_materials;        // tristrips materials
-
-    group_list fans_v;              	// fans vertex index
-    group_list fans_n;              	// fans normal index
-    group_list fans_c;              	// fans color index
-    group_tci_list fans_tcs;            // fanss texture coordinates ( up to 4 sets )
-    group_vai_list fans_vas;            // fans vertex attributes ( up to 8 sets )
-    string_list fan_materials;	        // fans materials
-
-    void read_properties(gzFile fp, int nproperties);
-    
-    void read_object( gzFile fp,
-                             int obj_type,
-                             int nproperties,
-                             int nelements,
-                             group_list& vertices, 
-                             group_list& normals,
-                             group_list& colors,
-                             group_tci_list& texCoords,
-                             group_vai_list& vertexAttribs,
-                             string_list& materials);
+    // The index groups of each primitive type are kept twice: flat, as
+    // read_bin decodes them, and as one list per group for the getters
+    // below and for writing. Either side is built from the other the first
+    // time it is asked for, so readers pay only for the form they use.
+    enum Primitive {
+        PRIM_POINTS = 0,
+        PRIM_TRIANGLES,
+        PRIM_STRIPS,
+        PRIM_FANS
+    };
+
+    mutable SGBinObjectGroups pts_groups;
+    mutable SGBinObjectGroups tris_groups;
+    mutable SGBinObjectGroups strips_groups;
+    mutable SGBinObjectGroups fans_groups;
+
+    mutable unsigned lists_pending = 0;    // bit per primitive, lists out of date
+    mutable unsigned groups_pending = 0;   // bit per primitive, groups out of date
+
+    mutable group_list pts_v;               	// points vertex index
+    mutable group_list pts_n;               	// points normal index
+    mutable group_list pts_c;               	// points color index
+    mutable group_tci_list pts_tcs;             // points texture coordinates ( up to 4 sets )
+    mutable group_vai_list pts_vas;             // points vertex attributes ( up to 8 sets )
+    mutable string_list pt_materials;           // points materials
+
+    mutable group_list tris_v;              	// triangles vertex index
+    mutable group_list tris_n;              	// triangles normal index
+    mutable group_list tris_c;              	// triangles color index
+    mutable group_tci_list tris_tcs;            // triangles texture coordinates ( up to 4 sets )
+    mutable group_vai_list tris_vas;            // triangles vertex attributes ( up to 8 sets )
+    mutable string_list tri_materials;          // triangles materials
+
+    mutable group_list strips_v;            	// tristrips vertex index
+    mutable group_list strips_n;            	// tristrips normal index
+    mutable group_list strips_c;            	// tristrips color index
+    mutable group_tci_list strips_tcs;          // tristrips texture coordinates ( up to 4 sets )
+    mutable group_vai_list strips_vas;          // tristrips vertex attributes ( up to 8 sets )
+    mutable string_list strip_materials;        // tristrips materials
+
+    mutable group_list fans_v;              	// fans vertex index
+    mutable group_list fans_n;              	// fans normal index
+    mutable group_list fans_c;              	// fans color index
+    mutable group_tci_list fans_tcs;            // fanss texture coordinates ( up to 4 sets )
+    mutable group_vai_list fans_vas;            // fans vertex attributes ( up to 8 sets )
+    mutable string_list fan_materials;	        // fans materials
+
+    void sync_lists( Primitive p ) const {
+        if ( lists_pending & (1u << p) ) build_lists( p );
+    }
+    void sync_groups( Primitive p ) const {
+        if ( groups_pending & (1u << p) ) build_groups( p );
+    }
+    void build_lists( Primitive p ) const;
+    void build_groups( Primitive p ) const;
                              
     void write_header(gzFile fp, int type, int nProps, int nElements);
     void write_objects(gzFile fp, 
@@ -233,39 +336,46 @@ public:
     
     // Points API
     bool add_point( const SGBinObjectPoint& pt );
-    inline const group_list& get_pts_v() const { return pts_v; }
-    inline const group_list& get_pts_n() const { return pts_n; }    
-    inline const group_tci_list& get_pts_tcs() const { return pts_tcs; }
-    inline const group_vai_list& get_pts_vas() const { return pts_vas; }
-    inline const string_list& get_pt_materials() const { return pt_materials; }
+    inline const group_list& get_pts_v() const { sync_lists(PRIM_POINTS); return pts_v; }
+    inline const group_list& get_pts_n() const { sync_lists(PRIM_POINTS); return pts_n; }    
+    inline const group_tci_list& get_pts_tcs() const { sync_lists(PRIM_POINTS); return pts_tcs; }
+    inline const group_vai_list& get_pts_vas() const { sync_lists(PRIM_POINTS); return pts_vas; }
+    inline const string_list& get_pt_materials() const { sync_lists(PRIM_POINTS); return pt_materials; }
+    inline const SGBinObjectGroups& get_pts_groups() const { sync_groups(PRIM_POINTS); return pts_groups; }
 
     // Triangles API
     bool add_triangle( const SGBinObjectTriangle& tri );
-    inline const group_list& get_tris_v() const { return tris_v; }
-    inline const group_list& get_tris_n() const { return tris_n; }
-    inline const group_list& get_tris_c() const { return tris_c; }
-    inline const group_tci_list& get_tris_tcs() const { return tris_tcs; }
-    inline const group_vai_list& get_tris_vas() const { return tris_vas; }
-    inline const string_list& get_tri_materials() const { return tri_materials; }
+    inline const group_list& get_tris_v() const { sync_lists(PRIM_TRIANGLES); return tris_v; }
+    inline const group_list& get_tris_n() const { sync_lists(PRIM_TRIANGLES); return tris_n; }
+    inline const group_list& get_tris_c() const { sync_lists(PRIM_TRIANGLES); return tris_c; }
+    inline const group_tci_list& get_tris_tcs() const { sync_lists(PRIM_TRIANGLES); return tris_tcs; }
+    inline const group_vai_list& get_tris_vas() const { sync_lists(PRIM_TRIANGLES); return tris_vas; }
+    inline const string_list& get_tri_materials() const { sync_lists(PRIM_TRIANGLES); return tri_materials; }
+    inline const SGBinObjectGroups& get_tris_groups() const { sync_groups(PRIM_TRIANGLES); return tris_groups; }
     
     // Strips API (deprecated - read only)
-    inline const group_list& get_strips_v() const { return strips_v; }
-    inline const group_list& get_strips_n() const { return strips_n; }
-    inline const group_list& get_strips_c() const { return strips_c; }
-    inline const group_tci_list& get_strips_tcs() const { return strips_tcs; }
-    inline const group_vai_list& get_strips_vas() const { return strips_vas; }
-    inline const string_list& get_strip_materials() const { return strip_materials; }
+    inline const group_list& get_strips_v() const { sync_lists(PRIM_STRIPS); return strips_v; }
+    inline const group_list& get_strips_n() const { sync_lists(PRIM_STRIPS); return strips_n; }
+    inline const group_list& get_strips_c() const { sync_lists(PRIM_STRIPS); return strips_c; }
+    inline const group_tci_list& get_strips_tcs() const { sync_lists(PRIM_STRIPS); return strips_tcs; }
+    inline const group_vai_list& get_strips_vas() const { sync_lists(PRIM_STRIPS); return strips_vas; }
+    inline const string_list& get_strip_materials() const { sync_lists(PRIM_STRIPS); return strip_materials; }
+    inline const SGBinObjectGroups& get_strips_groups() const { sync_groups(PRIM_STRIPS); return strips_groups; }
 
     // Fans API (deprecated - read only )
-    inline const group_list& get_fans_v() const { return fans_v; }
-    inline const group_list& get_fans_n() const { return fans_n; }
-    inline const group_list& get_fans_c() const { return fans_c; }
-    inline const group_tci_list& get_fans_tcs() const { return fans_tcs; }
-    inline const group_vai_list& get_fans_vas() const { return fans_vas; }
-    inline const string_list& get_fan_materials() const { return fan_materials; }
+    inline const group_list& get_fans_v() const { sync_lists(PRIM_FANS); return fans_v; }
+    inline const group_list& get_fans_n() const { sync_lists(PRIM_FANS); return fans_n; }
+    inline const group_list& get_fans_c() const { sync_lists(PRIM_FANS); return fans_c; }
+    inline const group_tci_list& get_fans_tcs() const { sync_lists(PRIM_FANS); return fans_tcs; }
+    inline const group_vai_list& get_fans_vas() const { sync_lists(PRIM_FANS); return fans_vas; }
+    inline const string_list& get_fan_materials() const { sync_lists(PRIM_FANS); return fan_materials; }
+    inline const SGBinObjectGroups& get_fans_groups() const { sync_groups(PRIM_FANS); return fans_groups; }
 
     /**
      * Read a binary file object and populate the provided structures.
+     * The whole file is mapped (or inflated, when gzip compressed) into
+     * memory and the index groups are decoded straight into their flat
+     * form; the per group lists are only built if asked for.
      * @param file input file name
      * @return result of read
      */
@@ -282,8 +392,24 @@ public:
      */
     bool write_bin( const std::string& base, const std::string& name, const SGBucket& b );
 
+    /// How write_bin_file() stores the scenery-file.
+    enum Compression {
+        COMPRESSION_GZIP,   ///< gzip, readable by every version
+        COMPRESSION_NONE,   ///< as is, mapped straight into memory on reading
+        COMPRESSION_LZ4     ///< LZ4 in a container, much faster to unpack than gzip
+    };
+
+    bool write_bin_file( const SGPath& file,
+                         Compression compression = COMPRESSION_GZIP );
 
-    bool write_bin_file(const SGPath& file);
+    /**
+     * Store the scenery-file src again at dst with another compression.
+     * The object stream is copied as is, nothing is decoded. src and dst
+     * may be the same file.
+     * @return result of write, throws sg_io_exception if src can't be read
+     */
+    static bool convert_bin( const SGPath& src, const SGPath& dst,
+                             Compression compression );
 
     /**
      * Write out the structures to an ASCII file.  We assume that the
@@ -0,0 +1,177 @@
+// sg_lz4.cxx -- compression and decompression of single LZ4 blocks
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "sg_lz4.hxx"
+
+#include <cstdint>
+#include <cstring>
+
+namespace simgear
+{
+
+namespace
+{
+
+// Limits of the block format: matches are at least MIN_MATCH bytes, the
+// last LAST_LITERALS bytes are always literals and no match starts in the
+// last MATCH_LIMIT bytes.
+const size_t MIN_MATCH = 4;
+const size_t LAST_LITERALS = 5;
+const size_t MATCH_LIMIT = 12;
+const size_t MAX_OFFSET = 0xffff;
+
+const unsigned HASH_BITS = 16;
+
+inline uint32_t read32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void putLength(std::vector<char>& out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        out.push_back(char(255));
+    out.push_back(char(length));
+}
+
+void putSequence(std::vector<char>& out, const char* literals,
+                 size_t numLiterals, size_t offset, size_t matchLength)
+{
+    size_t token = (numLiterals < 15 ? numLiterals : 15) << 4;
+    if (matchLength) {
+        size_t m = matchLength - MIN_MATCH;
+        token |= m < 15 ? m : 15;
+    }
+    out.push_back(char(token));
+    if (numLiterals >= 15)
+        putLength(out, numLiterals - 15);
+    out.insert(out.end(), literals, literals + numLiterals);
+
+    // the last sequence has literals only
+    if (!matchLength)
+        return;
+    out.push_back(char(offset & 0xff));
+    out.push_back(char(offset >> 8));
+    if (matchLength - MIN_MATCH >= 15)
+        putLength(out, matchLength - MIN_MATCH - 15);
+}
+
+// reads a length continued in 255 steps, false if the input ends first
+bool getLength(const unsigned char*& ip, const unsigned char* end,
+               size_t& length)
+{
+    unsigned char b;
+    do {
+        if (ip == end)
+            return false;
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+} // of anonymous namespace
+
+void lz4Compress(const char* src, size_t size, std::vector<char>& out)
+{
+    out.clear();
+    out.reserve(size + size/255 + 16);
+
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+    size_t anchor = 0;
+    size_t ip = 0;
+    while (MATCH_LIMIT < size && ip < size - MATCH_LIMIT) {
+        uint32_t sequence = read32(src + ip);
+        uint32_t& entry = table[hash32(sequence)];
+        size_t ref = entry;
+        entry = uint32_t(ip);
+
+        if (ref < ip && ip - ref <= MAX_OFFSET && read32(src + ref) == sequence) {
+            size_t length = MIN_MATCH;
+            size_t maxLength = size - LAST_LITERALS - ip;
+            while (length < maxLength && src[ref + length] == src[ip + length])
+                ++length;
+
+            putSequence(out, src + anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+        } else {
+            ++ip;
+        }
+    }
+    putSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+bool lz4Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize)
+{
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+    const unsigned char* const end = ip + srcSize;
+    size_t op = 0;
+
+    while (ip != end) {
+        const unsigned token = *ip++;
+
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !getLength(ip, end, numLiterals))
+            return false;
+        if (size_t(end - ip) < numLiterals || dstSize - op < numLiterals)
+            return false;
+        memcpy(dst + op, ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+
+        // the block ends after the literals of its last sequence
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return false;
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || op < offset)
+            return false;
+
+        size_t length = token & 15;
+        if (length == 15 && !getLength(ip, end, length))
+            return false;
+        length += MIN_MATCH;
+        if (dstSize - op < length)
+            return false;
+
+        char* out = dst + op;
+        const char* match = out - offset;
+        if (length <= offset) {
+            memcpy(out, match, length);
+        } else {
+            // overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < length; ++i)
+                out[i] = match[i];
+        }
+        op += length;
+    }
+    return op == dstSize;
+}
+
+} // of namespace simgear
@@ -0,0 +1,45 @@
+/**
+ * \file sg_lz4.hxx
+ * Compression and decompression of single LZ4 blocks.
+ */
+
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _SG_LZ4_HXX
+#define _SG_LZ4_HXX
+
+#include <cstddef>
+#include <vector>
+
+namespace simgear
+{
+
+/**
+ * Compress size bytes at src into one LZ4 block, replacing the contents
+ * of out. The block is in the standard LZ4 block format, so it can also
+ * be decoded with LZ4_decompress_safe() from liblz4.
+ */
+void lz4Compress(const char* src, size_t size, std::vector<char>& out);
+
+/**
+ * Decode one LZ4 block of srcSize bytes into dstSize bytes at dst.
+ * Returns false if the block is malformed or does not decode to exactly
+ * dstSize bytes; nothing is read or written out of bounds either way.
+ */
+bool lz4Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize);
+
+} // of namespace simgear
+
+#endif // _SG_LZ4_HXX
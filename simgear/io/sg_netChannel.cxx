@@ -41,9 +41,25 @@
 
 #include <simgear/debug/logstream.hxx>
 
+#if defined(__linux__)
+#  define SG_NET_CHANNEL_EPOLL 1
+#  include <sys/epoll.h>
+#  include <unistd.h>
+#endif
+
 
 namespace simgear  {
 
+namespace {
+
+// interest flags kept in NetChannel::pollEvents
+enum {
+    POLL_READ = 1,
+    POLL_WRITE = 2
+};
+
+} // of anonymous namespace
+
 NetChannel::NetChannel ()
 {
   closed = true ;
@@ -53,6 +69,8 @@ NetChannel::NetChannel ()
   write_blocked = false ;
   should_delete = false ;
   poller = NULL;
+  pollHandle = -1;
+  pollEvents = 0;
 }
   
 NetChannel::~NetChannel ()
@@ -156,6 +174,11 @@ NetChannel::close (void)
     write_blocked = false ;
   }
 
+  // unregister while the handle is still ours; once closed, the same
+  // number may be handed to another channel
+  if (poller) {
+    poller->updateInterest(this, 0);
+  }
   Socket::close () ;
 }
 
@@ -244,6 +267,27 @@ void NetChannel::handleError (int error)
     }
 }
 
+NetChannelPoller::NetChannelPoller() :
+    epollFd(-1)
+{
+#if defined(SG_NET_CHANNEL_EPOLL)
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        SG_LOG(SG_IO, SG_WARN, "NetChannelPoller: epoll_create1 failed, using select: "
+               << strerror(errno));
+    }
+#endif
+}
+
+NetChannelPoller::~NetChannelPoller()
+{
+#if defined(SG_NET_CHANNEL_EPOLL)
+    if (epollFd >= 0) {
+        ::close(epollFd);
+    }
+#endif
+}
+
 void
 NetChannelPoller::addChannel(NetChannel* channel)
 {
@@ -259,6 +303,7 @@ NetChannelPoller::removeChannel(NetChannel* channel)
 {
     assert(channel);
     assert(channel->poller == this);
+    updateInterest(channel, 0);
     channel->poller = NULL;
 
     auto it = std::find(channels.begin(), channels.end(), channel);
@@ -267,18 +312,160 @@ NetChannelPoller::removeChannel(NetChannel* channel)
     }
 }
 
+void
+NetChannelPoller::updateInterest(NetChannel* channel, unsigned int events)
+{
+#if defined(SG_NET_CHANNEL_EPOLL)
+    if (epollFd < 0) {
+        return;
+    }
+
+    // channels with no interest are dropped from the set rather than kept
+    // with an empty mask, since epoll always reports hangups
+    const int handle = events ? channel->getHandle() : -1;
+    if ((handle == channel->pollHandle) && (events == channel->pollEvents)) {
+        return;
+    }
+
+    if ((channel->pollHandle >= 0) && (handle != channel->pollHandle)) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, channel->pollHandle, NULL);
+        channel->pollHandle = -1;
+        channel->pollEvents = 0;
+    }
+
+    if (handle < 0) {
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = ((events & POLL_READ) ? EPOLLIN : 0) |
+                ((events & POLL_WRITE) ? EPOLLOUT : 0);
+    ev.data.ptr = channel;
+
+    int op = (channel->pollHandle < 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    int result = epoll_ctl(epollFd, op, handle, &ev);
+    if ((result != 0) && (errno == EEXIST || errno == ENOENT)) {
+        // registration went stale behind our back, eg the handle was
+        // replaced without going through NetChannel::close
+        op = (op == EPOLL_CTL_ADD) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        result = epoll_ctl(epollFd, op, handle, &ev);
+    }
+
+    if (result != 0) {
+        SG_LOG(SG_IO, SG_WARN, "Network:" << handle << ": epoll_ctl failed: "
+               << strerror(errno));
+        return;
+    }
+
+    channel->pollHandle = handle;
+    channel->pollEvents = events;
+#endif
+}
+
 bool
 NetChannelPoller::poll(unsigned int timeout)
 {
     if (channels.empty()) {
         return false;
     }
-    
-    enum { MAX_SOCKETS = 256 } ;
-    Socket* reads [ MAX_SOCKETS+1 ] ;
-    Socket* writes [ MAX_SOCKETS+1 ] ;
-    int nreads = 0 ;
-    int nwrites = 0 ;
+
+    if (epollFd < 0) {
+        return pollSelect(timeout);
+    }
+
+    unsigned int nopen = 0 ;
+    bool anyInterest = false ;
+
+    ChannelList::iterator it = channels.begin();
+    while( it != channels.end() )
+    {
+        NetChannel* ch = *it;
+        if ( ch -> should_delete )
+        {
+            // avoid the channel trying to remove itself from us, or we get
+            // bug http://code.google.com/p/flightgear-bugs/issues/detail?id=1144
+            updateInterest(ch, 0);
+            ch->poller = NULL;
+            delete ch;
+            it = channels.erase(it);
+            continue;
+        }
+
+        ++it; // we've copied the pointer into ch
+        if ( ch->closed ) {
+            continue;
+        }
+
+        if (ch -> resolving_host )
+        {
+            updateInterest(ch, 0);
+            ch -> handleResolve();
+            continue;
+        }
+
+        nopen++ ;
+        unsigned int events = (ch->readable() ? POLL_READ : 0) |
+                              (ch->writable() ? POLL_WRITE : 0);
+        updateInterest(ch, events);
+        anyInterest |= (events != 0);
+    } // of interest-updating pass
+
+    if (!nopen)
+      return false ;
+    if (!anyInterest)
+      return true ; //hmmm- should we shutdown?
+
+    return pollEpoll(timeout, nopen);
+}
+
+bool
+NetChannelPoller::pollEpoll(unsigned int timeout, unsigned int nopen)
+{
+#if defined(SG_NET_CHANNEL_EPOLL)
+    enum { MAX_EVENTS = 256 } ;
+    struct epoll_event events [ MAX_EVENTS ] ;
+
+    int maxEvents = (nopen < MAX_EVENTS) ? (int) nopen : (int) MAX_EVENTS;
+    int count = epoll_wait(epollFd, events, maxEvents, (int) timeout);
+    if (count < 0) {
+        if (errno != EINTR) {
+            SG_LOG(SG_IO, SG_WARN, "NetChannelPoller: epoll_wait failed: "
+                   << strerror(errno));
+        }
+        return true;
+    }
+
+    // dispatch all reads before all writes, as the select path does.
+    // A handler may close or remove other channels, so re-check each one.
+    for ( int i=0; i<count; i++ )
+    {
+      NetChannel* ch = (NetChannel*) events[i].data.ptr;
+      if ( (ch->poller == this) && !ch->closed &&
+           (ch->pollEvents & POLL_READ) &&
+           (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) )
+        ch -> handleReadEvent();
+    }
+
+    for ( int i=0; i<count; i++ )
+    {
+      NetChannel* ch = (NetChannel*) events[i].data.ptr;
+      if ( (ch->poller == this) && !ch->closed &&
+           (ch->pollEvents & POLL_WRITE) &&
+           (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) )
+        ch -> handleWriteEvent();
+    }
+#else
+    (void) timeout;
+    (void) nopen;
+#endif
+    return true ;
+}
+
+bool
+NetChannelPoller::pollSelect(unsigned int timeout)
+{
+    std::vector<Socket*> reads, writes;
     int nopen = 0 ;
     
     ChannelList::iterator it = channels.begin();
@@ -308,24 +495,21 @@ NetChannelPoller::poll(unsigned int timeout)
       
         nopen++ ;
         if (ch -> readable()) {
-          assert(nreads<MAX_SOCKETS);
-          reads[nreads++] = ch ;
+          reads.push_back(ch);
         }
         if (ch -> writable()) {
-          assert(nwrites<MAX_SOCKETS);
-          writes[nwrites++] = ch ;
+          writes.push_back(ch);
         }
     } // of array-filling pass
-    
-    reads[nreads] = NULL ;
-    writes[nwrites] = NULL ;
 
     if (!nopen)
       return false ;
-    if (!nreads && !nwrites)
+    if (reads.empty() && writes.empty())
       return true ; //hmmm- should we shutdown?
 
-    Socket::select (reads, writes, timeout) ;
+    reads.push_back(NULL);
+    writes.push_back(NULL);
+    Socket::select (reads.data(), writes.data(), timeout) ;
 
     for ( int i=0; reads[i]; i++ )
     {
@@ -71,6 +71,9 @@ class NetChannel : public Socket
   
     friend class NetChannelPoller;
     NetChannelPoller* poller;
+    // handle and events as last registered with the poller's epoll set
+    int pollHandle;
+    unsigned int pollEvents;
 public:
 
   NetChannel () ;
@@ -115,11 +118,29 @@ public:
 
 };
 
+/**
+ * Waits for events on a set of channels. On Linux this uses epoll, so
+ * the number of channels and their handles are not limited by
+ * FD_SETSIZE; elsewhere, or if no epoll instance can be created, it
+ * falls back to Socket::select.
+ */
 class NetChannelPoller
 {
     typedef std::vector<NetChannel*> ChannelList;
     ChannelList channels;
+    int epollFd;
+
+    NetChannelPoller(const NetChannelPoller&) = delete;
+    NetChannelPoller& operator=(const NetChannelPoller&) = delete;
+
+    friend class NetChannel;
+    void updateInterest(NetChannel* channel, unsigned int events);
+    bool pollEpoll(unsigned int timeout, unsigned int nopen);
+    bool pollSelect(unsigned int timeout);
 public:
+    NetChannelPoller();
+    ~NetChannelPoller();
+
     void addChannel(NetChannel* channel);
     void removeChannel(NetChannel* channel);
     
@@ -39,7 +39,8 @@ using std::string;
 SGSocketUDP::SGSocketUDP( const string& host, const string& port ) :
     hostname(host),
     port_str(port),
-    save_len(0)
+    save_len(0),
+    batch_count(0)
 {
     set_valid( false );
 }
@@ -185,6 +186,87 @@ int SGSocketUDP::write( const char *buf, const int length ) {
 }
 
 
+char* SGSocketUDP::batchSlot( int i ) {
+    if ( batch_buf.empty() ) {
+        batch_buf.resize( SG_IO_UDP_BATCH_SIZE * SG_IO_MAX_MSG_SIZE );
+    }
+    return &batch_buf[ i * SG_IO_MAX_MSG_SIZE ];
+}
+
+
+// read the queued datagrams from socket (server)
+int SGSocketUDP::readBatch() {
+    batch_count = 0;
+    if ( ! isvalid() ) {
+	return 0;
+    }
+
+    void* buffers[ SG_IO_UDP_BATCH_SIZE ];
+    int sizes[ SG_IO_UDP_BATCH_SIZE ];
+    for ( int i = 0; i < SG_IO_UDP_BATCH_SIZE; ++i ) {
+        buffers[i] = batchSlot( i );
+        // leave room for the terminator, as read() does
+        sizes[i] = SG_IO_MAX_MSG_SIZE - 1;
+    }
+
+    int result = sock.recvBatch( buffers, sizes, batch_len,
+                                 SG_IO_UDP_BATCH_SIZE, 0 );
+    for ( int i = 0; i < result; ++i ) {
+        batchSlot( i )[ batch_len[i] ] = '\0';
+    }
+    if ( result > 0 ) {
+        batch_count = result;
+    }
+
+    return result;
+}
+
+
+// queue datagram for the next flushBatch() (client)
+int SGSocketUDP::writeBatch( const char *buf, const int length ) {
+    if ( ! isvalid() ) {
+	return 0;
+    }
+
+    if ( length > SG_IO_MAX_MSG_SIZE ) {
+        // too big for a slot, send it directly but keep the order
+        flushBatch();
+        return write( buf, length );
+    }
+
+    memcpy( batchSlot( batch_count ), buf, length );
+    batch_len[ batch_count++ ] = length;
+    if ( batch_count == SG_IO_UDP_BATCH_SIZE ) {
+        flushBatch();
+    }
+
+    return length;
+}
+
+
+// send the queued datagrams (client)
+int SGSocketUDP::flushBatch() {
+    if ( ! isvalid() || batch_count == 0 ) {
+	return 0;
+    }
+
+    const void* buffers[ SG_IO_UDP_BATCH_SIZE ];
+    for ( int i = 0; i < batch_count; ++i ) {
+        buffers[i] = batchSlot( i );
+    }
+
+    int result = sock.sendBatch( buffers, batch_len, batch_count, 0 );
+    if ( result < batch_count ) {
+	SG_LOG( SG_IO, SG_WARN, "Error writing to socket: " << port
+                << ", dropped " << batch_count - std::max(result, 0)
+                << " datagrams" );
+    }
+    batch_count = 0;
+
+    return std::max( result, 0 );
+}
+
+
 // write null terminated string to socket (server)
 int SGSocketUDP::writestring( const char *str ) {
     if ( !isvalid() ) {
@@ -202,6 +284,9 @@ bool SGSocketUDP::close() {
 	return 0;
     }
 
+    if ( get_dir() == SG_IO_OUT ) {
+        flushBatch();
+    }
     sock.close();
 
     return true;
@@ -31,11 +31,15 @@
 #include <simgear/compiler.h>
 
 #include <string>
+#include <vector>
 
 #include <simgear/math/sg_types.hxx>
 #include <simgear/io/iochannel.hxx>
 #include <simgear/io/raw_socket.hxx>
 
+/** Number of datagrams handled by one readBatch()/flushBatch() call. */
+#define SG_IO_UDP_BATCH_SIZE 32
+
 /**
  * A UDP socket I/O class based on SGIOChannel and plib/net.
  */
@@ -53,6 +57,15 @@ private:
 
     short unsigned int port;
 
+    // Slots of SG_IO_MAX_MSG_SIZE bytes for readBatch()/writeBatch(),
+    // allocated on first use. A UDP channel only goes one way, so the
+    // same slots hold either received or queued datagrams.
+    std::vector<char> batch_buf;
+    int batch_len[ SG_IO_UDP_BATCH_SIZE ];
+    int batch_count;
+
+    char* batchSlot( int i );
+
 public:
 
     /**
@@ -111,6 +124,38 @@ public:
     // write null terminated string to a socket
     int writestring( const char *str );
 
+    /**
+     * Read all datagrams already queued on the socket, up to
+     * SG_IO_UDP_BATCH_SIZE, with a single system call where the
+     * platform supports it. Blocks like read() for the first one. The
+     * datagrams are null terminated and stay valid until the next
+     * readBatch() call.
+     * @return number of datagrams read, or a negative value like read()
+     */
+    int readBatch();
+
+    /** @return datagram i of the last readBatch() */
+    inline const char* getBatchData( int i ) const {
+        return &batch_buf[ i * SG_IO_MAX_MSG_SIZE ];
+    }
+
+    /** @return length of datagram i of the last readBatch() */
+    inline int getBatchLength( int i ) const { return batch_len[i]; }
+
+    /**
+     * Queue a datagram for flushBatch(), which is done automatically
+     * when SG_IO_UDP_BATCH_SIZE datagrams are waiting.
+     * @return length, or 0 on error like write()
+     */
+    int writeBatch( const char *buf, const int length );
+
+    /**
+     * Send the datagrams queued by writeBatch() with a single system
+     * call where the platform supports it.
+     * @return number of datagrams sent
+     */
+    int flushBatch();
+
     // close file
     bool close();
 
@@ -15,8 +15,10 @@
 
 #include <simgear/misc/sg_dir.hxx>
 #include <simgear/misc/test_macros.hxx>
+#include <simgear/structure/exception.hxx>
 
 #include "sg_binobj.hxx"
+#include "sg_lz4.hxx"
 
 using std::cout;
 using std::cerr;
@@ -344,6 +346,282 @@ void test_many_objects()
     compareTris(basic, rd);
 }
 
+void compareGroups(const SGBinObject& lists, const SGBinObject& flat)
+{
+    // dropped triangles come last in the tests
+    const SGBinObjectGroups& groups(flat.get_tris_groups());
+    SG_VERIFY(groups.size() <= lists.get_tri_materials().size());
+
+    for (unsigned int i=0; i<groups.size(); i += 7) {
+        const int_list& v(lists.get_tris_v()[i]);
+        SG_CHECK_EQUAL(groups.getCount(i), v.size());
+        SG_CHECK_EQUAL(groups.getMaterial(i), lists.get_tri_materials()[i]);
+
+        const int* gv = groups.getIndices(i, SGBinObjectGroups::VERTICES);
+        SG_VERIFY(int_list(gv, gv + v.size()) == v);
+
+        const int_list& tc(lists.get_tris_tcs()[i][0]);
+        const int* gtc = groups.getIndices(i, SGBinObjectGroups::TEXCOORDS_0);
+        SG_VERIFY(int_list(gtc, gtc + tc.size()) == tc);
+
+        SG_VERIFY(!groups.has(i, SGBinObjectGroups::COLORS));
+        SG_VERIFY(groups.getIndices(i, SGBinObjectGroups::COLORS) == nullptr);
+    }
+}
+
+void test_flat_groups()
+{
+    SGBinObject basic;
+    SGPath path(simgear::Dir::current().file("flat.btg.gz"));
+
+    basic.set_gbs_center(SGVec3d(1, 2, 3));
+    basic.set_gbs_radius(12345);
+
+    std::vector<SGVec3d> points;
+    generate_points(10000, points);
+    std::vector<SGVec3f> normals;
+    generate_normals(1024, normals);
+    std::vector<SGVec2f> texCoords;
+    generate_tcs(20000, texCoords);
+
+    basic.set_wgs84_nodes(points);
+    basic.set_normals(normals);
+    basic.set_texcoords(texCoords);
+
+    generate_tris(basic, 5000);
+
+    // a zero area triangle is dropped on reading
+    SGBinObjectTriangle degenerate;
+    degenerate.material = "material2";
+    degenerate.v_list = {1, 1, 2};
+    degenerate.n_list = {1, 2, 3};
+    degenerate.tc_list[0] = {1, 2, 3};
+    basic.add_triangle(degenerate);
+
+    // groups built from the lists match them
+    SG_CHECK_EQUAL(basic.get_tris_groups().size(), 5001);
+    compareGroups(basic, basic);
+
+    bool ok = basic.write_bin_file(path);
+    SG_VERIFY( ok );
+
+    SGBinObject rd;
+    ok = rd.read_bin(path);
+    SG_VERIFY( ok );
+    SG_CHECK_EQUAL(rd.get_tris_groups().size(), 5000);
+    compareGroups(basic, rd);
+    compareTris(basic, rd);
+
+    // the same file without compression is read through the mapping
+    SGPath plainPath(simgear::Dir::current().file("flat.btg"));
+    gzFile in = gzopen(path.utf8Str().c_str(), "rb");
+    FILE* out = fopen(plainPath.utf8Str().c_str(), "wb");
+    SG_VERIFY(in && out);
+    char buf[4096];
+    int n;
+    while ((n = gzread(in, buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, n, out);
+    }
+    gzclose(in);
+    fclose(out);
+
+    SGBinObject plain;
+    ok = plain.read_bin(plainPath);
+    SG_VERIFY( ok );
+    SG_CHECK_EQUAL(plain.get_wgs84_nodes().size(), points.size());
+    comparePoints(plain, points);
+    compareTexCoords(plain, texCoords);
+    compareGroups(basic, plain);
+    compareTris(basic, plain);
+
+    // a truncated file is an error, not a short read
+    SGPath truncatedPath(simgear::Dir::current().file("truncated.btg"));
+    FILE* truncated = fopen(truncatedPath.utf8Str().c_str(), "wb");
+    FILE* full = fopen(plainPath.utf8Str().c_str(), "rb");
+    n = fread(buf, 1, sizeof(buf), full);
+    fwrite(buf, 1, n, truncated);
+    fclose(full);
+    fclose(truncated);
+
+    bool threw = false;
+    try {
+        SGBinObject rd2;
+        rd2.read_bin(truncatedPath);
+    } catch (sg_exception&) {
+        threw = true;
+    }
+    SG_VERIFY(threw);
+}
+
+void test_lz4()
+{
+    std::vector<std::string> inputs = {
+        "", "a", "abcabcabcabcabcabcabcabcabcabcabcabcabc",
+        string(100000, 'x')
+    };
+    string mixed;
+    for (int i=0; i<200000; ++i) {
+        mixed += (i % 7 == 0) ? char(random() % 256) : char('a' + (i / 13) % 5);
+    }
+    inputs.push_back(mixed);
+
+    for (const string& input : inputs) {
+        std::vector<char> compressed;
+        simgear::lz4Compress(input.data(), input.size(), compressed);
+        std::vector<char> output(input.size());
+        SG_VERIFY(simgear::lz4Decompress(compressed.data(), compressed.size(),
+                                         output.data(), output.size()));
+        SG_VERIFY(string(output.begin(), output.end()) == input);
+
+        // a block cut short must not decode
+        if (compressed.size() > 1) {
+            SG_VERIFY(!simgear::lz4Decompress(compressed.data(), compressed.size() - 1,
+                                              output.data(), output.size()));
+        }
+    }
+}
+
+void test_compression()
+{
+    SGBinObject basic;
+    basic.set_gbs_center(SGVec3d(1, 2, 3));
+    basic.set_gbs_radius(12345);
+
+    std::vector<SGVec3d> points;
+    generate_points(10000, points);
+    std::vector<SGVec3f> normals;
+    generate_normals(1024, normals);
+    std::vector<SGVec2f> texCoords;
+    generate_tcs(20000, texCoords);
+
+    basic.set_wgs84_nodes(points);
+    basic.set_normals(normals);
+    basic.set_texcoords(texCoords);
+    generate_tris(basic, 5000);
+
+    const SGBinObject::Compression compressions[] = {
+        SGBinObject::COMPRESSION_GZIP,
+        SGBinObject::COMPRESSION_NONE,
+        SGBinObject::COMPRESSION_LZ4
+    };
+    for (SGBinObject::Compression compression : compressions) {
+        SGPath path(simgear::Dir::current().file("compressed.btg"));
+        SG_VERIFY(basic.write_bin_file(path, compression));
+
+        SGBinObject rd;
+        SG_VERIFY(rd.read_bin(path));
+        SG_CHECK_EQUAL(rd.get_wgs84_nodes().size(), points.size());
+        comparePoints(rd, points);
+        compareTexCoords(rd, texCoords);
+        compareTris(basic, rd);
+
+        // converting keeps the object stream
+        for (SGBinObject::Compression to : compressions) {
+            SGPath converted(simgear::Dir::current().file("converted.btg"));
+            SG_VERIFY(SGBinObject::convert_bin(path, converted, to));
+
+            SGBinObject cv;
+            SG_VERIFY(cv.read_bin(converted));
+            SG_CHECK_EQUAL(cv.get_version(), rd.get_version());
+            comparePoints(cv, points);
+            compareTris(basic, cv);
+        }
+    }
+}
+
+void test_convert_in_place()
+{
+    SGBinObject basic;
+    basic.set_gbs_center(SGVec3d(1, 2, 3));
+    basic.set_gbs_radius(12345);
+    std::vector<SGVec3d> points;
+    generate_points(10000, points);
+    std::vector<SGVec3f> normals;
+    generate_normals(1024, normals);
+    std::vector<SGVec2f> texCoords;
+    generate_tcs(20000, texCoords);
+
+    basic.set_wgs84_nodes(points);
+    basic.set_normals(normals);
+    basic.set_texcoords(texCoords);
+    generate_tris(basic, 5000);
+
+    // uncompressed and LZ4 sources are read through a mapping of the
+    // file, which converting must not truncate
+    const SGBinObject::Compression compressions[] = {
+        SGBinObject::COMPRESSION_NONE,
+        SGBinObject::COMPRESSION_LZ4,
+        SGBinObject::COMPRESSION_GZIP,
+        SGBinObject::COMPRESSION_NONE,
+        SGBinObject::COMPRESSION_NONE,
+        SGBinObject::COMPRESSION_LZ4,
+        SGBinObject::COMPRESSION_LZ4
+    };
+    SGPath path(simgear::Dir::current().file("in_place.btg"));
+    SG_VERIFY(basic.write_bin_file(path, SGBinObject::COMPRESSION_GZIP));
+    for (SGBinObject::Compression to : compressions) {
+        SG_VERIFY(SGBinObject::convert_bin(path, path, to));
+
+        SGBinObject cv;
+        SG_VERIFY(cv.read_bin(path));
+        comparePoints(cv, points);
+        compareTexCoords(cv, texCoords);
+        compareTris(basic, cv);
+    }
+
+    SGPath tmp(path);
+    tmp.concat(".tmp");
+    SG_VERIFY(!tmp.exists());
+    path.remove();
+}
+
+void test_corrupt_sizes()
+{
+    SGBinObject basic;
+    std::vector<SGVec3d> points;
+    generate_points(1000, points);
+    std::vector<SGVec3f> normals;
+    generate_normals(100, normals);
+    std::vector<SGVec2f> texCoords;
+    generate_tcs(1000, texCoords);
+
+    basic.set_wgs84_nodes(points);
+    basic.set_normals(normals);
+    basic.set_texcoords(texCoords);
+    generate_tris(basic, 500);
+
+    // the sizes stored in a file must not decide what is allocated: a
+    // corrupt gzip trailer or container header is an error, not 4 GB
+    const SGBinObject::Compression compressions[] = {
+        SGBinObject::COMPRESSION_GZIP,
+        SGBinObject::COMPRESSION_LZ4
+    };
+    for (SGBinObject::Compression compression : compressions) {
+        SGPath path(simgear::Dir::current().file("corrupt.btg"));
+        SG_VERIFY(basic.write_bin_file(path, compression));
+
+        FILE* fp = fopen(path.utf8Str().c_str(), "r+b");
+        if (compression == SGBinObject::COMPRESSION_GZIP) {
+            fseek(fp, -4, SEEK_END);  // ISIZE
+        } else {
+            fseek(fp, 8, SEEK_SET);   // uncompressed size
+        }
+        const unsigned char huge[4] = { 0xf0, 0xff, 0xff, 0xff };
+        fwrite(huge, 1, sizeof(huge), fp);
+        fclose(fp);
+
+        bool threw = false;
+        try {
+            SGBinObject rd;
+            rd.read_bin(path);
+        } catch (sg_exception&) {
+            threw = true;
+        }
+        SG_VERIFY(threw);
+        path.remove();
+    }
+}
+
 int main(int argc, char* argv[])
 {
     test_empty();
@@ -352,6 +630,11 @@ int main(int argc, char* argv[])
     test_big();
     test_some_objects();
     test_many_objects();
+    test_flat_groups();
+    test_lz4();
+    test_compression();
+    test_convert_in_place();
+    test_corrupt_sizes();
     
     return 0;
 }
@@ -492,6 +492,69 @@ void testUpdateNoChanges(HTTP::Client* cl)
 
 }
 
+void removeHashCaches(const SGPath& p)
+{
+    simgear::Dir d(p);
+    for (auto c : d.children(simgear::Dir::TYPE_FILE | simgear::Dir::INCLUDE_HIDDEN)) {
+        if (c.file() == ".hashes") {
+            c.remove();
+        }
+    }
+    for (const auto& c : d.children(simgear::Dir::TYPE_DIR | simgear::Dir::NO_DOT_OR_DOTDOT)) {
+        removeHashCaches(c);
+    }
+}
+
+void testHashCache(HTTP::Client* cl)
+{
+    std::unique_ptr<HTTPRepository> repo;
+    SGPath p(simgear::Dir::current().path());
+    p.append("http_repo_basic"); // same as before
+
+    // without caches every local file is hashed again, nothing downloaded
+    removeHashCaches(p);
+    global_repo->clearRequestCounts();
+
+    repo.reset(new HTTPRepository(p, cl));
+    repo->setBaseUrl("http://localhost:2000/repo");
+    repo->update();
+    waitForUpdateComplete(cl, repo.get());
+    repo.reset();
+
+    verifyFileState(p, "dirC/subdirA/subsubA/fileCAAA");
+    verifyRequestCount("dirB/subdirA/fileBAA", 0);
+    verifyRequestCount("dirC/fileCA", 0);
+    if (!(p / ".hashes").exists() || !(p / "dirC/subdirA/subsubA/.hashes").exists()) {
+        throw sg_error("Missing hash cache");
+    }
+
+    // the text cache of older versions is still read, then replaced
+    SGPath fileA = p / "fileA";
+    removeHashCaches(p);
+    {
+        sg_ofstream of(p / ".dirhash", std::ios::out | std::ios::trunc);
+        of << fileA.utf8Str() << "*" << fileA.modTime() << "*"
+           << fileA.sizeInBytes() << "*" << std::string(40, '0') << "\n";
+    }
+    global_repo->clearRequestCounts();
+
+    repo.reset(new HTTPRepository(p, cl));
+    repo->setBaseUrl("http://localhost:2000/repo");
+    repo->update();
+    waitForUpdateComplete(cl, repo.get());
+    repo.reset();
+
+    // the bogus cached hash made fileA look modified
+    verifyFileState(p, "fileA");
+    verifyRequestCount("fileA", 1);
+    verifyRequestCount("fileB", 0);
+    if ((p / ".dirhash").exists() || !(p / ".hashes").exists()) {
+        throw sg_error("Hash cache not converted");
+    }
+
+    std::cout << "Passed test: hash cache" << std::endl;
+}
+
 void testModifyLocalFiles(HTTP::Client* cl)
 {
     std::unique_ptr<HTTPRepository> repo;
@@ -920,6 +983,7 @@ int main(int argc, char* argv[])
 
     testBasicClone(&cl);
 	testUpdateNoChanges(&cl);
+    testHashCache(&cl);
 
     testModifyLocalFiles(&cl);
 
@@ -0,0 +1,214 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/raw_socket.hxx>
+#include <simgear/io/sg_socket_udp.hxx>
+#include <simgear/misc/test_macros.hxx>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+// Sends batches of datagrams over the loopback interface, where they are
+// queued on the receiving socket as soon as they are sent, so a
+// non-blocking receiver sees all of them at once.
+
+namespace {
+
+const int PORT = 15843;
+const string PORT_STR = "15843";
+
+string payload(int i)
+{
+    // a different length for each datagram
+    return "datagram-" + std::to_string(i) + string(i % 7, '*');
+}
+
+void checkBatch(const SGSocketUDP& receiver, int first, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const string expected = payload(first + i);
+        SG_CHECK_EQUAL(receiver.getBatchLength(i), (int) expected.size());
+        SG_CHECK_EQUAL(string(receiver.getBatchData(i)), expected);
+        SG_CHECK_EQUAL(receiver.getBatchData(i)[expected.size()], '\0');
+    }
+}
+
+void testPartialBatch()
+{
+    SGSocketUDP receiver("127.0.0.1", PORT_STR), sender("127.0.0.1", PORT_STR);
+    SG_VERIFY(receiver.open(SG_IO_IN));
+    SG_VERIFY(sender.open(SG_IO_OUT));
+    receiver.setBlocking(false);
+
+    for (int i = 0; i < 5; ++i) {
+        const string p = payload(i);
+        SG_CHECK_EQUAL(sender.writeBatch(p.data(), p.size()), (int) p.size());
+    }
+
+    // nothing goes out before the flush
+    SG_VERIFY(receiver.readBatch() <= 0);
+
+    SG_CHECK_EQUAL(sender.flushBatch(), 5);
+    SG_CHECK_EQUAL(sender.flushBatch(), 0);
+    SG_CHECK_EQUAL(receiver.readBatch(), 5);
+    checkBatch(receiver, 0, 5);
+
+    sender.close();
+    receiver.close();
+}
+
+void testAutomaticFlush()
+{
+    SGSocketUDP receiver("127.0.0.1", PORT_STR), sender("127.0.0.1", PORT_STR);
+    SG_VERIFY(receiver.open(SG_IO_IN));
+    SG_VERIFY(sender.open(SG_IO_OUT));
+    receiver.setBlocking(false);
+
+    for (int i = 0; i < SG_IO_UDP_BATCH_SIZE - 1; ++i) {
+        const string p = payload(i);
+        sender.writeBatch(p.data(), p.size());
+    }
+    SG_VERIFY(receiver.readBatch() <= 0);
+
+    // the last slot fills the batch, which sends it
+    const string last = payload(SG_IO_UDP_BATCH_SIZE - 1);
+    sender.writeBatch(last.data(), last.size());
+    SG_CHECK_EQUAL(receiver.readBatch(), SG_IO_UDP_BATCH_SIZE);
+    checkBatch(receiver, 0, SG_IO_UDP_BATCH_SIZE);
+
+    // and starts a new one
+    SG_CHECK_EQUAL(sender.flushBatch(), 0);
+    const string next = payload(100);
+    sender.writeBatch(next.data(), next.size());
+    SG_CHECK_EQUAL(sender.flushBatch(), 1);
+    SG_CHECK_EQUAL(receiver.readBatch(), 1);
+    checkBatch(receiver, 100, 1);
+
+    sender.close();
+    receiver.close();
+}
+
+void testOversize()
+{
+    // a datagram too big for a batch slot, which a raw socket can take
+    simgear::Socket receiver;
+    SG_VERIFY(receiver.open(false));
+    SG_VERIFY(receiver.bind("127.0.0.1", PORT) != -1);
+    receiver.setBlocking(false);
+
+    SGSocketUDP sender("127.0.0.1", PORT_STR);
+    SG_VERIFY(sender.open(SG_IO_OUT));
+
+    const string small0 = payload(0), small1 = payload(1), small2 = payload(2);
+    const string big(SG_IO_MAX_MSG_SIZE + 1000, 'B');
+    sender.writeBatch(small0.data(), small0.size());
+    sender.writeBatch(small1.data(), small1.size());
+    // goes out directly, after the datagrams queued before it
+    SG_CHECK_EQUAL(sender.writeBatch(big.data(), big.size()), (int) big.size());
+    sender.writeBatch(small2.data(), small2.size());
+    sender.flushBatch();
+
+    std::vector<char> buf(65536);
+    const string expected[] = { small0, small1, big, small2 };
+    for (const string& e : expected) {
+        const int len = receiver.recv(buf.data(), buf.size());
+        SG_CHECK_EQUAL(len, (int) e.size());
+        SG_CHECK_EQUAL(string(buf.data(), len), e);
+    }
+    SG_VERIFY(receiver.recv(buf.data(), buf.size()) < 0);
+
+    sender.close();
+    receiver.close();
+}
+
+void testFlushOnClose()
+{
+    SGSocketUDP receiver("127.0.0.1", PORT_STR), sender("127.0.0.1", PORT_STR);
+    SG_VERIFY(receiver.open(SG_IO_IN));
+    SG_VERIFY(sender.open(SG_IO_OUT));
+    receiver.setBlocking(false);
+
+    for (int i = 0; i < 3; ++i) {
+        const string p = payload(i);
+        sender.writeBatch(p.data(), p.size());
+    }
+    SG_VERIFY(receiver.readBatch() <= 0);
+
+    SG_VERIFY(sender.close());
+    SG_CHECK_EQUAL(receiver.readBatch(), 3);
+    checkBatch(receiver, 0, 3);
+
+    receiver.close();
+}
+
+void testRawSocketBatch()
+{
+    simgear::Socket receiver, sender;
+    SG_VERIFY(receiver.open(false));
+    SG_VERIFY(receiver.bind("127.0.0.1", PORT) != -1);
+    receiver.setBlocking(false);
+    SG_VERIFY(sender.open(false));
+    SG_VERIFY(sender.connect("127.0.0.1", PORT) != -1);
+
+    const int count = 5;
+    std::vector<string> payloads;
+    const void* out[count];
+    int outSizes[count];
+    for (int i = 0; i < count; ++i) {
+        payloads.push_back(payload(i));
+    }
+    for (int i = 0; i < count; ++i) {
+        out[i] = payloads[i].data();
+        outSizes[i] = payloads[i].size();
+    }
+    SG_CHECK_EQUAL(sender.sendBatch(out, outSizes, count), count);
+
+    char slots[count][64];
+    void* in[count];
+    int inSizes[count], lengths[count];
+    for (int i = 0; i < count; ++i) {
+        in[i] = slots[i];
+        inSizes[i] = sizeof(slots[i]);
+    }
+
+    // takes what fits, the rest stays queued for the next call
+    int received = 0;
+    while (received < count) {
+        const int n = receiver.recvBatch(in, inSizes, lengths, 2);
+        SG_VERIFY(n >= 1 && n <= 2);
+        for (int i = 0; i < n; ++i, ++received) {
+            SG_CHECK_EQUAL(lengths[i], (int) payloads[received].size());
+            SG_CHECK_EQUAL(string(slots[i], lengths[i]), payloads[received]);
+        }
+    }
+    SG_VERIFY(receiver.recvBatch(in, inSizes, lengths, count) < 0);
+    SG_CHECK_EQUAL(sender.sendBatch(out, outSizes, 0), 0);
+
+    sender.close();
+    receiver.close();
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    sglog().setLogLevels(SG_ALL, SG_ALERT);
+    simgear::Socket::initSockets();
+
+    testPartialBatch();
+    testAutomaticFlush();
+    testOversize();
+    testFlushOnClose();
+    testRawSocketBatch();
+
+    cout << "all tests passed" << endl;
+    return EXIT_SUCCESS;
+}
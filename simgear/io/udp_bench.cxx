@@ -0,0 +1,130 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <iostream>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/sg_socket_udp.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Compares per-datagram read()/write() with readBatch()/writeBatch() on
+// the loopback interface. Sender and receiver run in lockstep, one burst
+// at a time, so the socket buffer never overflows and nothing is dropped.
+
+namespace {
+
+const int BURST = SG_IO_UDP_BATCH_SIZE;
+
+bool openPair(SGSocketUDP& receiver, SGSocketUDP& sender)
+{
+    if (!receiver.open(SG_IO_IN) || !sender.open(SG_IO_OUT)) {
+        cerr << "failed to open loopback sockets" << endl;
+        return false;
+    }
+    receiver.setBlocking(false);
+    return true;
+}
+
+int runSingle(const std::string& port, int packets, int size)
+{
+    SGSocketUDP receiver("127.0.0.1", port), sender("127.0.0.1", port);
+    if (!openPair(receiver, sender)) {
+        return -1;
+    }
+
+    std::string payload(size, 'x');
+    char buf[SG_IO_MAX_MSG_SIZE];
+    int received = 0;
+    for (int sent = 0; sent < packets; sent += BURST) {
+        for (int i = 0; i < BURST; ++i) {
+            sender.write(payload.data(), size);
+        }
+        for (int i = 0; i < BURST; ++i) {
+            if (receiver.read(buf, sizeof(buf)) == size) {
+                ++received;
+            }
+        }
+    }
+    return received;
+}
+
+int runBatch(const std::string& port, int packets, int size)
+{
+    SGSocketUDP receiver("127.0.0.1", port), sender("127.0.0.1", port);
+    if (!openPair(receiver, sender)) {
+        return -1;
+    }
+
+    std::string payload(size, 'x');
+    int received = 0;
+    for (int sent = 0; sent < packets; sent += BURST) {
+        for (int i = 0; i < BURST; ++i) {
+            sender.writeBatch(payload.data(), size);
+        }
+        sender.flushBatch();
+
+        for (int pending = BURST; pending > 0;) {
+            int count = receiver.readBatch();
+            if (count <= 0) {
+                break;
+            }
+            for (int i = 0; i < count; ++i) {
+                if (receiver.getBatchLength(i) == size) {
+                    ++received;
+                }
+            }
+            pending -= count;
+        }
+    }
+    return received;
+}
+
+void report(const char* name, const SGTimeStamp& start, int packets, int received)
+{
+    double usec = (SGTimeStamp::now() - start).toUSecs();
+    cout << name << ": " << received << "/" << packets << " datagrams in "
+         << usec / 1000.0 << " ms, "
+         << (usec > 0 ? received / usec : 0.0) << " M datagrams/s" << endl;
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc > 4) {
+        cerr << "Usage: " << argv[0] << " [packets [size [port]]]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    int packets = (argc > 1) ? atoi(argv[1]) : 200000;
+    int size = (argc > 2) ? atoi(argv[2]) : 200;
+    std::string port = (argc > 3) ? argv[3] : "5599";
+    if (packets <= 0 || size <= 0 || size >= SG_IO_MAX_MSG_SIZE) {
+        cerr << "bad packet count or size" << endl;
+        return EXIT_FAILURE;
+    }
+
+    sglog().setLogLevels(SG_ALL, SG_ALERT);
+
+    SGTimeStamp start = SGTimeStamp::now();
+    int received = runSingle(port, packets, size);
+    if (received < 0) {
+        return EXIT_FAILURE;
+    }
+    report("read/write", start, packets, received);
+
+    start = SGTimeStamp::now();
+    received = runBatch(port, packets, size);
+    if (received < 0) {
+        return EXIT_FAILURE;
+    }
+    report("readBatch/writeBatch", start, packets, received);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+// Read-only memory mapped files
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+#include <simgear/compiler.h>
+
+#include <simgear/misc/sg_mmap.hxx>
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#else
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include <simgear/debug/logstream.hxx>
+
+namespace simgear
+{
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const SGPath& path)
+{
+    open(path);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const SGPath& path)
+{
+    close();
+
+    const std::wstring wpath = path.wstr();
+    HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        SG_LOG(SG_IO, SG_WARN, "MappedFile: can't open " << path);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        SG_LOG(SG_IO, SG_WARN, "MappedFile: can't get size of " << path);
+        CloseHandle(file);
+        return false;
+    }
+
+    _file = file;
+    _size = static_cast<size_t>(size.QuadPart);
+    _open = true;
+    if (_size == 0)
+        return true;
+
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        SG_LOG(SG_IO, SG_WARN, "MappedFile: can't map " << path);
+        close();
+        return false;
+    }
+
+    _mapping = mapping;
+    _data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!_data) {
+        SG_LOG(SG_IO, SG_WARN, "MappedFile: can't map " << path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data)
+        UnmapViewOfFile(_data);
+    if (_mapping)
+        CloseHandle(static_cast<HANDLE>(_mapping));
+    if (_file)
+        CloseHandle(static_cast<HANDLE>(_file));
+
+    _data = nullptr;
+    _mapping = nullptr;
+    _file = nullptr;
+    _size = 0;
+    _open = false;
+}
+
+#else
+
+bool MappedFile::open(const SGPath& path)
+{
+    close();
+
+    const std::string localPath = path.local8BitStr();
+    int fd = ::open(localPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        SG_LOG(SG_IO, SG_WARN, "MappedFile: can't open " << path << ": "
+               << strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        SG_LOG(SG_IO, SG_WARN, "MappedFile: can't stat " << path << ": "
+               << strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    _size = static_cast<size_t>(st.st_size);
+    if (_size > 0) {
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            SG_LOG(SG_IO, SG_WARN, "MappedFile: can't map " << path << ": "
+                   << strerror(errno));
+            ::close(fd);
+            _size = 0;
+            return false;
+        }
+        _data = static_cast<const char*>(data);
+    }
+
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    _open = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data)
+        munmap(const_cast<char*>(_data), _size);
+
+    _data = nullptr;
+    _size = 0;
+    _open = false;
+}
+
+#endif
+
+} // of namespace simgear
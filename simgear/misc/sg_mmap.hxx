@@ -0,0 +1,68 @@
+// Read-only memory mapped files
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _SG_MMAP_HXX
+#define _SG_MMAP_HXX
+
+#include <cstddef>
+
+#include <simgear/misc/sg_path.hxx>
+
+namespace simgear
+{
+
+/**
+ * A file mapped read-only into memory.
+ *
+ * The mapping stays valid until close() is called or the object is
+ * destroyed. Empty files can be opened, but data() is nullptr for them.
+ */
+class MappedFile
+{
+public:
+    MappedFile();
+    explicit MappedFile(const SGPath& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Map the given file, closing any previous mapping. Returns false (and
+     * logs the reason) if the file can't be opened or mapped.
+     */
+    bool open(const SGPath& path);
+
+    void close();
+
+    bool isOpen() const { return _open; }
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    bool _open = false;
+    const char* _data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+};
+
+} // of namespace simgear
+
+#endif // _SG_MMAP_HXX
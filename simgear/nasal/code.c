@@ -293,7 +293,7 @@ static void setupArgs(naContext ctx, struct Frame* f, naRef* args, int nargs)
         naRef argv = naNewVector(ctx);
         naVec_setsize(ctx, argv, nargs > 0 ? nargs : 0);
         for(i=0; i<nargs; i++)
-            PTR(argv).vec->rec->array[i] = *args++;
+            naVec_set(argv, i, *args++);
         naiHash_newsym(PTR(f->locals).hash, &c->constants[c->restArgSym], &argv);
     }
 }
@@ -390,6 +390,8 @@ static naRef evalCat(naContext ctx, naRef l, naRef r)
 static naRef bindFunction(naContext ctx, struct Frame* f, naRef code)
 {
     naRef result = naNewFunc(ctx, code);
+    GC_BARRIER(f->locals);
+    GC_BARRIER(f->func);
     PTR(result).func->namespace = f->locals;
     PTR(result).func->next = f->func;
     return result;
@@ -413,16 +415,48 @@ static naRef getLocal2(naContext ctx, struct Frame* f, naRef sym)
     return result;
 }
 
-static void getLocal(naContext ctx, struct Frame* f, naRef* sym, naRef* out)
+// Lookup caches: every OP_LOCAL and OP_MEMBER instruction remembers
+// the hash entry its last lookup ended in (see struct naLookupCache).
+// They are not locked, so they are only used while a single thread
+// runs Nasal code.
+static int lookupCaches = 1;
+
+void naSetLookupCaches(int enable)
 {
-    struct naFunc* func;
+    lookupCaches = enable;
+}
+
+#define USE_CACHES() (lookupCaches && globals->nThreads <= 1)
+
+static void getLocal(naContext ctx, struct Frame* f, naRef* sym, naRef* out,
+                     struct naLookupCache* lc)
+{
+    struct naFunc *func, *ffunc;
     struct naStr* str = PTR(*sym).str;
+    int ent, cache;
     if(naiHash_sym(PTR(f->locals).hash, str, out))
         return;
-    func = PTR(f->func).func;
+    func = ffunc = PTR(f->func).func;
+    if((cache = USE_CACHES())) {
+        if(lc->epoch == nasal_cache_epoch && lc->func == ffunc
+           && naiHash_entget(lc->holder, lc->ent, *sym, out))
+            return;
+        lc->epoch = 0;
+    }
     while(func && PTR(func->namespace).hash) {
-        if(naiHash_sym(PTR(func->namespace).hash, str, out))
+        struct naHash* ns = PTR(func->namespace).hash;
+        if(cache) ns->cached |= CACHED_CHAIN;
+        if((ent = naiHash_symentry(ns, str)) >= 0) {
+            naiHash_entget(ns, ent, *sym, out);
+            if(cache) {
+                ffunc->cached |= CACHED_KEY;
+                lc->func = ffunc;
+                lc->holder = ns;
+                lc->ent = ent;
+                lc->epoch = nasal_cache_epoch;
+            }
             return;
+        }
         func = PTR(func->next).func;
     }
     // Now do it again using the more general naHash_get().  This will
@@ -496,6 +530,94 @@ static void getMember(naContext ctx, naRef obj, naRef fld,
     if(err[0]) naRuntimeError(ctx, err);
 }
 
+// The first parent of a receiver, looking for its parents at entry
+// *pent first
+static struct naHash* firstParent(struct naHash* h, int* pent)
+{
+    naRef p;
+    struct VecRec* pv;
+    if(!naiHash_entget(h, *pent, globals->parentsRef, &p)) {
+        if((*pent = naiHash_entry(h, globals->parentsRef)) < 0) return 0;
+        naiHash_entget(h, *pent, globals->parentsRef, &p);
+    }
+    if(!IS_VEC(p) || !(pv = PTR(p).vec->rec) || !pv->size) return 0;
+    return IS_HASH(pv->array[0]) ? PTR(pv->array[0]).hash : 0;
+}
+
+// As getMember_r(), but finds the hash holding the member and flags
+// everything searched on the way for the lookup caches.  Returns 1 if
+// found, 0 if not, and -1 to give up on anything getMember_r() would
+// have to report or ask a ghost about.
+static int findMember(struct naHash* h, naRef fld, struct naHash** holder,
+                      int* ent, int count)
+{
+    int i, found;
+    naRef p;
+    struct VecRec* pv;
+    if(--count < 0) return -1;
+    h->cached |= CACHED_CHAIN;
+    if((*ent = naiHash_entry(h, fld)) >= 0) {
+        *holder = h;
+        return 1;
+    }
+    if((i = naiHash_entry(h, globals->parentsRef)) < 0) return 0;
+    naiHash_entget(h, i, globals->parentsRef, &p);
+    if(!IS_VEC(p)) return -1;
+    PTR(p).vec->cached |= CACHED_CHAIN;
+    pv = PTR(p).vec->rec;
+    for(i=0; pv && i<pv->size; i++) {
+        if(!IS_HASH(pv->array[i])) return -1;
+        found = findMember(PTR(pv->array[i]).hash, fld, holder, ent, count);
+        if(found) return found;
+    }
+    return 0;
+}
+
+static int cachedMember(struct naLookupCache* lc, struct naHash* h,
+                        naRef fld, naRef* out)
+{
+    if(!lc->holder)
+        return 0;
+    if(lc->pent < 0)
+        return naiHash_entget(h, lc->ent, fld, out);
+    if(lc->epoch != nasal_cache_epoch || naiHash_entry(h, fld) >= 0
+       || firstParent(h, &lc->pent) != lc->parent)
+        return 0;
+    return naiHash_entget(lc->holder, lc->ent, fld, out);
+}
+
+// OP_MEMBER: getMember() through the lookup cache of the instruction.
+// Only members inherited through the first parent are cached.
+static void getCachedMember(naContext ctx, naRef obj, naRef fld,
+                            naRef* result, struct naLookupCache* lc)
+{
+    struct naHash *h, *parent = 0, *holder = 0;
+    int ent, pent = -1;
+    if(!IS_HASH(obj) || !USE_CACHES()) {
+        getMember(ctx, obj, fld, result, 64);
+        return;
+    }
+    h = PTR(obj).hash;
+    if(cachedMember(lc, h, fld, result))
+        return;
+    lc->holder = 0;
+    if((ent = naiHash_entry(h, fld)) >= 0) {
+        holder = h;
+    } else if(!(parent = firstParent(h, &pent))
+              || findMember(parent, fld, &holder, &ent, 63) != 1) {
+        getMember(ctx, obj, fld, result, 64);
+        return;
+    }
+    naiHash_entget(holder, ent, fld, result);
+    lc->holder = holder;
+    lc->ent = ent;
+    lc->pent = pent;
+    if(holder != h) {
+        lc->parent = parent;
+        lc->epoch = nasal_cache_epoch;
+    }
+}
+
 static void setMember(naContext ctx, naRef obj, naRef fld, naRef value)
 {
     if (IS_GHOST(obj)) {
@@ -575,12 +697,105 @@ static void evalSlice2(naContext ctx, naRef src, naRef dst,
 #define STK(n) (ctx->opStack[ctx->opTop-(n)])
 #define SETFRAME(F) f = (F); cd = PTR(PTR(f->func).func->code).code;
 #define FIXFRAME() SETFRAME(&(ctx->fStack[ctx->fTop-1]))
+// With GCC and clang, every instruction jumps straight on to the next
+// one through a table of label addresses ("threaded" dispatch), which
+// branch predictors handle much better than all instructions going
+// back through the single indirect jump of the switch.
+#if defined(__GNUC__) && !defined(INTERPRETER_DUMP) \
+    && !defined(NASAL_NO_THREADED_DISPATCH)
+# define THREADED_DISPATCH
+#endif
+
+#if defined(THREADED_DISPATCH)
+# define DISPATCH(op) goto *dispatch[(op) < NUM_OPCODES ? (op) : NUM_OPCODES];
+# define CASE(op) L_##op
+# define DEFAULT L_default
+# define NEXT do { ctx->ntemps = 0; op = BYTECODE(cd)[f->ip++]; \
+                   DISPATCH(op) } while(0)
+#else
+# define DISPATCH(op) switch(op)
+# define CASE(op) case op
+# define DEFAULT default
+# define NEXT break
+#endif
+
 static naRef run(naContext ctx)
 {
     struct Frame* f;
     struct naCode* cd;
     int op, arg;
     naRef a, b;
+#if defined(THREADED_DISPATCH)
+    static void* dispatch[NUM_OPCODES+1] = {
+        [OP_NOT] = &&L_OP_NOT,
+        [OP_MUL] = &&L_OP_MUL,
+        [OP_PLUS] = &&L_OP_PLUS,
+        [OP_MINUS] = &&L_OP_MINUS,
+        [OP_DIV] = &&L_OP_DIV,
+        [OP_NEG] = &&L_OP_NEG,
+        [OP_CAT] = &&L_OP_CAT,
+        [OP_LT] = &&L_OP_LT,
+        [OP_LTE] = &&L_OP_LTE,
+        [OP_GT] = &&L_OP_GT,
+        [OP_GTE] = &&L_OP_GTE,
+        [OP_EQ] = &&L_OP_EQ,
+        [OP_NEQ] = &&L_OP_NEQ,
+        [OP_EACH] = &&L_OP_EACH,
+        [OP_JMP] = &&L_OP_JMP,
+        [OP_JMPLOOP] = &&L_OP_JMPLOOP,
+        [OP_JIFNOTPOP] = &&L_OP_JIFNOTPOP,
+        [OP_JIFEND] = &&L_OP_JIFEND,
+        [OP_FCALL] = &&L_OP_FCALL,
+        [OP_MCALL] = &&L_OP_MCALL,
+        [OP_RETURN] = &&L_OP_RETURN,
+        [OP_PUSHCONST] = &&L_OP_PUSHCONST,
+        [OP_PUSHONE] = &&L_OP_PUSHONE,
+        [OP_PUSHZERO] = &&L_OP_PUSHZERO,
+        [OP_PUSHNIL] = &&L_OP_PUSHNIL,
+        [OP_POP] = &&L_OP_POP,
+        [OP_DUP] = &&L_OP_DUP,
+        [OP_XCHG] = &&L_OP_XCHG,
+        [OP_INSERT] = &&L_OP_INSERT,
+        [OP_EXTRACT] = &&L_OP_EXTRACT,
+        [OP_MEMBER] = &&L_OP_MEMBER,
+        [OP_SETMEMBER] = &&L_OP_SETMEMBER,
+        [OP_LOCAL] = &&L_OP_LOCAL,
+        [OP_SETLOCAL] = &&L_OP_SETLOCAL,
+        [OP_NEWVEC] = &&L_OP_NEWVEC,
+        [OP_VAPPEND] = &&L_OP_VAPPEND,
+        [OP_NEWHASH] = &&L_OP_NEWHASH,
+        [OP_HAPPEND] = &&L_OP_HAPPEND,
+        [OP_MARK] = &&L_OP_MARK,
+        [OP_UNMARK] = &&L_OP_UNMARK,
+        [OP_BREAK] = &&L_OP_BREAK,
+        [OP_SETSYM] = &&L_OP_SETSYM,
+        [OP_DUP2] = &&L_OP_DUP2,
+        [OP_INDEX] = &&L_OP_INDEX,
+        [OP_BREAK2] = &&L_OP_BREAK2,
+        [OP_PUSHEND] = &&L_OP_PUSHEND,
+        [OP_JIFTRUE] = &&L_OP_JIFTRUE,
+        [OP_JIFNOT] = &&L_OP_JIFNOT,
+        [OP_FCALLH] = &&L_OP_FCALLH,
+        [OP_MCALLH] = &&L_OP_MCALLH,
+        [OP_XCHG2] = &&L_OP_XCHG2,
+        [OP_UNPACK] = &&L_OP_UNPACK,
+        [OP_SLICE] = &&L_OP_SLICE,
+        [OP_SLICE2] = &&L_OP_SLICE2,
+        [OP_BIT_AND] = &&L_OP_BIT_AND,
+        [OP_BIT_OR] = &&L_OP_BIT_OR,
+        [OP_BIT_XOR] = &&L_OP_BIT_XOR,
+        [OP_BIT_NEG] = &&L_OP_BIT_NEG,
+        [OP_JIFNOTLT] = &&L_OP_JIFNOTLT,
+        [OP_JIFNOTLTE] = &&L_OP_JIFNOTLTE,
+        [OP_JIFNOTGT] = &&L_OP_JIFNOTGT,
+        [OP_JIFNOTGTE] = &&L_OP_JIFNOTGTE,
+        [OP_JIFNOTEQ] = &&L_OP_JIFNOTEQ,
+        [OP_JIFNOTNEQ] = &&L_OP_JIFNOTNEQ,
+        [OP_LOCALMEMBER] = &&L_OP_LOCALMEMBER,
+        [OP_ADDLOCAL] = &&L_OP_ADDLOCAL,
+        [NUM_OPCODES] = &&L_default
+    };
+#endif
 
     ctx->dieArg = naNil();
     ctx->error[0] = 0;
@@ -591,12 +806,12 @@ static naRef run(naContext ctx)
         op = BYTECODE(cd)[f->ip++];
         DBG(printf("Stack Depth: %d\n", ctx->opTop));
         DBG(printOpDEBUG(f->ip-1, op));
-        switch(op) {
-        case OP_POP:  ctx->opTop--; break;
-        case OP_DUP:  PUSH(STK(1)); break;
-        case OP_DUP2: PUSH(STK(2)); PUSH(STK(2)); break;
-        case OP_XCHG:  a=STK(1); STK(1)=STK(2); STK(2)=a; break;
-        case OP_XCHG2: a=STK(1); STK(1)=STK(2); STK(2)=STK(3); STK(3)=a; break;
+        DISPATCH(op) {
+        CASE(OP_POP):  ctx->opTop--; NEXT;
+        CASE(OP_DUP):  PUSH(STK(1)); NEXT;
+        CASE(OP_DUP2): PUSH(STK(2)); PUSH(STK(2)); NEXT;
+        CASE(OP_XCHG):  a=STK(1); STK(1)=STK(2); STK(2)=a; NEXT;
+        CASE(OP_XCHG2): a=STK(1); STK(1)=STK(2); STK(2)=STK(3); STK(3)=a; NEXT;
 
 #define BINOP(expr) do { \
     double l = IS_NUM(STK(2)) ? STK(2).num : numify(ctx, STK(2)); \
@@ -604,146 +819,147 @@ static naRef run(naContext ctx)
     SETNUM(STK(2), expr);                                         \
     ctx->opTop--; } while(0)
 
-        case OP_PLUS:  BINOP(l + r);         break;
-        case OP_MINUS: BINOP(l - r);         break;
-        case OP_MUL:   BINOP(l * r);         break;
-        case OP_DIV:   BINOP(l / r);         break;
-        case OP_LT:    BINOP(l <  r ? 1 : 0); break;
-        case OP_LTE:   BINOP(l <= r ? 1 : 0); break;
-        case OP_GT:    BINOP(l >  r ? 1 : 0); break;
-        case OP_GTE:   BINOP(l >= r ? 1 : 0); break;
-        case OP_BIT_AND: BINOP((int)l & (int)r); break;
-        case OP_BIT_OR:  BINOP((int)l | (int)r); break;
-        case OP_BIT_XOR: BINOP((int)l ^ (int)r); break;
+        CASE(OP_PLUS):  BINOP(l + r);         NEXT;
+        CASE(OP_MINUS): BINOP(l - r);         NEXT;
+        CASE(OP_MUL):   BINOP(l * r);         NEXT;
+        CASE(OP_DIV):   BINOP(l / r);         NEXT;
+        CASE(OP_LT):    BINOP(l <  r ? 1 : 0); NEXT;
+        CASE(OP_LTE):   BINOP(l <= r ? 1 : 0); NEXT;
+        CASE(OP_GT):    BINOP(l >  r ? 1 : 0); NEXT;
+        CASE(OP_GTE):   BINOP(l >= r ? 1 : 0); NEXT;
+        CASE(OP_BIT_AND): BINOP((int)l & (int)r); NEXT;
+        CASE(OP_BIT_OR):  BINOP((int)l | (int)r); NEXT;
+        CASE(OP_BIT_XOR): BINOP((int)l ^ (int)r); NEXT;
 #undef BINOP
 
-        case OP_EQ: case OP_NEQ:
+        CASE(OP_EQ): CASE(OP_NEQ):
             STK(2) = evalEquality(op, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_CAT:
+            NEXT;
+        CASE(OP_CAT):
             STK(2) = evalCat(ctx, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_NEG:
+            NEXT;
+        CASE(OP_NEG):
             STK(1) = naNum(-numify(ctx, STK(1)));
-            break;
-        case OP_BIT_NEG:
+            NEXT;
+        CASE(OP_BIT_NEG):
             STK(1) = naNum(~(int)numify(ctx, STK(1)));
-            break;
-        case OP_NOT:
+            NEXT;
+        CASE(OP_NOT):
             STK(1) = naNum(boolify(ctx, STK(1)) ? 0 : 1);
-            break;
-        case OP_PUSHCONST:
+            NEXT;
+        CASE(OP_PUSHCONST):
             a = CONSTARG();
             if(IS_CODE(a)) a = bindFunction(ctx, f, a);
             PUSH(a);
-            break;
-        case OP_PUSHONE:
+            NEXT;
+        CASE(OP_PUSHONE):
             PUSH(naNum(1));
-            break;
-        case OP_PUSHZERO:
+            NEXT;
+        CASE(OP_PUSHZERO):
             PUSH(naNum(0));
-            break;
-        case OP_PUSHNIL:
+            NEXT;
+        CASE(OP_PUSHNIL):
             PUSH(naNil());
-            break;
-        case OP_PUSHEND:
+            NEXT;
+        CASE(OP_PUSHEND):
             PUSH(endToken());
-            break;
-        case OP_NEWVEC:
+            NEXT;
+        CASE(OP_NEWVEC):
             PUSH(naNewVector(ctx));
-            break;
-        case OP_VAPPEND:
+            NEXT;
+        CASE(OP_VAPPEND):
             naVec_append(STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_NEWHASH:
+            NEXT;
+        CASE(OP_NEWHASH):
             PUSH(naNewHash(ctx));
-            break;
-        case OP_HAPPEND:
+            NEXT;
+        CASE(OP_HAPPEND):
             naHash_set(STK(3), STK(2), STK(1));
             ctx->opTop -= 2;
-            break;
-        case OP_LOCAL:
+            NEXT;
+        CASE(OP_LOCAL):
             a = CONSTARG();
-            getLocal(ctx, f, &a, &b);
+            getLocal(ctx, f, &a, &b, &cd->caches[ARG()]);
             PUSH(b);
-            break;
-        case OP_SETSYM:
+            NEXT;
+        CASE(OP_SETSYM):
             setSymbol(f, STK(1), STK(2));
             ctx->opTop--;
-            break;
-        case OP_SETLOCAL:
+            NEXT;
+        CASE(OP_SETLOCAL):
             naHash_set(f->locals, STK(1), STK(2));
             ctx->opTop--;
-            break;
-        case OP_MEMBER:
-            getMember(ctx, STK(1), CONSTARG(), &STK(1), 64);
-            break;
-        case OP_SETMEMBER:
+            NEXT;
+        CASE(OP_MEMBER):
+            a = CONSTARG();
+            getCachedMember(ctx, STK(1), a, &STK(1), &cd->caches[ARG()]);
+            NEXT;
+        CASE(OP_SETMEMBER):
             setMember(ctx, STK(2), STK(1), STK(3));
-            break;
-        case OP_INSERT:
+            NEXT;
+        CASE(OP_INSERT):
             containerSet(ctx, STK(2), STK(1), STK(3));
             ctx->opTop -= 2;
-            break;
-        case OP_EXTRACT:
+            NEXT;
+        CASE(OP_EXTRACT):
             STK(2) = containerGet(ctx, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_SLICE:
+            NEXT;
+        CASE(OP_SLICE):
             evalSlice(ctx, STK(3), STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_SLICE2:
+            NEXT;
+        CASE(OP_SLICE2):
             evalSlice2(ctx, STK(4), STK(3), STK(2), STK(1));
             ctx->opTop -= 2;
-            break;
-        case OP_JMPLOOP:
+            NEXT;
+        CASE(OP_JMPLOOP):
             // Identical to JMP, except for locking
             naCheckBottleneck();
             f->ip = BYTECODE(cd)[f->ip];
             DBG(printf("   [Jump to: %d]\n", f->ip));
-            break;
-        case OP_JMP:
+            NEXT;
+        CASE(OP_JMP):
             f->ip = BYTECODE(cd)[f->ip];
             DBG(printf("   [Jump to: %d]\n", f->ip));
-            break;
-        case OP_JIFEND:
+            NEXT;
+        CASE(OP_JIFEND):
             arg = ARG();
             if(IS_END(STK(1))) {
                 ctx->opTop--; // Pops **ONLY** if it's nil!
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFTRUE:
+            NEXT;
+        CASE(OP_JIFTRUE):
             arg = ARG();
             if(boolify(ctx, STK(1))) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFNOT:
+            NEXT;
+        CASE(OP_JIFNOT):
             arg = ARG();
             if(!boolify(ctx, STK(1))) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFNOTPOP:
+            NEXT;
+        CASE(OP_JIFNOTPOP):
             arg = ARG();
             if(!boolify(ctx, POP())) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_FCALL:  SETFRAME(setupFuncall(ctx, ARG(), 0, 0)); break;
-        case OP_MCALL:  SETFRAME(setupFuncall(ctx, ARG(), 1, 0)); break;
-        case OP_FCALLH: SETFRAME(setupFuncall(ctx,     1, 0, 1)); break;
-        case OP_MCALLH: SETFRAME(setupFuncall(ctx,     1, 1, 1)); break;
-        case OP_RETURN:
+            NEXT;
+        CASE(OP_FCALL):  SETFRAME(setupFuncall(ctx, ARG(), 0, 0)); NEXT;
+        CASE(OP_MCALL):  SETFRAME(setupFuncall(ctx, ARG(), 1, 0)); NEXT;
+        CASE(OP_FCALLH): SETFRAME(setupFuncall(ctx,     1, 0, 1)); NEXT;
+        CASE(OP_MCALLH): SETFRAME(setupFuncall(ctx,     1, 1, 1)); NEXT;
+        CASE(OP_RETURN):
             a = STK(1);
             ctx->dieArg = naNil();
             if(ctx->callChild) naFreeContext(ctx->callChild);
@@ -751,31 +967,65 @@ static naRef run(naContext ctx)
             ctx->opTop = f->bp + 1; // restore the correct opstack frame!
             STK(1) = a;
             FIXFRAME();
-            break;
-        case OP_EACH:
+            NEXT;
+        CASE(OP_EACH):
             evalEach(ctx, 0);
-            break;
-        case OP_INDEX:
+            NEXT;
+        CASE(OP_INDEX):
             evalEach(ctx, 1);
-            break;
-        case OP_MARK: // save stack state (e.g. "setjmp")
+            NEXT;
+        CASE(OP_MARK): // save stack state (e.g. "setjmp")
             if(ctx->markTop >= MAX_MARK_DEPTH)
                 ERR(ctx, "mark stack overflow");
             ctx->markStack[ctx->markTop++] = ctx->opTop;
-            break;
-        case OP_UNMARK: // pop stack state set by mark
+            NEXT;
+        CASE(OP_UNMARK): // pop stack state set by mark
             ctx->markTop--;
-            break;
-        case OP_BREAK: // restore stack state (FOLLOW WITH JMP!)
+            NEXT;
+        CASE(OP_BREAK): // restore stack state (FOLLOW WITH JMP!)
             ctx->opTop = ctx->markStack[ctx->markTop-1];
-            break;
-        case OP_BREAK2: // same, but also pop the mark stack
+            NEXT;
+        CASE(OP_BREAK2): // same, but also pop the mark stack
             ctx->opTop = ctx->markStack[--ctx->markTop];
-            break;
-        case OP_UNPACK:
+            NEXT;
+        CASE(OP_UNPACK):
             evalUnpack(ctx, ARG());
-            break;
-        default:
+            NEXT;
+        CASE(OP_LOCALMEMBER):
+            a = CONSTARG();
+            getLocal(ctx, f, &a, &b, &cd->caches[ARG()]);
+            PUSH(b);
+            a = CONSTARG();
+            getCachedMember(ctx, STK(1), a, &STK(1), &cd->caches[ARG()]);
+            NEXT;
+        CASE(OP_ADDLOCAL):
+            a = CONSTARG();
+            getLocal(ctx, f, &a, &b, &cd->caches[ARG()]);
+            b = naNum((IS_NUM(b) ? b.num : numify(ctx, b)) + CONSTARG().num);
+            setSymbol(f, a, b);
+            PUSH(b);
+            NEXT;
+
+#define CMPJUMP(expr) do { \
+    double l = IS_NUM(STK(2)) ? STK(2).num : numify(ctx, STK(2)); \
+    double r = IS_NUM(STK(1)) ? STK(1).num : numify(ctx, STK(1)); \
+    ctx->opTop -= 2;                                              \
+    arg = ARG();                                                  \
+    if(!(expr)) f->ip = arg; } while(0)
+
+        CASE(OP_JIFNOTLT):  CMPJUMP(l <  r); NEXT;
+        CASE(OP_JIFNOTLTE): CMPJUMP(l <= r); NEXT;
+        CASE(OP_JIFNOTGT):  CMPJUMP(l >  r); NEXT;
+        CASE(OP_JIFNOTGTE): CMPJUMP(l >= r); NEXT;
+#undef CMPJUMP
+
+        CASE(OP_JIFNOTEQ): CASE(OP_JIFNOTNEQ):
+            a = evalEquality(op == OP_JIFNOTEQ ? OP_EQ : OP_NEQ, STK(2), STK(1));
+            ctx->opTop -= 2;
+            arg = ARG();
+            if(a.num == 0) f->ip = arg;
+            NEXT;
+        DEFAULT:
             ERR(ctx, "BUG: bad opcode");
         }
         ctx->ntemps = 0; // reset GC temp vector
@@ -783,6 +1033,10 @@ static naRef run(naContext ctx)
     }
     return naNil(); // unreachable
 }
+#undef DISPATCH
+#undef CASE
+#undef DEFAULT
+#undef NEXT
 #undef POP
 #undef CONSTARG
 #undef STK
@@ -870,6 +1124,7 @@ char* naGetError(naContext ctx)
 naRef naBindFunction(naContext ctx, naRef code, naRef closure)
 {
     naRef func = naNewFunc(ctx, code);
+    GC_BARRIER(closure);
     PTR(func).func->namespace = closure;
     PTR(func).func->next = naNil();
     return func;
@@ -880,6 +1135,8 @@ naRef naBindToContext(naContext ctx, naRef code)
     naRef func = naNewFunc(ctx, code);
     if(ctx->fTop) {
         struct Frame* f = &ctx->fStack[ctx->fTop-1];
+        GC_BARRIER(f->locals);
+        GC_BARRIER(f->func);
         PTR(func).func->namespace = f->locals;
         PTR(func).func->next = f->func;
     }
@@ -921,6 +1178,7 @@ naRef naCall(naContext ctx, naRef func, int argc, naRef* args,
         locals = naNewHash(ctx);
     if(!IS_FUNC(func)) {
         func = naNewFunc(ctx, func);
+        GC_BARRIER(locals);
         PTR(func).func->namespace = locals;
     }
     if(!IS_NIL(obj))
@@ -18,6 +18,11 @@
 // collector synchronization.
 #define OBJ_CACHE_SZ 1
 
+// Version of the bytecode, for naSaveCode()/naLoadCode().  Bump it when
+// the meaning of an opcode or its operands changes (adding opcodes
+// changes NUM_OPCODES, which is checked as well).
+#define NASAL_BYTECODE_VERSION 1
+
 enum {    
     OP_NOT, OP_MUL, OP_PLUS, OP_MINUS, OP_DIV, OP_NEG, OP_CAT, OP_LT, OP_LTE,
     OP_GT, OP_GTE, OP_EQ, OP_NEQ, OP_EACH, OP_JMP, OP_JMPLOOP, OP_JIFNOTPOP,
@@ -27,7 +32,11 @@ enum {
     OP_NEWHASH, OP_HAPPEND, OP_MARK, OP_UNMARK, OP_BREAK, OP_SETSYM, OP_DUP2,
     OP_INDEX, OP_BREAK2, OP_PUSHEND, OP_JIFTRUE, OP_JIFNOT, OP_FCALLH,
     OP_MCALLH, OP_XCHG2, OP_UNPACK, OP_SLICE, OP_SLICE2, OP_BIT_AND, OP_BIT_OR,
-    OP_BIT_XOR, OP_BIT_NEG
+    OP_BIT_XOR, OP_BIT_NEG,
+    // Superinstructions, see codegen.c
+    OP_JIFNOTLT, OP_JIFNOTLTE, OP_JIFNOTGT, OP_JIFNOTGTE, OP_JIFNOTEQ,
+    OP_JIFNOTNEQ, OP_LOCALMEMBER, OP_ADDLOCAL,
+    NUM_OPCODES // must come last
 };
 
 struct Frame {
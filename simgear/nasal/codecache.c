@@ -0,0 +1,280 @@
+#include <string.h>
+
+#include "nasal.h"
+#include "code.h"
+
+/* Serialized code objects, for keeping compiled bytecode in a cache
+ * on disk.  The data starts with a header identifying the source text
+ * and the interpreter it was compiled for:
+ *
+ *   "NaBC", format version, opcode count, first line, source length,
+ *   source hash, data hash
+ *
+ * followed by the top level code object: its size fields, its
+ * constants and then its bytecode, argument and line tables as 16 bit
+ * words.  Constants are a tag byte and the value; function literals
+ * are nested code objects.  Integers are little endian, hashes are
+ * 64 bit FNV-1a. */
+
+#define MAGIC "NaBC"
+#define HEADER_SZ 32
+#define MAX_NESTING 256
+
+enum { CONST_NIL, CONST_NUM, CONST_STR, CONST_SYM, CONST_CODE };
+
+typedef unsigned long long u64;
+
+static u64 fnv1a(const unsigned char* data, int len)
+{
+    u64 h = 0xcbf29ce484222325ULL;
+    int i;
+    for(i=0; i<len; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+struct Writer {
+    unsigned char* buf;
+    int sz;
+    int pos;
+};
+
+static void putBytes(struct Writer* w, const void* data, int n)
+{
+    if(w->pos + n <= w->sz) memcpy(w->buf + w->pos, data, n);
+    w->pos += n;
+}
+
+static void put(struct Writer* w, u64 val, int n)
+{
+    unsigned char b[8];
+    int i;
+    for(i=0; i<n; i++) b[i] = (unsigned char)(val >> (8*i));
+    putBytes(w, b, n);
+}
+
+static void saveCode(struct Writer* w, struct naCode* c);
+
+static void saveConstant(struct Writer* w, naRef r)
+{
+    naRef sym;
+    if(IS_NUM(r)) {
+        u64 bits;
+        memcpy(&bits, &r.num, sizeof(bits));
+        put(w, CONST_NUM, 1);
+        put(w, bits, 8);
+    } else if(IS_STR(r)) {
+        // Symbols must come back as the interned string, local variable
+        // lookups compare them by identity
+        int interned = naHash_get(globals->symbols, r, &sym)
+            && IDENTICAL(r, sym);
+        put(w, interned ? CONST_SYM : CONST_STR, 1);
+        put(w, naStr_len(r), 4);
+        putBytes(w, naStr_data(r), naStr_len(r));
+    } else if(IS_CODE(r)) {
+        put(w, CONST_CODE, 1);
+        saveCode(w, PTR(r).code);
+    } else {
+        put(w, CONST_NIL, 1);
+    }
+}
+
+static void saveCode(struct Writer* w, struct naCode* c)
+{
+    int i, n = c->codesz + c->nArgs + 2*c->nOptArgs + c->nLines;
+    put(w, c->nArgs, 1);
+    put(w, c->nOptArgs, 1);
+    put(w, c->needArgVector, 1);
+    put(w, c->nConstants, 2);
+    put(w, c->codesz, 2);
+    put(w, c->restArgSym, 2);
+    put(w, c->nLines, 2);
+    put(w, c->nCaches, 2);
+    for(i=0; i<c->nConstants; i++)
+        saveConstant(w, c->constants[i]);
+    for(i=0; i<n; i++)
+        put(w, BYTECODE(c)[i], 2);
+}
+
+static void putHeader(struct Writer* w, int firstLine, const char* src,
+                      int srclen, u64 dataHash)
+{
+    putBytes(w, MAGIC, 4);
+    put(w, NASAL_BYTECODE_VERSION, 2);
+    put(w, NUM_OPCODES, 2);
+    put(w, (unsigned int)firstLine, 4);
+    put(w, (unsigned int)srclen, 4);
+    put(w, fnv1a((const unsigned char*)src, srclen), 8);
+    put(w, dataHash, 8);
+}
+
+int naSaveCode(naRef code, int firstLine, const char* src, int srclen,
+               char* buf, int bufsz)
+{
+    struct Writer w;
+    if(!IS_CODE(code)) return 0;
+    w.buf = (unsigned char*)buf;
+    w.sz = buf ? bufsz : 0;
+    w.pos = HEADER_SZ;
+    saveCode(&w, PTR(code).code);
+    if(w.pos <= w.sz) {
+        int sz = w.pos;
+        w.pos = 0;
+        putHeader(&w, firstLine, src, srclen,
+                  fnv1a(w.buf + HEADER_SZ, sz - HEADER_SZ));
+        w.pos = sz;
+    }
+    return w.pos;
+}
+
+struct Reader {
+    naContext ctx;
+    naRef srcFile;
+    const unsigned char* buf;
+    int len;
+    int pos;
+    int depth;
+    int bad;
+};
+
+static const unsigned char* getBytes(struct Reader* r, int n)
+{
+    const unsigned char* p = r->buf + r->pos;
+    if(r->bad || n < 0 || n > r->len - r->pos) {
+        r->bad = 1;
+        return 0;
+    }
+    r->pos += n;
+    return p;
+}
+
+static u64 get(struct Reader* r, int n)
+{
+    const unsigned char* b = getBytes(r, n);
+    u64 val = 0;
+    int i;
+    if(!b) return 0;
+    for(i=0; i<n; i++) val |= (u64)b[i] << (8*i);
+    return val;
+}
+
+static naRef loadCode(struct Reader* r);
+
+static naRef loadConstant(struct Reader* r)
+{
+    int type = (int)get(r, 1);
+    if(type == CONST_NUM) {
+        u64 bits = get(r, 8);
+        double num;
+        memcpy(&num, &bits, sizeof(num));
+        return naNum(num);
+    } else if(type == CONST_STR || type == CONST_SYM) {
+        naRef s, dummy;
+        int len = (int)get(r, 4);
+        const unsigned char* data = getBytes(r, len);
+        if(!data) return naNil();
+        s = naStr_fromdata(naNewString(r->ctx), (const char*)data, len);
+        naHash_get(globals->symbols, s, &dummy); // noop, make s immutable
+        return type == CONST_SYM ? naInternSymbol(s) : s;
+    } else if(type == CONST_CODE) {
+        return loadCode(r);
+    } else if(type != CONST_NIL) {
+        r->bad = 1;
+    }
+    return naNil();
+}
+
+static naRef loadCode(struct Reader* r)
+{
+    int i, n, nArgs, nOptArgs, needArgVector, nConstants, codesz;
+    int restArgSym, nLines, nCaches;
+    naRef consts, codeObj;
+    struct naCode* c;
+
+    nArgs = (int)get(r, 1);
+    nOptArgs = (int)get(r, 1);
+    needArgVector = (int)get(r, 1);
+    nConstants = (int)get(r, 2);
+    codesz = (int)get(r, 2);
+    restArgSym = (int)get(r, 2);
+    nLines = (int)get(r, 2);
+    nCaches = (int)get(r, 2);
+    if(nArgs > 31 || nOptArgs > 31 || needArgVector > 1
+       || restArgSym >= nConstants || ++r->depth > MAX_NESTING)
+        r->bad = 1;
+    if(r->bad) return naNil();
+
+    // Collect the constants first, like naCodeGen(): the code object
+    // must not be seen by the collector before its table is filled in.
+    consts = naNewVector(r->ctx);
+    for(i=0; i<nConstants && !r->bad; i++)
+        naVec_append(consts, loadConstant(r));
+    n = codesz + nArgs + 2*nOptArgs + nLines;
+    if(r->bad || n > (r->len - r->pos) / 2) {
+        r->bad = 1;
+        return naNil();
+    }
+
+    codeObj = naNewCode(r->ctx);
+    c = PTR(codeObj).code;
+    c->nArgs = nArgs;
+    c->nOptArgs = nOptArgs;
+    c->needArgVector = needArgVector;
+    c->nConstants = nConstants;
+    c->codesz = codesz;
+    c->restArgSym = restArgSym;
+    c->nLines = nLines;
+    GC_BARRIER(r->srcFile);
+    c->srcFile = r->srcFile;
+    c->constants = 0;
+    c->constants = naAlloc((int)(size_t)(LINEIPS(c)+c->nLines));
+    for(i=0; i<nConstants; i++) {
+        c->constants[i] = naVec_get(consts, i);
+        GC_BARRIER(c->constants[i]);
+    }
+    for(i=0; i<n; i++)
+        BYTECODE(c)[i] = (unsigned short)get(r, 2);
+
+    c->nCaches = nCaches;
+    c->caches = 0;
+    if(nCaches) {
+        int sz = nCaches * sizeof(struct naLookupCache);
+        c->caches = naAlloc(sz);
+        naBZero(c->caches, sz);
+    }
+    r->depth--;
+    return codeObj;
+}
+
+naRef naLoadCode(naContext ctx, naRef srcFile, int firstLine,
+                 const char* src, int srclen, const char* buf, int len)
+{
+    struct Reader r;
+    struct Writer w;
+    unsigned char header[HEADER_SZ];
+    naRef code;
+
+    if(!buf || len < HEADER_SZ) return naNil();
+    w.buf = header;
+    w.sz = HEADER_SZ;
+    w.pos = 0;
+    putHeader(&w, firstLine, src, srclen,
+              fnv1a((const unsigned char*)buf + HEADER_SZ, len - HEADER_SZ));
+    if(memcmp(header, buf, HEADER_SZ) != 0) return naNil();
+
+    // Protect from garbage collection
+    naTempSave(ctx, srcFile);
+
+    r.ctx = ctx;
+    r.srcFile = srcFile;
+    r.buf = (const unsigned char*)buf;
+    r.len = len;
+    r.pos = HEADER_SZ;
+    r.depth = 0;
+    r.bad = 0;
+    code = loadCode(&r);
+    if(r.bad || r.pos != len) return naNil();
+    return code;
+}
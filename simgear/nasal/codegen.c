@@ -10,9 +10,18 @@
 #define UNARY(tok)  (LEFT(tok) && LEFT(tok) == RIGHT(tok))
 #define BINARY(tok) (LEFT(tok) && RIGHT(tok) && LEFT(tok)->next == RIGHT(tok))
 
+// Fuse common instruction sequences into superinstructions
+// (OP_LOCALMEMBER, OP_ADDLOCAL and the OP_JIFNOTxx comparisons)
+#if defined(NASAL_NO_SUPERINSTRUCTIONS)
+# define SUPERINSTRUCTIONS 0
+#else
+# define SUPERINSTRUCTIONS 1
+#endif
+
 // Forward references for recursion
 static void genExpr(struct Parser* p, struct Token* t);
 static void genExprList(struct Parser* p, struct Token* t);
+static void lineEntry(struct Parser* p, struct Token* t);
 static naRef newLambda(struct Parser* p, struct Token* t);
 
 static void emit(struct Parser* p, int val)
@@ -33,6 +42,22 @@ static void emitImmediate(struct Parser* p, int val, int arg)
     emit(p, arg);
 }
 
+/* OP_MEMBER and OP_LOCAL (and the superinstructions doing the same)
+ * take a second operand, the index of their lookup cache in the code
+ * object. */
+static int newCache(struct Parser* p)
+{
+    if(p->cg->nCaches >= 0xffff)
+        naParseError(p, "too many symbol lookups in code block", 0);
+    return p->cg->nCaches++;
+}
+
+static void emitLookup(struct Parser* p, int op, int cidx)
+{
+    emitImmediate(p, op, cidx);
+    emit(p, newCache(p));
+}
+
 static void genBinOp(int op, struct Parser* p, struct Token* t)
 {
     if(!LEFT(t) || !RIGHT(t))
@@ -126,18 +151,37 @@ static int genLValue(struct Parser* p, struct Token* t, int* cidx)
     }
 }
 
+/* Superinstruction for "sym += <number>" and "sym -= <number>",
+ * instead of OP_PUSHCONST, OP_LOCAL, OP_PUSHCONST, OP_PLUS, OP_XCHG
+ * and OP_SETSYM */
+static int genAddLocal(int op, struct Parser* p, struct Token* t)
+{
+    struct Token *lv = LEFT(t), *rv = RIGHT(t);
+    if(!SUPERINSTRUCTIONS || (op != OP_PLUS && op != OP_MINUS)
+       || !lv || lv->type != TOK_SYMBOL
+       || !rv || rv->type != TOK_LITERAL || rv->str)
+        return 0;
+    if(op == OP_MINUS) rv->num *= -1; // Pre-negate constants
+    emitLookup(p, OP_ADDLOCAL, findConstantIndex(p, lv));
+    emit(p, findConstantIndex(p, rv));
+    return 1;
+}
+
 static void genEqOp(int op, struct Parser* p, struct Token* t)
 {
-    int cidx, n = 2, setop = genLValue(p, LEFT(t), &cidx);
+    int cidx, n = 2, setop;
+    if(genAddLocal(op, p, t))
+        return;
+    setop = genLValue(p, LEFT(t), &cidx);
     if(setop == OP_SETMEMBER) {
         emit(p, OP_DUP2);
         emit(p, OP_POP);
-        emitImmediate(p, OP_MEMBER, cidx);
+        emitLookup(p, OP_MEMBER, cidx);
     } else if(setop == OP_INSERT) {
         emit(p, OP_DUP2);
         emit(p, OP_EXTRACT);
     } else {
-        emitImmediate(p, OP_LOCAL, cidx);
+        emitLookup(p, OP_LOCAL, cidx);
         n = 1;
     }
     genExpr(p, RIGHT(t));
@@ -286,7 +330,7 @@ static void genFuncall(struct Parser* p, struct Token* t)
         method = 1;
         genExpr(p, LEFT(LEFT(t)));
         emit(p, OP_DUP);
-        emitImmediate(p, OP_MEMBER, findConstantIndex(p, RIGHT(LEFT(t))));
+        emitLookup(p, OP_MEMBER, findConstantIndex(p, RIGHT(LEFT(t))));
     } else {
         genExpr(p, LEFT(t));
     }
@@ -328,6 +372,30 @@ static void fixJumpTarget(struct Parser* p, int spot)
     p->cg->byteCode[spot] = p->cg->codesz;
 }
 
+/* Generates the test of a conditional, and a jump to be fixed up that
+ * is taken if it fails.  Comparisons are fused with the jump. */
+static int genTestJump(struct Parser* p, struct Token* t)
+{
+    int op;
+    switch((SUPERINSTRUCTIONS && t) ? t->type : TOK_TOP) {
+    case TOK_LT:  op = OP_JIFNOTLT;  break;
+    case TOK_LTE: op = OP_JIFNOTLTE; break;
+    case TOK_GT:  op = OP_JIFNOTGT;  break;
+    case TOK_GTE: op = OP_JIFNOTGTE; break;
+    case TOK_EQ:  op = OP_JIFNOTEQ;  break;
+    case TOK_NEQ: op = OP_JIFNOTNEQ; break;
+    default:
+        genExpr(p, t);
+        return emitJump(p, OP_JIFNOTPOP);
+    }
+    lineEntry(p, t);
+    if(!LEFT(t) || !RIGHT(t))
+        naParseError(p, "empty subexpression", t->line);
+    genExpr(p, LEFT(t));
+    genExpr(p, RIGHT(t));
+    return emitJump(p, op);
+}
+
 static void genShortCircuit(struct Parser* p, struct Token* t)
 {
     int end;
@@ -342,8 +410,7 @@ static void genShortCircuit(struct Parser* p, struct Token* t)
 static void genIf(struct Parser* p, struct Token* tif, struct Token* telse)
 {
     int jumpNext, jumpEnd;
-    genExpr(p, tif->children); // the test
-    jumpNext = emitJump(p, OP_JIFNOTPOP);
+    jumpNext = genTestJump(p, tif->children); // the test
     genExprList(p, tif->children->next->children); // the body
     jumpEnd = emitJump(p, OP_JMP);
     fixJumpTarget(p, jumpNext);
@@ -366,8 +433,7 @@ static void genQuestion(struct Parser* p, struct Token* t)
     int jumpNext, jumpEnd;
     if(!RIGHT(t) || RIGHT(t)->type != TOK_COLON)
         naParseError(p, "invalid ?: expression", t->line);
-    genExpr(p, LEFT(t)); // the test
-    jumpNext = emitJump(p, OP_JIFNOTPOP);
+    jumpNext = genTestJump(p, LEFT(t)); // the test
     genExpr(p, LEFT(RIGHT(t))); // the "if true" expr
     jumpEnd = emitJump(p, OP_JMP);
     fixJumpTarget(p, jumpNext);
@@ -386,13 +452,19 @@ static void genLoop(struct Parser* p, struct Token* body,
                     struct Token* update, struct Token* label,
                     int loopTop, int jumpEnd)
 {
-    int cont, jumpOverContinue;
-    
+    int cont, jumpOverContinue, jumpBreak = -1;
+    int test = p->cg->byteCode[jumpEnd-1];
+
     p->cg->loops[p->cg->loopTop-1].breakIP = jumpEnd-1;
 
     jumpOverContinue = emitJump(p, OP_JMP);
     p->cg->loops[p->cg->loopTop-1].contIP = p->cg->codesz;
     cont = emitJump(p, OP_JMP);
+    if(test != OP_JIFNOTPOP && test != OP_JIFEND) {
+        // A fused test can't take the end token pushed by break
+        p->cg->loops[p->cg->loopTop-1].breakIP = p->cg->codesz;
+        jumpBreak = emitJump(p, OP_JIFEND);
+    }
     fixJumpTarget(p, jumpOverContinue);
 
     genExprList(p, body);
@@ -401,6 +473,7 @@ static void genLoop(struct Parser* p, struct Token* body,
     if(update) { genExpr(p, update); emit(p, OP_POP); }
     emitImmediate(p, OP_JMPLOOP, loopTop);
     fixJumpTarget(p, jumpEnd);
+    if(jumpBreak >= 0) fixJumpTarget(p, jumpBreak);
     p->cg->loopTop--;
     emit(p, OP_UNMARK);
     emit(p, OP_PUSHNIL); // Leave something on the stack
@@ -413,8 +486,7 @@ static void genForWhile(struct Parser* p, struct Token* init,
     int loopTop, jumpEnd;
     if(init) { genExpr(p, init); emit(p, OP_POP); }
     loopTop = startLoop(p, label);
-    genExpr(p, test);
-    jumpEnd = emitJump(p, OP_JIFNOTPOP);
+    jumpEnd = genTestJump(p, test);
     genLoop(p, body, update, label, loopTop, jumpEnd);
 }
 
@@ -616,14 +688,19 @@ static void genExtract(struct Parser* p, struct Token* t)
     }
 }
 
-static void genExpr(struct Parser* p, struct Token* t)
+static void lineEntry(struct Parser* p, struct Token* t)
 {
-    int i;
-    if(!t) naParseError(p, "parse error", -1); // throw line -1...
-    p->errLine = t->line;                      // ...to use this one instead
+    p->errLine = t->line;
     if(t->line != p->cg->lastLine)
         newLineEntry(p, t->line);
     p->cg->lastLine = t->line;
+}
+
+static void genExpr(struct Parser* p, struct Token* t)
+{
+    int i;
+    if(!t) naParseError(p, "parse error", -1); // throw line -1...
+    lineEntry(p, t);                           // ...to use this one instead
     switch(t->type) {
     case TOK_TOP:      genExprList(p, LEFT(t)); break;
     case TOK_IF:       genIfElse(p, t);   break;
@@ -670,7 +747,7 @@ static void genExpr(struct Parser* p, struct Token* t)
         emit(p, OP_NOT);
         break;
     case TOK_SYMBOL:
-        emitImmediate(p, OP_LOCAL, findConstantIndex(p, t));
+        emitLookup(p, OP_LOCAL, findConstantIndex(p, t));
         break;
     case TOK_MINUS:
         if(BINARY(t)) {
@@ -703,10 +780,17 @@ static void genExpr(struct Parser* p, struct Token* t)
         emit(p, OP_BIT_NEG);
         break;
     case TOK_DOT:
-        genExpr(p, LEFT(t));
         if(!RIGHT(t) || RIGHT(t)->type != TOK_SYMBOL)
             naParseError(p, "object field not symbol", RIGHT(t)->line);
-        emitImmediate(p, OP_MEMBER, findConstantIndex(p, RIGHT(t)));
+        if(SUPERINSTRUCTIONS && LEFT(t) && LEFT(t)->type == TOK_SYMBOL
+           && LEFT(t)->line == t->line) {
+            // OP_LOCAL and OP_MEMBER in one
+            emitLookup(p, OP_LOCALMEMBER, findConstantIndex(p, LEFT(t)));
+            emitImmediate(p, findConstantIndex(p, RIGHT(t)), newCache(p));
+            break;
+        }
+        genExpr(p, LEFT(t));
+        emitLookup(p, OP_MEMBER, findConstantIndex(p, RIGHT(t)));
         break;
     case TOK_EMPTY: case TOK_NIL:
         emit(p, OP_PUSHNIL);
@@ -764,6 +848,7 @@ naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
     cg.byteCode = naParseAlloc(p, cg.codeAlloced *sizeof(unsigned short));
     cg.codesz = 0;
     cg.consts = naNewVector(p->context);
+    cg.nCaches = 0;
     cg.loopTop = 0;
     cg.lineIps = 0;
     cg.nLineIps = 0;
@@ -797,11 +882,14 @@ naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
     code->nConstants = naVec_size(cg.consts);
     code->codesz = cg.codesz;
     code->nLines = cg.nextLineIp;
+    GC_BARRIER(p->srcFile);
     code->srcFile = p->srcFile;
     code->constants = 0;
     code->constants = naAlloc((int)(size_t)(LINEIPS(code)+code->nLines));
-    for(i=0; i<code->nConstants; i++)
+    for(i=0; i<code->nConstants; i++) {
         code->constants[i] = naVec_get(p->cg->consts, i);
+        GC_BARRIER(code->constants[i]);
+    }
 
     for(i=0; i<code->nArgs; i++) ARGSYMS(code)[i] = cg.argSyms[i];
     for(i=0; i<code->nOptArgs; i++) OPTARGSYMS(code)[i] = cg.optArgSyms[i];
@@ -809,5 +897,13 @@ naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
     for(i=0; i<code->codesz; i++) BYTECODE(code)[i] = cg.byteCode[i];
     for(i=0; i<code->nLines; i++) LINEIPS(code)[i] = cg.lineIps[i];
 
+    code->nCaches = cg.nCaches;
+    code->caches = 0;
+    if(cg.nCaches) {
+        int sz = cg.nCaches * sizeof(struct naLookupCache);
+        code->caches = naAlloc(sz);
+        naBZero(code->caches, sz);
+    }
+
     return codeObj;
 }
@@ -20,7 +20,13 @@
 #include "NasalHash.hxx"
 #include "NasalString.hxx"
 
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/structure/SGProfiler.hxx>
+
 #include <cassert>
+#include <iterator>
 #include <stdexcept> // for std::runtime_error
 
 namespace nasal
@@ -57,11 +63,69 @@ namespace nasal
     return String(_ctx, str);
   }
 
+  //----------------------------------------------------------------------------
+  naRef ContextWrapper::parseCode( const std::string& name,
+                                   const std::string& src,
+                                   const SGPath& cacheFile,
+                                   int* errLine )
+  {
+    naRef srcFile = to_nasal(name);
+    if( !cacheFile.isNull() && cacheFile.exists() )
+    {
+      sg_ifstream in(cacheFile);
+      std::string data( (std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>() );
+      naRef code = naLoadCode( _ctx, srcFile, 1,
+                               src.data(), src.size(),
+                               data.data(), data.size() );
+      if( naIsCode(code) )
+        return code;
+    }
+
+    int line = 0;
+    naRef code = naParseCode( _ctx, srcFile, 1,
+                              const_cast<char*>(src.data()), src.size(),
+                              &line );
+    if( !naIsCode(code) )
+    {
+      if( errLine )
+        *errLine = line;
+      return code;
+    }
+
+    if( cacheFile.isNull() )
+      return code;
+
+    std::string data(naSaveCode(code, 1, src.data(), src.size(), nullptr, 0),
+                     '\0');
+    naSaveCode(code, 1, src.data(), src.size(), &data[0], data.size());
+
+    // Write to a temporary file first, so that other processes never load
+    // a partially written cache (which would only be rejected anyway).
+    SGPath tmp(cacheFile.str() + ".tmp");
+    {
+      sg_ofstream out(tmp);
+      out.write(data.data(), data.size());
+      if( !out )
+      {
+        SG_LOG(SG_NASAL, SG_WARN, "Failed to write bytecode cache " << tmp);
+        return code;
+      }
+    }
+    if( cacheFile.exists() )
+      SGPath(cacheFile).remove();
+    if( !tmp.rename(cacheFile) )
+      SG_LOG(SG_NASAL, SG_WARN, "Failed to write bytecode cache " << cacheFile);
+
+    return code;
+  }
+
   //----------------------------------------------------------------------------
   naRef ContextWrapper::callMethod( Me me,
                                     naRef code,
                                     std::initializer_list<naRef> args )
   {
+    SG_PROFILE_ZONE("nasal-call");
     naRef ret = naCallMethodCtx(
       _ctx,
       code,
@@ -24,6 +24,9 @@
 
 #include <boost/call_traits.hpp>
 #include <initializer_list>
+#include <string>
+
+class SGPath;
 
 namespace nasal
 {
@@ -83,6 +86,23 @@ namespace nasal
         return (*from_nasal_ptr<T>::get())(_ctx, ref);
       }
 
+      /**
+       * Compile Nasal source code, using a bytecode cache file: if
+       * @a cacheFile holds code compiled from the same source by this
+       * version of the interpreter it is loaded from there, otherwise the
+       * source is parsed and the cache file (re)written.
+       *
+       * @param name      Name of the source file, for error messages
+       * @param src       Source code
+       * @param cacheFile Bytecode cache file (a null path disables caching)
+       * @param errLine   Set to the line of the error if parsing fails
+       * @return The code object, or nil on errors (see naGetError())
+       */
+      naRef parseCode( const std::string& name,
+                       const std::string& src,
+                       const SGPath& cacheFile,
+                       int* errLine = nullptr );
+
       naRef callMethod(Me me, naRef code, std::initializer_list<naRef> args);
 
       template<class Ret, class... Args>
@@ -45,6 +45,13 @@ class TestContext:
       return from_nasal<T>(execImpl(code, nasal::Me{}));
     }
 
+    /// Execute code with the Nasal standard library in scope
+    template<class T = naRef>
+    T execStd(const std::string& code)
+    {
+      return from_nasal<T>(execImpl(code, nasal::Me{}, naInit_std(_ctx)));
+    }
+
     template<class T>
     T convert(const std::string& str)
     {
@@ -52,7 +59,8 @@ class TestContext:
     }
 
   protected:
-    naRef execImpl(const std::string& code_str, nasal::Me me)
+    naRef execImpl(const std::string& code_str, nasal::Me me,
+                   naRef locals = naNil())
     {
       int err_line = -1;
       naRef code = naParseCode( _ctx, to_nasal("<TextContext::exec>"), 0,
@@ -61,7 +69,7 @@ class TestContext:
       if( !naIsCode(code) )
         throw std::runtime_error("Failed to parse code: " + code_str);
 
-      naRef ret = naCallMethod(code, me, 0, 0, naNil());
+      naRef ret = naCallMethod(code, me, 0, 0, locals);
 
       if( char* err = naGetError(_ctx) )
         throw std::runtime_error(
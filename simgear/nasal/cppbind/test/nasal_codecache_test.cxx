@@ -0,0 +1,105 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/sg_path.hxx>
+
+// Round trips of code objects through naSaveCode()/naLoadCode() and the
+// bytecode cache of ContextWrapper::parseCode().
+
+static const std::string src =
+  "var Class = { new: func(n) { return { parents: [Class], n: n }; },\n"
+  "              get: func(k = 2, rest...) { me.n * k + size(rest) } };\n"
+  "var s = 'text';\n"
+  "var f = func(a, b...) { var r = a; foreach(var x; b) r += x; r };\n"
+  "var o = Class.new(1.5);\n"
+  "return s ~ ' ' ~ f(1, 2, 3) ~ ' ' ~ o.get() ~ ' ' ~ o.get(4, nil, nil);\n";
+
+static std::string save(naRef code)
+{
+  std::string data(naSaveCode(code, 1, src.data(), src.size(), nullptr, 0),
+                   '\0');
+  BOOST_REQUIRE(!data.empty());
+  BOOST_REQUIRE_EQUAL(
+    naSaveCode(code, 1, src.data(), src.size(), &data[0], data.size()),
+    (int)data.size()
+  );
+  return data;
+}
+
+static std::string run(TestContext& c, naRef code)
+{
+  naRef ret = naCallMethod(code, naNil(), 0, 0, naInit_std(c.c_ctx()));
+  BOOST_REQUIRE(!naGetError(c.c_ctx()));
+  return c.from_nasal<std::string>(ret);
+}
+
+BOOST_AUTO_TEST_CASE( save_load )
+{
+  TestContext c;
+  int errLine = -1;
+  naRef code = naParseCode( c.c_ctx(), c.to_nasal("test"), 1,
+                            const_cast<char*>(src.data()), src.size(),
+                            &errLine );
+  BOOST_REQUIRE(naIsCode(code));
+  std::string data = save(code);
+
+  naRef loaded = naLoadCode( c.c_ctx(), c.to_nasal("test"), 1,
+                             src.data(), src.size(),
+                             data.data(), data.size() );
+  BOOST_REQUIRE(naIsCode(loaded));
+  BOOST_CHECK_EQUAL(save(loaded), data);
+  BOOST_CHECK_EQUAL(run(c, loaded), "text 6 3 8");
+
+  // Rejected for other source, first line or corrupted data
+  std::string other = src + " ";
+  BOOST_CHECK(naIsNil(naLoadCode( c.c_ctx(), c.to_nasal("test"), 1,
+                                  other.data(), other.size(),
+                                  data.data(), data.size() )));
+  BOOST_CHECK(naIsNil(naLoadCode( c.c_ctx(), c.to_nasal("test"), 2,
+                                  src.data(), src.size(),
+                                  data.data(), data.size() )));
+  for( size_t i = 0; i < data.size(); i += 7 )
+  {
+    std::string bad = data;
+    bad[i] ^= 0x10;
+    BOOST_CHECK(naIsNil(naLoadCode( c.c_ctx(), c.to_nasal("test"), 1,
+                                    src.data(), src.size(),
+                                    bad.data(), bad.size() )));
+  }
+  BOOST_CHECK(naIsNil(naLoadCode( c.c_ctx(), c.to_nasal("test"), 1,
+                                  src.data(), src.size(),
+                                  data.data(), data.size() - 1 )));
+}
+
+BOOST_AUTO_TEST_CASE( cache_file )
+{
+  TestContext c;
+  SGPath cache = simgear::Dir::current().path() / "nasal_codecache_test.nbc";
+  cache.remove();
+
+  naRef code = c.parseCode("test", src, cache);
+  BOOST_REQUIRE(naIsCode(code));
+  BOOST_REQUIRE(cache.exists());
+  BOOST_CHECK_EQUAL(run(c, code), "text 6 3 8");
+
+  naRef cached = c.parseCode("test", src, cache);
+  BOOST_REQUIRE(naIsCode(cached));
+  BOOST_CHECK_EQUAL(save(cached), save(code));
+  BOOST_CHECK_EQUAL(run(c, cached), "text 6 3 8");
+
+  // Stale cache: compiled from the new source and rewritten
+  std::string src2 = "return 42;";
+  naRef code2 = c.parseCode("test", src2, cache);
+  BOOST_REQUIRE(naIsCode(code2));
+  BOOST_CHECK_EQUAL(run(c, code2), "42");
+  BOOST_CHECK_EQUAL(save(c.parseCode("test", src2, cache)), save(code2));
+
+  int errLine = -1;
+  BOOST_CHECK(naIsNil(c.parseCode("test", "var x = ;", cache, &errLine)));
+  BOOST_CHECK_EQUAL(errLine, 1);
+
+  cache.remove();
+}
@@ -0,0 +1,79 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+// Code that the superinstructions of codegen.c (fused comparisons and
+// jumps, OP_LOCALMEMBER and OP_ADDLOCAL) are generated for.
+
+BOOST_AUTO_TEST_CASE( compare_jump )
+{
+  TestContext c;
+  BOOST_CHECK_EQUAL(
+    c.exec<std::string>(
+      "var r = '';\n"
+      "var t = func(a, b) {\n"
+      "  (a < b ? 1 : 0) ~ (a <= b ? 1 : 0) ~ (a > b ? 1 : 0)\n"
+      "  ~ (a >= b ? 1 : 0) ~ (a == b ? 1 : 0) ~ (a != b ? 1 : 0);\n"
+      "};\n"
+      "r ~= t(1, 2) ~ ' ' ~ t(2, 2) ~ ' ' ~ t('3', 2) ~ ' ';\n"
+      "if(nil == nil) r ~= 'a'; else r ~= 'b';\n"
+      "if('x' != 'x') r ~= 'c'; elsif(1 >= 2) r ~= 'd'; else r ~= 'e';\n"
+      "return r;\n"
+    ),
+    "110001 010110 001101 ae"
+  );
+}
+
+BOOST_AUTO_TEST_CASE( loops )
+{
+  TestContext c;
+  BOOST_CHECK_EQUAL(
+    c.exec<std::string>(
+      "var r = '';\n"
+      "for(var i = 0; i < 10; i += 1) {\n"
+      "  if(i == 2) continue;\n"
+      "  if(i >= 5) break;\n"
+      "  r ~= i;\n"
+      "}\n"
+      "var j = 10;\n"
+      "while(j > 0) { j -= 3; r ~= j; }\n"
+      "for(outer; var k = 0; k != 3; k += 1)\n"
+      "  for(var l = 0; l < 3; l += 1) {\n"
+      "    if(l > k) continue outer;\n"
+      "    if(k == 2) break outer;\n"
+      "    r ~= k ~ l;\n"
+      "  }\n"
+      "return r ~ ' ' ~ i ~ ' ' ~ k;\n"
+    ),
+    "0134741-2001011 5 2"
+  );
+}
+
+BOOST_AUTO_TEST_CASE( add_local )
+{
+  TestContext c;
+  BOOST_CHECK_EQUAL(
+    c.exec<std::string>(
+      "var x = 1;\n"
+      "var f = func { x += 2; x -= 0.5 };\n"
+      "var r = f() ~ ' ' ~ x ~ ' ';\n"
+      "var s = '4';\n"
+      "s += 1;\n"
+      "return r ~ s;\n"
+    ),
+    "2.5 2.5 5"
+  );
+}
+
+BOOST_AUTO_TEST_CASE( local_member )
+{
+  TestContext c;
+  BOOST_CHECK_EQUAL(
+    c.exec<std::string>(
+      "var o = {a: {b: 3}, f: func { me.a.b }};\n"
+      "return o.a.b ~ o.f();\n"
+    ),
+    "33"
+  );
+}
@@ -138,3 +138,73 @@ BOOST_AUTO_TEST_CASE( object_holder_gc )
   c.runGC();
   BOOST_CHECK_EQUAL(active_instances.size(), 0);
 }
+
+//------------------------------------------------------------------------------
+static void createUnrootedGhost(intptr_t p, naRef vec = naNil())
+{
+  // allocate from a context of its own, so that it is not kept alive as
+  // one of the temporaries of the test context
+  naContext ctx = naNewContext();
+  active_instances.insert(p);
+  naRef ghost = naNewGhost(ctx, &ghost_type, (void*)p);
+  if( naIsVector(vec) )
+    naVec_append(vec, ghost);
+  naFreeContext(ctx);
+}
+
+BOOST_AUTO_TEST_CASE( incremental_gc )
+{
+  TestContext c;
+  c.runGC();
+  BOOST_REQUIRE(active_instances.empty());
+
+  // Mark only a few objects per step
+  naGCSetIncremental(1, 0);
+
+  naRef keep = naNewVector(c),
+        src = naNewVector(c),
+        dst = naNewVector(c);
+  int key = naGCSave(keep);
+
+  // Plenty of objects to mark between the two vectors. The ones
+  // appended last are marked first, so dst is scanned before src.
+  naVec_append(keep, src);
+  for(int i = 0; i < 5000; ++i)
+    naVec_append(keep, naNewVector(c));
+  naVec_append(keep, dst);
+
+  const int num_kept = 100;
+  for(intptr_t i = 1; i <= num_kept; ++i)
+    createUnrootedGhost(i, src);
+
+  // Move the ghosts from src to dst while collections are running. Only
+  // the write barrier keeps those moved into an already scanned dst
+  // from being collected.
+  int num_busy = 0;
+  for(intptr_t i = 0; i < 100000; ++i)
+  {
+    createUnrootedGhost(1000 + i);
+    bool busy = naGarbageCollect();
+    if( busy && naVec_size(src) )
+    {
+      naVec_append(dst, naVec_removelast(src));
+      ++num_busy;
+    }
+    else if( !busy && !naVec_size(src) )
+      break;
+  }
+
+  BOOST_CHECK_GT(num_busy, 0);
+  BOOST_CHECK_EQUAL(naVec_size(src), 0);
+  BOOST_CHECK_EQUAL(naVec_size(dst), num_kept);
+  for(intptr_t i = 1; i <= num_kept; ++i)
+    BOOST_CHECK_EQUAL(active_instances.count(i), 1);
+  // the garbage has been collected without calling naGC, except for
+  // the ghost created after the last collection
+  BOOST_CHECK_LE(active_instances.size(), num_kept + 1);
+
+  naGCSetIncremental(0, 0);
+  naGCRelease(key);
+  c.runGC();
+  BOOST_REQUIRE(active_instances.empty());
+}
@@ -0,0 +1,78 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+#include <simgear/nasal/nasal.h>
+
+// Every lookup below goes through the same OP_MEMBER or OP_LOCAL
+// instruction (in get()), so a stale lookup cache shows up as a wrong
+// result after the change in between.
+
+static const char* const MEMBER_SCRIPT =
+  "var A = {f: func { 1 }};\n"
+  "var B = {parents: [A]};\n"
+  "var C = {f: func { 4 }};\n"
+  "var o = {parents: [B]};\n"
+  "var p = {parents: [B]};\n"
+  "var get = func(obj) { obj.f() };\n"
+  "var r = '';\n"
+  "r ~= get(o) ~ get(p);\n"
+  "B.f = func { 2 };     r ~= get(o);\n"
+  "o.f = func { 3 };     r ~= get(o) ~ get(p);\n"
+  "delete(o, 'f');       r ~= get(o);\n"
+  "delete(B, 'f');       r ~= get(o);\n"
+  "o.parents = [C];      r ~= get(o) ~ get(p);\n"
+  "p.parents[0] = C;     r ~= get(p);\n"
+  "B.parents = [C];      p.parents = [B]; r ~= get(p);\n"
+  "append(B.parents, A); r ~= get(p);\n"
+  "C.f = func { nil };   r ~= (get(p) == nil ? 'x' : 'y');\n"
+  "delete(C, 'f');       r ~= get(p);\n"
+  "return r;\n";
+
+static const char* const LOCAL_SCRIPT =
+  "var x = 1;\n"
+  "var mk = func { return func { x }; };\n"
+  "var get = mk();\n"
+  "var r = '';\n"
+  "r ~= get();\n"
+  "x = 2;                       r ~= get();\n"
+  "closure(get, 0)['x'] = 3;    r ~= get();\n"
+  "delete(closure(get, 0), 'x'); r ~= get();\n"
+  "var loop = func { var s = ''; for(var i=0; i<3; i+=1) s ~= get(); s };\n"
+  "r ~= loop();\n"
+  "return r;\n";
+
+BOOST_AUTO_TEST_CASE( member_cache )
+{
+  TestContext c;
+  BOOST_CHECK_EQUAL(c.execStd<std::string>(MEMBER_SCRIPT), "112322141444x1");
+
+  naSetLookupCaches(0);
+  BOOST_CHECK_EQUAL(c.execStd<std::string>(MEMBER_SCRIPT), "112322141444x1");
+  naSetLookupCaches(1);
+}
+
+BOOST_AUTO_TEST_CASE( member_cache_receivers )
+{
+  TestContext c;
+  BOOST_CHECK_EQUAL(
+    c.execStd<std::string>(
+      "var A = {f: func { me.v }};\n"
+      "var r = '';\n"
+      "for(var i=0; i<6; i+=1) {\n"
+      "  var o = {parents: [A], v: i};\n"
+      "  if(i == 3) o.f = func { 'x' };\n"
+      "  r ~= o.f();\n"
+      "}\n"
+      "return r;\n"
+    ),
+    "012x45"
+  );
+}
+
+BOOST_AUTO_TEST_CASE( local_cache )
+{
+  TestContext c;
+  BOOST_CHECK_EQUAL(c.execStd<std::string>(LOCAL_SCRIPT), "1232222");
+}
@@ -84,10 +84,12 @@ enum { T_STR, T_VEC, T_HASH, T_CODE, T_FUNC, T_CCODE, T_GHOST,
 // This is a macro instead of a separate struct to allow compilers to
 // avoid padding.  GCC on x86, at least, will always pad the size of
 // an embedded struct up to 32 bits.  Doing it this way allows the
-// implementing objects to pack in 16 bits worth of data "for free".
+// implementing objects to pack in 8 bits worth of data "for free".
+// The cached byte holds the CACHED_* flags of the lookup caches.
 #define GC_HEADER \
     unsigned char mark; \
-    unsigned char type
+    unsigned char type; \
+    unsigned char cached
 
 struct naObj {
     GC_HEADER;
@@ -129,6 +131,23 @@ struct naHash {
     struct HashRec* rec;
 };
 
+// Inline cache of one OP_MEMBER or OP_LOCAL instruction.  The result
+// is the entry ent of holder, which is checked to still hold the key
+// on every hit.  A member of the receiver itself (pent == -1) is
+// looked for at the same entry of any receiver.  An inherited member
+// is valid for receivers without such a member of their own whose
+// first parent is parent, as long as the epoch is current; pent is
+// where the last receiver keeps its parents.  OP_LOCAL only finds the
+// entry again while the frame runs func.
+struct naLookupCache {
+    unsigned int epoch;
+    struct naFunc* func;
+    struct naHash* parent;
+    struct naHash* holder;
+    int ent;
+    int pent;
+};
+
 struct naCode {
     GC_HEADER;
     unsigned int nArgs : 5;
@@ -138,8 +157,10 @@ struct naCode {
     unsigned short codesz;
     unsigned short restArgSym; // The "..." vector name, defaults to "arg"
     unsigned short nLines;
+    unsigned short nCaches;
     naRef srcFile;
     naRef* constants;
+    struct naLookupCache* caches; // one per OP_MEMBER/OP_LOCAL
 };
 
 /* naCode objects store their variable length arrays in a single block
@@ -209,6 +230,22 @@ naRef naStr_buf(naRef str, int len);
 int naiHash_tryset(naRef hash, naRef key, naRef val); // sets if exists
 int naiHash_sym(struct naHash* h, struct naStr* sym, naRef* out);
 void naiHash_newsym(struct naHash* h, naRef* sym, naRef* val);
+int naiHash_entry(struct naHash* h, naRef key);
+int naiHash_symentry(struct naHash* h, struct naStr* sym);
+int naiHash_entget(struct naHash* h, int ent, naRef key, naRef* out);
+int naiHash_nextent(struct naHash* h);
+
+// Flags in the cached byte of objects seen by the lookup caches.
+// Changing the keys of a CACHED_CHAIN object (or anything in a
+// CACHED_CHAIN vector) may change the result of a cached lookup, and
+// so does freeing any flagged object, as its address might be reused.
+// All of these move nasal_cache_epoch on and empty every cache at once.
+#define CACHED_CHAIN 1
+#define CACHED_KEY   2
+extern unsigned int nasal_cache_epoch;
+void naiInvalidateCaches();
+#define CACHE_CHANGED(o) \
+    do { if((o)->cached & CACHED_CHAIN) naiInvalidateCaches(); } while(0)
 
 void naGC_init(struct naPool* p, int type);
 struct naObj** naGC_get(struct naPool* p, int n, int* nout);
@@ -216,6 +253,14 @@ void naGC_swapfree(void** target, void* val);
 void naGC_freedead();
 void naiGCMark(naRef r);
 void naiGCMarkHash(naRef h);
+void naiGCBarrier(naRef r);
+
+// Write barrier for the incremental collector: every naRef stored into
+// a vector, hash, func, code or ghost must pass through this, so that
+// objects stored into already scanned ones are not lost while a mark
+// phase is running.  Stack and temp slots don't need it.
+extern int nasal_gc_marking;
+#define GC_BARRIER(r) do { if(nasal_gc_marking) naiGCBarrier(r); } while(0)
 
 void naStr_gcclean(struct naStr* s);
 void naVec_gcclean(struct naVec* s);
@@ -5,6 +5,7 @@
 
 static void reap(struct naPool* p);
 static void mark(naRef r);
+static void scan(struct naObj* o);
 
 struct Block {
     int   size;
@@ -33,9 +34,63 @@ static void marktemps(struct Context* c)
         mark(r);
     }
 }
+
+// Marks everything directly reachable from the contexts and globals.
+// The stacks and temps are not covered by the write barrier, so this
+// is done again when an incremental collection finishes.
+static void markroots()
+{
+    int i;
+    struct Context* c;
+    for(c = globals->allContexts; c; c = c->nextAll) {
+        for (i = 0; i < c->fTop; i++) {
+            mark(c->fStack[i].func);
+            mark(c->fStack[i].locals);
+        }
+        for (i = 0; i < c->opTop; i++)
+            mark(c->opStack[i]);
+        mark(c->dieArg);
+        marktemps(c);
+    }
+    mark(globals->save);
+    mark(globals->save_hash);
+    mark(globals->symbols);
+    mark(globals->meRef);
+    mark(globals->argRef);
+    mark(globals->parentsRef);
+}
+
 //#define GC_DETAIL_DEBUG 
 static int __elements_visited = 0;
 static int gc_busy=0;
+
+// Incremental collection state.  Marked objects whose children are not
+// yet marked ("grey" objects) wait on an explicit stack, so marking can
+// stop at any point and resume at the next step.
+int nasal_gc_marking = 0;
+static int gc_incremental = 0;
+static int gc_budget = 2000;
+static int gc_step = 0;
+static int gc_drained = 0;
+static int gc_start_count = 0;
+static struct naObj** grey = 0;
+static int ngrey = 0;
+static int greysz = 0;
+
+// Marks the children of every grey object, stopping once budget
+// microseconds have passed since the bottleneck began (or never, for a
+// negative budget).  Returns nonzero when no grey objects are left.
+static int drain(int budget)
+{
+    int n = 0;
+    while(ngrey) {
+        scan(grey[--ngrey]);
+        if(budget >= 0 && (++n & 63) == 0 && global_elapsedUSec() >= budget)
+            return 0;
+    }
+    return 1;
+}
+
 // Must be called with the big lock!
 static void garbageCollect()
 {
@@ -45,89 +100,31 @@ static void garbageCollect()
     int i;
     struct Context* c;
     globals->allocCount = 0;
-    c = globals->allContexts;
 
 #if GC_DETAIL_DEBUG
-    int ctxc = 0;
     __elements_visited = 0;
     int st = global_elapsedUSec();
     int et = 0;
-    int stel = __elements_visited;
-    int eel = 0;
 #endif
 
-    c = globals->allContexts;
-    while (c) {
-#if GC_DETAIL_DEBUG
-        ctxc++;
-#endif
+    // Drop the objects cached by the contexts, they are swept with the
+    // rest of the unreachable ones.
+    for (c = globals->allContexts; c; c = c->nextAll)
         for (i = 0; i < NUM_NASAL_TYPES; i++)
             c->nfree[i] = 0;
-        for (i = 0; i < c->fTop; i++) {
-            mark(c->fStack[i].func);
-            mark(c->fStack[i].locals);
-        }
-        for (i = 0; i < c->opTop; i++)
-            mark(c->opStack[i]);
-        mark(c->dieArg);
-        marktemps(c);
-        c = c->nextAll;
-    }
-#if GC_DETAIL_DEBUG
-    et = global_elapsedUSec() - st;
-    st = global_elapsedUSec();
-    eel = __elements_visited - stel; stel = __elements_visited;
-    printf("--> garbageCollect(#e%-5d): %-4d ", eel, et);
-#endif
-
-    mark(globals->save);
-#if GC_DETAIL_DEBUG
-    et = global_elapsedUSec() - st;
-    st = global_elapsedUSec();
-    eel = __elements_visited - stel; stel = __elements_visited;
-    printf("s(%5d) %-5d ", eel, et);
-#endif
-
-    mark(globals->save_hash);
-#if GC_DETAIL_DEBUG
-    et = global_elapsedUSec() - st;
-    st = global_elapsedUSec();
-    eel = __elements_visited - stel; stel = __elements_visited;
-    printf("h(%5d) %-5d ", eel, et);
-#endif
-
-
-    mark(globals->symbols);
-#if GC_DETAIL_DEBUG
-    et = global_elapsedUSec() - st;
-    st = global_elapsedUSec();
-    eel = __elements_visited - stel; stel = __elements_visited;
-    //printf("sy(%5d) %-4d ", eel, et);
-#endif
-
-    mark(globals->meRef);
-#if GC_DETAIL_DEBUG
-    et = global_elapsedUSec() - st;
-    st = global_elapsedUSec();
-    eel = __elements_visited - stel; stel = __elements_visited;
-    //printf("me(%5d) %-5d ", eel, et);
-#endif
 
-    mark(globals->argRef);
+    // Whatever an incremental collection has marked so far stays
+    // marked; this completes it, or does all the work for a full one.
+    markroots();
+    drain(-1);
+    nasal_gc_marking = 0;
+    gc_drained = 0;
 #if GC_DETAIL_DEBUG
     et = global_elapsedUSec() - st;
     st = global_elapsedUSec();
-    eel = __elements_visited - stel; stel = __elements_visited;
-    //printf("ar(%5d) %-5d ", eel, et);
+    printf("--> garbageCollect(#e%-5d): %-4d ", __elements_visited, et);
 #endif
 
-    mark(globals->parentsRef);
-#if GC_DETAIL_DEBUG
-    et = global_elapsedUSec() - st;
-    st = global_elapsedUSec();
-    eel = __elements_visited - stel; stel = __elements_visited;
-#endif
-    //printf(" ev[%3d] %-5d", eel, et);
     // Finally collect all the freed objects
     for (i = 0; i < NUM_NASAL_TYPES; i++) {
         reap(&(globals->pools[i]));
@@ -147,6 +144,9 @@ static void garbageCollect()
         naFree(globals->deadBlocks);
         globals->deadBlocks = naAlloc(sizeof(void*) * globals->deadsz);
     }
+    // The next incremental collection starts once half of the
+    // allocations allowed until a forced one have been used.
+    gc_start_count = globals->allocCount / 2;
     globals->needGC = 0;
 #if GC_DETAIL_DEBUG
     et = global_elapsedUSec() - st;
@@ -156,6 +156,26 @@ static void garbageCollect()
     gc_busy = 0;
 }
 
+// Must be called with the big lock!  Does one slice of an incremental
+// collection: starts marking when allocations are running low, marks
+// within the time budget, and sweeps in a step of its own once the
+// previous one found nothing left to mark.
+static void incrementalStep()
+{
+    if (gc_busy)
+        return;
+    if (!nasal_gc_marking) {
+        if (globals->allocCount >= gc_start_count)
+            return;
+        nasal_gc_marking = 1;
+        markroots();
+    } else if (gc_drained) {
+        garbageCollect();
+        return;
+    }
+    gc_drained = drain(gc_budget);
+}
+
 void naModLock()
 {
     LOCK();
@@ -201,6 +221,9 @@ static void bottleneck()
 #endif
         if(g->needGC)
             garbageCollect();
+        else if(gc_step)
+            incrementalStep();
+        gc_step = 0;
         if(g->waitCount) naSemUp(g->sem, g->waitCount);
         g->bottleneck = 0;
     }
@@ -246,6 +269,18 @@ int naGarbageCollect()
     // GC can typically take between 5ms and 50ms (F-15, FG1000 PFD & MFD, Advanced weather) - but usually it is completed
     // prior to the start of the next frame.
 
+    if (gc_incremental) {
+        // Spread the collection over the frames instead, see
+        // incrementalStep()
+        rv = nasal_gc_marking;
+        gc_step = 1;
+        bottleneck();
+        rv |= nasal_gc_marking;
+        UNLOCK();
+        naCheckBottleneck();
+        return rv;
+    }
+
     globals->needGC = nasal_globals->allocCount < 23000;
     if (globals->needGC)
         bottleneck();
@@ -258,6 +293,12 @@ int naGarbageCollect()
     return rv;
 }
 
+void naGCSetIncremental(int enable, int budgetUSec)
+{
+    gc_incremental = enable;
+    gc_budget = budgetUSec > 0 ? budgetUSec : 0;
+}
+
 void naCheckBottleneck()
 {
     if(globals->bottleneck) { LOCK(); bottleneck(); UNLOCK(); }
@@ -266,6 +307,7 @@ void naCheckBottleneck()
 static void naCode_gcclean(struct naCode* o)
 {
     naFree(o->constants);  o->constants = 0;
+    naFree(o->caches);     o->caches = 0;
 }
 
 static void naCCode_gcclean(struct naCCode* c)
@@ -291,6 +333,11 @@ static void freeelem(struct naPool* p, struct naObj* o)
     case T_CCODE: naCCode_gcclean((struct naCCode*)o); break;
     case T_GHOST: naGhost_gcclean((struct naGhost*)o); break;
     }
+    // ...forget any lookup cache that could see its address again...
+    if(o->cached) {
+        naiInvalidateCaches();
+        o->cached = 0;
+    }
     p->free[p->nfree++] = o;  // ...and add it to the free list
 }
 
@@ -330,6 +377,7 @@ void naGC_init(struct naPool* p, int type)
     p->free0 = p->free = 0;
     p->nfree = p->freesz = p->freetop = 0;
     reap(p);
+    gc_start_count = globals->allocCount / 2;
 }
 
 static int poolsize(struct naPool* p)
@@ -374,20 +422,36 @@ static void markvec(naRef r)
         mark(vr->array[i]);
 }
 
-// Sets the reference bit on the object, and recursively on all
-// objects reachable from it.  Uses the processor stack for recursion...
-static void mark(naRef r)
+// Sets the reference bit on the object and queues it so that the
+// objects it references get marked by drain().
+static void shade(struct naObj* o)
 {
-    int i;
+    __elements_visited++;
+    o->mark = 1;
+    if(ngrey >= greysz) {
+        greysz = greysz ? 2*greysz : 1024;
+        grey = naRealloc(grey, sizeof(struct naObj*) * greysz);
+    }
+    grey[ngrey++] = o;
+}
 
+static void mark(naRef r)
+{
     if(IS_NUM(r) || IS_NIL(r))
         return;
 
     if(PTR(r).obj->mark == 1)
         return;
-    __elements_visited++;
-    PTR(r).obj->mark = 1;
-    switch(PTR(r).obj->type) {
+    shade(PTR(r).obj);
+}
+
+// Marks the objects referenced by an already marked object
+static void scan(struct naObj* o)
+{
+    int i;
+    naRef r;
+    SETPTR(r, o);
+    switch(o->type) {
     case T_VEC: markvec(r); break;
     case T_HASH: naiGCMarkHash(r); break;
     case T_CODE:
@@ -411,6 +475,18 @@ void naiGCMark(naRef r)
     mark(r);
 }
 
+// While marking, an object stored into one that was already scanned
+// would otherwise never be found, so it is marked here instead.
+void naiGCBarrier(naRef r)
+{
+    if(IS_NUM(r) || IS_NIL(r) || PTR(r).obj->mark)
+        return;
+    LOCK();
+    if(nasal_gc_marking && !PTR(r).obj->mark)
+        shade(PTR(r).obj);
+    UNLOCK();
+}
+
 // Collects all the unreachable objects into a free list, and
 // allocates more space if needed.
 static void reap(struct naPool* p)
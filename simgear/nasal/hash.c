@@ -105,6 +105,7 @@ static HashRec* resize(struct naHash* hash)
 {
     HashRec *hr = hash->rec, *hr2;
     int i, lgsz = 0;
+    if(hash->cached) naiInvalidateCaches(); // entries are renumbered
     if(hr) {
         int oldsz = hr->size;
         while(oldsz) { oldsz >>= 1; lgsz++; }
@@ -140,21 +141,44 @@ int naHash_get(naRef hash, naRef key, naRef* out)
     return 0;
 }
 
+/* Only new keys and the parents vector matter to the lookup caches,
+ * other values are read through the cached entry anyway. */
+static int isParents(naRef key)
+{
+    return naStr_len(key) == 7 && memcmp(naStr_data(key), "parents", 7) == 0;
+}
+
+unsigned int nasal_cache_epoch = 1;
+
+void naiInvalidateCaches()
+{
+    if(++nasal_cache_epoch == 0) nasal_cache_epoch = 1; // 0 is "empty"
+}
+
 void naHash_set(naRef hash, naRef key, naRef val)
 {
-    HashRec* hr = REC(hash);
+    struct naHash* h = PTR(hash).hash;
+    HashRec* hr = h->rec;
+    int size;
     if(!hr || hr->next >= POW2(hr->lgsz))
-        hr = resize(PTR(hash).hash);
+        hr = resize(h);
+    GC_BARRIER(key);
+    GC_BARRIER(val);
+    size = hr->size;
     hashset(hr, key, val);
+    if((h->cached & CACHED_CHAIN) && (hr->size != size || isParents(key)))
+        naiInvalidateCaches();
 }
 
 void naHash_delete(naRef hash, naRef key)
 {
     HashRec* hr = REC(hash);
     if(hr) {
-        int cell = findcell(hr, key, refhash(key));
-        if(TAB(hr)[cell] >= 0) {
+        int ent, cell = findcell(hr, key, refhash(key));
+        if((ent = TAB(hr)[cell]) >= 0) {
+            CACHE_CHANGED(PTR(hash).hash);
             TAB(hr)[cell] = ENT_DELETED;
+            ENTS(hr)[ent].key = ENTS(hr)[ent].val = naNil();
             if(--hr->size < POW2(hr->lgsz-1))
                 resize(PTR(hash).hash);
         }
@@ -218,7 +242,13 @@ int naiHash_tryset(naRef hash, naRef key, naRef val)
     HashRec* hr = REC(hash);
     if(hr) {
         int ent, cell = findcell(hr, key, refhash(key));
-        if((ent = TAB(hr)[cell]) >= 0) { ENTS(hr)[ent].val = val; return 1; }
+        if((ent = TAB(hr)[cell]) >= 0) {
+            GC_BARRIER(val);
+            ENTS(hr)[ent].val = val;
+            if(PTR(hash).hash->cached & CACHED_CHAIN && isParents(key))
+                naiInvalidateCaches();
+            return 1;
+        }
     }
     return 0;
 }
@@ -234,7 +264,7 @@ void naiGCHashClean(struct naHash* h)
  * optimization).  Assumes that the key is an interned symbol
  * (i.e. the hash code is precomputed, and we only need to test for
  * pointer identity). */
-int naiHash_sym(struct naHash* hash, struct naStr* sym, naRef* out)
+int naiHash_symentry(struct naHash* hash, struct naStr* sym)
 {
     HashRec* hr = hash->rec;
     if(hr) {
@@ -243,14 +273,19 @@ int naiHash_sym(struct naHash* hash, struct naStr* sym, naRef* out)
         unsigned int hc = sym->hashcode;
         int cell, mask = POW2(hr->lgsz+1) - 1, step = (2*hc+1) & mask;
         for(cell=HBITS(hr,hc); tab[cell] != ENT_EMPTY; cell=(cell+step)&mask)
-            if(tab[cell]!=ENT_DELETED && sym==PTR(ents[tab[cell]].key).str) {
-                *out = ents[tab[cell]].val;
-                return 1;
-            }
+            if(tab[cell]!=ENT_DELETED && sym==PTR(ents[tab[cell]].key).str)
+                return tab[cell];
     }
-    return 0;
+    return -1;
 }
 
+int naiHash_sym(struct naHash* hash, struct naStr* sym, naRef* out)
+{
+    int ent = naiHash_symentry(hash, sym);
+    if(ent < 0) return 0;
+    *out = ENTS(hash->rec)[ent].val;
+    return 1;
+}
 
 /* As above, a special naHash_set for setting local variables.
  * Assumes that the key is interned, and also that it isn't already
@@ -271,7 +306,40 @@ void naiHash_newsym(struct naHash* hash, naRef* sym, naRef* val)
     if(ent >= NCELLS(hr)) return; /* race protection, don't overrun */
     TAB(hr)[cell] = ent;
     hr->size++;
+    CACHE_CHANGED(hash);
+    GC_BARRIER(*sym);
+    GC_BARRIER(*val);
     ENTS(hr)[TAB(hr)[cell]].key = *sym;
     ENTS(hr)[TAB(hr)[cell]].val = *val;
 }
 
+/* Entry lookups for the lookup caches in code.c.  Entries keep their
+ * index until the hash is resized, and a deleted one loses its key, so
+ * an entry that still holds the key is the current binding of it. */
+int naiHash_entry(struct naHash* hash, naRef key)
+{
+    HashRec* hr = hash->rec;
+    if(hr) {
+        int ent = TAB(hr)[findcell(hr, key, refhash(key))];
+        if(ent >= 0) return ent;
+    }
+    return -1;
+}
+
+int naiHash_entget(struct naHash* hash, int ent, naRef key, naRef* out)
+{
+    HashRec* hr = hash->rec;
+    naRef k;
+    if(!hr || ent < 0 || ent >= hr->next || ent >= POW2(hr->lgsz))
+        return 0;
+    k = ENTS(hr)[ent].key;
+    if(!IS_STR(k) || !IS_STR(key) || !equal(key, k))
+        return 0;
+    *out = ENTS(hr)[ent].val;
+    return 1;
+}
+
+int naiHash_nextent(struct naHash* hash)
+{
+    return hash->rec ? hash->rec->next : 0;
+}
@@ -598,6 +598,8 @@ static naRef f_bind(naContext c, naRef me, int argc, naRef* args)
     if(!IS_FUNC(func) || (!IS_NIL(next) && !IS_FUNC(next)) || !IS_HASH(hash))
         ARGERR();
     func = naNewFunc(c, PTR(func).func->code);
+    GC_BARRIER(hash);
+    GC_BARRIER(next);
     PTR(func).func->namespace = hash;
     PTR(func).func->next = next;
     return func;
@@ -652,7 +654,7 @@ static naRef f_sort(naContext c, naRef me, int argc, naRef* args)
     out = naNewVector(c);
     naVec_setsize(c, out, sd.n);
     for(i=0; i<sd.n; i++)
-        PTR(out).vec->rec->array[i] = sd.elems[sd.recs[i].i];
+        naVec_set(out, i, sd.elems[sd.recs[i].i]);
     naFree(sd.recs);
     naFreeContext(sd.subc);
     return out;
@@ -0,0 +1,119 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <string>
+
+#include <iostream>
+
+#include <simgear/nasal/nasal.h>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Times member and symbol lookups with and without the lookup caches of
+// OP_MEMBER and OP_LOCAL. Each script runs its loop N times, inside a
+// function so that the lookups are not all in the frame's own locals.
+
+namespace {
+
+struct Script
+{
+    const char* name;
+    const char* code;
+};
+
+const Script scripts[] = {
+    { "own field",
+      "var o = {x: 1};\n"
+      "var f = func { var s = 0; for(var i=0; i<N; i+=1) s += o.x; s };\n"
+      "f();\n" },
+    { "method, 1 parent",
+      "var A = {m: func { me.x }};\n"
+      "var o = {parents: [A], x: 1};\n"
+      "var f = func { var s = 0; for(var i=0; i<N; i+=1) s += o.m(); s };\n"
+      "f();\n" },
+    { "method, 3 parents",
+      "var A = {m: func { me.x }};\n"
+      "var B = {parents: [A], b: 1};\n"
+      "var C = {parents: [B], c: 1};\n"
+      "var o = {parents: [C], x: 1};\n"
+      "var f = func { var s = 0; for(var i=0; i<N; i+=1) s += o.m(); s };\n"
+      "f();\n" },
+    { "method, many receivers",
+      "var A = {m: func { me.x }};\n"
+      "var B = {parents: [A]};\n"
+      "var v = [];\n"
+      "for(var i=0; i<16; i+=1) append(v, {parents: [B], x: i});\n"
+      "var f = func { var s = 0; for(var i=0; i<N; i+=1) s += v[i & 15].m(); s };\n"
+      "f();\n" },
+    { "global symbol",
+      "var g = 1;\n"
+      "var f = func { var s = 0; for(var i=0; i<N; i+=1) s += g; s };\n"
+      "f();\n" },
+    { "closure, 3 levels",
+      "var g = 1;\n"
+      "var f = func { func { func { var s = 0; for(var i=0; i<N; i+=1) s += g; s }() }() };\n"
+      "f();\n" },
+};
+
+// Returns the run time in milliseconds, or a negative number on errors
+double runScript(const Script& script, int n)
+{
+    naContext ctx = naNewContext();
+    std::string code = script.code;
+    int errLine = -1;
+    naRef src = naNewString(ctx);
+    naStr_fromdata(src, "bench", 5);
+    naRef c = naParseCode(ctx, src, 1, (char*)code.c_str(), code.size(), &errLine);
+    if (!naIsCode(c)) {
+        cerr << script.name << ": parse error at line " << errLine << endl;
+        naFreeContext(ctx);
+        return -1;
+    }
+
+    naRef locals = naInit_std(ctx);
+    naRef key = naNewString(ctx);
+    naStr_fromdata(key, "N", 1);
+    naHash_set(locals, naInternSymbol(key), naNum(n));
+
+    SGTimeStamp start = SGTimeStamp::now();
+    naCall(ctx, c, 0, 0, naNil(), locals);
+    double msec = (SGTimeStamp::now() - start).toMSecs();
+    if (naGetError(ctx)) {
+        cerr << script.name << ": " << naGetError(ctx) << endl;
+        msec = -1;
+    }
+    naFreeContext(ctx);
+    return msec;
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2) {
+        cerr << "Usage: " << argv[0] << " [iterations]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    int n = (argc > 1) ? atoi(argv[1]) : 2000000;
+    if (n <= 0) {
+        cerr << "bad iteration count" << endl;
+        return EXIT_FAILURE;
+    }
+
+    for (const Script& script : scripts) {
+        naSetLookupCaches(0);
+        double uncached = runScript(script, n);
+        naSetLookupCaches(1);
+        double cached = runScript(script, n);
+        if (uncached < 0 || cached < 0) {
+            return EXIT_FAILURE;
+        }
+        cout << script.name << ": " << uncached << " ms uncached, "
+             << cached << " ms cached" << endl;
+    }
+    return EXIT_SUCCESS;
+}
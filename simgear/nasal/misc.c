@@ -132,6 +132,7 @@ naRef naNewCCodeUD( struct Context* c,
 naRef naNewFunc(struct Context* c, naRef code)
 {
     naRef func = naNew(c, T_FUNC);
+    GC_BARRIER(code);
     PTR(func).func->code = code;
     PTR(func).func->namespace = naNil();
     PTR(func).func->next = naNil();
@@ -175,8 +176,10 @@ void* naGhost_ptr(naRef ghost)
 
 void naGhost_setData(naRef ghost, naRef data)
 {
-    if(IS_GHOST(ghost))
+    if(IS_GHOST(ghost)) {
+        GC_BARRIER(data);
         PTR(ghost).ghost->data = data;
+    }
 }
 
 naRef naGhost_data(naRef ghost)
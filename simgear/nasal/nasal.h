@@ -50,6 +50,22 @@ void* naGetUserData(naContext c) GCC_PURE;
 // run GC now (may block)
 void naGC();
 
+// Member and symbol lookups remember where they found their result
+// last time, unless this is turned off (which only makes sense to
+// measure them).  Enabled by default.
+void naSetLookupCaches(int enable);
+
+// Spread collections over several naGarbageCollect() calls (one per
+// frame), each marking for at most budgetUSec microseconds, instead of
+// collecting all at once.  Running out of objects before a collection
+// is complete, or calling naGC(), still finishes it in one go.
+void naGCSetIncremental(int enable, int budgetUSec);
+
+// Collect, or do a step of an incremental collection, when this looks
+// due soon; meant to be called between frames.  Returns nonzero if a
+// collection was done or is in progress.
+int naGarbageCollect();
+
 // "Save" this object in the context, preventing it (and objects
 // referenced by it) from being garbage collected.
 // TODO do we need a context? It is not used anyhow...
@@ -86,6 +102,21 @@ void naTempSave(naContext c, naRef r);
 naRef naParseCode(naContext c, naRef srcFile, int firstLine,
                   char* buf, int len, int* errLine);
 
+// Serializes a code object returned from naParseCode, to be cached
+// and loaded again with naLoadCode instead of parsing the source
+// another time.  The firstLine and source text are those passed to
+// naParseCode.  Writes the data to buf if it is at least bufsz bytes
+// long, and returns the number of bytes needed (like snprintf).
+int naSaveCode(naRef code, int firstLine, const char* src, int srclen,
+               char* buf, int bufsz);
+
+// Recreates a code object from data written by naSaveCode.  Returns
+// nil if the data is corrupt, was made for other source text or
+// first line, or by a different version of the interpreter; the
+// caller should then fall back to naParseCode.
+naRef naLoadCode(naContext c, naRef srcFile, int firstLine,
+                 const char* src, int srclen, const char* buf, int len);
+
 // Binds a bare code object (as returned from naParseCode) with a
 // closure object (a hash) to act as the outer scope / namespace.
 naRef naBindFunction(naContext ctx, naRef code, naRef closure);
@@ -0,0 +1,90 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <iostream>
+
+#include <simgear/nasal/nasal.h>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Runs Nasal scripts, like the suite in simgear/nasal/bench, and prints
+// the best of several run times for each. Compare the interpreter
+// variants by building with NASAL_NO_SUPERINSTRUCTIONS or
+// NASAL_NO_THREADED_DISPATCH defined.
+
+namespace {
+
+// Returns the run time in milliseconds, or a negative number on errors
+double runScript(const std::string& name, const std::string& code)
+{
+    naContext ctx = naNewContext();
+    naRef src = naStr_fromdata(naNewString(ctx), name.c_str(), name.size());
+    int errLine = -1;
+    naRef c = naParseCode(ctx, src, 1, const_cast<char*>(code.c_str()),
+                          code.size(), &errLine);
+    if (!naIsCode(c)) {
+        cerr << name << ": parse error at line " << errLine << endl;
+        naFreeContext(ctx);
+        return -1;
+    }
+
+    SGTimeStamp start = SGTimeStamp::now();
+    naCall(ctx, c, 0, 0, naNil(), naInit_std(ctx));
+    double msec = (SGTimeStamp::now() - start).toMSecs();
+    if (naGetError(ctx)) {
+        cerr << name << ": " << naGetError(ctx) << endl;
+        msec = -1;
+    }
+    naFreeContext(ctx);
+    return msec;
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    int runs = 3;
+    int first = 1;
+    if (argc > 2 && !strcmp(argv[1], "-n")) {
+        runs = atoi(argv[2]);
+        first = 3;
+    }
+    if (first >= argc || runs <= 0) {
+        cerr << "Usage: " << argv[0] << " [-n runs] script.nas..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    double total = 0;
+    for (int i = first; i < argc; ++i) {
+        std::ifstream file(argv[i]);
+        if (!file) {
+            cerr << "can't read " << argv[i] << endl;
+            return EXIT_FAILURE;
+        }
+        std::ostringstream code;
+        code << file.rdbuf();
+
+        double best = -1;
+        for (int run = 0; run < runs; ++run) {
+            double msec = runScript(argv[i], code.str());
+            if (msec < 0) {
+                return EXIT_FAILURE;
+            }
+            if (best < 0 || msec < best) {
+                best = msec;
+            }
+        }
+        cout << argv[i] << ": " << best << " ms" << endl;
+        total += best;
+    }
+    cout << "total: " << total << " ms" << endl;
+    return EXIT_SUCCESS;
+}
@@ -96,6 +96,9 @@ struct CodeGenerator {
 
     // Dynamic storage for constants, to be compiled into a static table
     naRef consts;
+
+    // Number of OP_MEMBER/OP_LOCAL lookup caches emitted so far
+    int nCaches;
 };
 
 void naParseError(struct Parser* p, char* msg, int line);
@@ -11,8 +11,12 @@
 #include "props.hxx"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <limits>
 
+#include <map>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <iomanip>
@@ -20,6 +24,8 @@
 #include <exception> // can't use sg_exception becuase of PROPS_STANDALONE
 #include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <stdio.h>
 #include <string.h>
@@ -51,20 +57,243 @@ using std::stringstream;
 using namespace simgear;
 
 
+/* The listeners of a node. Notifying them takes no lock and doesn't
+allocate: the listeners live in an array which is never resized, but
+replaced by a new copy whenever a listener is added or removed. Replaced
+arrays are only freed once no notification is iterating over them anymore.
+Removing a listener clears its slot in all arrays still alive, and then waits
+for the notifications which might have read the slot before to finish (see
+waitForDispatches()), so once removeChangeListener() returns the listener
+won't be called anymore and may be deleted. */
 struct SGPropertyNodeListeners
 {
-  /* Protect _num_iterators and _items. We use a recursive mutex to allow
-  nested access to work as normal. */
-  std::recursive_mutex  _rmutex;
+  typedef std::atomic<SGPropertyChangeListener*> Slot;
 
-  /* This keeps a count of the current number of nested invocations of
-  forEachListener(). If non-zero, other code higher up the stack is iterating
-  _items[] so for example code must not erase items in the vector. */
-  int _num_iterators = 0;
+  struct Array
+  {
+    explicit Array(size_t n) : size(n), items(new Slot[n]) {}
+
+    size_t size;
+    std::unique_ptr<Slot[]> items;
+  };
+
+  ~SGPropertyNodeListeners()
+  {
+    delete _current.load();
+    for (Array* items : _retired)
+      delete items;
+  }
+
+  /* Serializes adding and removing listeners. It is never held while calling
+  a listener. */
+  std::mutex _mutex;
+
+  /* Wait until the notifications which were running when a listener has been
+  cleared are done. Must be called without _mutex held. Notifications started
+  later can't see the listener anymore, and count against the other of the
+  two counters, so a steady stream of notifications can't hold us up forever.
+  Doesn't wait if this thread is notifying listeners itself (of any node):
+  the notification we would wait for could be our own, or one waiting for
+  us in turn. */
+  void waitForDispatches()
+  {
+    if (t_dispatching > 0)
+      return;
+
+    std::lock_guard<std::mutex> lock(_graceMutex);
+    unsigned old = _phase.fetch_xor(1);
+    while (_active[old].load() != 0)
+      std::this_thread::yield();
+  }
+
+  Array* current() const { return _current.load(); }
+
+  /* Replace the array of listeners. Must be called with _mutex held. */
+  void publish(Array* items)
+  {
+    Array* old = _current.exchange(items);
+    if (old)
+      _retired.push_back(old);
+    reclaim();
+  }
+
+  /* Free replaced arrays, unless a notification might still use one of them.
+  Must be called with _mutex held. */
+  void reclaim()
+  {
+    if (!_retired.empty() && _active[0].load() == 0 && _active[1].load() == 0) {
+      for (Array* items : _retired)
+        delete items;
+      _retired.clear();
+    }
+    _hasRetired = !_retired.empty();
+  }
+
+  /* Clear the slots of a listener in all arrays. Must be called with _mutex
+  held. Returns false if the listener hasn't been registered. */
+  bool clear(SGPropertyChangeListener* listener)
+  {
+    Array* items = _current.load();
+    size_t pos = 0;
+    while (items && pos < items->size && items->items[pos] != listener)
+      ++pos;
+    if (!items || pos == items->size)
+      return false;
+
+    items->items[pos] = nullptr;
+    for (Array* old : _retired)
+      for (size_t i = 0; i < old->size; ++i)
+        if (old->items[i] == listener)
+          old->items[i] = nullptr;
+    return true;
+  }
+
+  /* Call <callback> for each listener. Nested notifications (eg. a listener
+  changing the value it listens to) are fine. */
+  template<typename Callback>
+  void forEach(const Callback& callback)
+  {
+    // Incrementing before reading _current (and publish() doing it the other
+    // way round) ensures the array can't be freed while we are using it.
+    unsigned phase = _phase.load();
+    ++_active[phase];
+    ++t_dispatching;
+    Array* items = _current.load();
+    if (items) {
+      for (size_t i = 0; i < items->size; ++i) {
+        SGPropertyChangeListener* listener = items->items[i];
+        if (listener) {
+          try {
+            callback(listener);
+          }
+          catch (std::exception& e) {
+            SG_LOG(SG_GENERAL, SG_ALERT, "Ignoring exception from property callback: " << e.what());
+          }
+        }
+      }
+    }
+
+    --t_dispatching;
+    if (--_active[phase] == 0 && _active[phase ^ 1].load() == 0 && _hasRetired) {
+      // Don't block if someone else is modifying the listeners, the array
+      // will be freed the next time anyway.
+      std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+      if (lock.owns_lock())
+        reclaim();
+    }
+  }
+
+private:
+  std::atomic<Array*> _current{nullptr};
+
+  /* Number of notifications currently iterating over the listeners, counted
+  in two halves flipped by waitForDispatches(). */
+  std::atomic<int> _active[2] = {{0}, {0}};
+  std::atomic<unsigned> _phase{0};
+  std::mutex _graceMutex;
+
+  /* Number of notifications running in this thread, of any node. */
+  static thread_local int t_dispatching;
+
+  /* Arrays replaced while a notification has been running. */
+  std::vector<Array*> _retired;
+  std::atomic<bool> _hasRetired{false};
+};
+
+thread_local int SGPropertyNodeListeners::t_dispatching = 0;
+
+namespace
+{
+/* valueChanged() notifications for coalesced listeners, waiting to be
+delivered by SGPropertyChangeListener::fireCoalescedChanges(). */
+struct CoalescedChanges
+{
+  typedef std::pair<SGPropertyChangeListener*, SGPropertyNode*> Change;
+
+  std::mutex mutex;
+  std::vector<Change> queue;  // in order of the first change
+  std::set<Change> pending;   // contents of queue, to drop duplicates
+  std::deque<Change> delivering;
+  bool flushing = false;
+
+  void add(SGPropertyChangeListener* listener, SGPropertyNode* node)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending.insert(Change(listener, node)).second)
+      queue.push_back(Change(listener, node));
+  }
+
+  /* Drop all changes matching the predicate, eg. because the listener or
+  node is about to vanish. */
+  template<typename Pred>
+  void remove(const Pred& pred)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.empty() && delivering.empty())
+      return;
+
+    queue.erase(std::remove_if(queue.begin(), queue.end(), pred), queue.end());
+    delivering.erase(std::remove_if(delivering.begin(), delivering.end(), pred),
+                     delivering.end());
+    for (auto it = pending.begin(); it != pending.end();) {
+      if (pred(*it))
+        it = pending.erase(it);
+      else
+        ++it;
+    }
+  }
+};
+
+CoalescedChanges& coalescedChanges()
+{
+  static CoalescedChanges changes;
+  return changes;
+}
+}
+
+/* Lookup table for the children of nodes with many children. Children are
+grouped by name and ordered by index within each group. Children sharing the
+same name and index keep their insertion order, so lookups return the same
+node as a linear scan of _children would. */
+struct SGPropertyChildIndex
+{
+  typedef std::multimap<int, SGPropertyNode*> IndexMap;
+
+  std::unordered_map<std::string, IndexMap> _names;
+
+  void add(SGPropertyNode* child)
+  {
+    _names[child->getNameString()].emplace(child->getIndex(), child);
+  }
+
+  void remove(SGPropertyNode* child)
+  {
+    auto group = _names.find(child->getNameString());
+    if (group == _names.end())
+      return;
+
+    auto range = group->second.equal_range(child->getIndex());
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == child) {
+        group->second.erase(it);
+        break;
+      }
+    }
+    if (group->second.empty())
+      _names.erase(group);
+  }
 
-  std::vector<SGPropertyChangeListener *> _items;
+  const IndexMap* find(const std::string& name) const
+  {
+    auto group = _names.find(name);
+    return group != _names.end() ? &group->second : nullptr;
+  }
 };
 
+/* Bumped whenever a child is added to or removed from any node. This
+invalidates the cached resolutions of all SGPropertyPath instances. */
+static std::atomic<unsigned int> tree_generation(0);
+
 
 ////////////////////////////////////////////////////////////////////////
 // Local classes.
@@ -380,12 +609,38 @@ find_child (Itr begin, Itr end, int index, const PropertyList& nodes)
   return -1;
 }
 
+/**
+ * Locate a child node by name and index using the lookup table.
+ */
+template<typename Itr>
+static SGPropertyNode*
+find_indexed_child (const SGPropertyChildIndex& childIndex,
+                    Itr begin, Itr end, int index)
+{
+  const SGPropertyChildIndex::IndexMap* group =
+    childIndex.find(std::string(begin, end));
+  if (!group)
+    return 0;
+
+  // lower_bound (not find) to get the first of several equal entries
+  SGPropertyChildIndex::IndexMap::const_iterator it = group->lower_bound(index);
+  if (it == group->end() || it->first != index)
+    return 0;
+  return it->second;
+}
+
 /**
  * Locate the child node with the highest index of the same name
  */
 static int
-find_last_child (const char * name, const PropertyList& nodes)
+find_last_child (const char * name, const PropertyList& nodes,
+                 const SGPropertyChildIndex* childIndex)
 {
+  if (childIndex) {
+    const SGPropertyChildIndex::IndexMap* group = childIndex->find(name);
+    return group ? group->rbegin()->first : -1;
+  }
+
   size_t nNodes = nodes.size();
   int index = -1;
 
@@ -406,8 +661,24 @@ find_last_child (const char * name, const PropertyList& nodes)
 static int
 first_unused_index( const char * name,
                     const PropertyList& nodes,
+                    const SGPropertyChildIndex* childIndex,
                     int min_index )
 {
+  if( childIndex )
+  {
+    const SGPropertyChildIndex::IndexMap* group = childIndex->find(name);
+    if( !group )
+      return min_index;
+
+    // Indices are sorted, so walk them until we find a gap
+    int index = min_index;
+    for( auto it = group->lower_bound(min_index);
+              it != group->end() && it->first <= index;
+            ++it )
+      index = it->first + 1;
+    return index;
+  }
+
   const char* nameEnd = name + strlen(name);
 
   for( int index = min_index; index < std::numeric_limits<int>::max(); ++index )
@@ -422,8 +693,11 @@ first_unused_index( const char * name,
 
 template<typename Itr>
 inline SGPropertyNode*
-SGPropertyNode::getExistingChild (Itr begin, Itr end, int index)
+SGPropertyNode::getExistingChild (Itr begin, Itr end, int index) const
 {
+  if (_childIndex)
+    return find_indexed_child(*_childIndex, begin, end, index);
+
   int pos = find_child(begin, end, index, _children);
   if (pos >= 0)
     return _children[pos];
@@ -441,7 +715,7 @@ SGPropertyNode::getChildImpl (Itr begin, Itr end, int index, bool create)
     } else if (create) {
       // REVIEW: Memory Leak - 2,028 (1,976 direct, 52 indirect) bytes in 13 blocks are definitely lost
       node = new SGPropertyNode(begin, end, index, this);
-      _children.push_back(node);
+      appendChild(node);
       fireChildAdded(node);
       return node;
     } else {
@@ -576,7 +850,7 @@ find_node (SGPropertyNode * current,
            int last_index = -1)
 {
   using namespace boost;
-  typedef split_iterator<typename range_result_iterator<Range>::type>
+  typedef split_iterator<typename range_const_iterator<Range>::type>
     PathSplitIterator;
 
   PathSplitIterator itr
@@ -987,14 +1261,26 @@ SGPropertyNode::~SGPropertyNode ()
   // zero out all parent pointers, else they might be dangling
   for (unsigned i = 0; i < _children.size(); ++i)
     _children[i]->_parent = 0;
+  if (!_children.empty())
+    ++tree_generation;
+  delete _childIndex;
   clearValue();
 
   if (_listeners) {
-    vector<SGPropertyChangeListener*>::iterator it;
-    for (it = _listeners->_items.begin(); it != _listeners->_items.end(); ++it)
-      (*it)->unregister_property(this);
+    SGPropertyNodeListeners::Array* items = _listeners->current();
+    for (size_t i = 0; items && i < items->size; ++i) {
+      if (SGPropertyChangeListener* listener = items->items[i])
+        listener->unregister_property(this);
+    }
     delete _listeners;
   }
+
+  // Coalesced listeners of ancestors queue changes of this node too, so
+  // this is needed even without listeners of our own. Cheap while nothing
+  // is queued.
+  coalescedChanges().remove([this](const CoalescedChanges::Change& change) {
+    return change.second == this;
+  });
 }
 
 
@@ -1090,13 +1376,13 @@ SGPropertyNode *
 SGPropertyNode::addChild(const char * name, int min_index, bool append)
 {
   int pos = append
-          ? std::max(find_last_child(name, _children) + 1, min_index)
-          : first_unused_index(name, _children, min_index);
+          ? std::max(find_last_child(name, _children, _childIndex) + 1, min_index)
+          : first_unused_index(name, _children, _childIndex, min_index);
 
   SGPropertyNode_ptr node;
   // REVIEW: Memory Leak - 152 bytes in 1 blocks are definitely lost
   node = new SGPropertyNode(name, name + strlen(name), pos, this);
-  _children.push_back(node);
+  appendChild(node);
   fireChildAdded(node);
   return node;
 }
@@ -1117,9 +1403,9 @@ SGPropertyNode::addChildren( const std::string& name,
   {
     // First grab all used indices. This saves us of testing every index if it
     // is used for every element to be created
-    for( size_t i = 0; i < nodes.size(); i++ )
+    for( size_t i = 0; i < _children.size(); i++ )
     {
-      const SGPropertyNode* node = nodes[i];
+      const SGPropertyNode* node = _children[i];
 
       if( node->getNameString() == name && node->getIndex() >= min_index )
         used_indices.insert(node->getIndex());
@@ -1128,7 +1414,8 @@ SGPropertyNode::addChildren( const std::string& name,
   else
   {
     // If we don't want to fill the holes just find last node
-    min_index = std::max(find_last_child(name.c_str(), _children) + 1, min_index);
+    min_index = std::max(find_last_child(name.c_str(), _children, _childIndex) + 1,
+                         min_index);
   }
 
   for( int index = min_index;
@@ -1139,7 +1426,7 @@ SGPropertyNode::addChildren( const std::string& name,
     {
       SGPropertyNode_ptr node;
       node = new SGPropertyNode(name, index, this);
-      _children.push_back(node);
+      appendChild(node);
       fireChildAdded(node);
       nodes.push_back(node);
     }
@@ -1199,9 +1486,9 @@ SGPropertyNode::getChild (const std::string& name, int index, bool create)
 {
 #if PROPS_STANDALONE
   const char *n = name.c_str();
-  int pos = find_child(n, n + strlen(n), index, _children);
-  if (pos >= 0) {
-    return _children[pos];
+  SGPropertyNode* node = getExistingChild(n, n + strlen(n), index);
+  if (node) {
+    return node;
 #else
   SGPropertyNode* node = getExistingChild(name.begin(), name.end(), index);
   if (node) {
@@ -1211,7 +1498,7 @@ SGPropertyNode::getChild (const std::string& name, int index, bool create)
       // REVIEW: Memory Leak - 12,862 (11,856 direct, 1,006 indirect) bytes in 78 blocks are definitely lost
       SGPropertyNode* node = new SGPropertyNode(name, index, this);
       // REVIEW: Memory Leak - 104,647 (8 direct, 104,639 indirect) bytes in 1 blocks are definitely lost
-      _children.push_back(node);
+      appendChild(node);
       fireChildAdded(node);
       return node;
     } else {
@@ -1225,11 +1512,7 @@ SGPropertyNode::getChild (const std::string& name, int index, bool create)
 const SGPropertyNode *
 SGPropertyNode::getChild (const char * name, int index) const
 {
-  int pos = find_child(name, name + strlen(name), index, _children);
-  if (pos >= 0)
-    return _children[pos];
-  else
-    return 0;
+  return getExistingChild(name, name + strlen(name), index);
 }
 
 
@@ -1240,8 +1523,19 @@ PropertyList
 SGPropertyNode::getChildren (const char * name) const
 {
   PropertyList children;
-  size_t max = _children.size();
 
+  if (_childIndex) {
+    // Already sorted by index
+    const SGPropertyChildIndex::IndexMap* group = _childIndex->find(name);
+    if (group) {
+      children.reserve(group->size());
+      for (const auto& entry : *group)
+        children.push_back(entry.second);
+    }
+    return children;
+  }
+
+  size_t max = _children.size();
   for (size_t i = 0; i < max; i++)
     if (compare_strings(_children[i]->getName(), name))
       children.push_back(_children[i]);
@@ -1281,10 +1575,9 @@ SGPropertyNode_ptr SGPropertyNode::removeChild(int pos)
 SGPropertyNode_ptr
 SGPropertyNode::removeChild(const char * name, int index)
 {
-  SGPropertyNode_ptr ret;
-  int pos = find_child(name, name + strlen(name), index, _children);
-  if (pos >= 0)
-    ret = removeChild(pos);
+  SGPropertyNode_ptr ret = getExistingChild(name, name + strlen(name), index);
+  if (ret)
+    removeChild(ret.get());
   return ret;
 }
 
@@ -1318,6 +1611,9 @@ SGPropertyNode::removeAllChildren()
   }
 
   _children.clear();
+  delete _childIndex;
+  _childIndex = nullptr;
+  ++tree_generation;
 }
 
 std::string
@@ -2150,6 +2446,41 @@ SGPropertyNode::getNode (const char * relative_path, int index) const
   return ((SGPropertyNode *)this)->getNode(relative_path, index, false);
 }
 
+SGPropertyNode *
+SGPropertyNode::getNode (const SGPropertyPath& path, bool create)
+{
+  if (path._cachedBase == this
+      && path._cachedGeneration == tree_generation.load(std::memory_order_relaxed)
+      && (path._cachedNode || !create))
+    return path._cachedNode;
+
+  SGPropertyNode* node = path._absolute ? getRootNode() : this;
+  for (const SGPropertyPath::Component& component : path._components) {
+    if (component.name) {
+      node = node->getChild(*component.name, component.index, create);
+    } else {
+      SGPropertyNode* parent = node->getParent();
+      if (parent == 0)
+        SG_LOG(SG_GENERAL, SG_ALERT, "attempt to move past root with '..' node " << node->getName());
+      node = parent;
+    }
+    if (node == 0)
+      break;
+  }
+
+  // Read the generation only now, as we might just have created nodes
+  path._cachedBase = this;
+  path._cachedNode = node;
+  path._cachedGeneration = tree_generation.load(std::memory_order_relaxed);
+  return node;
+}
+
+const SGPropertyNode *
+SGPropertyNode::getNode (const SGPropertyPath& path) const
+{
+  return ((SGPropertyNode *)this)->getNode(path, false);
+}
+
 ////////////////////////////////////////////////////////////////////////
 // Convenience methods using relative paths.
 ////////////////////////////////////////////////////////////////////////
@@ -2319,6 +2650,97 @@ SGPropertyNode::setUnspecifiedValue (const char * relative_path,
   return getNode(relative_path, true)->setUnspecifiedValue(value);
 }
 
+/**
+ * Get a value for another node by a preparsed path.
+ */
+bool
+SGPropertyNode::getBoolValue (const SGPropertyPath& path,
+                              bool defaultValue) const
+{
+  const SGPropertyNode * node = getNode(path);
+  return (node == 0 ? defaultValue : node->getBoolValue());
+}
+
+int
+SGPropertyNode::getIntValue (const SGPropertyPath& path,
+                             int defaultValue) const
+{
+  const SGPropertyNode * node = getNode(path);
+  return (node == 0 ? defaultValue : node->getIntValue());
+}
+
+long
+SGPropertyNode::getLongValue (const SGPropertyPath& path,
+                              long defaultValue) const
+{
+  const SGPropertyNode * node = getNode(path);
+  return (node == 0 ? defaultValue : node->getLongValue());
+}
+
+float
+SGPropertyNode::getFloatValue (const SGPropertyPath& path,
+                               float defaultValue) const
+{
+  const SGPropertyNode * node = getNode(path);
+  return (node == 0 ? defaultValue : node->getFloatValue());
+}
+
+double
+SGPropertyNode::getDoubleValue (const SGPropertyPath& path,
+                                double defaultValue) const
+{
+  const SGPropertyNode * node = getNode(path);
+  return (node == 0 ? defaultValue : node->getDoubleValue());
+}
+
+const char *
+SGPropertyNode::getStringValue (const SGPropertyPath& path,
+                                const char * defaultValue) const
+{
+  const SGPropertyNode * node = getNode(path);
+  return (node == 0 ? defaultValue : node->getStringValue());
+}
+
+
+/**
+ * Set a value for another node by a preparsed path.
+ */
+bool
+SGPropertyNode::setBoolValue (const SGPropertyPath& path, bool value)
+{
+  return getNode(path, true)->setBoolValue(value);
+}
+
+bool
+SGPropertyNode::setIntValue (const SGPropertyPath& path, int value)
+{
+  return getNode(path, true)->setIntValue(value);
+}
+
+bool
+SGPropertyNode::setLongValue (const SGPropertyPath& path, long value)
+{
+  return getNode(path, true)->setLongValue(value);
+}
+
+bool
+SGPropertyNode::setFloatValue (const SGPropertyPath& path, float value)
+{
+  return getNode(path, true)->setFloatValue(value);
+}
+
+bool
+SGPropertyNode::setDoubleValue (const SGPropertyPath& path, double value)
+{
+  return getNode(path, true)->setDoubleValue(value);
+}
+
+bool
+SGPropertyNode::setStringValue (const SGPropertyPath& path, const char * value)
+{
+  return getNode(path, true)->setStringValue(value);
+}
+
 
 /**
  * Test whether another node is tied.
@@ -2421,21 +2843,26 @@ SGPropertyNode::addChangeListener (SGPropertyChangeListener * listener,
     // REVIEW: Memory Leak - 32 bytes in 1 blocks are indirectly lost
     _listeners = new SGPropertyNodeListeners;
 
-  std::lock_guard lock(_listeners->_rmutex);
-  /* If there's a nullptr entry (a listener that was unregistered), we
-  overwrite it. This ensures that listeners that routinely unregister+register
-  themselves don't make _listeners->_items grow unnecessarily. Otherwise simply
-  append. */
-  auto it = std::find(_listeners->_items.begin(), _listeners->_items.end(),
-        (SGPropertyChangeListener*) nullptr
-        );
-  if (it == _listeners->_items.end()) {
-    // REVIEW: Memory Leak - 8 bytes in 1 blocks are indirectly lost
-    _listeners->_items.push_back(listener);
-  }
-  else {
-    *it = listener;
+  {
+    std::lock_guard<std::mutex> lock(_listeners->_mutex);
+    SGPropertyNodeListeners::Array* current = _listeners->current();
+
+    size_t n = 0;
+    for (size_t i = 0; current && i < current->size; ++i)
+      if (current->items[i])
+        ++n;
+
+    // Copy the remaining listeners and append the new one
+    SGPropertyNodeListeners::Array* items =
+      new SGPropertyNodeListeners::Array(n + 1);
+    n = 0;
+    for (size_t i = 0; current && i < current->size; ++i)
+      if (SGPropertyChangeListener* l = current->items[i])
+        items->items[n++] = l;
+    items->items[n] = listener;
+    _listeners->publish(items);
   }
+
   listener->register_property(this);
   if (initial)
     // REVIEW: Memory Leak - 24,928 bytes in 164 blocks are indirectly lost
@@ -2447,37 +2874,45 @@ SGPropertyNode::removeChangeListener (SGPropertyChangeListener * listener)
 {
   if (_listeners == 0)
     return;
-  /* We use a std::unique_lock rather than a std::lock_guard because we may
-  need to unlock early. */
-  std::unique_lock lock(_listeners->_rmutex);
-  vector<SGPropertyChangeListener*>::iterator it =
-    find(_listeners->_items.begin(), _listeners->_items.end(), listener);
-  if (it != _listeners->_items.end()) {
-    assert(_listeners->_num_iterators >= 0);
-    if (_listeners->_num_iterators) {
-      /* _listeners._items is currently being iterated further up the stack in
-      this thread by one or more nested invocations of forEachListener(), so
-      we must be careful to not break these iterators. So we must not delete
-      _listeners. And we must not erase this entry from the vector because that
-      could cause the next listener to be missed out.
-
-      So we simply set this entry to nullptr (nullptr items are skipped by
-      forEachListener()). When all invocations of forEachListener() have
-      finished iterating and it is safe to modify things again, it will clean
-      up any nullptr entries in _listeners->_items. */
-      *it = nullptr;
-      listener->unregister_property(this);
-    }
-    else {
-      _listeners->_items.erase(it);
-      listener->unregister_property(this);
-      if (_listeners->_items.empty()) {
-        lock.unlock();
-        delete _listeners;
-        _listeners = 0;
-      }
+
+  {
+    std::lock_guard<std::mutex> lock(_listeners->_mutex);
+    if (!_listeners->clear(listener))
+      return;
+
+    SGPropertyNodeListeners::Array* current = _listeners->current();
+    size_t n = 0;
+    for (size_t i = 0; i < current->size; ++i)
+      if (current->items[i])
+        ++n;
+
+    SGPropertyNodeListeners::Array* items = 0;
+    if (n > 0) {
+      items = new SGPropertyNodeListeners::Array(n);
+      n = 0;
+      for (size_t i = 0; i < current->size; ++i)
+        if (SGPropertyChangeListener* l = current->items[i])
+          items->items[n++] = l;
     }
+    _listeners->publish(items);
   }
+
+  _listeners->waitForDispatches();
+  listener->unregister_property(this);
+
+  // Drop the queued changes this node has reported to the listener, or all of
+  // them if the listener is gone for good.
+  bool registered = !listener->_properties.empty();
+  coalescedChanges().remove([=](const CoalescedChanges::Change& change) {
+    if (change.first != listener)
+      return false;
+    if (!registered)
+      return true;
+    for (const SGPropertyNode* n = change.second; n; n = n->getParent())
+      if (n == this)
+        return true;
+    return false;
+  });
 }
 
 void
@@ -2524,60 +2959,14 @@ SGPropertyNode::fireChildrenRemovedRecursive()
   }
 }
 
-/* Calls <callback> for each item in _listeners. We are careful to skip nullptr
-entries in _listeners->items[], which can be created if listeners are removed
-while we are iterating. */
-static void forEachListener(
-    SGPropertyNode* node,
-    SGPropertyNodeListeners*& _listeners,
-    std::function<void (SGPropertyChangeListener*)> callback
-    )
-{
-  if (!_listeners) return;
-
-  std::lock_guard lock(_listeners->_rmutex);
-  assert(_listeners->_num_iterators >= 0);
-  _listeners->_num_iterators += 1;
-
-  /* We need to use an index here when iterating _listeners->_items, not an
-  iterator. This is because a listener may add new listeners, causing the
-  vector to be reallocated, which would invalidate any iterator. */
-  for (size_t i = 0; i < _listeners->_items.size(); ++i) {
-    auto listener = _listeners->_items[i];
-    if (listener) {
-      try {
-        callback(listener);
-      }
-      catch (std::exception& e) {
-        SG_LOG(SG_GENERAL, SG_ALERT, "Ignoring exception from property callback: " << e.what());
-      }
-    }
-  }
-
-  _listeners->_num_iterators -= 1;
-  assert(_listeners->_num_iterators >= 0);
-
-  if (_listeners->_num_iterators == 0) {
-
-    /* Remove any items that have been set to nullptr. */
-    _listeners->_items.erase(
-        std::remove(_listeners->_items.begin(), _listeners->_items.end(), (SGPropertyChangeListener*) nullptr),
-        _listeners->_items.end()
-        );
-    if (_listeners->_items.empty()) {
-      delete _listeners;
-      _listeners = nullptr;
-    }
-  }
-}
-
 int SGPropertyNode::nListeners() const
 {
   if (!_listeners) return 0;
-  std::lock_guard lock(_listeners->_rmutex);
+  std::lock_guard<std::mutex> lock(_listeners->_mutex);
+  SGPropertyNodeListeners::Array* items = _listeners->current();
   int   n = 0;
-  for (auto listener: _listeners->_items) {
-    if (listener)   n += 1;
+  for (size_t i = 0; items && i < items->size; ++i) {
+    if (items->items[i])   n += 1;
   }
   return n;
 }
@@ -2585,11 +2974,13 @@ int SGPropertyNode::nListeners() const
 void
 SGPropertyNode::fireValueChanged (SGPropertyNode * node)
 {
-  forEachListener(
-      node,
-      _listeners,
-      [&](SGPropertyChangeListener* listener) { listener->valueChanged(node);}
-      );
+  if (_listeners)
+    _listeners->forEach([node](SGPropertyChangeListener* listener) {
+      if (listener->_coalesced)
+        coalescedChanges().add(listener, node);
+      else
+        listener->valueChanged(node);
+    });
   if (_parent != 0)
     _parent->fireValueChanged(node);
 }
@@ -2598,11 +2989,10 @@ void
 SGPropertyNode::fireChildAdded (SGPropertyNode * parent,
 				SGPropertyNode * child)
 {
-  forEachListener(
-      parent,
-      _listeners,
-      [&](SGPropertyChangeListener* listener) { listener->childAdded(parent, child);}
-      );
+  if (_listeners)
+    _listeners->forEach([parent, child](SGPropertyChangeListener* listener) {
+      listener->childAdded(parent, child);
+    });
   if (_parent != 0)
     _parent->fireChildAdded(parent, child);
 }
@@ -2611,11 +3001,10 @@ void
 SGPropertyNode::fireChildRemoved (SGPropertyNode * parent,
 				  SGPropertyNode * child)
 {
-  forEachListener(
-      parent,
-      _listeners,
-      [&](SGPropertyChangeListener* listener) { listener->childRemoved(parent, child);}
-      );
+  if (_listeners)
+    _listeners->forEach([parent, child](SGPropertyChangeListener* listener) {
+      listener->childRemoved(parent, child);
+    });
   if (_parent != 0)
     _parent->fireChildRemoved(parent, child);
 }
@@ -2629,10 +3018,118 @@ SGPropertyNode::eraseChild(simgear::PropertyList::iterator child)
   node->clearValue();
   fireChildRemoved(node);
 
+  unindexChild(node);
   _children.erase(child);
+  ++tree_generation;
   return node;
 }
 
+//------------------------------------------------------------------------------
+void
+SGPropertyNode::appendChild(SGPropertyNode* child)
+{
+  _children.push_back(child);
+  ++tree_generation;
+
+  if (_childIndex) {
+    _childIndex->add(child);
+  } else if (_children.size() > CHILD_INDEX_THRESHOLD) {
+    // Build the lookup table lazily, once linear searches get expensive
+    _childIndex = new SGPropertyChildIndex;
+    for (size_t i = 0; i < _children.size(); ++i)
+      _childIndex->add(_children[i]);
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+SGPropertyNode::unindexChild(SGPropertyNode* child)
+{
+  if (_childIndex)
+    _childIndex->remove(child);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Implementation of SGPropertyPath.
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Get the shared copy of a node name. Interned names are never released,
+ * so the returned pointer stays valid for the lifetime of the program.
+ */
+static const std::string*
+intern_name (const std::string& name)
+{
+  static std::mutex mutex;
+  static std::unordered_set<std::string> names;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return &*names.insert(name).first;
+}
+
+SGPropertyPath::SGPropertyPath (const char * path)
+  : _path(path)
+{
+  parse();
+}
+
+SGPropertyPath::SGPropertyPath (const std::string& path)
+  : _path(path)
+{
+  parse();
+}
+
+/**
+ * Split the path into components, following the same rules as
+ * SGPropertyNode::getNode(const char*).
+ */
+void
+SGPropertyPath::parse ()
+{
+  _absolute = !_path.empty() && _path[0] == '/';
+
+  size_t pos = 0;
+  while (pos < _path.size()) {
+    size_t end = _path.find('/', pos);
+    if (end == std::string::npos)
+      end = _path.size();
+
+    const std::string token = _path.substr(pos, end - pos);
+    pos = end + 1;
+
+    // Empty components (eg. "a//b" or a trailing '/') and "." are skipped
+    if (token.empty() || token == ".")
+      continue;
+    if (token == "..") {
+      _components.push_back({nullptr, 0});
+      continue;
+    }
+
+    size_t nameEnd = 0;
+    if (!isalpha_c(token[0]) && token[0] != '_')
+      throw std::runtime_error("name must begin with alpha or '_' in '"
+                               + _path + "'");
+    while (nameEnd < token.size()
+           && (isalpha_c(token[nameEnd]) || isdigit_c(token[nameEnd])
+               || isspecial_c(token[nameEnd])))
+      ++nameEnd;
+
+    int index = 0;
+    if (nameEnd < token.size()) {
+      if (token[nameEnd] != '[')
+        throw std::runtime_error("illegal characters in token: " + token);
+
+      size_t i = nameEnd + 1;
+      for (; i < token.size() && isdigit_c(token[i]); ++i)
+        index = (index * 10) + (token[i] - '0');
+      if (i != token.size() - 1 || token[i] != ']')
+        throw std::runtime_error("unterminated index (looking for ']')");
+    }
+
+    _components.push_back({intern_name(token.substr(0, nameEnd)), index});
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////
 // Implementation of SGPropertyChangeListener.
 ////////////////////////////////////////////////////////////////////////
@@ -2642,6 +3139,49 @@ SGPropertyChangeListener::SGPropertyChangeListener(bool recursive)
     SG_UNUSED(recursive); // for the moment, all listeners are recursive
 }
 
+size_t
+SGPropertyChangeListener::fireCoalescedChanges ()
+{
+  CoalescedChanges& changes = coalescedChanges();
+  {
+    std::lock_guard<std::mutex> lock(changes.mutex);
+    if (changes.flushing) {
+      SG_LOG(SG_GENERAL, SG_ALERT, "fireCoalescedChanges: called recursively");
+      return 0;
+    }
+    changes.flushing = true;
+    // Changes caused by the listeners we are about to call are delivered
+    // next time.
+    changes.delivering.assign(changes.queue.begin(), changes.queue.end());
+    changes.queue.clear();
+    changes.pending.clear();
+  }
+
+  size_t count = 0;
+  for (;;) {
+    CoalescedChanges::Change change;
+    {
+      // Take one at a time, as each listener might remove others
+      std::lock_guard<std::mutex> lock(changes.mutex);
+      if (changes.delivering.empty()) {
+        changes.flushing = false;
+        break;
+      }
+      change = changes.delivering.front();
+      changes.delivering.pop_front();
+    }
+
+    try {
+      change.first->valueChanged(change.second);
+    }
+    catch (std::exception& e) {
+      SG_LOG(SG_GENERAL, SG_ALERT, "Ignoring exception from property callback: " << e.what());
+    }
+    ++count;
+  }
+  return count;
+}
+
 SGPropertyChangeListener::~SGPropertyChangeListener ()
 {
   for (int i = static_cast<int>(_properties.size() - 1); i >= 0; i--)
@@ -748,6 +748,22 @@ public:
   /// Called if \a child has been removed from its \a parent.
   virtual void childRemoved(SGPropertyNode * parent, SGPropertyNode * child);
 
+  /**
+   * Coalesced listeners don't get valueChanged() called for every single
+   * change. Instead, changes are queued and delivered once per changed node
+   * by fireCoalescedChanges(), which SGSubsystemMgr::update() calls after
+   * each frame. Other notifications are not affected.
+   */
+  void setCoalesced(bool coalesced) { _coalesced = coalesced; }
+  bool isCoalesced() const { return _coalesced; }
+
+  /**
+   * Deliver the changes queued for coalesced listeners.
+   *
+   * @return Number of valueChanged() calls made.
+   */
+  static size_t fireCoalescedChanges();
+
 protected:
     SGPropertyChangeListener(bool recursive = false);
   friend class SGPropertyNode;
@@ -756,10 +772,74 @@ protected:
 
 private:
   std::vector<SGPropertyNode *> _properties;
+  bool _coalesced = false;
 };
 
 
 struct SGPropertyNodeListeners;
+struct SGPropertyChildIndex;
+
+
+/**
+ * A property path which is parsed only once.
+ *
+ * <p>The path is split into its components on construction and the
+ * component names are interned, so resolving it never parses the string
+ * again. The node it resolves to is cached together with the node it was
+ * resolved from, until a child is added to or removed from any property
+ * tree.</p>
+ *
+ * <p>Meant for constant paths which are looked up over and over again,
+ * eg. every frame:</p>
+ *
+ * <pre>
+ * static const SGPropertyPath altitude("/position/altitude-ft");
+ * double alt = root->getDoubleValue(altitude);
+ * </pre>
+ *
+ * <p>Like the property nodes themselves, a path is not thread safe: don't
+ * share an instance between threads.</p>
+ */
+class SGPropertyPath
+{
+public:
+  /**
+   * Parse the given path. Throws std::runtime_error for a malformed path.
+   */
+  explicit SGPropertyPath (const char * path);
+  explicit SGPropertyPath (const std::string& path);
+
+  /**
+   * Get the path as passed to the constructor.
+   */
+  const std::string& str () const { return _path; }
+
+  /**
+   * Test whether the path is resolved starting at the root node.
+   */
+  bool isAbsolute () const { return _absolute; }
+
+private:
+  friend class SGPropertyNode;
+
+  void parse ();
+
+  struct Component
+  {
+    /// Interned name, or nullptr for the parent node ("..")
+    const std::string* name;
+    int index;
+  };
+
+  std::string _path;
+  bool _absolute = false;
+  std::vector<Component> _components;
+
+  // Result of the last resolution
+  mutable const SGPropertyNode* _cachedBase = nullptr;
+  mutable SGPropertyNode* _cachedNode = nullptr;
+  mutable unsigned int _cachedGeneration = 0;
+};
 
 
 /**
@@ -773,7 +853,9 @@ public:
    * Public constants.
    */
   enum {
-    MAX_STRING_LEN = 1024
+    MAX_STRING_LEN = 1024,
+    /// Number of children at which a (name, index) lookup table is built
+    CHILD_INDEX_THRESHOLD = 32
   };
 
   /**
@@ -1154,6 +1236,16 @@ public:
 				  int index) const
   { return getNode(relative_path.c_str(), index); }
 
+  /**
+   * Get a pointer to another node by a preparsed path.
+   */
+  SGPropertyNode * getNode (const SGPropertyPath& path, bool create = false);
+
+  /**
+   * Get a const pointer to another node by a preparsed path.
+   */
+  const SGPropertyNode * getNode (const SGPropertyPath& path) const;
+
   //
   // Access Mode.
   //
@@ -1509,6 +1601,42 @@ public:
   { return getStringValue(relative_path.c_str(), defaultValue); }
 
 
+  /**
+   * Get another node's value as a bool.
+   */
+  bool getBoolValue (const SGPropertyPath& path,
+                     bool defaultValue = false) const;
+
+  /**
+   * Get another node's value as an int.
+   */
+  int getIntValue (const SGPropertyPath& path, int defaultValue = 0) const;
+
+  /**
+   * Get another node's value as a long int.
+   */
+  long getLongValue (const SGPropertyPath& path,
+                     long defaultValue = 0L) const;
+
+  /**
+   * Get another node's value as a float.
+   */
+  float getFloatValue (const SGPropertyPath& path,
+                       float defaultValue = 0.0f) const;
+
+  /**
+   * Get another node's value as a double.
+   */
+  double getDoubleValue (const SGPropertyPath& path,
+                         double defaultValue = 0.0) const;
+
+  /**
+   * Get another node's value as a string.
+   */
+  const char * getStringValue (const SGPropertyPath& path,
+                               const char * defaultValue = "") const;
+
+
   /**
    * Set another node's value as a bool.
    */
@@ -1591,6 +1719,39 @@ public:
    */
   bool setUnspecifiedValue (const char * relative_path, const char * value);
 
+  /**
+   * Set another node's value as a bool.
+   */
+  bool setBoolValue (const SGPropertyPath& path, bool value);
+
+  /**
+   * Set another node's value as an int.
+   */
+  bool setIntValue (const SGPropertyPath& path, int value);
+
+  /**
+   * Set another node's value as a long int.
+   */
+  bool setLongValue (const SGPropertyPath& path, long value);
+
+  /**
+   * Set another node's value as a float.
+   */
+  bool setFloatValue (const SGPropertyPath& path, float value);
+
+  /**
+   * Set another node's value as a double.
+   */
+  bool setDoubleValue (const SGPropertyPath& path, double value);
+
+  /**
+   * Set another node's value as a string.
+   */
+  bool setStringValue (const SGPropertyPath& path, const char * value);
+
+  bool setStringValue (const SGPropertyPath& path, const std::string& value)
+  { return setStringValue(path, value.c_str()); }
+
 
   /**
    * Test whether another node is bound to an external data source.
@@ -1709,6 +1870,10 @@ public:
 
   /**
    * Remove a change listener from the property.
+   *
+   * Waits for notifications of the listener running in other threads to
+   * finish, so the listener may be deleted afterwards. When called from
+   * within a notification, that notification may still be running.
    */
   void removeChangeListener (SGPropertyChangeListener * listener);
 
@@ -1852,12 +2017,20 @@ private:
 
   SGPropertyNodeListeners*  _listeners;
 
+  /// Lookup table for children by name and index. Only built once the node
+  /// has more than CHILD_INDEX_THRESHOLD children.
+  SGPropertyChildIndex* _childIndex = nullptr;
+
+  // Keep _childIndex in sync with _children
+  void appendChild (SGPropertyNode* child);
+  void unindexChild (SGPropertyNode* child);
+
   // Pass name as a pair of iterators
   template<typename Itr>
   SGPropertyNode * getChildImpl (Itr begin, Itr end, int index = 0, bool create = false);
   // very internal method
   template<typename Itr>
-  SGPropertyNode* getExistingChild (Itr begin, Itr end, int index);
+  SGPropertyNode* getExistingChild (Itr begin, Itr end, int index) const;
   // very internal path parsing function
   template<typename SplitItr>
   friend SGPropertyNode* find_node_aux(SGPropertyNode * current, SplitItr& itr,
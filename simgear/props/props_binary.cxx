@@ -0,0 +1,651 @@
+/**
+ * \file props_binary.cxx
+ * Compact binary snapshots of property trees.
+ *
+ * Cache files used by readCachedProperties() consist of a header listing
+ * the source files, followed by a snapshot:
+ *
+ *   "SGPC" u32:version u32:file-count { u32:length path md5 } * file-count
+ *   snapshot
+ *
+ * Layout (all integers little endian, strings are referenced by their
+ * position in the string table):
+ *
+ *   "SGPB" u32:version u32:string-count u32:node-count
+ *   string table: { u32:length bytes '\0' } * string-count
+ *   u32:top-level-count node * top-level-count
+ *
+ *   node: u32:name i32:index u32:attributes u8:type value
+ *         u32:child-count node * child-count
+ *
+ * The value depends on the type: nothing for NONE, u8 for BOOL, i32 for
+ * INT, i64 for LONG, f32 for FLOAT, f64 for DOUBLE, a string for STRING,
+ * UNSPECIFIED and ALIAS and 3 or 4 f64 for VEC3D and VEC4D. The ALIAS
+ * string is the path of the target, resolved like SGPropertyNode::alias():
+ * absolute paths from the root of the tree read into, others from the
+ * alias itself. Snapshots of a tree store absolute paths, cache files the
+ * paths as written in the XML.
+ */
+
+#include <simgear_config.h>
+
+#include "props_binary.hxx"
+
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/math/SGMath.hxx>
+#include <simgear/misc/sg_mmap.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/misc/strutils.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/structure/exception.hxx>
+
+#include "props_io.hxx"
+#include "vectorPropTemplates.hxx"
+
+namespace
+{
+
+const char MAGIC[4] = {'S', 'G', 'P', 'B'};
+const uint32_t VERSION = 1;
+
+const char CACHE_MAGIC[4] = {'S', 'G', 'P', 'C'};
+const uint32_t CACHE_VERSION = 2;
+
+// Value types as stored in the file, independent of simgear::props::Type
+enum BinaryType : uint8_t
+{
+  BT_NONE = 0,
+  BT_ALIAS,
+  BT_BOOL,
+  BT_INT,
+  BT_LONG,
+  BT_FLOAT,
+  BT_DOUBLE,
+  BT_STRING,
+  BT_UNSPECIFIED,
+  BT_VEC3D,
+  BT_VEC4D
+};
+
+////////////////////////////////////////////////////////////////////////
+// Writer.
+////////////////////////////////////////////////////////////////////////
+
+// Targets of the alias nodes of a tree, as they should be written
+typedef std::unordered_map<const SGPropertyNode*, std::string> AliasPaths;
+
+class BinaryWriter
+{
+public:
+  explicit BinaryWriter (const AliasPaths* aliasPaths = nullptr) :
+    _aliasPaths(aliasPaths)
+  {}
+
+  void writeChildren (const SGPropertyNode* node)
+  {
+    int nChildren = node->nChildren();
+    putU32(nChildren);
+    for (int i = 0; i < nChildren; ++i)
+      writeNode(node->getChild(i));
+  }
+
+  void finish (std::ostream& output)
+  {
+    std::string header(MAGIC, sizeof(MAGIC));
+    std::swap(header, _nodes);
+    putU32(VERSION);
+    putU32(static_cast<uint32_t>(_strings.size()));
+    putU32(_nodeCount);
+    for (const std::string* str : _strings) {
+      putU32(static_cast<uint32_t>(str->size()));
+      _nodes.append(*str);
+      _nodes.push_back('\0');
+    }
+    std::swap(header, _nodes);
+
+    output.write(header.data(), header.size());
+    output.write(_nodes.data(), _nodes.size());
+  }
+
+private:
+  void writeNode (const SGPropertyNode* node)
+  {
+    ++_nodeCount;
+    putU32(stringId(node->getNameString()));
+    putU32(static_cast<uint32_t>(node->getIndex()));
+    putU32(static_cast<uint32_t>(node->getAttributes()
+                                 & ~SGPropertyNode::REMOVED));
+
+    using namespace simgear;
+    AliasPaths::const_iterator aliasPath;
+    if (_aliasPaths &&
+        (aliasPath = _aliasPaths->find(node)) != _aliasPaths->end()) {
+      putU8(BT_ALIAS);
+      putU32(stringId(aliasPath->second));
+    } else if (node->isAlias()) {
+      const SGPropertyNode* target = node->getAliasTarget();
+      putU8(BT_ALIAS);
+      putU32(stringId(target ? target->getPath() : std::string()));
+    } else {
+      switch (node->getType()) {
+      case props::BOOL:
+        putU8(BT_BOOL);
+        putU8(node->getBoolValue() ? 1 : 0);
+        break;
+      case props::INT:
+        putU8(BT_INT);
+        putU32(static_cast<uint32_t>(node->getIntValue()));
+        break;
+      case props::LONG:
+        putU8(BT_LONG);
+        putU64(static_cast<uint64_t>(node->getLongValue()));
+        break;
+      case props::FLOAT: {
+        float value = node->getFloatValue();
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        putU8(BT_FLOAT);
+        putU32(bits);
+        break;
+      }
+      case props::DOUBLE:
+        putU8(BT_DOUBLE);
+        putDouble(node->getDoubleValue());
+        break;
+      case props::STRING:
+        putU8(BT_STRING);
+        putU32(stringId(node->getStringValue()));
+        break;
+      case props::UNSPECIFIED:
+        putU8(BT_UNSPECIFIED);
+        putU32(stringId(node->getStringValue()));
+        break;
+      case props::VEC3D: {
+        SGVec3d value = node->getValue<SGVec3d>();
+        putU8(BT_VEC3D);
+        for (int i = 0; i < 3; ++i)
+          putDouble(value[i]);
+        break;
+      }
+      case props::VEC4D: {
+        SGVec4d value = node->getValue<SGVec4d>();
+        putU8(BT_VEC4D);
+        for (int i = 0; i < 4; ++i)
+          putDouble(value[i]);
+        break;
+      }
+      default:
+        putU8(BT_NONE);
+        break;
+      }
+    }
+
+    writeChildren(node);
+  }
+
+  uint32_t stringId (const std::string& str)
+  {
+    auto it = _stringIds.find(str);
+    if (it != _stringIds.end())
+      return it->second;
+
+    uint32_t id = static_cast<uint32_t>(_strings.size());
+    it = _stringIds.emplace(str, id).first;
+    _strings.push_back(&it->first);
+    return id;
+  }
+
+  void putU8 (uint8_t value)
+  {
+    _nodes.push_back(static_cast<char>(value));
+  }
+
+  void putU32 (uint32_t value)
+  {
+    for (int i = 0; i < 4; ++i)
+      _nodes.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+
+  void putU64 (uint64_t value)
+  {
+    putU32(static_cast<uint32_t>(value));
+    putU32(static_cast<uint32_t>(value >> 32));
+  }
+
+  void putDouble (double value)
+  {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    putU64(bits);
+  }
+
+  const AliasPaths* _aliasPaths;
+  std::unordered_map<std::string, uint32_t> _stringIds;
+  std::vector<const std::string*> _strings;
+  std::string _nodes;
+  uint32_t _nodeCount = 0;
+};
+
+////////////////////////////////////////////////////////////////////////
+// Reader.
+////////////////////////////////////////////////////////////////////////
+
+class BinaryReader
+{
+public:
+  BinaryReader (const char* buf, size_t size) :
+    _pos(reinterpret_cast<const uint8_t*>(buf)),
+    _end(_pos + size)
+  {}
+
+  void read (SGPropertyNode* start_node)
+  {
+    if (!isBinaryProperties(reinterpret_cast<const char*>(_pos), _end - _pos))
+      fail("not a binary property file");
+    _pos += sizeof(MAGIC);
+
+    uint32_t version = getU32();
+    if (version != VERSION)
+      fail("unsupported binary property file version");
+
+    uint32_t nStrings = getU32();
+    getU32(); // node count, only informative
+    if (nStrings > static_cast<size_t>(_end - _pos) / 5)
+      fail("bad string count");
+
+    _strings.reserve(nStrings);
+    for (uint32_t i = 0; i < nStrings; ++i) {
+      uint32_t length = getU32();
+      need(static_cast<size_t>(length) + 1);
+      if (_pos[length] != '\0')
+        fail("unterminated string");
+      _strings.push_back(reinterpret_cast<const char*>(_pos));
+      _pos += length + 1;
+    }
+
+    readChildren(start_node);
+
+    for (const auto& alias : _aliases) {
+      if (!alias.first->alias(alias.second.c_str()))
+        SG_LOG(SG_INPUT, SG_ALERT, "readBinaryProperties: failed to set alias "
+               << alias.first->getPath() << " to " << alias.second);
+    }
+  }
+
+private:
+  // parent is nullptr while skipping a write protected subtree
+  void readChildren (SGPropertyNode* parent)
+  {
+    uint32_t nChildren = getU32();
+    for (uint32_t i = 0; i < nChildren; ++i)
+      readNode(parent);
+  }
+
+  void readNode (SGPropertyNode* parent)
+  {
+    const char* name = getString();
+    int index = static_cast<int>(getU32());
+    int attributes = static_cast<int>(getU32());
+    uint8_t type = getU8();
+
+    SGPropertyNode* node = 0;
+    if (parent) {
+      node = parent->getChild(name, index, true);
+      if (!node->getAttribute(SGPropertyNode::WRITE)) {
+        SG_LOG(SG_INPUT, SG_ALERT, "Not overwriting write-protected property "
+               << node->getPath(true));
+        node = 0;
+      }
+    }
+
+    switch (type) {
+    case BT_NONE:
+      break;
+    case BT_ALIAS: {
+      const char* target = getString();
+      if (node)
+        _aliases.emplace_back(node, target);
+      break;
+    }
+    case BT_BOOL: {
+      bool value = getU8() != 0;
+      if (node)
+        node->setBoolValue(value);
+      break;
+    }
+    case BT_INT: {
+      int value = static_cast<int>(getU32());
+      if (node)
+        node->setIntValue(value);
+      break;
+    }
+    case BT_LONG: {
+      long value = static_cast<long>(getU64());
+      if (node)
+        node->setLongValue(value);
+      break;
+    }
+    case BT_FLOAT: {
+      uint32_t bits = getU32();
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      if (node)
+        node->setFloatValue(value);
+      break;
+    }
+    case BT_DOUBLE: {
+      double value = getDouble();
+      if (node)
+        node->setDoubleValue(value);
+      break;
+    }
+    case BT_STRING: {
+      const char* value = getString();
+      if (node)
+        node->setStringValue(value);
+      break;
+    }
+    case BT_UNSPECIFIED: {
+      const char* value = getString();
+      if (node)
+        node->setUnspecifiedValue(value);
+      break;
+    }
+    case BT_VEC3D: {
+      SGVec3d value;
+      for (int i = 0; i < 3; ++i)
+        value[i] = getDouble();
+      if (node)
+        node->setValue(value);
+      break;
+    }
+    case BT_VEC4D: {
+      SGVec4d value;
+      for (int i = 0; i < 4; ++i)
+        value[i] = getDouble();
+      if (node)
+        node->setValue(value);
+      break;
+    }
+    default:
+      fail("unknown value type");
+    }
+
+    // Set the attributes once the value has been assigned, as they might
+    // prevent writing it.
+    if (node)
+      node->setAttributes(attributes);
+
+    readChildren(node);
+  }
+
+  void need (size_t n)
+  {
+    if (static_cast<size_t>(_end - _pos) < n)
+      fail("unexpected end of data");
+  }
+
+  uint8_t getU8 ()
+  {
+    need(1);
+    return *_pos++;
+  }
+
+  uint32_t getU32 ()
+  {
+    need(4);
+    uint32_t value = _pos[0] | (_pos[1] << 8) | (_pos[2] << 16)
+                   | (static_cast<uint32_t>(_pos[3]) << 24);
+    _pos += 4;
+    return value;
+  }
+
+  uint64_t getU64 ()
+  {
+    uint64_t low = getU32();
+    return low | (static_cast<uint64_t>(getU32()) << 32);
+  }
+
+  double getDouble ()
+  {
+    uint64_t bits = getU64();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  const char* getString ()
+  {
+    uint32_t id = getU32();
+    if (id >= _strings.size())
+      fail("bad string reference");
+    return _strings[id];
+  }
+
+  void fail (const char* message)
+  {
+    throw sg_io_exception(std::string("readBinaryProperties: ") + message,
+                          SG_ORIGIN);
+  }
+
+  const uint8_t* _pos;
+  const uint8_t* _end;
+  std::vector<const char*> _strings;
+  std::vector<std::pair<SGPropertyNode*, std::string> > _aliases;
+};
+
+////////////////////////////////////////////////////////////////////////
+// Cache.
+////////////////////////////////////////////////////////////////////////
+
+void putCacheU32 (std::string& out, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+void putCacheString (std::string& out, const std::string& str)
+{
+  putCacheU32(out, static_cast<uint32_t>(str.size()));
+  out.append(str);
+}
+
+bool getCacheU32 (const char*& pos, const char* end, uint32_t& value)
+{
+  if (end - pos < 4)
+    return false;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(pos);
+  value = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+  pos += 4;
+  return true;
+}
+
+bool getCacheString (const char*& pos, const char* end, std::string& str)
+{
+  uint32_t length;
+  if (!getCacheU32(pos, end, length) || static_cast<size_t>(end - pos) < length)
+    return false;
+  str.assign(pos, length);
+  pos += length;
+  return true;
+}
+
+std::string hashFile (const SGPath& path)
+{
+  simgear::MappedFile mapped;
+  if (!mapped.open(path))
+    return std::string();
+  return simgear::strutils::md5(mapped.data(), mapped.size());
+}
+
+/**
+ * Check the source files listed in a cache file. Returns the offset of
+ * the snapshot, or 0 if the cache is stale or broken.
+ */
+size_t checkCache (const char* buf, size_t size)
+{
+  const char* pos = buf;
+  const char* end = buf + size;
+  if (size < sizeof(CACHE_MAGIC)
+      || memcmp(buf, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+    return 0;
+  pos += sizeof(CACHE_MAGIC);
+
+  uint32_t version, nFiles;
+  if (!getCacheU32(pos, end, version) || version != CACHE_VERSION
+      || !getCacheU32(pos, end, nFiles))
+    return 0;
+
+  for (uint32_t i = 0; i < nFiles; ++i) {
+    std::string path, hash;
+    if (!getCacheString(pos, end, path) || !getCacheString(pos, end, hash))
+      return 0;
+    if (hashFile(SGPath::fromUtf8(path)) != hash)
+      return 0;
+  }
+  return pos - buf;
+}
+
+} // of anonymous namespace
+
+void
+writeBinaryProperties (std::ostream &output, const SGPropertyNode * start_node)
+{
+  BinaryWriter writer;
+  writer.writeChildren(start_node);
+  writer.finish(output);
+}
+
+void
+writeBinaryProperties (const SGPath &file, const SGPropertyNode * start_node)
+{
+  SGPath(file).create_dir(0755);
+
+  sg_ofstream output(file, std::ios::out | std::ios::binary);
+  if (!output.good())
+    throw sg_io_exception("Cannot open file", sg_location(file), SG_ORIGIN);
+
+  writeBinaryProperties(output, start_node);
+  if (!output.good())
+    throw sg_io_exception("Failed to write file", sg_location(file), SG_ORIGIN);
+}
+
+bool
+isBinaryProperties (const char *buf, size_t size)
+{
+  return size >= sizeof(MAGIC) && memcmp(buf, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void
+readBinaryProperties (const char *buf, size_t size, SGPropertyNode * start_node)
+{
+  BinaryReader reader(buf, size);
+  reader.read(start_node);
+}
+
+void
+readBinaryProperties (const SGPath &file, SGPropertyNode * start_node)
+{
+  simgear::MappedFile mapped;
+  if (!mapped.open(file))
+    throw sg_io_exception("Cannot open file", sg_location(file), SG_ORIGIN);
+
+  readBinaryProperties(mapped.data(), mapped.size(), start_node);
+}
+
+bool
+readCachedProperties (const SGPath &file, SGPropertyNode * start_node,
+                      const SGPath &cache_dir, int default_mode, bool extended)
+{
+  std::ostringstream key;
+  key << file.realpath().utf8Str() << '|' << default_mode << '|' << extended;
+  SGPath cacheFile = cache_dir / (simgear::strutils::md5(key.str()) + ".sgpc");
+
+  if (cacheFile.exists()) {
+    simgear::MappedFile mapped(cacheFile);
+    size_t offset = mapped.isOpen() ? checkCache(mapped.data(), mapped.size()) : 0;
+    if (offset > 0) {
+      try {
+        readBinaryProperties(mapped.data() + offset, mapped.size() - offset,
+                             start_node);
+        return true;
+      } catch (sg_io_exception& e) {
+        // Nothing has been read if the header is broken, otherwise the
+        // XML file overwrites whatever has been read so far.
+        SG_LOG(SG_INPUT, SG_WARN, "Ignoring broken property cache "
+               << cacheFile << ": " << e.getFormattedMessage());
+      }
+    }
+  }
+
+  // Read into a new tree, so the snapshot only contains what comes from
+  // the files, then copy that over by reading the snapshot. Aliases are
+  // kept as written, to be resolved in the tree they end up in.
+  SGPropertyNode_ptr tree(new SGPropertyNode);
+  std::vector<SGPath> files;
+  std::vector<std::pair<SGPropertyNode_ptr, std::string> > aliases;
+  readProperties(file, tree, default_mode, extended, files, &aliases);
+
+  AliasPaths aliasPaths;
+  for (const auto& alias : aliases) {
+    // an alias moved elsewhere (by omit-node) can't be found anymore,
+    // don't cache such files
+    const SGPropertyNode* top = alias.first;
+    while (top->getParent())
+      top = top->getParent();
+    if (top != tree) {
+      SG_LOG(SG_INPUT, SG_DEBUG, "Not caching " << file
+             << ", alias " << alias.first->getPath() << " has moved");
+      readProperties(file, start_node, default_mode, extended);
+      return false;
+    }
+    aliasPaths[alias.first] = alias.second;
+  }
+
+  std::ostringstream snapshot;
+  BinaryWriter writer(&aliasPaths);
+  writer.writeChildren(tree);
+  writer.finish(snapshot);
+  const std::string data = snapshot.str();
+  readBinaryProperties(data.data(), data.size(), start_node);
+
+  std::string header(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  putCacheU32(header, CACHE_VERSION);
+  putCacheU32(header, static_cast<uint32_t>(files.size()));
+  for (const SGPath& path : files) {
+    putCacheString(header, path.utf8Str());
+    putCacheString(header, hashFile(path));
+  }
+
+  // Write to a temporary file first, so nobody sees a partial cache file.
+  SGPath tmpFile(cacheFile);
+  tmpFile.concat(".tmp");
+  tmpFile.create_dir(0755);
+  {
+    sg_ofstream output(tmpFile, std::ios::out | std::ios::binary);
+    output.write(header.data(), header.size());
+    output.write(data.data(), data.size());
+    if (!output.good()) {
+      SG_LOG(SG_INPUT, SG_WARN, "Failed to write property cache " << tmpFile);
+      return false;
+    }
+  }
+  // the cache directory might have been created in the meantime
+  cacheFile.set_cached(false);
+  if (cacheFile.exists())
+    cacheFile.remove();
+  if (!tmpFile.rename(cacheFile))
+    SG_LOG(SG_INPUT, SG_WARN, "Failed to write property cache " << cacheFile);
+  return false;
+}
+
+// end of props_binary.cxx
@@ -0,0 +1,75 @@
+/**
+ * \file props_binary.hxx
+ * Compact binary snapshots of property trees.
+ *
+ * A snapshot stores a subtree with its names, indices, typed values,
+ * attributes and aliases. Loading it doesn't involve any parsing beyond a
+ * single sequential pass over the data, so it can be read straight from a
+ * memory mapped file.
+ */
+
+#ifndef __PROPS_BINARY_HXX
+#define __PROPS_BINARY_HXX
+
+#include <simgear/compiler.h>
+#include <simgear/props/props.hxx>
+
+#include <cstddef>
+#include <iosfwd>
+
+class SGPath;
+
+/**
+ * Write the children of start_node (and their values, attributes and
+ * aliases) as a binary snapshot.
+ */
+void writeBinaryProperties (std::ostream &output,
+                            const SGPropertyNode * start_node);
+
+/**
+ * Write a binary snapshot to a file.
+ */
+void writeBinaryProperties (const SGPath &file,
+                            const SGPropertyNode * start_node);
+
+/**
+ * Read a binary snapshot from an in-memory buffer into start_node.
+ *
+ * Like readProperties(), existing nodes are overwritten, and write
+ * protected nodes are left untouched. Aliases are resolved once the whole
+ * snapshot has been read. Throws sg_io_exception for malformed data.
+ */
+void readBinaryProperties (const char *buf, size_t size,
+                           SGPropertyNode * start_node);
+
+/**
+ * Read a binary snapshot from a (memory mapped) file into start_node.
+ */
+void readBinaryProperties (const SGPath &file, SGPropertyNode * start_node);
+
+/**
+ * Test whether a buffer starts like a binary snapshot.
+ */
+bool isBinaryProperties (const char *buf, size_t size);
+
+/**
+ * Read properties from an XML file, using a binary snapshot cache.
+ *
+ * The first time, the file is read with readProperties() and the result
+ * (including everything the file includes) is stored as a binary snapshot
+ * in cache_dir, together with a hash of every file read. As long as none
+ * of these files change, later calls load the snapshot instead of parsing
+ * the XML files again.
+ *
+ * Aliases are resolved in the destination tree, just like when reading
+ * the XML file directly.
+ *
+ * @return true if the properties have been loaded from the cache.
+ */
+bool readCachedProperties (const SGPath &file, SGPropertyNode * start_node,
+                           const SGPath &cache_dir, int default_mode = 0,
+                           bool extended = false);
+
+#endif // __PROPS_BINARY_HXX
+
+// end of props_binary.hxx
@@ -50,6 +50,13 @@ using std::endl;
 const std::string ATTR = "_attr_";
 
 
+// Files read by readProperties(), if someone is interested in them.
+static thread_local vector<SGPath>* readFiles = nullptr;
+
+// Alias attributes left for someone else to resolve, see readProperties().
+static thread_local vector<std::pair<SGPropertyNode_ptr, string> >* readAliases = nullptr;
+
+
 ////////////////////////////////////////////////////////////////////////
 // Property list visitor, for XML parsing.
 ////////////////////////////////////////////////////////////////////////
@@ -258,7 +265,9 @@ PropsVisitor::startElement (const char * name, const XMLAttributes &atts)
       // Check for an alias.
       else if( att_name == "alias" )
       {
-        if( !node->alias(val) )
+        if( readAliases )
+          readAliases->emplace_back(node, val);
+        else if( !node->alias(val) )
           SG_LOG
           (
             SG_INPUT,
@@ -426,7 +435,6 @@ readProperties (istream &input, SGPropertyNode * start_node,
     throw visitor.getException();
 }
 
-
 /**
  * Read properties from a file.
  *
@@ -438,6 +446,9 @@ void
 readProperties (const SGPath &file, SGPropertyNode * start_node,
                 int default_mode, bool extended)
 {
+  if (readFiles)
+    readFiles->push_back(file);
+
   PropsVisitor visitor(start_node, file.utf8Str(), default_mode, extended);
   readXML(file, visitor);
   if (visitor.hasException())
@@ -445,6 +456,30 @@ readProperties (const SGPath &file, SGPropertyNode * start_node,
 }
 
 
+/**
+ * Read properties from a file, recording all files read.
+ */
+void
+readProperties (const SGPath &file, SGPropertyNode * start_node,
+                int default_mode, bool extended, vector<SGPath> &files,
+                vector<std::pair<SGPropertyNode_ptr, string> > *aliases)
+{
+  vector<SGPath>* previousFiles = readFiles;
+  vector<std::pair<SGPropertyNode_ptr, string> >* previousAliases = readAliases;
+  readFiles = &files;
+  readAliases = aliases;
+  try {
+    readProperties(file, start_node, default_mode, extended);
+  } catch (...) {
+    readFiles = previousFiles;
+    readAliases = previousAliases;
+    throw;
+  }
+  readFiles = previousFiles;
+  readAliases = previousAliases;
+}
+
+
 /**
  * Read properties from an in-memory buffer.
  *
@@ -16,6 +16,7 @@
 #include <simgear/props/props.hxx>
 
 #include <string>
+#include <vector>
 #include <iosfwd>
 #include <functional>
 
@@ -34,6 +35,20 @@ void readProperties (const SGPath &file, SGPropertyNode * start_node,
                      int default_mode = 0, bool extended = false);
 
 
+/**
+ * Read properties from an XML file, appending the paths of all files read
+ * (the file itself and everything it includes) to files.
+ *
+ * If aliases is given, alias attributes are not resolved but appended to
+ * it, as the node and the target path as written in the file.
+ */
+void readProperties (const SGPath &file, SGPropertyNode * start_node,
+                     int default_mode, bool extended,
+                     std::vector<SGPath> &files,
+                     std::vector<std::pair<SGPropertyNode_ptr, std::string> >
+                       *aliases = nullptr);
+
+
 /**
  * Read properties from an in-memory buffer.
  */
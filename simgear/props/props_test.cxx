@@ -8,17 +8,26 @@
 #include <simgear/compiler.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>               // std::unique_ptr
+#include <thread>
 #include <iostream>
 #include <map>
 #include <exception>
 
 #include "props.hxx"
+#include "props_binary.hxx"
 #include "props_io.hxx"
+#include "vectorPropTemplates.hxx"
 
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/math/SGMath.hxx>
 #include <simgear/misc/test_macros.hxx>
+#include <simgear/misc/sg_dir.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/misc/test_macros.hxx>
+#include <simgear/structure/exception.hxx>
 
 using std::cout;
 using std::cerr;
@@ -408,6 +417,88 @@ void test_addChild()
   dump_node(&root);
 }
 
+void testChildIndex()
+{
+  SGPropertyNode_ptr root(new SGPropertyNode);
+  SGPropertyNode* models = root->getNode("ai/models", true);
+
+  // enough children to make the node build its lookup table
+  const int count = 4 * SGPropertyNode::CHILD_INDEX_THRESHOLD;
+  for (int i = 0; i < count; ++i) {
+    models->addChild("aircraft")->setIntValue(i);
+    models->addChild("carrier");
+  }
+  SG_CHECK_EQUAL(models->nChildren(), 2 * count);
+  SG_CHECK_EQUAL(models->getChildren("aircraft").size(), static_cast<size_t>(count));
+  SG_CHECK_EQUAL(root->getIntValue("ai/models/aircraft[100]"), 100);
+  SG_CHECK_EQUAL(models->getChild("carrier", count - 1)->getIndex(), count - 1);
+  SG_VERIFY(models->getChild("carrier", count) == nullptr);
+
+  // removing children must leave a hole which is filled again by addChild
+  SG_VERIFY(models->removeChild("aircraft", 10));
+  SG_VERIFY(models->getChild("aircraft", 10) == nullptr);
+  SG_CHECK_EQUAL(models->getChildren("aircraft").size(), static_cast<size_t>(count - 1));
+  SG_CHECK_EQUAL(models->addChild("aircraft", 0, false)->getIndex(), 10);
+  SG_CHECK_EQUAL(models->addChild("aircraft", 0, true)->getIndex(), count);
+
+  // getChildren() has to be sorted by index
+  simgear::PropertyList aircraft = models->getChildren("aircraft");
+  for (size_t i = 0; i < aircraft.size(); ++i)
+    SG_CHECK_EQUAL(aircraft[i]->getIndex(), static_cast<int>(i));
+
+  simgear::PropertyList removed = models->removeChildren("carrier");
+  SG_CHECK_EQUAL(removed.size(), static_cast<size_t>(count));
+  SG_VERIFY(models->getChildren("carrier").empty());
+  SG_VERIFY(models->getNode("carrier[3]") == nullptr);
+  SG_CHECK_EQUAL(models->addChild("carrier")->getIndex(), 0);
+
+  models->removeAllChildren();
+  SG_CHECK_EQUAL(models->nChildren(), 0);
+  SG_VERIFY(models->getNode("aircraft[1]") == nullptr);
+}
+void testPropertyPath()
+{
+  SGPropertyNode_ptr root(new SGPropertyNode);
+  root->setDoubleValue("position/altitude-ft", 1000.0);
+  root->setIntValue("engines/engine[2]/rpm", 2400);
+
+  const SGPropertyPath altitude("/position/altitude-ft");
+  const SGPropertyPath rpm("engines/./engine[2]/rpm");
+  const SGPropertyPath missing("engines/engine[3]/rpm");
+  const SGPropertyPath up("../../position");
+  SG_VERIFY(altitude.isAbsolute());
+  SG_VERIFY(!rpm.isAbsolute());
+
+  SG_CHECK_EQUAL(root->getDoubleValue(altitude), 1000.0);
+  SG_CHECK_EQUAL(root->getIntValue(rpm), 2400);
+  SG_CHECK_EQUAL(root->getNode(rpm), root->getNode("engines/engine[2]/rpm"));
+  SG_CHECK_EQUAL(root->getIntValue(missing, 7), 7);
+
+  // absolute paths work from any node, relative ones from the given node
+  SGPropertyNode* engine = root->getNode("engines/engine[2]");
+  SG_CHECK_EQUAL(engine->getDoubleValue(altitude), 1000.0);
+  SG_CHECK_EQUAL(engine->getNode(up), root->getNode("position"));
+
+  // cached lookups have to notice structural changes
+  root->setIntValue(missing, 1200);
+  SG_CHECK_EQUAL(root->getIntValue(missing), 1200);
+  SG_CHECK_EQUAL(root->getIntValue("engines/engine[3]/rpm"), 1200);
+
+  SGPropertyNode_ptr old = root->getNode(rpm);
+  root->getNode("engines")->removeChild("engine", 2);
+  SG_VERIFY(root->getNode(rpm) == nullptr);
+  root->setIntValue(rpm, 100);
+  SG_VERIFY(root->getNode(rpm) != old);
+  SG_CHECK_EQUAL(root->getIntValue("engines/engine[2]/rpm"), 100);
+
+  bool threw = false;
+  try {
+    SGPropertyPath bad("engines/engine[2/rpm");
+  } catch (std::runtime_error&) {
+    threw = true;
+  }
+  SG_VERIFY(threw);
+}
 
 bool ensureNListeners(SGPropertyNode* node, int n)
 {
@@ -955,6 +1046,230 @@ void testDeleterListener()
     }
 }
 
+// Records the nodes it is told about, without keeping them alive
+class ChangedNodes : public SGPropertyChangeListener
+{
+public:
+    std::vector<SGPropertyNode*> changed;
+
+    void valueChanged(SGPropertyNode* node) override
+    {
+        changed.push_back(node);
+    }
+};
+
+void testCoalescedListener()
+{
+    SGPropertyNode_ptr tree(new SGPropertyNode);
+    defineSamplePropertyTree(tree);
+
+    TestListener l(tree.get());
+    l.setCoalesced(true);
+    tree->getNode("position/body")->addChangeListener(&l);
+
+    for (int i = 0; i < 10; ++i) {
+        tree->setIntValue("position/body/a", i);
+        tree->setIntValue("position/body/c", i);
+    }
+    SG_CHECK_EQUAL(l.checkValueChangeCount("position/body/a"), 0);
+
+    // one notification per node, no matter how often it changed
+    size_t fired = SGPropertyChangeListener::fireCoalescedChanges();
+    SG_CHECK_EQUAL(fired, 2);
+    SG_CHECK_EQUAL(l.checkValueChangeCount("position/body/a"), 1);
+    SG_CHECK_EQUAL(l.checkValueChangeCount("position/body/c"), 1);
+    fired = SGPropertyChangeListener::fireCoalescedChanges();
+    SG_CHECK_EQUAL(fired, 0);
+
+    // pending changes of removed listeners must be dropped
+    tree->setIntValue("position/body/d", 1);
+    tree->getNode("position/body")->removeChangeListener(&l);
+    fired = SGPropertyChangeListener::fireCoalescedChanges();
+    SG_CHECK_EQUAL(fired, 0);
+    SG_CHECK_EQUAL(l.checkValueChangeCount("position/body/d"), 0);
+
+    // and so must those of destroyed nodes, although only their parent
+    // has the listener
+    ChangedNodes parentListener;
+    parentListener.setCoalesced(true);
+    SGPropertyNode* body = tree->getNode("position/body");
+    body->addChangeListener(&parentListener);
+    body->getNode("doomed", true)->setIntValue(1);
+    tree->setIntValue("position/body/a", 42);
+    SG_CHECK_EQUAL(body->getChild("doomed")->nListeners(), 0);
+    body->removeChild("doomed", 0); // the last reference
+    fired = SGPropertyChangeListener::fireCoalescedChanges();
+    SG_CHECK_EQUAL(fired, 1);
+    SG_CHECK_EQUAL(parentListener.changed.size(), 1);
+    SG_VERIFY(parentListener.changed[0] == tree->getNode("position/body/a"));
+    body->removeChangeListener(&parentListener);
+}
+
+// Counts the calls which are still running, or starting, once the listener
+// has been removed, i.e. after it could have been deleted.
+class SlowListener : public SGPropertyChangeListener
+{
+public:
+    std::atomic<bool> calling{false};
+    std::atomic<bool> removed{false};
+    std::atomic<int> lateCalls{0};
+
+    void valueChanged(SGPropertyNode*) override
+    {
+        if (removed)
+            ++lateCalls;
+        calling = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        if (removed)
+            ++lateCalls;
+    }
+};
+
+void testRemoveListenerWhileFiring()
+{
+    SGPropertyNode_ptr tree(new SGPropertyNode);
+    SGPropertyNode* node = tree->getNode("position/body/a", true);
+
+    for (int round = 0; round < 20; ++round) {
+        SlowListener l;
+        node->addChangeListener(&l);
+
+        std::atomic<bool> stop{false};
+        std::thread firing([node, &stop]() {
+            for (int i = 0; !stop; ++i)
+                node->setIntValue(i);
+        });
+
+        while (!l.calling)
+            std::this_thread::yield();
+        // must wait for the call running in the other thread
+        node->removeChangeListener(&l);
+        l.removed = true;
+
+        stop = true;
+        firing.join();
+        SG_CHECK_EQUAL(l.lateCalls.load(), 0);
+    }
+}
+
+void testBinaryProperties()
+{
+    SGPropertyNode_ptr tree(new SGPropertyNode);
+    defineSamplePropertyTree(tree);
+    tree->setLongValue("misc/long", 1234567890123L);
+    tree->setFloatValue("misc/float", 0.25f);
+    tree->setUnspecifiedValue("misc/unspecified", "42");
+    tree->getNode("misc/vec3", true)->setValue(SGVec3d(1, 2, 3));
+    tree->getNode("misc/none", true);
+    tree->getNode("misc/readonly", true)->setAttributes(SGPropertyNode::READ
+                                                       | SGPropertyNode::ARCHIVE);
+    tree->getNode("misc/alias", true)->alias(tree->getNode("velocity/body/x"));
+
+    std::ostringstream output;
+    writeBinaryProperties(output, tree);
+    const std::string data = output.str();
+    SG_VERIFY(isBinaryProperties(data.data(), data.size()));
+
+    SGPropertyNode_ptr copy(new SGPropertyNode);
+    readBinaryProperties(data.data(), data.size(), copy);
+    SG_VERIFY(SGPropertyNode::compare(*tree, *copy));
+    SG_CHECK_EQUAL(copy->getNode("misc/long")->getType(), simgear::props::LONG);
+    SG_CHECK_EQUAL(copy->getLongValue("misc/long"), 1234567890123L);
+    SG_CHECK_EQUAL(copy->getNode("misc/unspecified")->getType(),
+                   simgear::props::UNSPECIFIED);
+    SG_VERIFY(copy->getNode("misc/vec3")->getValue<SGVec3d>() == SGVec3d(1, 2, 3));
+    SG_VERIFY(!copy->getNode("misc/none")->hasValue());
+    SG_CHECK_EQUAL(copy->getNode("misc/readonly")->getAttributes(),
+                   SGPropertyNode::READ | SGPropertyNode::ARCHIVE);
+    SG_VERIFY(copy->getNode("misc/alias")->isAlias());
+    SG_CHECK_EQUAL(copy->getNode("misc/alias")->getAliasTarget(),
+                   copy->getNode("velocity/body/x"));
+
+    // truncated data must be rejected
+    bool threw = false;
+    try {
+        SGPropertyNode_ptr broken(new SGPropertyNode);
+        readBinaryProperties(data.data(), data.size() / 2, broken);
+    } catch (sg_io_exception&) {
+        threw = true;
+    }
+    SG_VERIFY(threw);
+}
+
+void testCachedProperties()
+{
+    simgear::Dir tmp = simgear::Dir::tempDir("sgprops");
+    tmp.setRemoveOnDestroy();
+    const SGPath xml = tmp.file("test.xml");
+    const SGPath include = tmp.file("include.xml");
+    const SGPath cacheDir = tmp.file("cache");
+
+    {
+        sg_ofstream out(include);
+        out << "<PropertyList><b type=\"int\">1</b></PropertyList>";
+    }
+    {
+        sg_ofstream out(xml);
+        out << "<PropertyList><a type=\"double\">2.5</a>"
+            << "<c include=\"include.xml\"/></PropertyList>";
+    }
+
+    SGPropertyNode_ptr first(new SGPropertyNode);
+    SG_VERIFY(!readCachedProperties(xml, first, cacheDir));
+    SG_CHECK_EQUAL(first->getDoubleValue("a"), 2.5);
+    SG_CHECK_EQUAL(first->getIntValue("c/b"), 1);
+
+    SGPropertyNode_ptr second(new SGPropertyNode);
+    SG_VERIFY(readCachedProperties(xml, second, cacheDir));
+    SG_VERIFY(SGPropertyNode::compare(*first, *second));
+
+    // changing an included file invalidates the cache
+    {
+        sg_ofstream out(include);
+        out << "<PropertyList><b type=\"int\">3</b></PropertyList>";
+    }
+    SGPropertyNode_ptr third(new SGPropertyNode);
+    SG_VERIFY(!readCachedProperties(xml, third, cacheDir));
+    SG_CHECK_EQUAL(third->getIntValue("c/b"), 3);
+}
+
+void testCachedPropertiesAliases()
+{
+    simgear::Dir tmp = simgear::Dir::tempDir("sgprops");
+    tmp.setRemoveOnDestroy();
+    const SGPath xml = tmp.file("aliases.xml");
+    const SGPath cacheDir = tmp.file("cache");
+
+    {
+        sg_ofstream out(xml);
+        out << "<PropertyList><x type=\"int\">5</x>"
+            << "<rel alias=\"../x\"/><abs alias=\"/sim/foo\"/>"
+            << "</PropertyList>";
+    }
+
+    // aliases resolve the same way, loaded below the root, with and without
+    // the cache
+    SGPropertyNode_ptr plain(new SGPropertyNode);
+    readProperties(xml, plain->getNode("models/m", true));
+
+    SGPropertyNode_ptr first(new SGPropertyNode);
+    SG_VERIFY(!readCachedProperties(xml, first->getNode("models/m", true), cacheDir));
+    SGPropertyNode_ptr second(new SGPropertyNode);
+    SG_VERIFY(readCachedProperties(xml, second->getNode("models/m", true), cacheDir));
+
+    for (SGPropertyNode_ptr tree : {plain, first, second}) {
+        SGPropertyNode* rel = tree->getNode("models/m/rel");
+        SGPropertyNode* abs = tree->getNode("models/m/abs");
+        SG_VERIFY(rel && rel->isAlias());
+        SG_VERIFY(abs && abs->isAlias());
+        SG_CHECK_EQUAL(rel->getAliasTarget(), tree->getNode("models/m/x"));
+        SG_CHECK_EQUAL(rel->getIntValue(), 5);
+        SG_CHECK_EQUAL(abs->getAliasTarget(), tree->getNode("sim/foo"));
+        SG_VERIFY(!tree->getNode("models/m/sim"));
+        SG_VERIFY(SGPropertyNode::compare(*plain, *tree));
+    }
+}
+
 int main (int ac, char ** av)
 {
   test_value();
@@ -973,11 +1288,18 @@ int main (int ac, char ** av)
   }
 
   test_addChild();
+  testChildIndex();
+  testPropertyPath();
 
     testListener();
     tiedPropertiesTest();
     tiedPropertiesListeners();
     testDeleterListener();
+    testCoalescedListener();
+    testRemoveListenerWhileFiring();
+    testBinaryProperties();
+    testCachedProperties();
+    testCachedPropertiesAliases();
 
     // disable test for the moment
    // testAliasedListeners();
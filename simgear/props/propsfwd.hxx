@@ -27,6 +27,7 @@
 #include <vector>
 
 class SGPropertyNode;
+class SGPropertyPath;
 
 typedef SGSharedPtr<SGPropertyNode> SGPropertyNode_ptr;
 typedef SGSharedPtr<const SGPropertyNode> SGConstPropertyNode_ptr;
@@ -349,6 +349,13 @@ public:
    */
      bool valid(SGVec2f loc) const;
 
+  /**
+   * Condition and geographical areas checked by valid(), for
+   * SGMaterialLib to resolve materials ahead of time.
+   */
+  const SGCondition* get_condition() const { return condition; }
+  const std::shared_ptr<AreaList>& get_areas() const { return areas; }
+
   /**
    * Return pointer to glyph class, or 0 if it doesn't exist.
    */
@@ -32,6 +32,9 @@
 #include <string.h>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <set>
 
 #include <osgDB/Registry>
 
@@ -55,7 +58,61 @@ using std::string;
 class SGMaterialLib::MatLibPrivate
 {
 public:
+    // Marks the index out of date when a property used by a region
+    // condition changes
+    class ConditionListener : public SGPropertyChangeListener
+    {
+    public:
+        ConditionListener(std::atomic<bool>& dirty) : _dirty(dirty) {}
+        void valueChanged(SGPropertyNode*) override { _dirty = true; }
+    private:
+        std::atomic<bool>& _dirty;
+    };
+
+    MatLibPrivate() :
+        dirty(true),
+        indexable(true),
+        listener(dirty)
+    {
+    }
+
+    // Index of the table for a location, or -1 if the location is on a
+    // cell border and must be resolved by evaluating the materials
+    int findCell(SGVec2f loc) const
+    {
+        if (std::binary_search(lons.begin(), lons.end(), loc.x()) ||
+            std::binary_search(lats.begin(), lats.end(), loc.y()))
+            return -1;
+        size_t x = std::upper_bound(lons.begin(), lons.end(), loc.x()) - lons.begin();
+        size_t y = std::upper_bound(lats.begin(), lats.end(), loc.y()) - lats.begin();
+        return cells[y*(lons.size() + 1) + x];
+    }
+
+    // A point inside the cell between border i-1 and border i
+    static float cellCenter(const std::vector<float>& borders, size_t i)
+    {
+        if (borders.empty())
+            return 0.0f;
+        if (i == 0)
+            return borders.front() - 1.0f;
+        if (i == borders.size())
+            return borders.back() + 1.0f;
+        return 0.5f*(borders[i - 1] + borders[i]);
+    }
+
     std::mutex mutex;
+
+    std::atomic<bool> dirty;
+    bool indexable;
+    ConditionListener listener;
+
+    // Sorted, unique area borders. Cell (x, y) lies between borders x-1
+    // and x of lons, and y-1 and y of lats; cells holds for each the
+    // index of its resolved materials in tables.
+    std::vector<float> lons;
+    std::vector<float> lats;
+    std::vector<unsigned> cells;
+    std::vector<SGMaterialCache::material_cache_ptr> tables;
 };
 
 // Constructor
@@ -83,6 +140,8 @@ bool SGMaterialLib::load( const SGPath &fg_root, const SGPath& mpath,
     options->setObjectCacheHint(osgDB::Options::CACHE_ALL);
     options->setDatabasePath(fg_root.utf8Str());
 
+    std::set<const SGPropertyNode*> conditionProps;
+
     simgear::PropertyList blocks = materialblocks.getChildren("region");
     simgear::PropertyList::const_iterator block_iter = blocks.begin();
 
@@ -124,6 +183,7 @@ bool SGMaterialLib::load( const SGPath &fg_root, const SGPath& mpath,
 		SGSharedPtr<const SGCondition> condition;
 		if (conditionNode) {
 			condition = sgReadCondition(prop_root, conditionNode);
+			condition->collectDependentProperties(conditionProps);
 		}
 
 		// Now build all the materials for this set of areas and conditions
@@ -148,11 +208,34 @@ bool SGMaterialLib::load( const SGPath &fg_root, const SGPath& mpath,
 		}
     }
 
+    std::lock_guard<std::mutex> lock(d->mutex);
+    for (const SGPropertyNode* prop : conditionProps) {
+        if (prop->isTied()) {
+            SG_LOG( SG_TERRAIN, SG_INFO, "Material condition uses tied property "
+                    << prop->getPath() << ", not indexing materials" );
+            d->indexable = false;
+        }
+        const_cast<SGPropertyNode*>(prop)->addChangeListener(&d->listener);
+    }
+    d->dirty = true;
+
     return true;
 }
 
 // find a material record by material name and tile center
 SGMaterial *SGMaterialLib::find( const string& material, const SGVec2f center ) const
+{
+    SGMaterialCache::material_cache_ptr table = findTable(center);
+    if (!table)
+        return findUnindexed(material, center);
+
+    SGMaterialCache::material_cache::const_iterator it = table->find(material);
+    return it != table->end() ? it->second.get() : NULL;
+}
+
+// find a material by evaluating the conditions and areas of all
+// candidates
+SGMaterial *SGMaterialLib::findUnindexed( const string& material, const SGVec2f center ) const
 {
     SGMaterial *result = NULL;
     const_material_map_iterator it = matlib.find( material );
@@ -182,16 +265,126 @@ SGMaterial *SGMaterialLib::find( const string& material, const SGGeod& center )
 }
 
 SGMaterialCache *SGMaterialLib::generateMatCache(SGVec2f center)
+{
+    SGMaterialCache::material_cache_ptr table = findTable(center);
+    if (table)
+        return new SGMaterialCache(table);
+    return generateUnindexedMatCache(center);
+}
+
+SGMaterialCache *SGMaterialLib::generateUnindexedMatCache(SGVec2f center) const
 {
 	SGMaterialCache* newCache = new SGMaterialCache();
     material_map::const_reverse_iterator it = matlib.rbegin();
     for (; it != matlib.rend(); ++it) {
-        newCache->insert(it->first, find(it->first, center));
+        newCache->insert(it->first, findUnindexed(it->first, center));
     }
     
     return newCache;
 }
 
+// The materials resolved for a location by the index, null if the
+// index can't answer
+SGMaterialCache::material_cache_ptr SGMaterialLib::findTable(SGVec2f center) const
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    if (!d->indexable)
+        return SGMaterialCache::material_cache_ptr();
+    if (d->dirty.exchange(false))
+        rebuildIndex();
+    int cell = d->findCell(center);
+    if (cell < 0)
+        return SGMaterialCache::material_cache_ptr();
+    return d->tables[cell];
+}
+
+// Resolve all materials for every cell of the area borders. Conditions
+// don't depend on the location, so they are evaluated once per region;
+// cells inside the same set of region areas share their table. Called
+// with the mutex held.
+void SGMaterialLib::rebuildIndex() const
+{
+    std::map<const SGCondition*, bool> conditions;
+    std::map<const AreaList*, unsigned> areaLists;
+    std::vector<const AreaList*> areaListVector;
+
+    d->lons.clear();
+    d->lats.clear();
+    for (const_material_map_iterator it = begin(); it != end(); ++it) {
+        for (const SGSharedPtr<SGMaterial>& m : it->second) {
+            const SGCondition* condition = m->get_condition();
+            if (condition && !conditions.count(condition))
+                conditions[condition] = condition->test();
+
+            const AreaList* areas = m->get_areas().get();
+            if (areas->empty() || areaLists.count(areas))
+                continue;
+            areaLists[areas] = areaListVector.size();
+            areaListVector.push_back(areas);
+            for (const SGRect<float>& area : *areas) {
+                d->lons.push_back(area.l());
+                d->lons.push_back(area.r());
+                d->lats.push_back(area.t());
+                d->lats.push_back(area.b());
+            }
+        }
+    }
+    std::sort(d->lons.begin(), d->lons.end());
+    d->lons.erase(std::unique(d->lons.begin(), d->lons.end()), d->lons.end());
+    std::sort(d->lats.begin(), d->lats.end());
+    d->lats.erase(std::unique(d->lats.begin(), d->lats.end()), d->lats.end());
+
+    // The area lists containing each cell decide its materials
+    std::map<std::vector<bool>, unsigned> tableIndex;
+    d->cells.clear();
+    d->tables.clear();
+    for (size_t y = 0; y <= d->lats.size(); ++y) {
+        float lat = MatLibPrivate::cellCenter(d->lats, y);
+        for (size_t x = 0; x <= d->lons.size(); ++x) {
+            float lon = MatLibPrivate::cellCenter(d->lons, x);
+            std::vector<bool> inside(areaListVector.size(), false);
+            for (size_t i = 0; i < areaListVector.size(); ++i) {
+                for (const SGRect<float>& area : *areaListVector[i]) {
+                    if (area.contains(lon, lat)) {
+                        inside[i] = true;
+                        break;
+                    }
+                }
+            }
+
+            std::map<std::vector<bool>, unsigned>::iterator t;
+            t = tableIndex.find(inside);
+            if (t != tableIndex.end()) {
+                d->cells.push_back(t->second);
+                continue;
+            }
+
+            // Same choice as findUnindexed(): the last valid candidate
+            auto table = std::make_shared<SGMaterialCache::material_cache>();
+            for (const_material_map_iterator it = begin(); it != end(); ++it) {
+                SGSharedPtr<SGMaterial> result;
+                material_list::const_reverse_iterator m = it->second.rbegin();
+                for (; m != it->second.rend(); ++m) {
+                    const SGCondition* condition = (*m)->get_condition();
+                    const AreaList* areas = (*m)->get_areas().get();
+                    if ((!condition || conditions[condition]) &&
+                        (areas->empty() || inside[areaLists[areas]])) {
+                        result = *m;
+                        break;
+                    }
+                }
+                table->insert(std::make_pair(it->first, result));
+            }
+            tableIndex[inside] = d->tables.size();
+            d->cells.push_back(d->tables.size());
+            d->tables.push_back(table);
+        }
+    }
+
+    SG_LOG( SG_TERRAIN, SG_DEBUG, "Material index rebuilt: "
+            << d->cells.size() << " cells, " << d->tables.size() << " tables" );
+}
+
 SGMaterialCache *SGMaterialLib::generateMatCache(SGGeod center)
 {
 	SGVec2f c = SGVec2f(center.getLongitudeDeg(), center.getLatitudeDeg());
@@ -227,16 +420,27 @@ SGMaterialCache::SGMaterialCache ( void )
 {
 }
 
+// Constructor for a table resolved by SGMaterialLib
+SGMaterialCache::SGMaterialCache ( const material_cache_ptr& t ) :
+    table(t)
+{
+}
+
 // Insertion into the material cache
 void SGMaterialCache::insert(const std::string& name, SGSharedPtr<SGMaterial> material) {
+    if (table) {
+        cache = *table;
+        table.reset();
+    }
 	cache[name] = material;
 }
 
 // Search of the material cache
 SGMaterial *SGMaterialCache::find(const string& material) const
 {
-    SGMaterialCache::material_cache::const_iterator it = cache.find(material);
-    if (it == cache.end())
+    const material_cache& c = table ? *table : cache;
+    SGMaterialCache::material_cache::const_iterator it = c.find(material);
+    if (it == c.end())
         return NULL;
 
     return it->second;
@@ -244,5 +448,6 @@ SGMaterial *SGMaterialCache::find(const string& material) const
 
 // Destructor
 SGMaterialCache::~SGMaterialCache ( void ) {
-    SG_LOG( SG_TERRAIN, SG_DEBUG, "SGMaterialCache::~SGMaterialCache() size=" << cache.size());
+    SG_LOG( SG_TERRAIN, SG_DEBUG, "SGMaterialCache::~SGMaterialCache() size="
+            << (table ? table->size() : cache.size()));
 }
@@ -47,8 +47,17 @@ namespace osg { class Geode; }
 class SGMaterialCache : public osg::Referenced
 {
 private:
+    friend class SGMaterialLib;
+
     typedef std::map < std::string, SGSharedPtr<SGMaterial> > material_cache;
+    typedef std::shared_ptr<const material_cache> material_cache_ptr;
+
     material_cache cache;
+    // Resolved by SGMaterialLib and shared with its index, used instead
+    // of cache until insert() is called
+    material_cache_ptr table;
+
+    SGMaterialCache ( const material_cache_ptr& table );
 
 public:
     // Constructor
@@ -81,6 +90,11 @@ private:
     typedef material_map::const_iterator const_material_map_iterator;
 
     material_map matlib;
+
+    SGMaterial *findUnindexed( const std::string& material, SGVec2f center ) const;
+    SGMaterialCache *generateUnindexedMatCache( SGVec2f center ) const;
+    SGMaterialCache::material_cache_ptr findTable( SGVec2f center ) const;
+    void rebuildIndex() const;
     
 public:
 
@@ -90,7 +104,17 @@ public:
     // Load a library of material properties
     bool load( const SGPath &fg_root, const SGPath& mpath,
             SGPropertyNode *prop_root );
-    // find a material record by material name
+
+    /**
+     * Find a material record by material name.
+     *
+     * Both find() and generateMatCache() resolve materials through a
+     * spatial index: the region areas split the globe into cells, and
+     * every cell holds the materials valid for it. The index is rebuilt
+     * when a property used by a region condition changes. If a condition
+     * depends on a tied property, which doesn't notify listeners, the
+     * index isn't used and every lookup evaluates the conditions.
+     */
     SGMaterial *find( const std::string& material, SGVec2f center ) const;
     SGMaterial *find( const std::string& material, const SGGeod& center ) const;
 
@@ -104,8 +128,8 @@ public:
      * To fix this, and also avoid repeated re-evaluation of the material
      * conditions, we provide factory method to generate a material library
      * cache of the valid materials based on the current state and a given position.
+     * The materials are resolved like find() does.
      */
-
     SGMaterialCache *generateMatCache( SGVec2f center);
     SGMaterialCache *generateMatCache( SGGeod center);
 
@@ -0,0 +1,125 @@
+#include <simgear_config.h>
+#include <simgear/compiler.h>
+#include <simgear/misc/test_macros.hxx>
+
+#include "mat.hxx"
+#include "matlib.hxx"
+
+#include <iostream>
+
+#include <osg/ref_ptr>
+
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/props/props.hxx>
+
+// Regions with overlapping areas, one of them depending on a property.
+// Materials later in the file override earlier ones where they are valid.
+static const char* MATERIALS =
+  "<?xml version=\"1.0\"?>\n"
+  "<PropertyList>\n"
+  " <region>\n"
+  "  <name>global</name>\n"
+  "  <material><name>Grass</name><name>Forest</name><name>Sand</name></material>\n"
+  " </region>\n"
+  " <region>\n"
+  "  <name>europe</name>\n"
+  "  <area><lon1>-10</lon1><lon2>30</lon2><lat1>35</lat1><lat2>70</lat2></area>\n"
+  "  <material><name>Grass</name></material>\n"
+  " </region>\n"
+  " <region>\n"
+  "  <name>two-areas</name>\n"
+  "  <area><lon1>-5</lon1><lon2>-20</lon2><lat1>40</lat1><lat2>30</lat2></area>\n"
+  "  <area><lon1>20</lon1><lon2>40</lon2><lat1>60</lat1><lat2>80</lat2></area>\n"
+  "  <material><name>Sand</name><name>Forest</name></material>\n"
+  " </region>\n"
+  " <region>\n"
+  "  <name>alps-winter</name>\n"
+  "  <area><lon1>5.5</lon1><lon2>15.25</lon2><lat1>44</lat1><lat2>48</lat2></area>\n"
+  "  <condition>\n"
+  "   <equals><property>/sim/season</property><value>winter</value></equals>\n"
+  "  </condition>\n"
+  "  <material><name>Grass</name><name>Forest</name></material>\n"
+  " </region>\n"
+  " <region>\n"
+  "  <name>nowhere</name>\n"
+  "  <condition><equals><property>/sim/season</property><value>never</value></equals></condition>\n"
+  "  <material><name>Sand</name></material>\n"
+  " </region>\n"
+  "</PropertyList>\n";
+
+static const char* NAMES[] = { "Grass", "Forest", "Sand", "Unknown" };
+
+// What find() used to do: the last material of that name valid there
+static SGMaterial* reference(const SGMaterialLib& lib, const std::string& name,
+                             SGVec2f loc)
+{
+    for (auto it = lib.begin(); it != lib.end(); ++it) {
+        if (it->first != name)
+            continue;
+        for (auto m = it->second.rbegin(); m != it->second.rend(); ++m) {
+            if ((*m)->valid(loc))
+                return *m;
+        }
+    }
+    return nullptr;
+}
+
+// A grid over all areas, hitting their borders too
+static void compareGrid(SGMaterialLib& lib)
+{
+    for (float lon = -45.0f; lon <= 45.0f; lon += 0.25f) {
+        for (float lat = 25.0f; lat <= 85.0f; lat += 0.25f) {
+            const SGVec2f loc(lon, lat);
+            osg::ref_ptr<SGMaterialCache> cache = lib.generateMatCache(loc);
+            for (const char* name : NAMES) {
+                SGMaterial* expected = reference(lib, name, loc);
+                SG_VERIFY(lib.find(name, loc) == expected);
+                SG_VERIFY(cache->find(name) == expected);
+            }
+        }
+    }
+}
+
+static std::string regionOf(SGMaterialLib& lib, const char* name,
+                            float lon, float lat)
+{
+    SGMaterial* m = lib.find(name, SGVec2f(lon, lat));
+    return m ? m->get_region_name() : std::string();
+}
+
+int main(int argc, char* argv[])
+{
+    SGPath path = simgear::Dir::current().path() / "matlib_test.xml";
+    {
+        sg_ofstream f(path);
+        f << MATERIALS;
+    }
+
+    SGPropertyNode_ptr root = new SGPropertyNode;
+    root->setStringValue("/sim/season", "summer");
+
+    SGMaterialLibPtr lib = new SGMaterialLib;
+    SG_VERIFY(lib->load(simgear::Dir::current().path(), path, root));
+
+    compareGrid(*lib);
+    SG_CHECK_EQUAL(regionOf(*lib, "Grass", 10, 46), "europe");
+    SG_CHECK_EQUAL(regionOf(*lib, "Grass", -30, 46), "global");
+    SG_CHECK_EQUAL(regionOf(*lib, "Sand", 30, 70), "two-areas");
+
+    // the index follows the condition
+    root->setStringValue("/sim/season", "winter");
+    compareGrid(*lib);
+    SG_CHECK_EQUAL(regionOf(*lib, "Grass", 10, 46), "alps-winter");
+    SG_CHECK_EQUAL(regionOf(*lib, "Grass", 5.5f, 44), "alps-winter");
+    SG_CHECK_EQUAL(regionOf(*lib, "Grass", 5.25f, 44), "europe");
+
+    root->setStringValue("/sim/season", "summer");
+    compareGrid(*lib);
+    SG_CHECK_EQUAL(regionOf(*lib, "Grass", 10, 46), "europe");
+
+    path.remove();
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
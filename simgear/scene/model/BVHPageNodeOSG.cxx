@@ -42,7 +42,9 @@
 #include <simgear/scene/util/SGSceneUserData.hxx>
 #include <simgear/math/SGGeometry.hxx>
 
-#include <simgear/bvh/BVHStaticGeometryBuilder.hxx>
+#include <simgear/bvh/BVHGroup.hxx>
+#include <simgear/bvh/BVHSAHGeometryBuilder.hxx>
+#include <simgear/bvh/BVHTransform.hxx>
 
 #include "PrimitiveCollector.hxx"
 
@@ -113,7 +115,7 @@ public:
     _NodeVisitor(bool flatten, const osg::Matrix& localToWorldMatrix = osg::Matrix()) :
         osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN),
         _localToWorldMatrix(localToWorldMatrix),
-        _geometryBuilder(new BVHStaticGeometryBuilder),
+        _geometryBuilder(new BVHSAHGeometryBuilder),
         _flatten(flatten)
     {
         setTraversalMask(SG_NODEMASK_TERRAIN_BIT);
@@ -307,7 +309,7 @@ private:
     // The current pending nodes.
     _NodeBin _nodeBin;
 
-    SGSharedPtr<BVHStaticGeometryBuilder> _geometryBuilder;
+    SGSharedPtr<BVHSAHGeometryBuilder> _geometryBuilder;
 
     bool _flatten;
 };
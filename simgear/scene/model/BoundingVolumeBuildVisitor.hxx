@@ -34,7 +34,7 @@
 #include <simgear/scene/util/SGSceneUserData.hxx>
 #include <simgear/math/SGGeometry.hxx>
 
-#include <simgear/bvh/BVHStaticGeometryBuilder.hxx>
+#include <simgear/bvh/BVHSAHGeometryBuilder.hxx>
 
 #include "PrimitiveCollector.hxx"
 
@@ -45,7 +45,7 @@ public:
     class _PrimitiveCollector : public PrimitiveCollector {
     public:
         _PrimitiveCollector() :
-            _geometryBuilder(new BVHStaticGeometryBuilder)
+            _geometryBuilder(new BVHSAHGeometryBuilder)
         { }
         virtual ~_PrimitiveCollector()
         { }
@@ -62,7 +62,7 @@ public:
         BVHNode* buildTreeAndClear()
         {
             BVHNode* bvNode = _geometryBuilder->buildTree();
-            _geometryBuilder = new BVHStaticGeometryBuilder;
+            _geometryBuilder = new BVHSAHGeometryBuilder;
             return bvNode;
         }
 
@@ -81,7 +81,7 @@ public:
             return _geometryBuilder->getCurrentMaterial();
         }
 
-        SGSharedPtr<BVHStaticGeometryBuilder> _geometryBuilder;
+        SGSharedPtr<BVHSAHGeometryBuilder> _geometryBuilder;
     };
 
     BoundingVolumeBuildVisitor(bool dumpIntoLeafs) :
@@ -30,6 +30,8 @@
 #include <osg/Texture2D>
 #include <osg/ref_ptr>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <simgear/math/sg_random.h>
 #include <simgear/scene/util/OsgMath.hxx>
@@ -77,6 +79,48 @@ struct SGVertNormTex {
     }
   };
 
+  // Equivalence as defined by less: texture coordinates only count for
+  // the units both vertices have
+  struct equal_to
+  {
+    inline bool operator() (const SGVertNormTex& l,
+                            const SGVertNormTex& r) const
+    {
+      if (!(l.vertex == r.vertex) || !(l.normal == r.normal))
+        return false;
+      unsigned mask = l.tc_mask & r.tc_mask;
+      for (int idx = 0; idx < 4; ++idx) {
+        if ((mask & 1<<idx) && !(l.texCoord[idx] == r.texCoord[idx]))
+          return false;
+      }
+      return true;
+    }
+  };
+
+  // Hashes only what equal_to always compares
+  struct hash
+  {
+    inline size_t combine(size_t seed, float f) const
+    {
+      // -0 and +0 compare equal, so they must hash the same
+      if (f == 0.0f)
+        f = 0.0f;
+      uint32_t bits;
+      memcpy(&bits, &f, sizeof(bits));
+      return seed ^ (bits + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    }
+
+    inline size_t operator() (const SGVertNormTex& v) const
+    {
+      size_t h = 0;
+      for (int i = 0; i < 3; ++i)
+        h = combine(h, v.vertex[i]);
+      for (int i = 0; i < 3; ++i)
+        h = combine(h, v.normal[i]);
+      return h;
+    }
+  };
+
   void SetVertex( const SGVec3f& v )          { vertex = v; }
   const SGVec3f& GetVertex( void ) const      { return vertex; }
   
@@ -26,14 +26,29 @@ public:
 
   SGTileGeometryBin() {}
 
+  // The index streams of one group, nullptr for those it doesn't have
+  struct GroupIndices {
+    GroupIndices(const SGBinObjectGroups& groups, unsigned grp) :
+      count(groups.getCount(grp)),
+      v(groups.getIndices(grp, SGBinObjectGroups::VERTICES)),
+      n(groups.getIndices(grp, SGBinObjectGroups::NORMALS)),
+      tc0(groups.getIndices(grp, SGBinObjectGroups::TEXCOORDS_0)),
+      tc1(groups.getIndices(grp, SGBinObjectGroups::TEXCOORDS_0 + 1))
+    {}
+
+    size_t count;
+    const int* v;
+    const int* n;
+    const int* tc0;
+    const int* tc1;
+  };
+
   static SGVec2f
-  getTexCoord(const std::vector<SGVec2f>& texCoords, const int_list& tc,
+  getTexCoord(const std::vector<SGVec2f>& texCoords, const int* tc,
               const SGVec2f& tcScale, unsigned i)
   {
-    if (tc.empty())
+    if (!tc)
       return tcScale;
-    else if (tc.size() == 1)
-      return mult(texCoords[tc[0]], tcScale);
     else
       return mult(texCoords[tc[i]], tcScale);
   }
@@ -49,61 +64,47 @@ public:
     return material->get_tex_coord_scale();
   }
 
+  static SGVertNormTex
+  getVertex(const SGBinObject& obj, const GroupIndices& idx, unsigned i,
+            const SGVec2f& tc0Scale, const SGVec2f& tc1Scale)
+  {
+    const std::vector<SGVec3d>& vertices(obj.get_wgs84_nodes());
+    const std::vector<SGVec3f>& normals(obj.get_normals());
+    const std::vector<SGVec2f>& texCoords(obj.get_texcoords());
+
+    SGVertNormTex v;
+    v.SetVertex( toVec3f(vertices[idx.v[i]]) );
+    // Without normal indices, they are implicitly the vertex indices.
+    v.SetNormal( idx.n ? normals[idx.n[i]] : normals[idx.v[i]] );
+    v.SetTexCoord( 0, getTexCoord(texCoords, idx.tc0, tc0Scale, i) );
+    if (idx.tc1) {
+      v.SetTexCoord( 1, getTexCoord(texCoords, idx.tc1, tc1Scale, i) );
+    }
+    return v;
+  }
+
   static void
   addTriangleGeometry(SGTexturedTriangleBin& triangles,
                       const SGBinObject& obj, unsigned grp,
                       const SGVec2f& tc0Scale,
                       const SGVec2f& tc1Scale)
   {
-    const std::vector<SGVec3d>& vertices(obj.get_wgs84_nodes());
-    const std::vector<SGVec3f>& normals(obj.get_normals());
-    const std::vector<SGVec2f>& texCoords(obj.get_texcoords());
     const std::vector<SGVec2f>& overlayCoords(obj.get_overlaycoords());
-    const int_list& tris_v(obj.get_tris_v()[grp]);
-    const int_list& tris_n(obj.get_tris_n()[grp]);
-    const tci_list& tris_tc(obj.get_tris_tcs()[grp]);
-    bool  num_norms_is_num_verts = true;
-
-    if (tris_v.size() != tris_n.size()) {
-        // If the normal indices do not match, they should be inmplicitly
-        // the same than the vertex indices.
-        num_norms_is_num_verts = false;
-    }
+    const GroupIndices idx(obj.get_tris_groups(), grp);
 
-    if ( !tris_tc[1].empty() ) {
+    if ( idx.tc1 ) {
         triangles.hasSecondaryTexCoord(true);
     }
 
-    for (unsigned i = 2; i < tris_v.size(); i += 3) {
-        SGVertNormTex v0;
-        v0.SetVertex( toVec3f(vertices[tris_v[i-2]]) );
-        v0.SetNormal( num_norms_is_num_verts ? normals[tris_n[i-2]] :
-                                               normals[tris_v[i-2]] );
-        v0.SetTexCoord( 0, getTexCoord(texCoords, tris_tc[0], tc0Scale, i-2) );
-        if (!tris_tc[1].empty()) {
-            v0.SetTexCoord( 1, getTexCoord(texCoords, tris_tc[1], tc1Scale, i-2) );
-        }
-        v0.SetOverlayCoord(overlayCoords[tris_v[i-2]]);
-
-        SGVertNormTex v1;
-        v1.SetVertex( toVec3f(vertices[tris_v[i-1]]) );
-        v1.SetNormal( num_norms_is_num_verts ? normals[tris_n[i-1]] :
-                                               normals[tris_v[i-1]] );
-        v1.SetTexCoord( 0, getTexCoord(texCoords, tris_tc[0], tc0Scale, i-1) );
-        if (!tris_tc[1].empty()) {
-            v1.SetTexCoord( 1, getTexCoord(texCoords, tris_tc[1], tc1Scale, i-1) );
-        }
-        v1.SetOverlayCoord(overlayCoords[tris_v[i-1]]);
-
-        SGVertNormTex v2;
-        v2.SetVertex( toVec3f(vertices[tris_v[i]]) );
-        v2.SetNormal( num_norms_is_num_verts ? normals[tris_n[i]] :
-                                               normals[tris_v[i]] );
-        v2.SetTexCoord( 0, getTexCoord(texCoords, tris_tc[0], tc0Scale, i) );
-        if (!tris_tc[1].empty()) {
-            v2.SetTexCoord( 1, getTexCoord(texCoords, tris_tc[1], tc1Scale, i) );
-        }
-        v2.SetOverlayCoord(overlayCoords[tris_v[i]]);
+    for (unsigned i = 2; i < idx.count; i += 3) {
+        SGVertNormTex v0 = getVertex(obj, idx, i-2, tc0Scale, tc1Scale);
+        v0.SetOverlayCoord(overlayCoords[idx.v[i-2]]);
+
+        SGVertNormTex v1 = getVertex(obj, idx, i-1, tc0Scale, tc1Scale);
+        v1.SetOverlayCoord(overlayCoords[idx.v[i-1]]);
+
+        SGVertNormTex v2 = getVertex(obj, idx, i, tc0Scale, tc1Scale);
+        v2.SetOverlayCoord(overlayCoords[idx.v[i]]);
 
         triangles.insert(v0, v1, v2);
     }
@@ -115,49 +116,16 @@ public:
                    const SGVec2f& tc0Scale,
                    const SGVec2f& tc1Scale)
   {
-      const std::vector<SGVec3d>& vertices(obj.get_wgs84_nodes());
-      const std::vector<SGVec3f>& normals(obj.get_normals());
-      const std::vector<SGVec2f>& texCoords(obj.get_texcoords());
-      const int_list& strips_v(obj.get_strips_v()[grp]);
-      const int_list& strips_n(obj.get_strips_n()[grp]);
-      const tci_list& strips_tc(obj.get_strips_tcs()[grp]);
-      bool  num_norms_is_num_verts = true;
-
-      if (strips_v.size() != strips_n.size()) {
-          // If the normal indices do not match, they should be inmplicitly
-          // the same than the vertex indices.
-          num_norms_is_num_verts = false;
-      }
+    const GroupIndices idx(obj.get_strips_groups(), grp);
 
-      if ( !strips_tc[1].empty() ) {
-          triangles.hasSecondaryTexCoord(true);
-      }
+    if ( idx.tc1 ) {
+        triangles.hasSecondaryTexCoord(true);
+    }
 
-    for (unsigned i = 2; i < strips_v.size(); ++i) {
-      SGVertNormTex v0;
-      v0.SetVertex( toVec3f(vertices[strips_v[i-2]]) );
-      v0.SetNormal( num_norms_is_num_verts ? normals[strips_n[i-2]] :
-                                             normals[strips_v[i-2]] );
-      v0.SetTexCoord( 0, getTexCoord(texCoords, strips_tc[0], tc0Scale, i-2) );
-      if (!strips_tc[1].empty()) {
-          v0.SetTexCoord( 1, getTexCoord(texCoords, strips_tc[1], tc1Scale, i-2) );
-      }
-      SGVertNormTex v1;
-      v1.SetVertex( toVec3f(vertices[strips_v[i-1]]) );
-      v1.SetNormal( num_norms_is_num_verts ? normals[strips_n[i-1]] :
-                                             normals[strips_v[i-1]] );
-      v1.SetTexCoord( 0, getTexCoord(texCoords, strips_tc[1], tc0Scale, i-1) );
-      if (!strips_tc[1].empty()) {
-          v1.SetTexCoord( 1, getTexCoord(texCoords, strips_tc[1], tc1Scale, i-1) );
-      }
-      SGVertNormTex v2;
-      v2.SetVertex( toVec3f(vertices[strips_v[i]]) );
-      v2.SetNormal( num_norms_is_num_verts ? normals[strips_n[i]] :
-                                             normals[strips_v[i]] );
-      v2.SetTexCoord( 0, getTexCoord(texCoords, strips_tc[0], tc0Scale, i) );
-      if (!strips_tc[1].empty()) {
-          v2.SetTexCoord( 1, getTexCoord(texCoords, strips_tc[1], tc1Scale, i) );
-      }
+    for (unsigned i = 2; i < idx.count; ++i) {
+      SGVertNormTex v0 = getVertex(obj, idx, i-2, tc0Scale, tc1Scale);
+      SGVertNormTex v1 = getVertex(obj, idx, i-1, tc0Scale, tc1Scale);
+      SGVertNormTex v2 = getVertex(obj, idx, i, tc0Scale, tc1Scale);
       if (i%2)
         triangles.insert(v1, v0, v2);
       else
@@ -171,56 +139,25 @@ public:
                  const SGVec2f& tc0Scale,
                  const SGVec2f& tc1Scale)
   {
-      const std::vector<SGVec3d>& vertices(obj.get_wgs84_nodes());
-      const std::vector<SGVec3f>& normals(obj.get_normals());
-      const std::vector<SGVec2f>& texCoords(obj.get_texcoords());
-      const std::vector<SGVec2f>& overlayCoords(obj.get_overlaycoords());
-      const int_list& fans_v(obj.get_fans_v()[grp]);
-      const int_list& fans_n(obj.get_fans_n()[grp]);
-      const tci_list& fans_tc(obj.get_fans_tcs()[grp]);
-      bool  num_norms_is_num_verts = true;
-
-      if (fans_v.size() != fans_n.size()) {
-          // If the normal indices do not match, they should be inmplicitly
-          // the same than the vertex indices.
-          num_norms_is_num_verts = false;
-      }
-
-      if ( !fans_tc[1].empty() ) {
-          triangles.hasSecondaryTexCoord(true);
-      }
+    const std::vector<SGVec2f>& overlayCoords(obj.get_overlaycoords());
+    const GroupIndices idx(obj.get_fans_groups(), grp);
 
-    SGVertNormTex v0;
-    v0.SetVertex( toVec3f(vertices[fans_v[0]]) );
-    v0.SetNormal( num_norms_is_num_verts ? normals[fans_n[0]] :
-                                           normals[fans_v[0]] );
-    v0.SetTexCoord( 0, getTexCoord(texCoords, fans_tc[0], tc0Scale, 0) );
-    if (!fans_tc[1].empty()) {
-        v0.SetTexCoord( 1, getTexCoord(texCoords, fans_tc[1], tc1Scale, 0) );
-    }
-    v0.SetOverlayCoord(overlayCoords[fans_v[0]]);
-
-    SGVertNormTex v1;
-    v1.SetVertex( toVec3f(vertices[fans_v[1]]) );
-    v1.SetNormal( num_norms_is_num_verts ? normals[fans_n[1]] :
-                                           normals[fans_v[1]] );
-    v1.SetTexCoord( 0, getTexCoord(texCoords, fans_tc[0], tc0Scale, 1) );
-    if (!fans_tc[1].empty()) {
-        v1.SetTexCoord( 1, getTexCoord(texCoords, fans_tc[1], tc1Scale, 1) );
+    if ( idx.tc1 ) {
+        triangles.hasSecondaryTexCoord(true);
     }
-    v1.SetOverlayCoord(overlayCoords[fans_v[1]]);
-
-    for (unsigned i = 2; i < fans_v.size(); ++i) {
-      SGVertNormTex v2;
-      v2.SetVertex( toVec3f(vertices[fans_v[i]]) );
-      v2.SetNormal( num_norms_is_num_verts ? normals[fans_n[i]] :
-                                             normals[fans_v[i]] );
-      v2.SetTexCoord( 0, getTexCoord(texCoords, fans_tc[0], tc0Scale, i) );
-      if (!fans_tc[1].empty()) {
-          v2.SetTexCoord( 1, getTexCoord(texCoords, fans_tc[1], tc1Scale, i) );
-      }
-      v2.SetOverlayCoord(overlayCoords[fans_v[i]]);
-      
+    if (idx.count < 3)
+      return;
+
+    SGVertNormTex v0 = getVertex(obj, idx, 0, tc0Scale, tc1Scale);
+    v0.SetOverlayCoord(overlayCoords[idx.v[0]]);
+
+    SGVertNormTex v1 = getVertex(obj, idx, 1, tc0Scale, tc1Scale);
+    v1.SetOverlayCoord(overlayCoords[idx.v[1]]);
+
+    for (unsigned i = 2; i < idx.count; ++i) {
+      SGVertNormTex v2 = getVertex(obj, idx, i, tc0Scale, tc1Scale);
+      v2.SetOverlayCoord(overlayCoords[idx.v[i]]);
+
       triangles.insert(v0, v1, v2);
       v1 = v2;
     }
@@ -229,43 +166,40 @@ public:
   bool
   insertSurfaceGeometry(const SGBinObject& obj, SGMaterialCache* matcache)
   {
-    if (obj.get_tris_n().size() < obj.get_tris_v().size() ||
-        obj.get_tris_tcs().size() < obj.get_tris_v().size()) {
-      SG_LOG(SG_TERRAIN, SG_ALERT,
-             "Group list sizes for triangles do not match!");
-      return false;
+    // The flat groups keep the index streams of a group the same length,
+    // so there is nothing to check here
+    const SGBinObjectGroups& tris(obj.get_tris_groups());
+    const SGBinObjectGroups& strips(obj.get_strips_groups());
+    const SGBinObjectGroups& fans(obj.get_fans_groups());
+
+    // Size the bins once for all triangle groups of their material, so
+    // that the vertex tables don't rehash while the groups are added
+    std::map<std::string, unsigned> numTriangles;
+    for (unsigned grp = 0; grp < tris.size(); ++grp) {
+      numTriangles[tris.getMaterial(grp)] += tris.getCount(grp) / 3;
     }
+    std::map<std::string, unsigned>::const_iterator n;
+    for (n = numTriangles.begin(); n != numTriangles.end(); ++n)
+      materialTriangleMap[n->first].reserve(n->second);
 
-    for (unsigned grp = 0; grp < obj.get_tris_v().size(); ++grp) {
-      std::string materialName = obj.get_tri_materials()[grp];
+    for (unsigned grp = 0; grp < tris.size(); ++grp) {
+      const std::string& materialName = tris.getMaterial(grp);
       SGVec2f tc0Scale = getTexCoordScale(materialName, matcache);
       SGVec2f tc1Scale(1.0, 1.0);
       addTriangleGeometry(materialTriangleMap[materialName],
                           obj, grp, tc0Scale, tc1Scale );
     }
 
-    if (obj.get_strips_n().size() < obj.get_strips_v().size() ||
-        obj.get_strips_tcs().size() < obj.get_strips_v().size()) {
-      SG_LOG(SG_TERRAIN, SG_ALERT,
-             "Group list sizes for strips do not match!");
-      return false;
-    }
-    for (unsigned grp = 0; grp < obj.get_strips_v().size(); ++grp) {
-      std::string materialName = obj.get_strip_materials()[grp];
+    for (unsigned grp = 0; grp < strips.size(); ++grp) {
+      const std::string& materialName = strips.getMaterial(grp);
       SGVec2f tc0Scale = getTexCoordScale(materialName, matcache);
       SGVec2f tc1Scale(1.0, 1.0);
       addStripGeometry(materialTriangleMap[materialName],
                           obj, grp, tc0Scale, tc1Scale);
     }
 
-    if (obj.get_fans_n().size() < obj.get_fans_v().size() ||
-        obj.get_fans_tcs().size() < obj.get_fans_v().size()) {
-      SG_LOG(SG_TERRAIN, SG_ALERT,
-             "Group list sizes for fans do not match!");
-      return false;
-    }
-    for (unsigned grp = 0; grp < obj.get_fans_v().size(); ++grp) {
-      std::string materialName = obj.get_fan_materials()[grp];
+    for (unsigned grp = 0; grp < fans.size(); ++grp) {
+      const std::string& materialName = fans.getMaterial(grp);
       SGVec2f tc0Scale = getTexCoordScale(materialName, matcache);
       SGVec2f tc1Scale(1.0, 1.0);
       addFanGeometry(materialTriangleMap[materialName],
@@ -23,7 +23,9 @@
 #define SG_TRIANGLE_BIN_HXX
 
 #include <vector>
-#include <map>
+#include <list>
+#include <algorithm>
+#include <utility>
 #include "SGVertexArrayBin.hxx"
 
 template<typename T>
@@ -36,20 +38,24 @@ public:
   typedef SGVec3<index_type> triangle_ref;
   typedef std::vector<triangle_ref> TriangleVector;
   typedef std::vector<index_type> TriangleList;
-  typedef std::map<edge_ref,TriangleList> EdgeMap;
+  // Directed edges with the triangle they belong to
+  typedef std::vector<std::pair<edge_ref, index_type> > EdgeVector;
 
   void insert(const value_type& v0, const value_type& v1, const value_type& v2)
   {
     index_type i0 = SGVertexArrayBin<T>::insert(v0);
     index_type i1 = SGVertexArrayBin<T>::insert(v1);
     index_type i2 = SGVertexArrayBin<T>::insert(v2);
-    index_type triangleIndex = _triangleVector.size();
     _triangleVector.push_back(triangle_ref(i0, i1, i2));
-#ifdef BUILD_EDGE_MAP
-    _edgeMap[edge_ref(i0, i1)].push_back(triangleIndex);
-    _edgeMap[edge_ref(i1, i2)].push_back(triangleIndex);
-    _edgeMap[edge_ref(i2, i0)].push_back(triangleIndex);
-#endif
+  }
+
+  // Make room for numTriangles more triangles. A closed mesh has about
+  // half as many vertices as triangles, the vertex table grows past
+  // that estimate as needed.
+  void reserve(index_type numTriangles)
+  {
+    _triangleVector.reserve(_triangleVector.size() + numTriangles);
+    SGVertexArrayBin<T>::reserve(this->getNumVertices() + numTriangles/2);
   }
 
   unsigned getNumTriangles() const
@@ -60,9 +66,28 @@ public:
   { return _triangleVector; }
 
 #ifdef BUILD_EDGE_MAP
+  // Collects the edges of all triangles, sorted. They are only needed by
+  // getConnectedSets(), so they are built in one go instead of being
+  // kept in a map that is updated on every insert.
+  void getEdges(EdgeVector& edges) const
+  {
+    edges.clear();
+    edges.reserve(3*_triangleVector.size());
+    for (index_type i = 0; i < _triangleVector.size(); ++i) {
+      const triangle_ref& t = _triangleVector[i];
+      edges.push_back(std::make_pair(edge_ref(t[0], t[1]), i));
+      edges.push_back(std::make_pair(edge_ref(t[1], t[2]), i));
+      edges.push_back(std::make_pair(edge_ref(t[2], t[0]), i));
+    }
+    std::sort(edges.begin(), edges.end());
+  }
+
 // protected: //FIXME
   void getConnectedSets(std::list<TriangleVector>& connectSets) const
   {
+    EdgeVector edges;
+    getEdges(edges);
+
     std::vector<bool> processedTriangles(getNumTriangles(), false);
     for (index_type i = 0; i < getNumTriangles(); ++i) {
       if (processedTriangles[i])
@@ -84,17 +109,13 @@ public:
         edge_ref edge = edgeStack.back();
         edgeStack.pop_back();
         
-        typename EdgeMap::const_iterator emiList[2] = {
-          _edgeMap.find(edge),
-          _edgeMap.find(edge_ref(edge[1], edge[0]))
-        };
+        edge_ref edgeList[2] = { edge, edge_ref(edge[1], edge[0]) };
         for (unsigned ei = 0; ei < 2; ++ei) {
-          typename EdgeMap::const_iterator emi = emiList[ei];
-          if (emi == _edgeMap.end())
-            continue;
-
-          for (unsigned ti = 0; ti < emi->second.size(); ++ti) {
-            index_type triangleIndex = emi->second[ti];
+          typename EdgeVector::const_iterator emi;
+          emi = std::lower_bound(edges.begin(), edges.end(),
+                                 std::make_pair(edgeList[ei], index_type(0)));
+          for (; emi != edges.end() && emi->first == edgeList[ei]; ++emi) {
+            index_type triangleIndex = emi->second;
             if (processedTriangles[triangleIndex])
               continue;
 
@@ -115,9 +136,6 @@ public:
 
 private:
   TriangleVector _triangleVector;
-#ifdef BUILD_EDGE_MAP
-  EdgeMap _edgeMap;
-#endif
 };
 
 #endif
@@ -23,27 +23,37 @@
 #define SG_VERTEX_ARRAY_BIN_HXX
 
 #include <vector>
-#include <map>
+#include <unordered_map>
 
+// Collects the distinct vertices of a geometry. The value type provides
+// the hash and equal_to functors used to find earlier copies of a vertex.
 template<typename T>
 class SGVertexArrayBin {
 public:
   typedef T value_type;
-  typedef typename value_type::less less;
+  typedef typename value_type::hash hash;
+  typedef typename value_type::equal_to equal_to;
   typedef std::vector<value_type> ValueVector;
   typedef typename ValueVector::size_type index_type;
-  typedef std::map<value_type, index_type, less> ValueMap;
+  typedef std::unordered_map<value_type, index_type, hash, equal_to> ValueMap;
 
   index_type insert(const value_type& t)
   {
-    typename ValueMap::iterator i = _valueMap.find(t);
-    if (i != _valueMap.end())
-      return i->second;
+    std::pair<typename ValueMap::iterator, bool> i;
+    i = _valueMap.insert(typename ValueMap::value_type(t, _values.size()));
+    if (!i.second)
+      return i.first->second;
 
-    index_type index = _values.size();
-    _valueMap[t] = index;
     _values.push_back(t);
-    return index;
+    return i.first->second;
+  }
+
+  // Make room for numVertices distinct vertices, to avoid rehashing
+  // while a known amount of geometry is inserted
+  void reserve(index_type numVertices)
+  {
+    _values.reserve(numVertices);
+    _valueMap.reserve(numVertices);
   }
 
   const value_type& getVertex(index_type index) const
@@ -0,0 +1,176 @@
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <simgear/io/sg_binobj.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include "SGTileGeometryBin.hxx"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Times how fast tile geometry goes into the triangle bins, in vertices
+// (three per input triangle) per second. "map" is the std::map based
+// vertex and edge tables the bins used before they were hashed, "hash"
+// the current SGTexturedTriangleBin, "tile" the whole of
+// SGTileGeometryBin::insertSurfaceGeometry() including the vertex setup.
+//
+// Without arguments a synthetic grid tile is used, otherwise the given
+// BTG files.
+
+namespace {
+
+// The bins as they were: every vertex and every edge a tree node
+class MapTriangleBin {
+public:
+  typedef SGVertNormTex value_type;
+  typedef std::vector<value_type>::size_type index_type;
+  typedef SGVec2<index_type> edge_ref;
+  typedef SGVec3<index_type> triangle_ref;
+
+  index_type insert(const value_type& t)
+  {
+    std::map<value_type, index_type, value_type::less>::iterator i;
+    i = _valueMap.find(t);
+    if (i != _valueMap.end())
+      return i->second;
+
+    index_type index = _values.size();
+    _valueMap[t] = index;
+    _values.push_back(t);
+    return index;
+  }
+
+  void insert(const value_type& v0, const value_type& v1, const value_type& v2)
+  {
+    index_type i0 = insert(v0);
+    index_type i1 = insert(v1);
+    index_type i2 = insert(v2);
+    index_type triangleIndex = _triangles.size();
+    _triangles.push_back(triangle_ref(i0, i1, i2));
+    _edgeMap[edge_ref(i0, i1)].push_back(triangleIndex);
+    _edgeMap[edge_ref(i1, i2)].push_back(triangleIndex);
+    _edgeMap[edge_ref(i2, i0)].push_back(triangleIndex);
+  }
+
+  index_type getNumVertices() const
+  { return _values.size(); }
+
+private:
+  std::vector<value_type> _values;
+  std::map<value_type, index_type, value_type::less> _valueMap;
+  std::vector<triangle_ref> _triangles;
+  std::map<edge_ref, std::vector<index_type> > _edgeMap;
+};
+
+// A grid of size x size quads on a sphere segment, in bands of 16 rows
+// alternating between two materials
+void makeGridTile(SGBinObject& obj, int size)
+{
+  std::vector<SGVec3d> nodes;
+  std::vector<SGVec3f> normals;
+  std::vector<SGVec2f> texCoords;
+  for (int y = 0; y <= size; ++y) {
+    for (int x = 0; x <= size; ++x) {
+      SGGeod geod = SGGeod::fromDegM(0.001*x, 45 + 0.001*y, 10*((x*y) % 7));
+      nodes.push_back(SGVec3d::fromGeod(geod));
+      normals.push_back(toVec3f(normalize(nodes.back())));
+      texCoords.push_back(SGVec2f(0.1*x, 0.1*y));
+    }
+  }
+  obj.set_wgs84_nodes(nodes);
+  obj.set_normals(normals);
+  obj.set_texcoords(texCoords);
+  obj.set_overlaycoords(texCoords);
+
+  for (int band = 0; band < size; band += 16) {
+    SGBinObjectTriangle tri;
+    tri.material = (band / 16) % 2 ? "Grass" : "DryCrop";
+    for (int y = band; y < band + 16 && y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        int i = y*(size + 1) + x;
+        int quad[6] = { i, i + 1, i + size + 2, i, i + size + 2, i + size + 1 };
+        tri.v_list.insert(tri.v_list.end(), quad, quad + 6);
+      }
+    }
+    tri.n_list = tri.v_list;
+    tri.tc_list[0] = tri.v_list;
+    obj.add_triangle(tri);
+  }
+}
+
+template<typename Bin>
+double insertTriangles(const std::vector<SGVertNormTex>& vertices)
+{
+  Bin bin;
+  SGTimeStamp start = SGTimeStamp::now();
+  for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+    bin.insert(vertices[i], vertices[i + 1], vertices[i + 2]);
+  return (SGTimeStamp::now() - start).toSecs();
+}
+
+bool runTile(const SGBinObject& obj)
+{
+  osg::ref_ptr<SGTileGeometryBin> tile = new SGTileGeometryBin;
+  SGTimeStamp start = SGTimeStamp::now();
+  if (!tile->insertSurfaceGeometry(obj, 0))
+    return false;
+  double tileSecs = (SGTimeStamp::now() - start).toSecs();
+
+  // Feed the same triangles straight into the bins
+  std::vector<SGVertNormTex> vertices;
+  size_t numVertices = 0;
+  SGMaterialTriangleMap::const_iterator i;
+  for (i = tile->materialTriangleMap.begin();
+       i != tile->materialTriangleMap.end(); ++i) {
+    const SGTexturedTriangleBin& bin = i->second;
+    for (unsigned t = 0; t < bin.getNumTriangles(); ++t) {
+      for (int k = 0; k < 3; ++k)
+        vertices.push_back(bin.getVertex(bin.getTriangleRef(t)[k]));
+    }
+    numVertices += bin.getNumVertices();
+  }
+
+  double mapSecs = insertTriangles<MapTriangleBin>(vertices);
+  double hashSecs = insertTriangles<SGTexturedTriangleBin>(vertices);
+
+  double n = vertices.size();
+  cout << vertices.size() / 3 << " triangles, " << numVertices
+       << " distinct vertices" << endl;
+  cout << "  map:  " << n / mapSecs / 1e6 << " M vertices/s" << endl;
+  cout << "  hash: " << n / hashSecs / 1e6 << " M vertices/s" << endl;
+  cout << "  tile: " << n / tileSecs / 1e6 << " M vertices/s" << endl;
+  return true;
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    SGBinObject obj;
+    makeGridTile(obj, 400);
+    cout << "grid tile: ";
+    return runTile(obj) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    SGBinObject obj;
+    if (!obj.read_bin(SGPath::fromLocal8Bit(argv[i]))) {
+      cerr << argv[i] << ": failed to read" << endl;
+      return EXIT_FAILURE;
+    }
+    cout << argv[i] << ": ";
+    if (!runTile(obj))
+      return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
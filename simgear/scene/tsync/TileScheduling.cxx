@@ -0,0 +1,118 @@
+// TileScheduling.cxx -- order scenery tile syncs by when they are needed
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "TileScheduling.hxx"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <simgear/constants.h>
+#include <simgear/math/SGGeodesy.hxx>
+
+namespace simgear
+{
+
+bool tileCenterForPath(const std::string& dir, SGGeod& center)
+{
+    const auto slash = dir.rfind('/');
+    const std::string name = (slash == std::string::npos) ? dir : dir.substr(slash + 1);
+    if (name.size() != 7) {
+        return false;
+    }
+
+    const char ew = name[0], ns = name[4];
+    if ((ew != 'e' && ew != 'w') || (ns != 'n' && ns != 's')) {
+        return false;
+    }
+
+    for (int i : {1, 2, 3, 5, 6}) {
+        if (!isdigit(static_cast<unsigned char>(name[i]))) {
+            return false;
+        }
+    }
+
+    int lon = atoi(name.substr(1, 3).c_str());
+    int lat = atoi(name.substr(5, 2).c_str());
+    if (ew == 'w') lon = -lon;
+    if (ns == 's') lat = -lat;
+    center = SGGeod::fromDeg(lon + 0.5, lat + 0.5);
+    return true;
+}
+
+TileNeed tileNeed(const SGGeod& tileCenter,
+                  const TerrasyncFlightState& flight,
+                  double cancelDistanceM)
+{
+    using namespace TileScheduling;
+
+    const double d = SGGeodesy::distanceM(flight.position, tileCenter);
+    const double speed = std::max(flight.groundspeedKt * SG_KT_TO_MPS,
+                                  MinSpeedMPS);
+    double along = 0.0, cross = d;
+    if (speed > MinSpeedMPS) {
+        const double offTrack = (SGGeodesy::courseDeg(flight.position, tileCenter)
+                                 - flight.trackDeg) * SGD_DEGREES_TO_RADIANS;
+        along = d * cos(offTrack);
+        cross = fabs(d * sin(offTrack));
+    }
+
+    // the closest the aircraft gets to the tile
+    const double closest = (along > 0.0) ? cross : d;
+
+    TileNeed need;
+    need.distanceM = d;
+    need.wanted = (cancelDistanceM <= 0.0) || (closest <= cancelDistanceM);
+    if (d <= NeedRadiusM) {
+        need.seconds = 0.0;
+    } else if (along > 0.0 && cross <= NeedRadiusM) {
+        // we fly into range of it
+        need.seconds = (along - sqrt(NeedRadiusM * NeedRadiusM - cross * cross)) / speed;
+    } else {
+        need.seconds = (std::max(along, 0.0) + OffTrackPenalty * (closest - NeedRadiusM)) / speed;
+    }
+    return need;
+}
+
+void TileSchedulingState::update(const TerrasyncFlightState& flight)
+{
+    _flight = flight;
+}
+
+void TileSchedulingState::reposition()
+{
+    _flight.valid = false;
+    _reorderNow = true;
+}
+
+bool TileSchedulingState::next(TerrasyncFlightState& flight, bool& reorderNow)
+{
+    if (!_flight.valid) {
+        // keep _reorderNow for when the position arrives
+        return false;
+    }
+
+    flight = _flight;
+    reorderNow = _reorderNow;
+    _reorderNow = false;
+    return true;
+}
+
+} // namespace simgear
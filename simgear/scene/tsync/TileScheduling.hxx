@@ -0,0 +1,104 @@
+// TileScheduling.hxx -- order scenery tile syncs by when they are needed
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef TILESCHEDULING_HXX_
+#define TILESCHEDULING_HXX_
+
+#include <string>
+
+#include <simgear/math/SGMath.hxx>
+
+namespace simgear
+{
+
+namespace TileScheduling
+{
+    // tiles whose centre is closer than this to the aircraft are needed now
+    const double NeedRadiusM = 80 * 1000;
+    // below this groundspeed (m/s) the track is meaningless
+    const double MinSpeedMPS = 5;
+    // time of need per metre the track passes beside a tile, relative to a
+    // metre along the track: tiles off the track are needed only if we turn
+    const double OffTrackPenalty = 2;
+}
+
+/**
+ * @brief where the aircraft is and where it is going, as far as the tile
+ * scheduling is concerned.
+ */
+struct TerrasyncFlightState
+{
+    bool valid = false;
+    SGGeod position;
+    double trackDeg = 0.0;
+    double groundspeedKt = 0.0;
+};
+
+struct TileNeed
+{
+    double seconds;   ///< predicted time until the tile is needed
+    double distanceM; ///< current distance, to order tiles needed now
+    bool wanted;      ///< false if the aircraft is not coming near the tile
+};
+
+/**
+ * @brief find the centre of the 1x1 degree tile synced by a tile path
+ * such as 'Terrain/e000n50/e007n51', named after its south-west corner.
+ */
+bool tileCenterForPath(const std::string& dir, SGGeod& center);
+
+/**
+ * @brief predict when a tile will be needed, assuming the aircraft holds
+ * its track and groundspeed: tiles are needed once they are within
+ * NeedRadiusM. Tiles beside or behind the track get a later time the
+ * further off the track they are, and are not wanted any more once the
+ * closest the aircraft will get exceeds the cancel distance (unless that
+ * is 0).
+ */
+TileNeed tileNeed(const SGGeod& tileCenter,
+                  const TerrasyncFlightState& flight,
+                  double cancelDistanceM);
+
+/**
+ * @brief the flight state the tile scheduling works from, as last
+ * reported. After a reposition that state is stale, and tiles queued for
+ * the new position might look unwanted from the old one: nothing is
+ * scheduled until the next update brings the new position.
+ *
+ * Not thread safe, the owner guards it.
+ */
+class TileSchedulingState
+{
+public:
+    void update(const TerrasyncFlightState& flight);
+    void reposition();
+
+    /**
+     * @brief get the flight state to schedule from.
+     * @param reorderNow set if the tiles should be reordered right away,
+     * rather than on the next interval, as after a reposition
+     * @return false while there is no usable flight state
+     */
+    bool next(TerrasyncFlightState& flight, bool& reorderNow);
+
+private:
+    TerrasyncFlightState _flight;
+    bool _reorderNow = false;
+};
+
+} // namespace simgear
+
+#endif /* TILESCHEDULING_HXX_ */
@@ -42,14 +42,17 @@
 #include <signal.h>             // signal()
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
 
 #include <simgear/version.h>
 
 #include "terrasync.hxx"
+#include "TileScheduling.hxx"
 
 #include <simgear/bucket/newbucket.hxx>
 #include <simgear/misc/sg_path.hxx>
@@ -78,6 +81,9 @@ namespace UpdateInterval
     static const double FailedAttempt     = 10*60;
 }
 
+// reorder the pending tiles at most this often while flying
+static const int RescheduleIntervalMSec = 1000;
+
 typedef map<string,time_t> TileAgeCache;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -143,14 +149,33 @@ public:
     string _dir;
     Type _type;
     Status _status;
+
+    // centre of the 1x1 degree tile, for Tile items
+    SGGeod _center;
+    bool _hasCenter = false;
 };
 
+/**
+ * @brief when a sync item is needed, see tileNeed()
+ */
+static TileNeed itemNeed(const SyncItem& item,
+                         const TerrasyncFlightState& flight,
+                         double cancelDistanceM)
+{
+    if (!item._hasCenter) {
+        // no idea where it is, so don't hold it back
+        return {0.0, 0.0, true};
+    }
+    return tileNeed(item._center, flight, cancelDistanceM);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
  * @brief SyncSlot encapsulates a queue of sync items we will fetch
  * serially. Multiple slots exist to sync different types of item in
- * parallel.
+ * parallel. The tile slots share the queue of the first one, which is
+ * ordered by the time the tiles are needed.
  */
 class SyncSlot
 {
@@ -170,7 +195,12 @@ public:
 static const int SYNC_SLOT_TILES = 0; ///< Terrain and Objects sync
 static const int SYNC_SLOT_SHARED_DATA = 1; /// shared Models and Airport data
 static const int SYNC_SLOT_AI_DATA = 2; /// AI traffic and models
-static const unsigned int NUM_SYNC_SLOTS = 3;
+static const unsigned int NUM_SYNC_SLOTS = 3; ///< plus the extra tile slots
+
+static bool isTileSlot(unsigned int slot)
+{
+    return (slot == SYNC_SLOT_TILES) || (slot >= NUM_SYNC_SLOTS);
+}
 
 /**
  * @brief translate a sync item type into one of the available slots.
@@ -202,6 +232,7 @@ struct TerrasyncThreadState
         _success_count(0),
         _consecutive_errors(0),
         _cache_hits(0),
+        _cancelled_count(0),
         _transfer_rate(0),
         _total_kb_downloaded(0),
         _totalKbPending(0)
@@ -215,6 +246,7 @@ struct TerrasyncThreadState
     int  _success_count;
     int  _consecutive_errors;
     int  _cache_hits;
+    int  _cancelled_count;
     int _transfer_rate;
     // kbytes, not bytes, because bytes might overflow 2^31
     int _total_kb_downloaded;
@@ -320,6 +352,26 @@ public:
 
     void setCachePath(const SGPath &p) { _persistentCachePath = p; }
 
+    // the budgets take effect on the next start()
+    void setMaxTileSyncs(int n)         { _maxTileSyncs = std::max(n, 1); }
+    void setMaxConnections(int n)       { _maxConnections = std::max(n, 1); }
+    void setMaxBandwidth(int kbytesSec) { _maxBytesPerSec = std::max(kbytesSec, 0) * 1024u; }
+    void setCancelDistance(double km)   { _cancelDistanceM = km * 1000; }
+
+    void setFlightState(const TerrasyncFlightState& flight)
+    {
+        std::lock_guard<std::mutex> g(_stateLock);
+        _schedulingState.update(flight);
+    }
+
+    /// reorder the pending tiles right away once the new position is known,
+    /// rather than on the next interval
+    void rescheduleTiles()
+    {
+        std::lock_guard<std::mutex> g(_stateLock);
+        _schedulingState.reposition();
+    }
+
   private:
     void incrementCacheHits()
     {
@@ -331,13 +383,17 @@ public:
 
     // internal mode run and helpers
     void runInternal();
-    void updateSyncSlot(SyncSlot& slot);
+    void updateSyncSlot(SyncSlot& slot, std::deque<SyncItem>& queue);
+    bool withinBandwidthBudget() const;
+
+    void scheduleTiles(bool newTiles);
+    void cancelSync(SyncSlot& slot);
 
     void beginSyncAirports(SyncSlot& slot);
     void beginSyncTile(SyncSlot& slot);
     void beginNormalSync(SyncSlot& slot);
 
-    void drainWaitingTiles();
+    bool drainWaitingTiles();
 
     // commond helpers between both internal and external models
 
@@ -350,7 +406,13 @@ public:
     void writeCompletedTilesPersistentCache() const;
 
     HTTP::Client _http;
-    SyncSlot _syncSlots[NUM_SYNC_SLOTS];
+    std::vector<SyncSlot> _syncSlots;
+
+    unsigned int _maxTileSyncs = 2;
+    unsigned int _maxConnections = 4;
+    unsigned int _maxBytesPerSec = 0; ///< 0 for no limit
+    double _cancelDistanceM = 300 * 1000;
+    SGTimeStamp _lastSchedule;
 
     bool _stop, _running;
     SGBlockingDeque <SyncItem> waitingTiles;
@@ -369,6 +431,7 @@ public:
     string _dnsdn;
 
     TerrasyncThreadState _state;
+    TileSchedulingState _schedulingState;
     mutable std::mutex _stateLock;
 };
 
@@ -398,9 +461,11 @@ void SGTerraSync::WorkerThread::stop()
     request(w);
     join();
 
-    // clear the sync slots, in case we restart
-    for (unsigned int slot = 0; slot < NUM_SYNC_SLOTS; ++slot) {
-        _syncSlots[slot] = {};
+    // clear the sync slots, in case we restart. isDirActive() might be
+    // looking at them from another thread
+    {
+        std::lock_guard<std::mutex> g(_stateLock);
+        _syncSlots.clear();
     }
 
     // clear these so if re-init-ing, we check again
@@ -456,6 +521,14 @@ bool SGTerraSync::WorkerThread::start()
     _stop = false;
     _state = TerrasyncThreadState(); // clean state
 
+    {
+        std::lock_guard<std::mutex> g(_stateLock);
+        _syncSlots.resize(NUM_SYNC_SLOTS + _maxTileSyncs - 1);
+    }
+    // a single server serves all of it
+    _http.setMaxConnections(_maxConnections);
+    _http.setMaxHostConnections(_maxConnections);
+
     SG_LOG(SG_TERRASYNC, SG_MANDATORY_INFO,
            "Starting automatic scenery download/synchronization to '" << _local_dir << "'.");
 
@@ -547,7 +620,7 @@ void SGTerraSync::WorkerThread::run()
     }
 }
 
-void SGTerraSync::WorkerThread::updateSyncSlot(SyncSlot &slot)
+void SGTerraSync::WorkerThread::updateSyncSlot(SyncSlot &slot, std::deque<SyncItem>& queue)
 {
     if (slot.repository.get()) {
         slot.repository->process();
@@ -585,9 +658,9 @@ void SGTerraSync::WorkerThread::updateSyncSlot(SyncSlot &slot)
     }
 
     // init and start sync of the next repository
-    if (!slot.queue.empty()) {
-        slot.currentItem = slot.queue.front();
-        slot.queue.pop_front();
+    if (!queue.empty() && withinBandwidthBudget()) {
+        slot.currentItem = queue.front();
+        queue.pop_front();
 
         SGPath path(_local_dir);
         path.append(slot.currentItem._dir);
@@ -618,8 +691,96 @@ void SGTerraSync::WorkerThread::updateSyncSlot(SyncSlot &slot)
         slot.busy = true;
         slot.pendingKBytes = slot.repository->bytesToDownload();
 
-        SG_LOG(SG_TERRASYNC, SG_INFO, "sync of " << slot.repository->baseUrl() << " started, queue size is " << slot.queue.size());
+        SG_LOG(SG_TERRASYNC, SG_INFO, "sync of " << slot.repository->baseUrl() << " started, queue size is " << queue.size());
+    }
+}
+
+bool SGTerraSync::WorkerThread::withinBandwidthBudget() const
+{
+    if ((_maxBytesPerSec == 0) || (_http.transferRateBytesPerSec() < _maxBytesPerSec)) {
+        return true;
+    }
+
+    // over budget: wait for the running syncs, but never stall completely
+    return std::none_of(_syncSlots.begin(), _syncSlots.end(),
+                        [](const SyncSlot& s) { return s.busy; });
+}
+
+void SGTerraSync::WorkerThread::cancelSync(SyncSlot& slot)
+{
+    SG_LOG(SG_TERRASYNC, SG_INFO, "cancelled sync of '" << slot.currentItem._dir
+           << "', no longer needed");
+    // deleting the repository cancels its requests. Nothing is recorded
+    // for the directory, so it can be requested again
+    slot.repository.reset();
+    slot.busy = false;
+    slot.pendingKBytes = 0;
+    slot.currentItem = {};
+
+    std::lock_guard<std::mutex> g(_stateLock);
+    _state._cancelled_count++;
+}
+
+void SGTerraSync::WorkerThread::scheduleTiles(bool newTiles)
+{
+    TerrasyncFlightState flight;
+    bool force = false;
+    {
+        // without a position, or with the one from before a reposition,
+        // keep the order of the requests and cancel nothing
+        std::lock_guard<std::mutex> g(_stateLock);
+        if (!_schedulingState.next(flight, force)) {
+            return;
+        }
+    }
+
+    // the order only changes slowly as we fly, so bound the time spent here
+    if (!newTiles && !force &&
+        (_lastSchedule.elapsedMSec() < RescheduleIntervalMSec)) {
+        return;
+    }
+    _lastSchedule.stamp();
+
+    for (unsigned int slot = 0; slot < _syncSlots.size(); ++slot) {
+        SyncSlot& syncSlot = _syncSlots[slot];
+        if (isTileSlot(slot) && syncSlot.busy &&
+            !itemNeed(syncSlot.currentItem, flight, _cancelDistanceM).wanted) {
+            cancelSync(syncSlot);
+        }
+    }
+
+    auto& queue = _syncSlots[SYNC_SLOT_TILES].queue;
+    std::vector<std::pair<TileNeed, SyncItem>> pending;
+    pending.reserve(queue.size());
+    int cancelled = 0;
+    for (const auto& item : queue) {
+        const TileNeed need = itemNeed(item, flight, _cancelDistanceM);
+        if (need.wanted) {
+            pending.emplace_back(need, item);
+        } else {
+            SG_LOG(SG_TERRASYNC, SG_DEBUG, "dropped queued sync of '" << item._dir
+                   << "', no longer needed");
+            ++cancelled;
+        }
+    }
+
+    // stable, so tiles needed at the same time keep their request order
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const std::pair<TileNeed, SyncItem>& a,
+                        const std::pair<TileNeed, SyncItem>& b) {
+                         if (a.first.seconds != b.first.seconds) {
+                             return a.first.seconds < b.first.seconds;
+                         }
+                         return a.first.distanceM < b.first.distanceM;
+                     });
+
+    // isDirActive() looks at the queue from other threads
+    std::lock_guard<std::mutex> g(_stateLock);
+    queue.clear();
+    for (const auto& p : pending) {
+        queue.push_back(p.second);
     }
+    _state._cancelled_count += cancelled;
 }
 
 void SGTerraSync::WorkerThread::beginSyncAirports(SyncSlot& slot)
@@ -748,14 +909,17 @@ void SGTerraSync::WorkerThread::runInternal()
         if (_stop)
             break;
 
-        drainWaitingTiles();
+        const bool newTiles = drainWaitingTiles();
+        scheduleTiles(newTiles);
 
         bool anySlotBusy = false;
         unsigned int newPendingCount = 0;
 
         // update each sync slot in turn
-        for (unsigned int slot=0; slot < NUM_SYNC_SLOTS; ++slot) {
-            updateSyncSlot(_syncSlots[slot]);
+        for (unsigned int slot=0; slot < _syncSlots.size(); ++slot) {
+            auto& queue = isTileSlot(slot) ? _syncSlots[SYNC_SLOT_TILES].queue
+                                           : _syncSlots[slot].queue;
+            updateSyncSlot(_syncSlots[slot], queue);
             newPendingCount += _syncSlots[slot].pendingKBytes;
             anySlotBusy |= _syncSlots[slot].busy;
         }
@@ -847,8 +1011,10 @@ void SGTerraSync::WorkerThread::updated(SyncItem item, bool isNewDirectory)
     writeCompletedTilesPersistentCache();
 }
 
-void SGTerraSync::WorkerThread::drainWaitingTiles()
+bool SGTerraSync::WorkerThread::drainWaitingTiles()
 {
+    bool newTiles = false;
+
     // drain the waiting tiles queue into the sync slot queues.
     while (!waitingTiles.empty()) {
         SyncItem next = waitingTiles.pop_front();
@@ -861,9 +1027,16 @@ void SGTerraSync::WorkerThread::drainWaitingTiles()
             continue;
         }
 
+        if (next._type == SyncItem::Tile) {
+            next._hasCenter = tileCenterForPath(next._dir, next._center);
+            newTiles = true;
+        }
+
         const auto slot = syncSlotForType(next._type);
         _syncSlots[slot].queue.push_back(next);
     }
+
+    return newTiles;
 }
 
 bool SGTerraSync::WorkerThread::isDirActive(const std::string& path) const
@@ -881,7 +1054,7 @@ bool SGTerraSync::WorkerThread::isDirActive(const std::string& path) const
 
     // check each sync slot in turn
     std::lock_guard<std::mutex> g(_stateLock);
-    for (unsigned int slot = 0; slot < NUM_SYNC_SLOTS; ++slot) {
+    for (unsigned int slot = 0; slot < _syncSlots.size(); ++slot) {
         const auto& syncSlot = _syncSlots[slot];
         if (syncSlot.currentItem._dir == path)
             return true;
@@ -989,11 +1162,21 @@ void SGTerraSync::setRoot(SGPropertyNode_ptr root)
     if (!root) {
         _terraRoot.clear();
         _renderingRoot.clear();
+        _latitudeNode.clear();
+        _longitudeNode.clear();
+        _trackNode.clear();
+        _groundspeedNode.clear();
         return;
     }
 
     _terraRoot = root->getNode("/sim/terrasync",true);
     _renderingRoot = root->getNode("/sim/rendering", true);
+
+    // where we are going, to sync the tiles we need first
+    _latitudeNode = root->getNode("/position/latitude-deg", true);
+    _longitudeNode = root->getNode("/position/longitude-deg", true);
+    _trackNode = root->getNode("/orientation/track-deg", true);
+    _groundspeedNode = root->getNode("/velocities/groundspeed-kt", true);
 }
 
 void SGTerraSync::init()
@@ -1052,6 +1235,12 @@ void SGTerraSync::reinit()
 
         _workerThread->setCacheHits(_terraRoot->getIntValue("cache-hit", 0));
 
+        // scheduling of tile syncs, see TileScheduling
+        _workerThread->setMaxTileSyncs(_terraRoot->getIntValue("max-tile-syncs", 2));
+        _workerThread->setMaxConnections(_terraRoot->getIntValue("max-connections", 4));
+        _workerThread->setMaxBandwidth(_terraRoot->getIntValue("max-bandwidth-kbytes-sec", 0));
+        _workerThread->setCancelDistance(_terraRoot->getDoubleValue("cancel-distance-km", 300.0));
+
         if (_workerThread->start())
         {
             syncAirportsModels();
@@ -1087,6 +1276,7 @@ void SGTerraSync::bind()
     _errorCountNode = _terraRoot->getNode("error-count", true);
     _tileCountNode = _terraRoot->getNode("tile-count", true);
     _cacheHitsNode = _terraRoot->getNode("cache-hits", true);
+    _cancelledCountNode = _terraRoot->getNode("cancelled-count", true);
     _transferRateBytesSecNode = _terraRoot->getNode("transfer-rate-bytes-sec", true);
     _pendingKbytesNode = _terraRoot->getNode("pending-kbytes", true);
     _downloadedKBtesNode = _terraRoot->getNode("downloaded-kbytes", true);
@@ -1107,11 +1297,16 @@ void SGTerraSync::unbind()
     _activeNode.clear();
     _cacheHits.clear();
     _renderingRoot.clear();
+    _latitudeNode.clear();
+    _longitudeNode.clear();
+    _trackNode.clear();
+    _groundspeedNode.clear();
     _busyNode.clear();
     _updateCountNode.clear();
     _errorCountNode.clear();
     _tileCountNode.clear();
     _cacheHitsNode.clear();
+    _cancelledCountNode.clear();
     _transferRateBytesSecNode.clear();
     _pendingKbytesNode.clear();
     _downloadedKBtesNode.clear();
@@ -1141,6 +1336,16 @@ void SGTerraSync::update(double)
         reinit();
         SG_LOG(SG_TERRASYNC, SG_MANDATORY_INFO, "Terrasync stopped");
     }
+    if (worker_running && _latitudeNode) {
+        TerrasyncFlightState flight;
+        flight.valid = true;
+        flight.position = SGGeod::fromDeg(_longitudeNode->getDoubleValue(),
+                                          _latitudeNode->getDoubleValue());
+        flight.trackDeg = _trackNode->getDoubleValue();
+        flight.groundspeedKt = _groundspeedNode->getDoubleValue();
+        _workerThread->setFlightState(flight);
+    }
+
     TerrasyncThreadState copiedState(_workerThread->threadsafeCopyState());
 
     _busyNode->setIntValue(copiedState._busy);
@@ -1148,6 +1353,7 @@ void SGTerraSync::update(double)
     _errorCountNode->setIntValue(copiedState._fail_count);
     _tileCountNode->setIntValue(copiedState._updated_tile_count);
     _cacheHitsNode->setIntValue(copiedState._cache_hits);
+    _cancelledCountNode->setIntValue(copiedState._cancelled_count);
     _transferRateBytesSecNode->setIntValue(copiedState._transfer_rate);
     _pendingKbytesNode->setIntValue(copiedState._totalKbPending);
     _downloadedKBtesNode->setIntValue(copiedState._total_kb_downloaded);
@@ -1266,7 +1472,9 @@ bool SGTerraSync::isDataDirPending(const std::string& dataDir) const
 
 void SGTerraSync::reposition()
 {
-    // stub, remove
+    // the queued tiles were ordered for where we were: reorder them (and
+    // drop those no longer needed) as soon as the new position is known
+    _workerThread->rescheduleTiles();
 }
 
 
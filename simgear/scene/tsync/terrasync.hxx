@@ -54,8 +54,8 @@ public:
     static const char* staticSubsystemClassId() { return "terrasync"; }
 
     /// notify terrasync that the sim was repositioned, as opposed to
-    /// us travelling in a direction. Avoid last_lat / last_lon blocking
-    /// certain tiles when we reposition.
+    /// us travelling in a direction. Pending tiles are reordered for the
+    /// new position right away instead of on the next interval.
     void reposition();
 
     bool isIdle();
@@ -104,11 +104,19 @@ private:
     SGPropertyNode_ptr _errorCountNode;
     SGPropertyNode_ptr _tileCountNode;
     SGPropertyNode_ptr _cacheHitsNode;
+    SGPropertyNode_ptr _cancelledCountNode;
     SGPropertyNode_ptr _transferRateBytesSecNode;
     SGPropertyNode_ptr _pendingKbytesNode;
     SGPropertyNode_ptr _downloadedKBtesNode;
     SGPropertyNode_ptr _maxErrorsNode;
 
+    // position, track and groundspeed, to order the tiles by when they
+    // are needed
+    SGPropertyNode_ptr _latitudeNode;
+    SGPropertyNode_ptr _longitudeNode;
+    SGPropertyNode_ptr _trackNode;
+    SGPropertyNode_ptr _groundspeedNode;
+
     // we manually bind+init TerraSync during early startup
     // to get better overlap of slow operations (Shared Models sync
     // and nav-cache rebuild). As a result we need to track the bind/init
@@ -0,0 +1,176 @@
+#include <simgear_config.h>
+
+#include "TileScheduling.hxx"
+
+#include <cmath>
+#include <iostream>
+
+#include <simgear/constants.h>
+#include <simgear/math/SGGeodesy.hxx>
+#include <simgear/misc/test_macros.hxx>
+
+using namespace simgear;
+
+static bool near(double a, double b)
+{
+    return std::fabs(a - b) < 1e-9;
+}
+
+static void testTileCenterForPath()
+{
+    SGGeod c;
+    SG_VERIFY(tileCenterForPath("Terrain/e000n50/e007n51", c));
+    SG_VERIFY(near(c.getLongitudeDeg(), 7.5));
+    SG_VERIFY(near(c.getLatitudeDeg(), 51.5));
+
+    // south and west tiles are named after their south-west corner too
+    SG_VERIFY(tileCenterForPath("Objects/w010s40/w003s34", c));
+    SG_VERIFY(near(c.getLongitudeDeg(), -2.5));
+    SG_VERIFY(near(c.getLatitudeDeg(), -33.5));
+
+    SG_VERIFY(tileCenterForPath("w180s90", c));
+    SG_VERIFY(near(c.getLongitudeDeg(), -179.5));
+    SG_VERIFY(near(c.getLatitudeDeg(), -89.5));
+
+    SG_VERIFY(!tileCenterForPath("Airports/K/S/F", c));
+    SG_VERIFY(!tileCenterForPath("Terrain/e000n50/x007n51", c));
+    SG_VERIFY(!tileCenterForPath("Terrain/e000n50/e007q51", c));
+    SG_VERIFY(!tileCenterForPath("Terrain/e000n50/e0a7n51", c));
+    SG_VERIFY(!tileCenterForPath("Terrain/e000n50/e007n51x", c));
+    SG_VERIFY(!tileCenterForPath("", c));
+}
+
+// a flight state at the origin, on trackDeg at kt knots
+static TerrasyncFlightState flying(double trackDeg, double kt)
+{
+    TerrasyncFlightState f;
+    f.valid = true;
+    f.position = SGGeod::fromDeg(0.0, 0.0);
+    f.trackDeg = trackDeg;
+    f.groundspeedKt = kt;
+    return f;
+}
+
+static SGGeod at(double courseDeg, double distanceM)
+{
+    return SGGeodesy::direct(SGGeod::fromDeg(0.0, 0.0), courseDeg, distanceM);
+}
+
+static void testTileNeed()
+{
+    const double R = TileScheduling::NeedRadiusM;
+    const TerrasyncFlightState north = flying(0.0, 400.0);
+    const double speed = 400.0 * SG_KT_TO_MPS;
+
+    // within range: needed now
+    TileNeed n = tileNeed(at(90.0, R / 2), north, 0.0);
+    SG_CHECK_EQUAL(n.seconds, 0.0);
+    SG_VERIFY(n.wanted);
+    SG_VERIFY(std::fabs(n.distanceM - R / 2) < 1.0);
+
+    // straight ahead: needed when it comes into range
+    n = tileNeed(at(0.0, 3 * R), north, 0.0);
+    SG_VERIFY(n.wanted);
+    SG_VERIFY(std::fabs(n.seconds - 2 * R / speed) < 1.0);
+
+    // a tile further ahead is needed later
+    TileNeed further = tileNeed(at(0.0, 5 * R), north, 0.0);
+    SG_VERIFY(further.seconds > n.seconds);
+
+    // beside the track, but we pass within range: needed a little later
+    // than the tile straight ahead
+    TileNeed beside = tileNeed(at(10.0, 3 * R), north, 0.0);
+    SG_VERIFY(beside.seconds > n.seconds);
+    SG_VERIFY(beside.seconds < further.seconds);
+
+    // behind the aircraft: later than the same distance ahead, and the
+    // further behind the later
+    TileNeed behind = tileNeed(at(180.0, 3 * R), north, 0.0);
+    SG_VERIFY(behind.wanted);
+    SG_VERIFY(behind.seconds > n.seconds);
+    TileNeed furtherBehind = tileNeed(at(180.0, 5 * R), north, 0.0);
+    SG_VERIFY(furtherBehind.seconds > behind.seconds);
+
+    // abeam is between ahead and behind
+    TileNeed abeam = tileNeed(at(270.0, 3 * R), north, 0.0);
+    SG_VERIFY(abeam.seconds > n.seconds);
+    SG_VERIFY(abeam.seconds < behind.seconds);
+    SG_VERIFY(std::fabs(abeam.seconds -
+                        TileScheduling::OffTrackPenalty * 2 * R / speed) < 1.0);
+
+    // stationary: the track means nothing, so nearer tiles come first
+    // whichever way they are
+    const TerrasyncFlightState parked = flying(0.0, 0.0);
+    TileNeed parkedBehind = tileNeed(at(180.0, 2 * R), parked, 0.0);
+    TileNeed parkedAhead = tileNeed(at(0.0, 3 * R), parked, 0.0);
+    SG_VERIFY(parkedBehind.seconds < parkedAhead.seconds);
+}
+
+static void testCancelDistance()
+{
+    const double R = TileScheduling::NeedRadiusM;
+    const TerrasyncFlightState north = flying(0.0, 400.0);
+
+    // far ahead: we will get close, so it is still wanted
+    SG_VERIFY(tileNeed(at(0.0, 10 * R), north, 2 * R).wanted);
+    // behind: the closest we get is where we are now
+    SG_VERIFY(!tileNeed(at(180.0, 3 * R), north, 2 * R).wanted);
+    SG_VERIFY(tileNeed(at(180.0, 1.5 * R), north, 2 * R).wanted);
+    // ahead but off to the side: the closest approach is abeam
+    SG_VERIFY(!tileNeed(at(45.0, 4 * R), north, 2 * R).wanted);
+    SG_VERIFY(tileNeed(at(10.0, 4 * R), north, 2 * R).wanted);
+    // 0 disables cancelling
+    SG_VERIFY(tileNeed(at(180.0, 30 * R), north, 0.0).wanted);
+
+    // stationary: only the distance counts
+    const TerrasyncFlightState parked = flying(0.0, 0.0);
+    SG_VERIFY(!tileNeed(at(0.0, 3 * R), parked, 2 * R).wanted);
+    SG_VERIFY(tileNeed(at(180.0, 1.5 * R), parked, 2 * R).wanted);
+}
+
+static void testReposition()
+{
+    const double R = TileScheduling::NeedRadiusM;
+    TerrasyncFlightState before = flying(0.0, 400.0);
+    TileSchedulingState state;
+
+    TerrasyncFlightState flight;
+    bool reorderNow = true;
+    SG_VERIFY(!state.next(flight, reorderNow));
+
+    state.update(before);
+    SG_VERIFY(state.next(flight, reorderNow));
+    SG_VERIFY(!reorderNow);
+
+    // a tile at the destination, far behind the old position
+    TerrasyncFlightState after = before;
+    after.position = at(180.0, 20 * R);
+    after.groundspeedKt = 0.0;
+    const SGGeod destinationTile = at(180.0, 20.5 * R);
+    SG_VERIFY(!tileNeed(destinationTile, before, 2 * R).wanted);
+    SG_VERIFY(tileNeed(destinationTile, after, 2 * R).wanted);
+
+    // the old state must not be used to drop it
+    state.reposition();
+    SG_VERIFY(!state.next(flight, reorderNow));
+    SG_VERIFY(!state.next(flight, reorderNow));
+
+    // the next update brings the new position, to reorder for right away
+    state.update(after);
+    SG_VERIFY(state.next(flight, reorderNow));
+    SG_VERIFY(reorderNow);
+    SG_VERIFY(tileNeed(destinationTile, flight, 2 * R).wanted);
+    SG_VERIFY(state.next(flight, reorderNow));
+    SG_VERIFY(!reorderNow);
+}
+
+int main(int argc, char* argv[])
+{
+    testTileCenterForPath();
+    testTileNeed();
+    testCancelDistance();
+    testReposition();
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
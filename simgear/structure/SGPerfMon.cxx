@@ -24,6 +24,7 @@
 #endif
 
 #include "SGPerfMon.hxx"
+#include <simgear/structure/SGProfiler.hxx>
 #include <simgear/structure/SGSmplstat.hxx>
 
 #include <stdio.h>
@@ -34,6 +35,7 @@
 #include <simgear/sg_inlines.h>
 #include <simgear/debug/logstream.hxx>
 #include <simgear/math/sg_geodesy.hxx>
+#include <simgear/misc/sg_path.hxx>
 #include <simgear/structure/exception.hxx>
 
 using std::string;
@@ -55,6 +57,12 @@ SGPerformanceMonitor::bind(void)
     _timingDetailsFlag->setBoolValue(false);
     _statisticsInterval  = _root->getChild("interval-s",    0, true);
     _maxTimePerFrame_ms = _root->getChild("max-time-per-frame-ms", 0, true);
+
+    // setting trace-file writes the zones recorded so far as a Chrome
+    // trace, then clears the property again
+    SGPropertyNode* profiler = _root->getChild("profiler", 0, true);
+    _profilerFlag        = profiler->getChild("enabled",    0, true);
+    _profilerTraceFile   = profiler->getChild("trace-file", 0, true);
 }
 
 void
@@ -64,6 +72,8 @@ SGPerformanceMonitor::unbind(void)
     _statisticsFlag = 0;
     _statisticsInterval = 0;
     _maxTimePerFrame_ms = 0;
+    _profilerFlag = 0;
+    _profilerTraceFile = 0;
 }
 
 void
@@ -91,6 +101,14 @@ SGPerformanceMonitor::update(double dt)
         _subSysMgr->setReportTimingStats(true);
         _timingDetailsFlag->setBoolValue(false);
     }
+    if (SGProfiler::isEnabled() != _profilerFlag->getBoolValue()) {
+        SGProfiler::setEnabled(_profilerFlag->getBoolValue());
+    }
+    const std::string traceFile = _profilerTraceFile->getStringValue();
+    if (!traceFile.empty()) {
+        SGProfiler::writeChromeTrace(SGPath::fromUtf8(traceFile));
+        _profilerTraceFile->setStringValue("");
+    }
     if (!_isEnabled)
         return;
 
@@ -59,6 +59,8 @@ private:
     SGPropertyNode_ptr _statisticsFlag;
     SGPropertyNode_ptr _statisticsInterval;
     SGPropertyNode_ptr _maxTimePerFrame_ms;
+    SGPropertyNode_ptr _profilerFlag;
+    SGPropertyNode_ptr _profilerTraceFile;
 
     bool _isEnabled;
     int _count;
@@ -0,0 +1,339 @@
+// SGProfiler.cxx -- scoped-zone frame profiler
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "SGProfiler.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_set>
+#include <vector>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_path.hxx>
+
+std::atomic<bool> SGProfiler::_enabled{false};
+
+namespace {
+
+const unsigned int MAX_ZONE_DEPTH = 64;
+const uint64_t MARK_DURATION = ~uint64_t(0);
+
+// every field is atomic so that an export racing with the owning thread
+// reads stale values at worst, never a torn name pointer
+struct ZoneRecord {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> duration{0};
+};
+
+struct ThreadBuffer {
+    explicit ThreadBuffer(unsigned int aId) :
+        id(aId)
+    {
+    }
+
+    void record(const char* name, uint64_t start, uint64_t duration)
+    {
+        ZoneRecord* r = records.load(std::memory_order_relaxed);
+        if (!r) {
+            r = allocate();
+        }
+
+        const uint64_t w = written.load(std::memory_order_relaxed);
+        r += w % size;
+        r->name.store(name, std::memory_order_relaxed);
+        r->start.store(start, std::memory_order_relaxed);
+        r->duration.store(duration, std::memory_order_relaxed);
+        written.store(w + 1, std::memory_order_release);
+    }
+
+    ZoneRecord* allocate();
+
+    // the ring is only allocated once the thread records a zone, threads
+    // which never do so cost nothing more than this header
+    std::unique_ptr<ZoneRecord[]> storage;
+    std::atomic<ZoneRecord*> records{nullptr};
+    size_t size = 0; // set before records is published
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> clearedAt{0};
+    // set once the thread has exited and will record no more
+    std::atomic<bool> exited{false};
+    const unsigned int id;
+    std::string threadName; // guarded by the registry lock
+
+    // open zones, only touched by the owning thread
+    unsigned int depth = 0;
+    const char* openName[MAX_ZONE_DEPTH];
+    uint64_t openStart[MAX_ZONE_DEPTH];
+};
+
+struct Registry {
+    std::mutex lock;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::unordered_set<std::string> names;
+    size_t bufferSize = 16384;
+    unsigned int nextId = 1;
+};
+
+Registry& registry()
+{
+    static Registry global_registry;
+    return global_registry;
+}
+
+ZoneRecord* ThreadBuffer::allocate()
+{
+    {
+        std::lock_guard<std::mutex> g(registry().lock);
+        size = registry().bufferSize;
+    }
+    storage.reset(new ZoneRecord[size]);
+    records.store(storage.get(), std::memory_order_release);
+    return storage.get();
+}
+
+// buffers outlive their thread, so its zones can still be exported; the
+// registry drops them once that has happened
+struct ThreadBufferRef {
+    ~ThreadBufferRef()
+    {
+        if (buffer) {
+            buffer->exited.store(true, std::memory_order_release);
+        }
+    }
+
+    std::shared_ptr<ThreadBuffer> buffer;
+};
+
+thread_local ThreadBufferRef tls_buffer;
+
+ThreadBuffer& threadBuffer()
+{
+    if (!tls_buffer.buffer) {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> g(reg.lock);
+        tls_buffer.buffer = std::make_shared<ThreadBuffer>(reg.nextId++);
+        reg.buffers.push_back(tls_buffer.buffer);
+    }
+    return *tls_buffer.buffer;
+}
+
+uint64_t nowNSec()
+{
+    using namespace std::chrono;
+    static const steady_clock::time_point epoch = steady_clock::now();
+    return duration_cast<nanoseconds>(steady_clock::now() - epoch).count();
+}
+
+void writeJSONString(std::ostream& os, const char* s)
+{
+    os << '"';
+    for (; *s; ++s) {
+        const unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') {
+            os << '\\' << *s;
+        } else if (c < 0x20) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+               << static_cast<int>(c) << std::dec << std::setfill(' ');
+        } else {
+            os << *s;
+        }
+    }
+    os << '"';
+}
+
+void writeMicroseconds(std::ostream& os, uint64_t nsec)
+{
+    os << (nsec / 1000) << '.' << std::setw(3) << std::setfill('0')
+       << (nsec % 1000) << std::setfill(' ');
+}
+
+} // of anonymous namespace
+
+void SGProfiler::setEnabled(bool enabled)
+{
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void SGProfiler::setBufferSize(size_t zones)
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> g(reg.lock);
+    reg.bufferSize = std::max<size_t>(zones, 1);
+}
+
+void SGProfiler::setThreadName(const std::string& name)
+{
+    ThreadBuffer& buf = threadBuffer();
+    std::lock_guard<std::mutex> g(registry().lock);
+    buf.threadName = name;
+}
+
+const char* SGProfiler::internName(const std::string& name)
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> g(reg.lock);
+    return reg.names.insert(name).first->c_str();
+}
+
+void SGProfiler::beginZone(const char* name)
+{
+    ThreadBuffer& buf = threadBuffer();
+    if (buf.depth < MAX_ZONE_DEPTH) {
+        buf.openName[buf.depth] = name;
+        buf.openStart[buf.depth] = nowNSec();
+    }
+    ++buf.depth;
+}
+
+void SGProfiler::endZone()
+{
+    ThreadBuffer& buf = threadBuffer();
+    if (buf.depth == 0) {
+        return; // unbalanced, ignore
+    }
+
+    --buf.depth;
+    if (buf.depth < MAX_ZONE_DEPTH) {
+        const uint64_t start = buf.openStart[buf.depth];
+        buf.record(buf.openName[buf.depth], start, nowNSec() - start);
+    }
+}
+
+void SGProfiler::mark(const char* name)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    threadBuffer().record(name, nowNSec(), MARK_DURATION);
+}
+
+void SGProfiler::clear()
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> g(reg.lock);
+    for (auto& buf : reg.buffers) {
+        buf->clearedAt.store(buf->written.load(std::memory_order_acquire),
+                             std::memory_order_relaxed);
+    }
+}
+
+void SGProfiler::writeChromeTrace(std::ostream& os)
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<std::string> threadNames;
+    std::vector<const ThreadBuffer*> finished;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> g(reg.lock);
+        buffers = reg.buffers;
+        for (const auto& b : buffers) {
+            threadNames.push_back(b->threadName);
+        }
+    }
+
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&os, &first]() {
+        os << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        const ThreadBuffer& buf = *buffers[i];
+        // checked before reading the ring: if the thread had exited, the
+        // ring is complete and can go once written out
+        if (buf.exited.load(std::memory_order_acquire)) {
+            finished.push_back(&buf);
+        }
+
+        if (!threadNames[i].empty()) {
+            separator();
+            os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+               << buf.id << ",\"args\":{\"name\":";
+            writeJSONString(os, threadNames[i].c_str());
+            os << "}}";
+        }
+
+        const ZoneRecord* records = buf.records.load(std::memory_order_acquire);
+        if (!records) {
+            continue;
+        }
+
+        const uint64_t end = buf.written.load(std::memory_order_acquire);
+        const uint64_t size = buf.size;
+        uint64_t begin = buf.clearedAt.load(std::memory_order_relaxed);
+        if (end - std::min(begin, end) > size) {
+            begin = end - size;
+        }
+
+        for (uint64_t w = begin; w < end; ++w) {
+            const ZoneRecord& r = records[w % size];
+            const char* name = r.name.load(std::memory_order_relaxed);
+            if (!name) {
+                continue;
+            }
+
+            const uint64_t duration = r.duration.load(std::memory_order_relaxed);
+            separator();
+            os << "{\"name\":";
+            writeJSONString(os, name);
+            if (duration == MARK_DURATION) {
+                os << ",\"ph\":\"i\",\"s\":\"t\"";
+            } else {
+                os << ",\"ph\":\"X\",\"dur\":";
+                writeMicroseconds(os, duration);
+            }
+            os << ",\"ts\":";
+            writeMicroseconds(os, r.start.load(std::memory_order_relaxed));
+            os << ",\"pid\":1,\"tid\":" << buf.id << "}";
+        }
+    }
+
+    os << "\n]}\n";
+
+    if (!finished.empty()) {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> g(reg.lock);
+        reg.buffers.erase(std::remove_if(reg.buffers.begin(), reg.buffers.end(),
+            [&finished](const std::shared_ptr<ThreadBuffer>& b) {
+                return std::find(finished.begin(), finished.end(), b.get()) !=
+                       finished.end();
+            }), reg.buffers.end());
+    }
+}
+
+bool SGProfiler::writeChromeTrace(const SGPath& path)
+{
+    sg_ofstream os(path, std::ios::out | std::ios::trunc);
+    if (!os.is_open()) {
+        SG_LOG(SG_GENERAL, SG_WARN, "SGProfiler: unable to write trace to " << path);
+        return false;
+    }
+
+    writeChromeTrace(os);
+    os.close();
+    SG_LOG(SG_GENERAL, SG_INFO, "SGProfiler: wrote trace to " << path);
+    return true;
+}
@@ -0,0 +1,118 @@
+// SGProfiler.hxx -- scoped-zone frame profiler
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __SGPROFILER_HXX
+#define __SGPROFILER_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+class SGPath;
+
+/**
+ * Low-overhead, per-thread profiler for nested, named zones.
+ *
+ * <p>Each thread records completed zones into its own fixed-size ring
+ * buffer, so recording never takes a lock and old zones are simply
+ * overwritten. The ring is allocated when the thread records its first
+ * zone, and dropped once written out after the thread exited. While the
+ * profiler is disabled, a zone costs a single relaxed atomic load.</p>
+ *
+ * <p>The recorded zones of all threads can be written out in the Chrome
+ * trace-event JSON format, which chrome://tracing, Perfetto and
+ * Speedscope can display.</p>
+ *
+ * <p>Zone names are stored as pointers and must outlive the profiler:
+ * use string literals, or names returned by internName().</p>
+ */
+class SGProfiler
+{
+public:
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled()
+    { return _enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Number of zones each thread keeps; applies to threads which
+     * record their first zone after the call.
+     */
+    static void setBufferSize(size_t zones);
+
+    /// name the calling thread in exported traces
+    static void setThreadName(const std::string& name);
+
+    /// return a stable pointer for a dynamic zone name
+    static const char* internName(const std::string& name);
+
+    static void beginZone(const char* name);
+    static void endZone();
+
+    /// record an instantaneous event, such as an SGSubsystem::stamp()
+    static void mark(const char* name);
+
+    /// discard everything recorded so far, on all threads
+    static void clear();
+
+    /**
+     * Write all recorded zones as Chrome trace-event JSON. Threads may
+     * keep recording meanwhile; zones overwritten during the export can
+     * show up with inconsistent timings.
+     */
+    static void writeChromeTrace(std::ostream& os);
+    static bool writeChromeTrace(const SGPath& path);
+
+private:
+    static std::atomic<bool> _enabled;
+};
+
+/**
+ * Records a zone covering its own lifetime, if the profiler was enabled
+ * when it was created.
+ */
+class SGProfileZone
+{
+public:
+    explicit SGProfileZone(const char* name) :
+        _active(SGProfiler::isEnabled())
+    {
+        if (_active)
+            SGProfiler::beginZone(name);
+    }
+
+    ~SGProfileZone()
+    {
+        if (_active)
+            SGProfiler::endZone();
+    }
+
+    SGProfileZone(const SGProfileZone&) = delete;
+    SGProfileZone& operator=(const SGProfileZone&) = delete;
+
+private:
+    const bool _active;
+};
+
+#define SG_PROFILE_CONCAT_(a, b) a##b
+#define SG_PROFILE_CONCAT(a, b) SG_PROFILE_CONCAT_(a, b)
+
+/// profile the remainder of the enclosing scope
+#define SG_PROFILE_ZONE(name) \
+    SGProfileZone SG_PROFILE_CONCAT(sgProfileZone_, __LINE__)(name)
+
+#endif // __SGPROFILER_HXX
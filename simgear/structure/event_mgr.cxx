@@ -4,7 +4,13 @@
 
 #include "event_mgr.hxx"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+
 #include <simgear/debug/logstream.hxx>
+#include <simgear/structure/SGProfiler.hxx>
 
 void SGEventMgr::add(const std::string& name, SGCallback* cb,
                      double interval, double delay,
@@ -20,14 +26,14 @@ void SGEventMgr::add(const std::string& name, SGCallback* cb,
     if(delay <= 0) delay = 1e-6;
     if(interval <= 0) interval = 1e-6; // No timer endless loops please...
 
-    SGTimer* t = new SGTimer;
+    SGTimerQueue* q = simtime ? &_simQueue : &_rtQueue;
+
+    SGTimer* t = q->allocate();
     t->interval = interval;
     t->callback = cb;
     t->repeat = repeat;
     t->name = name;
     t->running = false;
-    
-    SGTimerQueue* q = simtime ? &_simQueue : &_rtQueue;
 
     q->insert(t, delay);
 }
@@ -100,21 +106,24 @@ void SGEventMgr::removeTask(const std::string& name)
         return;
     }
     
+  SGTimerQueue* q = &_simQueue;
   SGTimer* t = _simQueue.findByName(name);
-  if (t) {
-    _simQueue.remove(t);
-  } else if ((t = _rtQueue.findByName(name))) {
-    _rtQueue.remove(t);
-  } else {
+  if (!t) {
+    q = &_rtQueue;
+    t = _rtQueue.findByName(name);
+  }
+  if (!t) {
     SG_LOG(SG_GENERAL, SG_WARN, "removeTask: no task found with name:" << name);
     return;
   }
+
+  q->remove(t);
   if (t->running) {
     // mark as not repeating so that the SGTimerQueue::update()
     // will clean it up
     t->repeat = false;
   } else {
-    delete t;
+    q->release(t);
   }
 }
 
@@ -133,164 +142,338 @@ SGSubsystemMgr::Registrant<SGEventMgr> registrantSGEventMgr(
 
 ////////////////////////////////////////////////////////////////////////
 // SGTimerQueue
-// This is the priority queue implementation:
+// This is the timing wheel implementation:
 ////////////////////////////////////////////////////////////////////////
 
-SGTimerQueue::SGTimerQueue(int size)
+SGTimerQueue::SGTimerQueue(int size) :
+    _now(0.0),
+    _curTick(0),
+    _nextSeq(1),
+    _numEntries(0),
+    _overflow(nullptr),
+    _freeList(nullptr)
 {
-    _now = 0;
-    _numEntries = 0;
-    _tableSize = 1;
-    while(size > _tableSize)
-        _tableSize = ((_tableSize + 1)<<1) - 1;
-
-    _table = new HeapEntry[_tableSize];
-    for(int i=0; i<_tableSize; i++) {
-	    _table[i].pri = 0;
-        _table[i].timer = 0;
+    std::fill(std::begin(_slots), std::end(_slots), nullptr);
+    std::fill(std::begin(_levelCount), std::end(_levelCount), 0);
+
+    // pre-fill the pool
+    for (int i = 0; i < size; ++i) {
+        release(allocate());
     }
 }
 
-
 SGTimerQueue::~SGTimerQueue()
 {
     clear();
-    delete[] _table;
 }
 
 void SGTimerQueue::clear()
 {
-    // delete entries
-    for(int i=0; i<_numEntries; i++) {
-        delete _table[i].timer;
+    for (auto& t : _storage) {
+        if ((t._slot == LOC_FREE) || (t._slot == LOC_NONE && !t.running)) {
+            continue;
+        }
+
+        remove(&t);
+        if (t.running) {
+            // still inside its callback: update() releases it afterwards
+            t.repeat = false;
+        } else {
+            release(&t);
+        }
     }
-    
-    _numEntries = 0;
-    
-    // clear entire table to empty
-    for(int i=0; i<_tableSize; i++) {
-	    _table[i].pri = 0;
-        _table[i].timer = 0;
+
+    _firing.clear();
+}
+
+SGTimer* SGTimerQueue::allocate()
+{
+    SGTimer* t = _freeList;
+    if (t) {
+        _freeList = t->_next;
+        t->_next = nullptr;
+    } else {
+        _storage.emplace_back();
+        t = &_storage.back();
+        t->callback = nullptr;
     }
+
+    t->interval = 0.0;
+    t->repeat = false;
+    t->running = false;
+    t->_slot = LOC_NONE;
+    return t;
 }
-int maxTimerQueuePerItem_us = 30;
-void SGTimerQueue::update(double deltaSecs, std::map<std::string, double> &timingStats)
+
+void SGTimerQueue::release(SGTimer* t)
 {
-    _now += deltaSecs;
+    assert(t->_slot == LOC_NONE);
+    delete t->callback;
+    t->callback = nullptr;
+    t->name.clear();
+    t->profileName = nullptr;
+    t->running = false;
 
-    while (_numEntries && nextTime() <= _now) {
-        SGTimer* t = remove();
-        if (t->repeat)
-            insert(t, t->interval);
-        // warning: this is not thread safe
-        // but the entire timer queue isn't either
-        SGTimeStamp timeStamp;
-        timeStamp.stamp();
-        t->running = true;
-        t->run();
-        t->running = false;
-        timingStats[t->name] += timeStamp.elapsedMSec() / 1000.0;
-        if (!t->repeat)
-            delete t;
+    t->_slot = LOC_FREE;
+    t->_prev = nullptr;
+    t->_next = _freeList;
+    _freeList = t;
+}
+
+int64_t SGTimerQueue::tickFor(double time) const
+{
+    return static_cast<int64_t>(std::floor(time / TICK_SEC));
+}
+
+void SGTimerQueue::place(SGTimer* t)
+{
+    const int64_t dueTick = std::max(tickFor(t->_due), _curTick);
+    const int64_t delta = dueTick - _curTick;
+
+    SGTimer** head = &_overflow;
+    t->_slot = LOC_OVERFLOW;
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        if (delta < (int64_t(1) << (WHEEL_BITS * (level + 1)))) {
+            const int slot = (dueTick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            t->_slot = level * WHEEL_SLOTS + slot;
+            head = &_slots[t->_slot];
+            _levelCount[level]++;
+            break;
+        }
+    }
+
+    t->_prev = nullptr;
+    t->_next = *head;
+    if (*head) {
+        (*head)->_prev = t;
     }
+    *head = t;
 }
 
-void SGTimerQueue::insert(SGTimer* timer, double time)
+void SGTimerQueue::unlink(SGTimer* t)
 {
-    if(_numEntries >= _tableSize)
-	growArray();
+    SGTimer** head = nullptr;
+    if (t->_slot >= 0) {
+        head = &_slots[t->_slot];
+        _levelCount[t->_slot / WHEEL_SLOTS]--;
+    } else if (t->_slot == LOC_OVERFLOW) {
+        head = &_overflow;
+    }
 
-    _numEntries++;
-    _table[_numEntries-1].pri = -(_now + time);
-    _table[_numEntries-1].timer = timer;
+    if (head) {
+        if (t->_prev) {
+            t->_prev->_next = t->_next;
+        } else {
+            *head = t->_next;
+        }
+        if (t->_next) {
+            t->_next->_prev = t->_prev;
+        }
+    }
 
-    siftUp(_numEntries-1);
+    t->_prev = t->_next = nullptr;
+    t->_slot = LOC_NONE;
 }
 
-SGTimer* SGTimerQueue::remove(SGTimer* t)
+void SGTimerQueue::linkName(SGTimer* t)
 {
-    int entry;
-    for(entry=0; entry<_numEntries; entry++)
-        if(_table[entry].timer == t)
-            break;
-    if(entry == _numEntries)
-        return 0;
+    auto it = _byName.find(t->name);
+    t->_namePrev = nullptr;
+    if (it == _byName.end()) {
+        t->_nameNext = nullptr;
+        _byName.emplace(t->name, t);
+    } else {
+        t->_nameNext = it->second;
+        it->second->_namePrev = t;
+        it->second = t;
+    }
+}
 
-    // Swap in the last item in the table, and sift down
-    swap(entry, _numEntries-1);
-    _numEntries--;
-    siftDown(entry);
+void SGTimerQueue::unlinkName(SGTimer* t)
+{
+    if (t->_namePrev) {
+        t->_namePrev->_nameNext = t->_nameNext;
+    } else {
+        auto it = _byName.find(t->name);
+        assert(it != _byName.end() && it->second == t);
+        if (t->_nameNext) {
+            it->second = t->_nameNext;
+        } else {
+            _byName.erase(it);
+        }
+    }
+    if (t->_nameNext) {
+        t->_nameNext->_namePrev = t->_namePrev;
+    }
+    t->_namePrev = t->_nameNext = nullptr;
+}
 
-    return t;
+void SGTimerQueue::insert(SGTimer* timer, double time)
+{
+    assert(timer->_slot == LOC_NONE);
+    timer->_due = _now + time;
+    timer->_seq = _nextSeq++;
+    place(timer);
+    linkName(timer);
+    _numEntries++;
 }
 
-SGTimer* SGTimerQueue::remove()
+SGTimer* SGTimerQueue::remove(SGTimer* t)
 {
-    if(_numEntries == 0) {
-	return 0;
-    } else if(_numEntries == 1) {
-	_numEntries = 0;
-	return _table[0].timer;
+    if ((t->_slot == LOC_NONE) || (t->_slot == LOC_FREE)) {
+        return nullptr;
     }
 
-    SGTimer *result = _table[0].timer;
-    _table[0] = _table[_numEntries - 1];
+    // a timer waiting in _firing is skipped once its state changes
+    unlink(t);
+    unlinkName(t);
     _numEntries--;
-    siftDown(0);
-    return result;
+    return t;
 }
 
-void SGTimerQueue::siftDown(int n)
+void SGTimerQueue::cascade()
 {
-    // While we have children bigger than us, swap us with the biggest
-    // child.
-    while(lchild(n) < _numEntries) {
-        int bigc = lchild(n);
-        if(rchild(n) < _numEntries && pri(rchild(n)) > pri(bigc))
-            bigc = rchild(n);
-        if(pri(bigc) <= pri(n))
-            break;
-        swap(n, bigc);
-        n = bigc;
+    // re-place the slots whose span starts at the current tick, coarsest
+    // level first so their timers can trickle down more than one level
+    if ((_curTick & ((int64_t(1) << (WHEEL_BITS * WHEEL_LEVELS)) - 1)) == 0) {
+        SGTimer* list = _overflow;
+        _overflow = nullptr;
+        while (list) {
+            SGTimer* t = list;
+            list = t->_next;
+            place(t);
+        }
+    }
+
+    for (int level = WHEEL_LEVELS - 1; level > 0; --level) {
+        if (_curTick & ((int64_t(1) << (WHEEL_BITS * level)) - 1)) {
+            continue;
+        }
+
+        const int slot = level * WHEEL_SLOTS +
+            ((_curTick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+        SGTimer* list = _slots[slot];
+        _slots[slot] = nullptr;
+        while (list) {
+            SGTimer* t = list;
+            list = t->_next;
+            _levelCount[level]--;
+            place(t);
+        }
     }
 }
 
-void SGTimerQueue::siftUp(int n)
+int maxTimerQueuePerItem_us = 30;
+
+void SGTimerQueue::fireCurrentTick(std::map<std::string, double> &timingStats)
 {
-    while((n != 0) && (_table[n].pri > _table[parent(n)].pri)) {
-	swap(n, parent(n));
-	n = parent(n);
+    SGTimer** head = &_slots[_curTick & WHEEL_MASK];
+    for (SGTimer* t = *head; t; ) {
+        SGTimer* next = t->_next;
+        if (t->_due <= _now) {
+            unlink(t);
+            t->_slot = LOC_FIRING;
+            _firing.push_back({t->_due, t->_seq, t});
+        }
+        t = next;
+    }
+
+    if (_firing.empty()) {
+        return;
+    }
+
+    std::sort(_firing.begin(), _firing.end(), [](const Firing& a, const Firing& b) {
+        return (a.due < b.due) || ((a.due == b.due) && (a.seq < b.seq));
+    });
+
+    // callbacks may add and remove timers (including ones waiting in
+    // here), so work on a private copy
+    std::vector<Firing> firing;
+    firing.swap(_firing);
+    for (const auto& f : firing) {
+        SGTimer* t = f.timer;
+        if ((t->_seq != f.seq) || (t->_slot != LOC_FIRING)) {
+            continue; // removed by an earlier callback
+        }
+
+        // repeating timers stay findable by name while they run
+        t->_slot = LOC_NONE;
+        if (t->repeat) {
+            t->_due = _now + t->interval;
+            t->_seq = _nextSeq++;
+            place(t);
+        } else {
+            unlinkName(t);
+            _numEntries--;
+        }
+        // warning: this is not thread safe
+        // but the entire timer queue isn't either
+        SGTimeStamp timeStamp;
+        timeStamp.stamp();
+        if (!t->profileName && SGProfiler::isEnabled())
+            t->profileName = SGProfiler::internName(t->name);
+        t->running = true;
+        {
+            SGProfileZone zone(t->profileName);
+            t->run();
+        }
+        t->running = false;
+        timingStats[t->name] += timeStamp.elapsedMSec() / 1000.0;
+        if (!t->repeat && (t->_slot == LOC_NONE))
+            release(t);
+    }
+
+    firing.clear();
+    if (_firing.empty()) {
+        _firing.swap(firing); // keep the capacity
     }
-    siftDown(n);
 }
 
-void SGTimerQueue::growArray()
+void SGTimerQueue::update(double deltaSecs, std::map<std::string, double> &timingStats)
 {
-    _tableSize = ((_tableSize+1)<<1) - 1;
-    HeapEntry *newTable = new HeapEntry[_tableSize];
-    for(int i=0; i<_numEntries; i++) {
-	newTable[i].pri  = _table[i].pri;
-	newTable[i].timer = _table[i].timer;
+    _now += deltaSecs;
+    const int64_t nowTick = std::max(tickFor(_now), _curTick);
+
+    while (true) {
+        fireCurrentTick(timingStats);
+        if (_curTick >= nowTick) {
+            break;
+        }
+
+        // skip straight over empty stretches of the finer levels
+        int emptyLevels = 0;
+        while ((emptyLevels < WHEEL_LEVELS) && (_levelCount[emptyLevels] == 0)) {
+            ++emptyLevels;
+        }
+
+        if ((emptyLevels == WHEEL_LEVELS) && !_overflow) {
+            _curTick = nowTick;
+        } else if (emptyLevels == 0) {
+            ++_curTick;
+        } else {
+            const int64_t span = int64_t(1) << (WHEEL_BITS * emptyLevels);
+            _curTick = std::min((_curTick | (span - 1)) + 1, nowTick);
+        }
+
+        if ((_curTick & WHEEL_MASK) == 0) {
+            cascade();
+        }
     }
-    delete[] _table;
-    _table = newTable;
 }
 
 SGTimer* SGTimerQueue::findByName(const std::string& name) const
 {
-  for (int i=0; i < _numEntries; ++i) {
-    if (_table[i].timer->name == name) {
-      return _table[i].timer;
-    }
-  }
-  
-  return NULL;
+    auto it = _byName.find(name);
+    return (it == _byName.end()) ? nullptr : it->second;
 }
 
 void SGTimerQueue::dump()
 {
-    for (int i=0; i < _numEntries; ++i) {
-        const auto t = _table[i].timer;
-        SG_LOG(SG_GENERAL, SG_INFO, "\ttimer:" << t->name << ", interval=" << t->interval);
+    for (const auto& t : _storage) {
+        if ((t._slot == LOC_NONE) || (t._slot == LOC_FREE)) {
+            continue;
+        }
+        SG_LOG(SG_GENERAL, SG_INFO, "\ttimer:" << t.name << ", interval=" << t.interval
+               << ", due=" << t._due);
     }
 }
@@ -4,10 +4,20 @@
 #include <simgear/props/props.hxx>
 #include <simgear/structure/subsystem_mgr.hxx>
 
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
 #include "callback.hxx"
 
 class SGEventMgr;
 
+/**
+ * A named callback scheduled on an SGTimerQueue. Timers are owned and
+ * pooled by their queue: obtain them from SGTimerQueue::allocate() and
+ * hand them back with SGTimerQueue::release().
+ */
 class SGTimer
 {
 public:
@@ -19,8 +29,29 @@ public:
     SGCallback* callback;
     bool repeat;
     bool running;
+    const char* profileName = nullptr; ///< interned name for SGProfiler
+
+private:
+    friend class SGTimerQueue;
+
+    double _due = 0.0;          ///< absolute queue time to fire at
+    uint64_t _seq = 0;          ///< bumped on every insert
+    int _slot = -1;             ///< wheel slot, or one of SGTimerQueue::Location
+    SGTimer* _prev = nullptr;   ///< slot list (or free list) links
+    SGTimer* _next = nullptr;
+    SGTimer* _namePrev = nullptr; ///< timers sharing the same name
+    SGTimer* _nameNext = nullptr;
 };
 
+/**
+ * Hierarchical timing wheel holding the timers of one time base.
+ *
+ * Time is divided into ticks of TICK_SEC; four levels of 256 slots each
+ * cover roughly 49 days, with anything further out kept on an overflow
+ * list. Insert and remove are O(1); timers migrate to finer levels as
+ * their due time approaches. Timers which become due within one update()
+ * fire in order of their exact due time.
+ */
 class SGTimerQueue
 {
 public:
@@ -31,43 +62,64 @@ public:
 
     double now() { return _now; }
 
+    /// take a blank timer from the pool
+    SGTimer* allocate();
+    /// return a timer which is not queued to the pool
+    void     release(SGTimer* timer);
+
+    /// schedule @a timer to fire @a time seconds from now()
     void     insert(SGTimer* timer, double time);
+    /// unschedule @a timer, returns nullptr if it was not queued
     SGTimer* remove(SGTimer* timer);
-    SGTimer* remove();
-
-    SGTimer* nextTimer() { return _numEntries ? _table[0].timer : 0; }
-    double   nextTime()  { return -_table[0].pri; }
 
     SGTimer* findByName(const std::string& name) const;
 
+    /// number of queued timers
+    size_t   size() const { return _numEntries; }
+
     void dump();
 
+    static constexpr double TICK_SEC = 0.001;
+
 private:
-    // The "priority" is stored as a negative time.  This allows the
-    // implementation to treat the "top" of the heap as the largest
-    // value and avoids developer mindbugs. ;)
-    struct HeapEntry { double pri; SGTimer* timer; };
-
-    int parent(int n) { return ((n+1)/2) - 1; }
-    int lchild(int n) { return ((n+1)*2) - 1; }
-    int rchild(int n) { return ((n+1)*2 + 1) - 1; }
-    double pri(int n) { return _table[n].pri; }
-    void swap(int a, int b) {
-        HeapEntry tmp = _table[a];
-        _table[a] = _table[b];
-        _table[b] = tmp;
-    }
-    void siftDown(int n);
-    void siftUp(int n);
-    void growArray();
-
-    // gcc complains there is no function specification anywhere.
-    // void check();
+    enum Location {
+        LOC_NONE = -1,      ///< allocated, not queued
+        LOC_FREE = -2,      ///< on the free list
+        LOC_OVERFLOW = -3,  ///< beyond the top level
+        LOC_FIRING = -4     ///< due in the current update()
+    };
+
+    static const int WHEEL_BITS = 8;
+    static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+    static const int WHEEL_MASK = WHEEL_SLOTS - 1;
+    static const int WHEEL_LEVELS = 4;
+
+    int64_t tickFor(double time) const;
+    void place(SGTimer* timer);
+    void unlink(SGTimer* timer);
+    void linkName(SGTimer* timer);
+    void unlinkName(SGTimer* timer);
+    void cascade();
+    void fireCurrentTick(std::map<std::string, double> &timingStats);
+
+    struct Firing {
+        double due;
+        uint64_t seq;
+        SGTimer* timer;
+    };
 
     double _now;
-    HeapEntry *_table;
-    int _numEntries;
-    int _tableSize;
+    int64_t _curTick;
+    uint64_t _nextSeq;
+    size_t _numEntries;
+    SGTimer* _slots[WHEEL_LEVELS * WHEEL_SLOTS];
+    int _levelCount[WHEEL_LEVELS];
+    SGTimer* _overflow;
+
+    std::deque<SGTimer> _storage;
+    SGTimer* _freeList;
+    std::unordered_map<std::string, SGTimer*> _byName;
+    std::vector<Firing> _firing;
 };
 
 class SGEventMgr : public SGSubsystem
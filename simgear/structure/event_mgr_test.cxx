@@ -0,0 +1,187 @@
+#include <simgear_config.h>
+
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <simgear/compiler.h>
+#include <simgear/structure/event_mgr.hxx>
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/props/props.hxx>
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+std::vector<string> global_fired;
+
+void fireA() { global_fired.push_back("a"); }
+void fireB() { global_fired.push_back("b"); }
+void fireC() { global_fired.push_back("c"); }
+
+SGSharedPtr<SGEventMgr> makeEventMgr(SGPropertyNode* rtProp = nullptr)
+{
+    SGSharedPtr<SGEventMgr> mgr = new SGEventMgr;
+    if (rtProp)
+        mgr->setRealtimeProperty(rtProp);
+    mgr->init();
+    return mgr;
+}
+
+void testOrdering()
+{
+    global_fired.clear();
+    auto mgr = makeEventMgr();
+
+    // all due within the same update, and within the same wheel tick
+    mgr->addEvent("c", &fireC, 0.5003, true);
+    mgr->addEvent("a", &fireA, 0.5001, true);
+    mgr->addEvent("b", &fireB, 0.5002, true);
+
+    mgr->update(0.4);
+    SG_VERIFY(global_fired.empty());
+
+    mgr->update(0.2);
+    SG_CHECK_EQUAL(global_fired.size(), 3);
+    SG_CHECK_EQUAL(global_fired[0], "a");
+    SG_CHECK_EQUAL(global_fired[1], "b");
+    SG_CHECK_EQUAL(global_fired[2], "c");
+
+    // one-shot events are gone
+    mgr->update(10.0);
+    SG_CHECK_EQUAL(global_fired.size(), 3);
+}
+
+void testRepeatAndRemove()
+{
+    global_fired.clear();
+    auto mgr = makeEventMgr();
+
+    mgr->addTask("a", &fireA, 1.0, 0.0, true);
+    for (int i = 0; i < 10; ++i) {
+        mgr->update(0.5);
+    }
+    // first fire on the first frame, then once per second
+    SG_CHECK_EQUAL(std::count(global_fired.begin(), global_fired.end(), "a"), 5);
+
+    // a repeating task fires at most once per update
+    global_fired.clear();
+    mgr->update(10.0);
+    SG_CHECK_EQUAL(global_fired.size(), 1);
+
+    mgr->removeTask("a");
+    global_fired.clear();
+    mgr->update(10.0);
+    SG_VERIFY(global_fired.empty());
+}
+
+struct SelfRemover {
+    SGEventMgr* mgr;
+    int count = 0;
+    void fire()
+    {
+        ++count;
+        mgr->removeTask("self");
+        // removing a task due later in this same update cancels it
+        mgr->removeTask("victim");
+    }
+};
+
+void testRemoveFromCallback()
+{
+    global_fired.clear();
+    auto mgr = makeEventMgr();
+
+    SelfRemover remover;
+    remover.mgr = mgr.ptr();
+    mgr->addTask("self", &remover, &SelfRemover::fire, 0.1, 0.1, true);
+    mgr->addEvent("victim", &fireA, 0.15, true);
+
+    mgr->update(0.2);
+    SG_CHECK_EQUAL(remover.count, 1);
+    SG_VERIFY(global_fired.empty());
+
+    mgr->update(1.0);
+    SG_CHECK_EQUAL(remover.count, 1);
+}
+
+void testLongDelays()
+{
+    global_fired.clear();
+    auto mgr = makeEventMgr();
+
+    // these land on the coarser wheel levels and must cascade down
+    mgr->addEvent("c", &fireC, 3600.0 * 24 * 60, true); // beyond the top level
+    mgr->addEvent("b", &fireB, 5000.0, true);
+    mgr->addEvent("a", &fireA, 70.0, true);
+
+    mgr->update(69.9);
+    SG_VERIFY(global_fired.empty());
+    mgr->update(0.2);
+    SG_CHECK_EQUAL(global_fired.size(), 1);
+    SG_CHECK_EQUAL(global_fired.back(), "a");
+
+    for (int i = 0; i < 100; ++i) {
+        mgr->update(49.0);
+    }
+    SG_CHECK_EQUAL(global_fired.size(), 1);
+    mgr->update(49.0);
+    SG_CHECK_EQUAL(global_fired.size(), 2);
+    SG_CHECK_EQUAL(global_fired.back(), "b");
+
+    mgr->update(3600.0 * 24 * 60 - 5000.0);
+    SG_CHECK_EQUAL(global_fired.size(), 3);
+    SG_CHECK_EQUAL(global_fired.back(), "c");
+}
+
+void testDuplicateNames()
+{
+    global_fired.clear();
+    auto mgr = makeEventMgr();
+
+    for (int i = 0; i < 1000; ++i) {
+        mgr->addEvent("dup", &fireA, 1.0 + i * 0.01, true);
+    }
+
+    // remove a hundred of them, the rest all fire
+    for (int i = 0; i < 100; ++i) {
+        mgr->removeTask("dup");
+    }
+    mgr->update(20.0);
+    SG_CHECK_EQUAL(global_fired.size(), 900);
+}
+
+void testRealtimeQueue()
+{
+    global_fired.clear();
+    SGPropertyNode_ptr rt(new SGPropertyNode);
+    auto mgr = makeEventMgr(rt);
+
+    mgr->addEvent("a", &fireA, 0.5, false);
+    mgr->addEvent("b", &fireB, 0.5, true);
+
+    rt->setDoubleValue(0.0);
+    mgr->update(1.0);
+    SG_CHECK_EQUAL(global_fired.size(), 1);
+    SG_CHECK_EQUAL(global_fired.back(), "b");
+
+    rt->setDoubleValue(1.0);
+    mgr->update(0.0);
+    SG_CHECK_EQUAL(global_fired.size(), 2);
+    SG_CHECK_EQUAL(global_fired.back(), "a");
+}
+
+int main(int argc, char* argv[])
+{
+    testOrdering();
+    testRepeatAndRemove();
+    testRemoveFromCallback();
+    testLongDelays();
+    testDuplicateNames();
+    testRealtimeQueue();
+
+    cout << __FILE__ << ": All tests passed" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+#include <simgear_config.h>
+
+#include <cstdio>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <simgear/compiler.h>
+#include <simgear/structure/SGProfiler.hxx>
+#include <simgear/structure/subsystem_mgr.hxx>
+#include <simgear/misc/test_macros.hxx>
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+size_t countOf(const string& haystack, const string& needle)
+{
+    size_t count = 0;
+    for (size_t pos = haystack.find(needle); pos != string::npos;
+         pos = haystack.find(needle, pos + needle.size())) {
+        ++count;
+    }
+    return count;
+}
+
+string exportTrace()
+{
+    std::ostringstream os;
+    SGProfiler::writeChromeTrace(os);
+    return os.str();
+}
+
+void testNestedZones()
+{
+    SGProfiler::clear();
+    SGProfiler::setEnabled(false);
+    {
+        SG_PROFILE_ZONE("disabled-zone");
+    }
+
+    SGProfiler::setEnabled(true);
+    SGProfiler::setThreadName("main \"test\"");
+    {
+        SG_PROFILE_ZONE("outer-zone");
+        for (int i = 0; i < 3; ++i) {
+            SG_PROFILE_ZONE("inner-zone");
+        }
+        SGProfiler::mark("a-mark");
+    }
+    SGProfiler::setEnabled(false);
+
+    const string trace = exportTrace();
+    SG_CHECK_EQUAL(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0);
+    SG_CHECK_EQUAL(countOf(trace, "disabled-zone"), 0);
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"outer-zone\",\"ph\":\"X\""), 1);
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"inner-zone\",\"ph\":\"X\""), 3);
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"a-mark\",\"ph\":\"i\""), 1);
+    SG_VERIFY(trace.find("\"args\":{\"name\":\"main \\\"test\\\"\"}") != string::npos);
+
+    // inner zones close before the outer one, so they come first
+    SG_VERIFY(trace.find("inner-zone") < trace.find("outer-zone"));
+
+    SGProfiler::clear();
+    SG_CHECK_EQUAL(countOf(trace, "zone"), 4);
+    SG_CHECK_EQUAL(countOf(exportTrace(), "inner-zone"), 0);
+}
+
+void testRingBuffer()
+{
+    SGProfiler::clear();
+    SGProfiler::setEnabled(true);
+
+    // the ring is sized when the thread records its first zone, not
+    // when it first turns up
+    std::mutex lock;
+    std::condition_variable cond;
+    bool named = false, resized = false;
+    std::thread t([&]() {
+        SGProfiler::setThreadName("ring-test");
+        std::unique_lock<std::mutex> g(lock);
+        named = true;
+        cond.notify_all();
+        cond.wait(g, [&resized]() { return resized; });
+        for (int i = 0; i < 100; ++i) {
+            SG_PROFILE_ZONE("ring-zone");
+        }
+    });
+    {
+        std::unique_lock<std::mutex> g(lock);
+        cond.wait(g, [&named]() { return named; });
+        SGProfiler::setBufferSize(8);
+        resized = true;
+        cond.notify_all();
+    }
+    t.join();
+    SGProfiler::setEnabled(false);
+    SGProfiler::setBufferSize(16384);
+
+    const string trace = exportTrace();
+    SG_VERIFY(trace.find("ring-test") != string::npos);
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"ring-zone\""), 8);
+}
+
+void testExitedThreads()
+{
+    SGProfiler::clear();
+    SGProfiler::setEnabled(true);
+    std::thread t([]() {
+        SGProfiler::setThreadName("exited-thread");
+        for (int i = 0; i < 3; ++i) {
+            SG_PROFILE_ZONE("exited-zone");
+        }
+    });
+    t.join();
+
+    // a thread which never records a zone has nothing to export
+    std::thread idle([]() {
+        SGProfiler::setThreadName("idle-thread");
+    });
+    idle.join();
+    SGProfiler::setEnabled(false);
+
+    string trace = exportTrace();
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"exited-zone\""), 3);
+    SG_VERIFY(trace.find("exited-thread") != string::npos);
+    SG_VERIFY(trace.find("idle-thread") != string::npos);
+
+    // once written out, the buffers of exited threads are gone
+    trace = exportTrace();
+    SG_CHECK_EQUAL(countOf(trace, "exited-zone"), 0);
+    SG_CHECK_EQUAL(countOf(trace, "exited-thread"), 0);
+    SG_CHECK_EQUAL(countOf(trace, "idle-thread"), 0);
+}
+
+class ZoneSub : public SGSubsystem
+{
+public:
+    static const char* staticSubsystemClassId() { return "zone-sub"; }
+
+    void update(double dt) override
+    {
+        SG_PROFILE_ZONE("zone-sub-work");
+        stamp("zone-sub-stamp");
+    }
+};
+
+void testSubsystemZones()
+{
+    SGProfiler::clear();
+    SGSharedPtr<SGSubsystemMgr> manager = new SGSubsystemMgr();
+    manager->add("zone-sub", new ZoneSub);
+    manager->bind();
+    manager->init();
+
+    SGProfiler::setEnabled(true);
+    manager->update(0.1);
+    manager->update(0.1);
+    SGProfiler::setEnabled(false);
+
+    const string trace = exportTrace();
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"zone-sub\",\"ph\":\"X\""), 2);
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"zone-sub-work\",\"ph\":\"X\""), 2);
+    SG_CHECK_EQUAL(countOf(trace, "\"name\":\"zone-sub-stamp\",\"ph\":\"i\""), 2);
+}
+
+int main(int argc, char* argv[])
+{
+    testNestedZones();
+    testRingBuffer();
+    testExitedThreads();
+    testSubsystemZones();
+
+    cout << __FILE__ << ": All tests passed" << endl;
+    return EXIT_SUCCESS;
+}
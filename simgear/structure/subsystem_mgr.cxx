@@ -21,7 +21,14 @@
 #include <simgear_config.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include <simgear/debug/logstream.hxx>
 #include <simgear/timing/timestamp.hxx>
@@ -29,6 +36,7 @@
 #include "exception.hxx"
 #include "subsystem_mgr.hxx"
 #include "commands.hxx"
+#include "SGProfiler.hxx"
 
 #include <simgear/props/props.hxx>
 #include <simgear/math/SGMath.hxx>
@@ -134,6 +142,13 @@ SGSubsystem::is_suspended () const
 void SGSubsystem::stamp(const string& name)
 {
     timingInfo.push_back(TimingInfo(name, SGTimeStamp::now()));
+    if (SGProfiler::isEnabled()) {
+        const char*& profileName = _profileNames[name];
+        if (!profileName) {
+            profileName = SGProfiler::internName(name);
+        }
+        SGProfiler::mark(profileName);
+    }
 }
 
 void SGSubsystem::set_name(const std::string &n)
@@ -229,6 +244,272 @@ public:
     int initTime;
 
     void mergeTimerStats(SGSubsystem::TimerStats &stats);
+
+    // parallel scheduling state, see SGSubsystemGroup::buildSchedule()
+    string_list reads, writes;
+    bool accessDeclared = false;
+    std::vector<int> successors;
+    int predecessorCount = 0;
+    std::atomic<int> pendingCount{0};
+    double lastUpdateMSec = 0.0;
+    std::exception_ptr error;
+
+    /// interned copy of name, for SGProfiler zones
+    const char* profileName = nullptr;
+};
+
+namespace {
+
+/**
+ * Small work-stealing pool used by parallel subsystem groups. Each worker
+ * owns a deque; it pushes and pops at the back of its own deque, and steals
+ * from the front of the others when it runs dry. Slot zero is shared by all
+ * threads which are not pool workers. Threads waiting for a group to finish
+ * help run queued tasks, so parallel groups nested inside parallel groups
+ * cannot starve the pool.
+ */
+class SubsystemWorkerPool
+{
+public:
+    struct Task {
+        void (*fn)(void* context, int index);
+        void* context;
+        int index;
+    };
+
+    static SubsystemWorkerPool& instance()
+    {
+        static SubsystemWorkerPool pool;
+        return pool;
+    }
+
+    void push(const Task& task)
+    {
+        Queue& q = *_queues[currentSlot];
+        {
+            std::lock_guard<std::mutex> g(q.lock);
+            q.tasks.push_back(task);
+        }
+        _queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> g(_sleepLock);
+        }
+        _wake.notify_one();
+    }
+
+    /// run tasks until @a remaining drops to zero
+    void helpUntilDone(const std::atomic<int>& remaining)
+    {
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!runOne()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    SubsystemWorkerPool()
+    {
+        const unsigned int hw = std::thread::hardware_concurrency();
+        const unsigned int count = (hw > 2) ? hw - 1 : 1;
+        for (unsigned int i = 0; i <= count; ++i) {
+            _queues.emplace_back(new Queue);
+        }
+        for (unsigned int i = 0; i < count; ++i) {
+            _threads.emplace_back([this, i]() { workerMain(i + 1); });
+        }
+    }
+
+    ~SubsystemWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> g(_sleepLock);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto& t : _threads) {
+            t.join();
+        }
+    }
+
+    bool takeTask(Task& task)
+    {
+        const size_t n = _queues.size();
+        {
+            Queue& own = *_queues[currentSlot];
+            std::lock_guard<std::mutex> g(own.lock);
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < n; ++i) {
+            Queue& victim = *_queues[(currentSlot + i) % n];
+            std::lock_guard<std::mutex> g(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool runOne()
+    {
+        if (_queued.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+
+        Task task;
+        if (!takeTask(task)) {
+            return false;
+        }
+
+        _queued.fetch_sub(1, std::memory_order_acq_rel);
+        task.fn(task.context, task.index);
+        return true;
+    }
+
+    void workerMain(unsigned int slot)
+    {
+        currentSlot = slot;
+        SGProfiler::setThreadName("subsystem-worker-" + std::to_string(slot));
+        while (true) {
+            if (runOne()) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lk(_sleepLock);
+            _wake.wait(lk, [this] {
+                return _stop || (_queued.load(std::memory_order_acquire) > 0);
+            });
+            if (_stop) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+    std::atomic<int> _queued{0};
+    std::mutex _sleepLock;
+    std::condition_variable _wake;
+    bool _stop = false;
+
+    static thread_local unsigned int currentSlot;
+};
+
+thread_local unsigned int SubsystemWorkerPool::currentSlot = 0;
+
+/// true if one path is equal to, or a parent of, the other
+bool accessOverlaps(const std::string& a, const std::string& b)
+{
+    const std::string& shorter = (a.size() <= b.size()) ? a : b;
+    const std::string& longer = (a.size() <= b.size()) ? b : a;
+    if (longer.compare(0, shorter.size(), shorter) != 0) {
+        return false;
+    }
+
+    return (longer.size() == shorter.size()) ||
+           (shorter.back() == '/') || (longer[shorter.size()] == '/');
+}
+
+bool accessConflicts(const string_list& writes, const string_list& other)
+{
+    for (const auto& w : writes) {
+        for (const auto& o : other) {
+            if (accessOverlaps(w, o)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // of anonymous namespace
+
+/**
+ * State for one pass over a parallel group's members: each ready member
+ * is pushed to the worker pool, and on completion releases its successors.
+ */
+class SGSubsystemGroup::ParallelRun
+{
+public:
+    ParallelRun(SGSubsystemGroup* group, double dt) :
+        _group(group),
+        _dt(dt)
+    {
+    }
+
+    void run()
+    {
+        auto& members = _group->_members;
+        _remaining.store(static_cast<int>(members.size()), std::memory_order_relaxed);
+        for (auto m : members) {
+            m->pendingCount.store(m->predecessorCount, std::memory_order_relaxed);
+            m->error = nullptr;
+        }
+
+        auto& pool = SubsystemWorkerPool::instance();
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (members[i]->predecessorCount == 0) {
+                pool.push({&ParallelRun::runMember, this, static_cast<int>(i)});
+            }
+        }
+
+        pool.helpUntilDone(_remaining);
+
+        for (auto m : members) {
+            if (m->error) {
+                std::rethrow_exception(m->error);
+            }
+        }
+    }
+
+private:
+    static void runMember(void* context, int index)
+    {
+        auto self = static_cast<ParallelRun*>(context);
+        Member* member = self->_group->_members[index];
+
+        SGTimeStamp timeStamp;
+        timeStamp.stamp();
+        try {
+            auto sub = member->subsystem;
+            if (sub->_timerStats.size()) {
+                sub->_lastTimerStats.clear();
+                sub->_lastTimerStats.insert(sub->_timerStats.begin(), sub->_timerStats.end());
+            }
+            member->update(self->_dt);
+        } catch (...) {
+            member->error = std::current_exception();
+        }
+        member->lastUpdateMSec = timeStamp.elapsedMSec();
+
+        auto& pool = SubsystemWorkerPool::instance();
+        for (int s : member->successors) {
+            Member* succ = self->_group->_members[s];
+            if (succ->pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                pool.push({&ParallelRun::runMember, self, s});
+            }
+        }
+
+        // must be the final access to 'self', the owning thread may
+        // destroy it as soon as this reaches zero
+        self->_remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    SGSubsystemGroup* _group;
+    double _dt;
+    std::atomic<int> _remaining{0};
 };
 
 
@@ -390,9 +671,31 @@ SGSubsystemGroup::update (double delta_time_sec)
     TimerStats overrunItems;
     bool overrun = false;
 
+    auto recordMemberTime = [&](Member* member, double elapsedMSec) {
+        if (member->name.size())
+            _timerStats[member->name] += elapsedMSec / 1000.0;
+
+        if (recordTime && reportTimingCb) {
+            member->updateExecutionTime(elapsedMSec*1000);
+            if (elapsedMSec > SGSubsystemMgr::maxTimePerFrame_ms) {
+                overrunItems[member->name] += elapsedMSec;
+                overrun = true;
+            }
+        }
+    };
+
     SGTimeStamp outerTimeStamp;
     outerTimeStamp.stamp();
     while (loopCount-- > 0) {
+        if (_parallel && (_members.size() > 1)) {
+            updateParallel(delta_time_sec);
+            // fold timings on this thread, in member order
+            for (auto member : _members) {
+                recordMemberTime(member, member->lastUpdateMSec);
+            }
+            continue;
+        }
+
         for (auto member : _members) {
 
           timeStamp.stamp();
@@ -401,16 +704,7 @@ SGSubsystemGroup::update (double delta_time_sec)
               member->subsystem->_lastTimerStats.insert(member->subsystem->_timerStats.begin(), member->subsystem->_timerStats.end());
           }
           member->update(delta_time_sec); // indirect call
-          if (member->name.size())
-              _timerStats[member->name] += timeStamp.elapsedMSec() / 1000.0;
-
-          if (recordTime && reportTimingCb) {
-              member->updateExecutionTime(timeStamp.elapsedMSec()*1000);
-              if (timeStamp.elapsedMSec() > SGSubsystemMgr::maxTimePerFrame_ms) {
-                  overrunItems[member->name] += timeStamp.elapsedMSec();
-                  overrun = true;
-              }
-          }
+          recordMemberTime(member, timeStamp.elapsedMSec());
       }
     } // of multiple update loop
     _lastExecutionTime = _executionTime;
@@ -464,6 +758,109 @@ SGSubsystemGroup::update (double delta_time_sec)
     _lastTimerStats.insert(_timerStats.begin(), _timerStats.end());
 
 }
+void
+SGSubsystemGroup::updateParallel(double delta_time_sec)
+{
+    if (_scheduleDirty) {
+        buildSchedule();
+    }
+
+    ParallelRun run(this, delta_time_sec);
+    run.run();
+}
+
+void
+SGSubsystemGroup::buildSchedule()
+{
+    const size_t count = _members.size();
+
+    // gather what each member touches, as declared explicitly and widened
+    // by its registration. The registration alone only tells the init
+    // order, so members without declared access are barriers.
+    std::vector<string_list> reads(count), writes(count), depends(count);
+    std::vector<bool> barrier(count, false);
+    for (size_t i = 0; i < count; ++i) {
+        Member* m = _members[i];
+        m->successors.clear();
+        m->predecessorCount = 0;
+        reads[i] = m->reads;
+        writes[i] = m->writes;
+
+        barrier[i] = !m->accessDeclared;
+        if (m->accessDeclared && !m->subsystem->is_group()) {
+            try {
+                const auto& deps = SGSubsystemMgr::dependsFor(m->subsystem->subsystemClassId().c_str());
+                for (const auto& d : deps) {
+                    switch (d.type) {
+                    case SGSubsystemMgr::Dependency::HARD:
+                    case SGSubsystemMgr::Dependency::SOFT:
+                    case SGSubsystemMgr::Dependency::SEQUENCE:
+                        depends[i].push_back(d.name);
+                        break;
+                    case SGSubsystemMgr::Dependency::PROPERTY:
+                        reads[i].push_back(d.name);
+                        break;
+                    default:
+                        break;
+                    }
+                }
+            } catch (sg_exception&) {
+                // not registered, nothing to learn
+            }
+        }
+    }
+
+    auto names = [this](size_t i, const string_list& deps) {
+        const Member* m = _members[i];
+        const std::string classId = m->subsystem->subsystemClassId();
+        return std::any_of(deps.begin(), deps.end(), [&](const std::string& d) {
+            return (d == m->name) || (d == classId);
+        });
+    };
+
+    // edges always run from the earlier member to the later one, so the
+    // graph is acyclic and dependent members keep their serial order
+    for (size_t j = 1; j < count; ++j) {
+        for (size_t i = 0; i < j; ++i) {
+            const bool ordered = barrier[i] || barrier[j] ||
+                names(i, depends[j]) || names(j, depends[i]) ||
+                accessConflicts(writes[i], reads[j]) ||
+                accessConflicts(writes[i], writes[j]) ||
+                accessConflicts(writes[j], reads[i]);
+            if (ordered) {
+                _members[i]->successors.push_back(static_cast<int>(j));
+                _members[j]->predecessorCount++;
+            }
+        }
+    }
+
+    _scheduleDirty = false;
+}
+
+void
+SGSubsystemGroup::set_parallel(bool parallel)
+{
+    _parallel = parallel;
+    _scheduleDirty = true;
+}
+
+void
+SGSubsystemGroup::declare_member_access(const std::string& name,
+                                        const string_list& reads,
+                                        const string_list& writes)
+{
+    Member* member = get_member(name, false);
+    if (!member) {
+        SG_LOG(SG_GENERAL, SG_DEV_WARN, "declare_member_access: no member named '" << name << "'");
+        return;
+    }
+
+    member->reads = reads;
+    member->writes = writes;
+    member->accessDeclared = true;
+    _scheduleDirty = true;
+}
+
 void SGSubsystem::reportTimingStats(TimerStats *__lastValues) {
     std::string _name = "";
 
@@ -587,6 +984,7 @@ SGSubsystemGroup::set_subsystem (const string &name, SGSubsystem * subsystem,
     member->subsystem = subsystem;
     member->min_step_sec = min_step_sec;
     subsystem->set_group(this);
+    _scheduleDirty = true;
     notifyDidChange(subsystem, State::ADD);
     
     if (_state != State::INVALID && (_state <= State::POSTINIT)) {
@@ -673,6 +1071,7 @@ SGSubsystemGroup::remove_subsystem(const string &name)
         notifyWillChange(sub, State::REMOVE);
         delete *it;
         _members.erase(it);
+        _scheduleDirty = true;
         notifyDidChange(sub, State::REMOVE);
         return true;
     }
@@ -724,6 +1123,7 @@ void SGSubsystemGroup::clearSubsystems()
     }
     
     _members.clear();
+    _scheduleDirty = true;
 }
 
 void
@@ -813,6 +1213,11 @@ SGSubsystemGroup::Member::update (double delta_time_sec)
         return;
     }
     
+    if (!profileName && SGProfiler::isEnabled()) {
+        profileName = SGProfiler::internName(name);
+    }
+    SGProfileZone zone(profileName);
+
     SGTimeStamp oTimer;
     try {
         oTimer.stamp();
@@ -960,6 +1365,9 @@ SGSubsystemMgr::update (double delta_time_sec)
     for (int i = 0; i < MAX_GROUPS; i++) {
         _groups[i]->update(delta_time_sec);
     }
+
+    // deliver the property changes queued during this frame
+    SGPropertyChangeListener::fireCoalescedChanges();
     reportTimingStatsRequest = false;
 }
 
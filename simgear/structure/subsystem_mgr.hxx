@@ -369,6 +369,9 @@ private:
     std::string _subsystemId;
 
     SGSubsystemGroup* _group = nullptr;
+
+    /// stamp() names interned for the profiler, to skip its global lock
+    std::map<std::string, const char*> _profileNames;
 protected:
     TimerStats _timerStats, _lastTimerStats;
     double _executionTime;
@@ -428,6 +431,37 @@ public:
      */
     string_list member_names() const;
 
+    /**
+     * Enable or disable parallel update of this group's members.
+     *
+     * <p>In parallel mode, members which do not depend on each other are
+     * updated concurrently on a shared work-stealing thread pool; members
+     * which do depend on each other still run in member order. Only members
+     * whose accesses have been declared (see declare_member_access()) run
+     * concurrently at all; all others are treated as barriers and run
+     * alone, since nothing tells what state they touch. Two members with
+     * declared accesses depend on each other when either names the other as
+     * a HARD, SOFT or SEQUENCE dependency in its registration, or when
+     * their accesses overlap with at least one of them writing. PROPERTY
+     * dependencies from the registration count as reads.</p>
+     *
+     * <p>Members must not add or remove subsystems from this group while
+     * it is updating in parallel mode.</p>
+     */
+    void set_parallel(bool parallel);
+
+    bool is_parallel() const
+    { return _parallel; }
+
+    /**
+     * Declare the property subtrees (or other named resources) a member
+     * reads and writes during update(), for scheduling in parallel mode.
+     * Paths overlap when one is equal to, or a parent of, the other.
+     */
+    void declare_member_access(const std::string& name,
+                               const string_list& reads,
+                               const string_list& writes);
+
     template<class T>
     T* get_subsystem()
     {
@@ -452,6 +486,10 @@ private:
     
     class Member;
     Member* get_member (const std::string &name, bool create = false);
+
+    class ParallelRun;
+    void buildSchedule();
+    void updateParallel(double delta_time_sec);
     
     using MemberVec = std::vector<Member*>;
     MemberVec _members;
@@ -464,6 +502,10 @@ private:
 
   /// index of the member we are currently init-ing
     int _initPosition;
+
+    bool _parallel = false;
+    /// dependency graph for parallel mode needs rebuilding
+    bool _scheduleDirty = true;
     
     /// back-pointer to the manager, for the root groups. (sub-groups
     /// will have this as null, and chain via their parent)
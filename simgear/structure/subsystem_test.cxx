@@ -2,6 +2,9 @@
 
 #include <cstdio>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include <simgear/compiler.h>
 #include <simgear/constants.h>
@@ -111,6 +114,79 @@ public:
     double lastUpdateTime = 0.0;
 };
 
+// subsystems for the parallel group test: the pair of 'rendezvous' subs
+// only complete if they run concurrently, the others record ordering
+
+std::atomic<int> global_rendezvousCount{0};
+std::atomic<int> global_updateSequence{0};
+std::atomic<int> global_activeUpdates{0};
+
+class RendezvousSub : public SGSubsystem
+{
+public:
+    void update(double dt) override
+    {
+        ++global_rendezvousCount;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while ((global_rendezvousCount.load() < 2) &&
+               (std::chrono::steady_clock::now() < deadline)) {
+            std::this_thread::yield();
+        }
+        metPartner = (global_rendezvousCount.load() >= 2);
+    }
+
+    bool metPartner = false;
+};
+
+class RendezvousSubA : public RendezvousSub
+{
+public:
+    static const char* staticSubsystemClassId() { return "rendezvous-a"; }
+};
+
+class RendezvousSubB : public RendezvousSub
+{
+public:
+    static const char* staticSubsystemClassId() { return "rendezvous-b"; }
+};
+
+class SequenceSub : public SGSubsystem
+{
+public:
+    void update(double dt) override
+    {
+        ++global_activeUpdates;
+        // widen the window for a badly ordered schedule to show up
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        overlapped |= (global_activeUpdates.load() > 1);
+        sequence = ++global_updateSequence;
+        lastUpdateTime = dt;
+        --global_activeUpdates;
+    }
+
+    int sequence = 0;
+    double lastUpdateTime = 0.0;
+    bool overlapped = false; ///< another SequenceSub updated at the same time
+};
+
+class ProducerSub : public SequenceSub
+{
+public:
+    static const char* staticSubsystemClassId() { return "producer"; }
+};
+
+class ConsumerSub : public SequenceSub
+{
+public:
+    static const char* staticSubsystemClassId() { return "consumer"; }
+};
+
+class UndeclaredSub : public SequenceSub
+{
+public:
+    static const char* staticSubsystemClassId() { return "undeclared"; }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // sample delegate
 
@@ -162,6 +238,13 @@ SGSubsystemMgr::Registrant<InstrumentGroup> registrant4(SGSubsystemMgr::FDM);
 
 SGSubsystemMgr::InstancedRegistrant<FakeRadioSub> registrant3(SGSubsystemMgr::POST_FDM);
 
+SGSubsystemMgr::Registrant<RendezvousSubA> registrant5(SGSubsystemMgr::GENERAL);
+SGSubsystemMgr::Registrant<RendezvousSubB> registrant6(SGSubsystemMgr::GENERAL);
+SGSubsystemMgr::Registrant<ProducerSub> registrant7(SGSubsystemMgr::GENERAL);
+SGSubsystemMgr::Registrant<ConsumerSub> registrant8(SGSubsystemMgr::GENERAL,
+    {{"producer", SGSubsystemMgr::Dependency::HARD}});
+SGSubsystemMgr::Registrant<UndeclaredSub> registrant9(SGSubsystemMgr::GENERAL);
+
 void testRegistrationAndCreation()
 {
     SGSharedPtr<SGSubsystemMgr> manager = new SGSubsystemMgr();
@@ -534,6 +617,75 @@ void testAddRemoveAfterInit()
     SG_VERIFY(d->hasEvent("fake-radio.com2-did-remove"));
 }
 
+void testParallelGroup()
+{
+    SGSharedPtr<SGSubsystemMgr> manager = new SGSubsystemMgr();
+    auto group = manager->get_group(SGSubsystemMgr::GENERAL);
+    group->set_parallel(true);
+    SG_VERIFY(group->is_parallel());
+
+    // consumer is added first, but depends on the producer via its
+    // registration; the rendezvous pair are independent
+    auto consumer = manager->add<ConsumerSub>();
+    auto rendezvousA = manager->add<RendezvousSubA>();
+    auto producer = manager->add<ProducerSub>();
+    auto rendezvousB = manager->add<RendezvousSubB>();
+    for (auto name : {"consumer", "rendezvous-a", "producer", "rendezvous-b"}) {
+        group->declare_member_access(name, {}, {});
+    }
+
+    manager->bind();
+    manager->init();
+    manager->postinit();
+    manager->update(0.5);
+
+    SG_VERIFY(rendezvousA->metPartner);
+    SG_VERIFY(rendezvousB->metPartner);
+
+    // dependent members keep member order
+    SG_VERIFY(consumer->sequence > 0);
+    SG_VERIFY(producer->sequence > 0);
+    SG_VERIFY(consumer->sequence < producer->sequence);
+    SG_CHECK_EQUAL(producer->lastUpdateTime, 0.5);
+
+    // declared accesses: the second writer of an overlapping path runs
+    // after the first, readers of an unrelated path are free
+    SGSharedPtr<SGSubsystemGroup> inner = new SGSubsystemGroup;
+    inner->set_parallel(true);
+    auto writerA = new SequenceSub;
+    auto writerB = new SequenceSub;
+    auto reader = new SequenceSub;
+    inner->set_subsystem("writer-a", writerA);
+    inner->set_subsystem("writer-b", writerB);
+    inner->set_subsystem("reader", reader);
+    inner->declare_member_access("writer-a", {}, {"/instrumentation/nav"});
+    inner->declare_member_access("writer-b", {}, {"/instrumentation/nav/frequencies"});
+    inner->declare_member_access("reader", {"/instrumentation/comm"}, {});
+
+    inner->update(0.1);
+    SG_VERIFY(writerA->sequence < writerB->sequence);
+    SG_CHECK_EQUAL(reader->lastUpdateTime, 0.1);
+
+    // a registered member without declared access is still a barrier
+    auto undeclared = manager->create<UndeclaredSub>();
+    auto readerB = new SequenceSub;
+    inner->set_subsystem("undeclared", undeclared);
+    inner->set_subsystem("reader-b", readerB);
+    inner->declare_member_access("reader-b", {"/instrumentation/comm"}, {});
+    inner->update(0.2);
+    SG_VERIFY(!undeclared->overlapped);
+    SG_VERIFY(writerB->sequence < undeclared->sequence);
+    SG_VERIFY(reader->sequence < undeclared->sequence);
+    SG_VERIFY(undeclared->sequence < readerB->sequence);
+
+    // serial mode is unaffected (the rendezvous pair would wait for each
+    // other until the deadline, so pre-satisfy them)
+    global_rendezvousCount = 2;
+    group->set_parallel(false);
+    manager->update(0.1);
+    SG_VERIFY(consumer->sequence < producer->sequence);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -547,6 +699,7 @@ int main(int argc, char* argv[])
     testPropertyRoot();
     testAddRemoveAfterInit();
     testEmptyGroup();
+    testParallelGroup();
     
     cout << __FILE__ << ": All tests passed" << endl;
     return EXIT_SUCCESS;